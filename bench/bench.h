@@ -0,0 +1,149 @@
+/* Helpers shared by the headless benchmark hosts */
+#ifndef CPLUG_BENCH_H
+#define CPLUG_BENCH_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Blocks processed before we start measuring. Lets caches & branch predictors settle
+#define BENCH_NUM_WARMUP_BLOCKS 64
+#define BENCH_HISTOGRAM_WIDTH 50
+
+#define bench_check(cond, ...)                                                                                         \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "bench: " __VA_ARGS__);                                                                        \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+typedef struct BenchOptions
+{
+    const char* path;
+    uint32_t    blockSize;
+    double      sampleRate;
+    uint32_t    numBlocks;
+    uint32_t    numAutomationPoints; // Per parameter, per block
+} BenchOptions;
+
+static void bench_parseArgs(BenchOptions* opts, int argc, char** argv, const char* defaultPath)
+{
+    opts->path                = defaultPath;
+    opts->blockSize           = 512;
+    opts->sampleRate          = 48000;
+    opts->numBlocks           = 10000;
+    opts->numAutomationPoints = 4;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (! strcmp(argv[i], "-b") && i + 1 < argc)
+            opts->blockSize = (uint32_t)atoi(argv[++i]);
+        else if (! strcmp(argv[i], "-r") && i + 1 < argc)
+            opts->sampleRate = atof(argv[++i]);
+        else if (! strcmp(argv[i], "-n") && i + 1 < argc)
+            opts->numBlocks = (uint32_t)atoi(argv[++i]);
+        else if (! strcmp(argv[i], "-a") && i + 1 < argc)
+            opts->numAutomationPoints = (uint32_t)atoi(argv[++i]);
+        else if (argv[i][0] != '-')
+            opts->path = argv[i];
+        else
+        {
+            fprintf(
+                stderr,
+                "Usage: %s [-b blockSize] [-r sampleRate] [-n numBlocks] [-a automationPointsPerBlock] [plugin]\n",
+                argv[0]);
+            exit(1);
+        }
+    }
+    bench_check(opts->blockSize > 0 && opts->sampleRate > 0 && opts->numBlocks > 0, "Invalid arguments");
+    if (opts->numAutomationPoints > opts->blockSize)
+        opts->numAutomationPoints = opts->blockSize;
+}
+
+static uint64_t bench_nowNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int bench_compareU64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t bench_log2(uint64_t v)
+{
+    uint32_t n = 0;
+    while (v >>= 1)
+        n++;
+    return n;
+}
+
+// Sorts 'times' (ns per block) and prints percentiles, real-time factor & a histogram with power of 2 buckets
+static void bench_printStats(const char* name, const BenchOptions* opts, uint64_t* times)
+{
+    uint32_t numBlocks = opts->numBlocks;
+    double   total     = 0;
+    for (uint32_t i = 0; i < numBlocks; i++)
+        total += times[i];
+    qsort(times, numBlocks, sizeof(uint64_t), bench_compareU64);
+
+    double mean    = total / numBlocks;
+    double p50     = times[numBlocks / 2];
+    double p99     = times[(uint32_t)((numBlocks - 1) * 0.99)];
+    double max     = times[numBlocks - 1];
+    double blockNS = opts->blockSize / opts->sampleRate * 1e9;
+
+    printf(
+        "%s | %.0fHz | block %u | %u blocks | %u automation points/param/block\n",
+        name,
+        opts->sampleRate,
+        opts->blockSize,
+        numBlocks,
+        opts->numAutomationPoints);
+    printf("ns/block  mean %10.0f  p50 %10.0f  p99 %10.0f  max %10.0f\n", mean, p50, p99, max);
+    // Real-time factor: time spent processing / duration of audio processed. Must stay well below 1
+    printf(
+        "RTF       mean %10.5f  p50 %10.5f  p99 %10.5f  max %10.5f\n",
+        mean / blockNS,
+        p50 / blockNS,
+        p99 / blockNS,
+        max / blockNS);
+
+    uint32_t firstBucket = bench_log2(times[0] > 0 ? times[0] : 1);
+    uint32_t lastBucket  = bench_log2(times[numBlocks - 1] > 0 ? times[numBlocks - 1] : 1);
+    uint32_t counts[64]  = {0};
+    uint32_t maxCount    = 0;
+    for (uint32_t i = 0; i < numBlocks; i++)
+    {
+        uint32_t bucket = bench_log2(times[i] > 0 ? times[i] : 1);
+        counts[bucket]++;
+        if (counts[bucket] > maxCount)
+            maxCount = counts[bucket];
+    }
+
+    printf("\n%23s | %8s |\n", "ns/block", "blocks");
+    for (uint32_t bucket = firstBucket; bucket <= lastBucket; bucket++)
+    {
+        uint64_t lo       = 1ull << bucket;
+        uint64_t hi       = (1ull << (bucket + 1)) - 1;
+        uint32_t barWidth = (uint32_t)((uint64_t)counts[bucket] * BENCH_HISTOGRAM_WIDTH / maxCount);
+        if (barWidth == 0 && counts[bucket] > 0)
+            barWidth = 1;
+
+        printf("%10llu - %10llu | %8u | ", (unsigned long long)lo, (unsigned long long)hi, counts[bucket]);
+        for (uint32_t i = 0; i < barWidth; i++)
+            putchar('#');
+        putchar('\n');
+    }
+}
+
+#endif // CPLUG_BENCH_H
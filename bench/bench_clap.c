@@ -0,0 +1,317 @@
+/* Headless CLAP benchmark host (Linux)
+ * Loads a .clap, runs it with synthetic audio, MIDI & parameter automation and reports the time spent inside
+ * clap_plugin_t::process per block. No DAW or audio device required.
+ *
+ * Usage: cplug_bench_clap [-b blockSize] [-r sampleRate] [-n numBlocks] [-a automationPointsPerBlock] [plugin.clap] */
+#include "bench.h"
+#include <clap/clap.h>
+#include <dlfcn.h>
+
+#ifndef CPLUG_BENCH_CLAP_PATH
+#define CPLUG_BENCH_CLAP_PATH "cplug_example.clap"
+#endif
+
+#define BENCH_MAX_PORTS 8
+#define BENCH_MAX_CHANNELS 32
+
+typedef union BenchEvent
+{
+    clap_event_header_t      header;
+    clap_event_midi_t        midi;
+    clap_event_param_value_t param;
+} BenchEvent;
+
+typedef struct BenchEventList
+{
+    BenchEvent* events;
+    uint32_t    numEvents;
+    uint32_t    capacity;
+} BenchEventList;
+
+///////////////
+// Mock host //
+///////////////
+
+static void BenchHostLatency_changed(const clap_host_t* host) {}
+
+static const clap_host_latency_t s_bench_host_latency = {
+    .changed = BenchHostLatency_changed,
+};
+
+static void BenchHostState_mark_dirty(const clap_host_t* host) {}
+
+static const clap_host_state_t s_bench_host_state = {
+    .mark_dirty = BenchHostState_mark_dirty,
+};
+
+static void BenchHostParams_rescan(const clap_host_t* host, clap_param_rescan_flags flags) {}
+static void BenchHostParams_clear(const clap_host_t* host, clap_id param_id, clap_param_clear_flags flags) {}
+static void BenchHostParams_request_flush(const clap_host_t* host) {}
+
+static const clap_host_params_t s_bench_host_params = {
+    .rescan        = BenchHostParams_rescan,
+    .clear         = BenchHostParams_clear,
+    .request_flush = BenchHostParams_request_flush,
+};
+
+static const void* BenchHost_get_extension(const clap_host_t* host, const char* id)
+{
+    if (! strcmp(id, CLAP_EXT_LATENCY))
+        return &s_bench_host_latency;
+    if (! strcmp(id, CLAP_EXT_STATE))
+        return &s_bench_host_state;
+    if (! strcmp(id, CLAP_EXT_PARAMS))
+        return &s_bench_host_params;
+    return NULL;
+}
+
+static void BenchHost_request_restart(const clap_host_t* host) {}
+static void BenchHost_request_process(const clap_host_t* host) {}
+static void BenchHost_request_callback(const clap_host_t* host) {}
+
+static const clap_host_t s_bench_host = {
+    .clap_version     = CLAP_VERSION_INIT,
+    .host_data        = NULL,
+    .name             = "cplug_bench_clap",
+    .vendor           = "CPLUG",
+    .url              = "https://github.com/Tremus/CPLUG",
+    .version          = "1.0.0",
+    .get_extension    = BenchHost_get_extension,
+    .request_restart  = BenchHost_request_restart,
+    .request_process  = BenchHost_request_process,
+    .request_callback = BenchHost_request_callback,
+};
+
+static uint32_t BenchInputEvents_size(const clap_input_events_t* list)
+{
+    return ((const BenchEventList*)list->ctx)->numEvents;
+}
+
+static const clap_event_header_t* BenchInputEvents_get(const clap_input_events_t* list, uint32_t index)
+{
+    const BenchEventList* events = (const BenchEventList*)list->ctx;
+    return index < events->numEvents ? &events->events[index].header : NULL;
+}
+
+static bool BenchOutputEvents_try_push(const clap_output_events_t* list, const clap_event_header_t* event)
+{
+    return true;
+}
+
+static void bench_pushEvent(BenchEventList* list, const BenchEvent* event)
+{
+    bench_check(list->numEvents < list->capacity, "Event list overflow");
+    list->events[list->numEvents++] = *event;
+}
+
+static void bench_pushMidi(BenchEventList* list, uint32_t frame, uint8_t status, uint8_t data1, uint8_t data2)
+{
+    BenchEvent event           = {0};
+    event.midi.header.size     = sizeof(clap_event_midi_t);
+    event.midi.header.time     = frame;
+    event.midi.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+    event.midi.header.type     = CLAP_EVENT_MIDI;
+    event.midi.port_index      = 0;
+    event.midi.data[0]         = status;
+    event.midi.data[1]         = data1;
+    event.midi.data[2]         = data2;
+    bench_pushEvent(list, &event);
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions opts;
+    bench_parseArgs(&opts, argc, argv, CPLUG_BENCH_CLAP_PATH);
+    const char* path                = opts.path;
+    uint32_t    blockSize           = opts.blockSize;
+    double      sampleRate          = opts.sampleRate;
+    uint32_t    numBlocks           = opts.numBlocks;
+    uint32_t    numAutomationPoints = opts.numAutomationPoints;
+
+    //////////
+    // Load //
+    //////////
+
+    void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    bench_check(library != NULL, "Failed to load %s: %s", path, dlerror());
+    const clap_plugin_entry_t* entry = (const clap_plugin_entry_t*)dlsym(library, "clap_entry");
+    bench_check(entry != NULL, "Missing clap_entry in %s", path);
+    bench_check(entry->init(path), "clap_entry.init failed");
+
+    const clap_plugin_factory_t* factory = (const clap_plugin_factory_t*)entry->get_factory(CLAP_PLUGIN_FACTORY_ID);
+    bench_check(factory != NULL && factory->get_plugin_count(factory) > 0, "No plugins found in factory");
+    const clap_plugin_descriptor_t* desc = factory->get_plugin_descriptor(factory, 0);
+
+    const clap_plugin_t* plugin = factory->create_plugin(factory, &s_bench_host, desc->id);
+    bench_check(plugin != NULL, "Failed to create plugin %s", desc->id);
+    bench_check(plugin->init(plugin), "clap_plugin.init failed");
+
+    ///////////
+    // Ports //
+    ///////////
+
+    clap_audio_buffer_t inputs[BENCH_MAX_PORTS]  = {0};
+    clap_audio_buffer_t outputs[BENCH_MAX_PORTS] = {0};
+    uint32_t            numInputs                = 0;
+    uint32_t            numOutputs               = 0;
+    float*              channels[2][BENCH_MAX_PORTS][BENCH_MAX_CHANNELS];
+
+    const clap_plugin_audio_ports_t* ports = plugin->get_extension(plugin, CLAP_EXT_AUDIO_PORTS);
+    if (ports != NULL)
+    {
+        for (int isInput = 0; isInput < 2; isInput++)
+        {
+            clap_audio_buffer_t* buffers  = isInput ? inputs : outputs;
+            uint32_t             numPorts = ports->count(plugin, isInput);
+            bench_check(numPorts <= BENCH_MAX_PORTS, "Too many audio ports");
+            for (uint32_t i = 0; i < numPorts; i++)
+            {
+                clap_audio_port_info_t info;
+                bench_check(ports->get(plugin, i, isInput, &info), "Failed to get audio port info");
+                bench_check(info.channel_count <= BENCH_MAX_CHANNELS, "Too many audio channels");
+
+                for (uint32_t ch = 0; ch < info.channel_count; ch++)
+                    channels[isInput][i][ch] = (float*)calloc(blockSize, sizeof(float));
+                buffers[i].data32        = channels[isInput][i];
+                buffers[i].channel_count = info.channel_count;
+            }
+            if (isInput)
+                numInputs = numPorts;
+            else
+                numOutputs = numPorts;
+        }
+    }
+
+    ////////////
+    // Params //
+    ////////////
+
+    const clap_plugin_params_t* params    = plugin->get_extension(plugin, CLAP_EXT_PARAMS);
+    uint32_t                    numParams = params != NULL ? params->count(plugin) : 0;
+    clap_param_info_t*          paramInfo = (clap_param_info_t*)calloc(numParams + 1, sizeof(clap_param_info_t));
+    for (uint32_t i = 0; i < numParams; i++)
+        bench_check(params->get_info(plugin, i, &paramInfo[i]), "Failed to get param info %u", i);
+
+    // Automation for every param, plus a note on & off
+    BenchEventList eventList = {0};
+    eventList.capacity       = numParams * numAutomationPoints + 2;
+    eventList.events         = (BenchEvent*)calloc(eventList.capacity, sizeof(BenchEvent));
+
+    clap_input_events_t  inEvents  = {.ctx = &eventList, .size = BenchInputEvents_size, .get = BenchInputEvents_get};
+    clap_output_events_t outEvents = {.ctx = NULL, .try_push = BenchOutputEvents_try_push};
+
+    clap_event_transport_t transport = {0};
+    transport.header.size            = sizeof(transport);
+    transport.header.type            = CLAP_EVENT_TRANSPORT;
+    transport.flags                  = CLAP_TRANSPORT_HAS_TEMPO | CLAP_TRANSPORT_HAS_BEATS_TIMELINE;
+    transport.flags                 |= CLAP_TRANSPORT_IS_PLAYING;
+    transport.tempo                  = 120;
+
+    clap_process_t process      = {0};
+    process.frames_count        = blockSize;
+    process.transport           = &transport;
+    process.audio_inputs        = inputs;
+    process.audio_outputs       = outputs;
+    process.audio_inputs_count  = numInputs;
+    process.audio_outputs_count = numOutputs;
+    process.in_events           = &inEvents;
+    process.out_events          = &outEvents;
+
+    /////////
+    // Run //
+    /////////
+
+    bench_check(plugin->activate(plugin, sampleRate, 1, blockSize), "clap_plugin.activate failed");
+    bench_check(plugin->start_processing(plugin), "clap_plugin.start_processing failed");
+
+    uint64_t* times       = (uint64_t*)malloc(sizeof(uint64_t) * numBlocks);
+    uint32_t  totalBlocks = numBlocks + BENCH_NUM_WARMUP_BLOCKS;
+    double    phase       = 0;
+    double    phaseInc    = 220.0 / sampleRate;
+
+    for (uint32_t block = 0; block < totalBlocks; block++)
+    {
+        // Synthetic input
+        for (uint32_t i = 0; i < numInputs; i++)
+        {
+            for (uint32_t ch = 0; ch < inputs[i].channel_count; ch++)
+            {
+                double p = phase;
+                for (uint32_t f = 0; f < blockSize; f++, p += phaseInc)
+                    inputs[i].data32[ch][f] = (float)sin(2 * M_PI * p);
+            }
+        }
+        phase = fmod(phase + phaseInc * blockSize, 1.0);
+
+        // Note on every 8 blocks, released 4 blocks later. Automation ramps across each param range every 16 blocks
+        eventList.numEvents = 0;
+        if (block % 8 == 0)
+            bench_pushMidi(&eventList, 0, 0x90, 48 + (block / 8) % 24, 100);
+        if (block % 8 == 4)
+            bench_pushMidi(&eventList, 0, 0x80, 48 + (block / 8) % 24, 0);
+        for (uint32_t pt = 0; pt < numAutomationPoints; pt++)
+        {
+            uint32_t frame = pt * blockSize / numAutomationPoints;
+            double   ramp  = fmod((block + (double)frame / blockSize) / 16.0, 1.0);
+            for (uint32_t i = 0; i < numParams; i++)
+            {
+                const clap_param_info_t* info = &paramInfo[i];
+                if (info->flags & CLAP_PARAM_IS_READONLY)
+                    continue;
+                BenchEvent event            = {0};
+                event.param.header.size     = sizeof(clap_event_param_value_t);
+                event.param.header.time     = frame;
+                event.param.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+                event.param.header.type     = CLAP_EVENT_PARAM_VALUE;
+                event.param.param_id        = info->id;
+                event.param.cookie          = info->cookie;
+                event.param.note_id         = -1;
+                event.param.port_index      = -1;
+                event.param.channel         = -1;
+                event.param.key             = -1;
+                event.param.value           = info->min_value + (info->max_value - info->min_value) * ramp;
+                bench_pushEvent(&eventList, &event);
+            }
+        }
+
+        transport.song_pos_beats = (clap_beattime)(CLAP_BEATTIME_FACTOR * (block * blockSize / sampleRate) * 2.0);
+        process.steady_time      = (int64_t)block * blockSize;
+
+        uint64_t start = bench_nowNS();
+        plugin->process(plugin, &process);
+        uint64_t end = bench_nowNS();
+
+        if (block >= BENCH_NUM_WARMUP_BLOCKS)
+            times[block - BENCH_NUM_WARMUP_BLOCKS] = end - start;
+    }
+
+    plugin->stop_processing(plugin);
+    plugin->deactivate(plugin);
+
+    ///////////
+    // Stats //
+    ///////////
+
+    bench_printStats(desc->name, &opts, times);
+
+    //////////////
+    // Teardown //
+    //////////////
+
+    plugin->destroy(plugin);
+    entry->deinit();
+    dlclose(library);
+
+    for (int isInput = 0; isInput < 2; isInput++)
+    {
+        clap_audio_buffer_t* buffers  = isInput ? inputs : outputs;
+        uint32_t             numPorts = isInput ? numInputs : numOutputs;
+        for (uint32_t i = 0; i < numPorts; i++)
+            for (uint32_t ch = 0; ch < buffers[i].channel_count; ch++)
+                free(buffers[i].data32[ch]);
+    }
+    free(times);
+    free(eventList.events);
+    free(paramInfo);
+    return 0;
+}
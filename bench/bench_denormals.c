@@ -0,0 +1,122 @@
+// Times a bank of resonant filters ringing out into silence, like a reverb tail, with & without the denormal scope the
+// wrappers put around cplug_process. Also times the scope on its own, which every block pays.
+// Usage: ./cplug_bench_denormals [-n numBlocks]
+#include <cplug.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define bench_check(cond, ...)                                                                                         \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "bench: " __VA_ARGS__);                                                                        \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+#define BENCH_BLOCK_SIZE 512
+#define BENCH_NUM_FILTERS 32
+
+static uint64_t bench_nowNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Two pole resonators, each fed an impulse then left to decay
+typedef struct BenchFilters
+{
+    float a1[BENCH_NUM_FILTERS];
+    float a2[BENCH_NUM_FILTERS];
+    float y1[BENCH_NUM_FILTERS];
+    float y2[BENCH_NUM_FILTERS];
+} BenchFilters;
+
+static void bench_initFilters(BenchFilters* f)
+{
+    for (int i = 0; i < BENCH_NUM_FILTERS; i++)
+    {
+        double radius = 0.999 - i * 0.0002;
+        double theta  = 0.01 + i * 0.013;
+        f->a1[i]      = (float)(2 * radius * cos(theta));
+        f->a2[i]      = (float)(-radius * radius);
+        f->y1[i]      = 1.0f;
+        f->y2[i]      = 0.0f;
+    }
+}
+
+static void bench_processFilters(BenchFilters* f, float* out)
+{
+    memset(out, 0, sizeof(float) * BENCH_BLOCK_SIZE);
+    for (int i = 0; i < BENCH_NUM_FILTERS; i++)
+    {
+        float a1 = f->a1[i], a2 = f->a2[i], y1 = f->y1[i], y2 = f->y2[i];
+        for (int n = 0; n < BENCH_BLOCK_SIZE; n++)
+        {
+            float y  = a1 * y1 + a2 * y2;
+            y2       = y1;
+            y1       = y;
+            out[n]  += y;
+        }
+        f->y1[i] = y1;
+        f->y2[i] = y2;
+    }
+}
+
+// Returns the average time per block of the last quarter of the tail, when most of the filters are denormal
+static double bench_runTail(uint32_t numBlocks, bool useScope, uint32_t* numDenormalFilters)
+{
+    BenchFilters filters;
+    float        out[BENCH_BLOCK_SIZE];
+    bench_initFilters(&filters);
+
+    uint64_t start = 0;
+    for (uint32_t block = 0; block < numBlocks; block++)
+    {
+        if (block == numBlocks * 3 / 4)
+            start = bench_nowNS();
+        uint64_t floatMode = useScope ? cplug_disableDenormals() : 0;
+        bench_processFilters(&filters, out);
+        if (useScope)
+            cplug_restoreDenormals(floatMode);
+    }
+    uint64_t end = bench_nowNS();
+
+    *numDenormalFilters = 0;
+    for (int i = 0; i < BENCH_NUM_FILTERS; i++)
+    {
+        float y = fabsf(filters.y1[i]);
+        *numDenormalFilters += y != 0.0f && y < 1.17549435e-38f;
+    }
+    return (double)(end - start) / (numBlocks - numBlocks * 3 / 4);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t numBlocks = 1000;
+    if (argc > 2 && ! strcmp(argv[1], "-n"))
+        numBlocks = (uint32_t)atoi(argv[2]);
+    bench_check(numBlocks >= 4, "Usage: %s [-n numBlocks]", argv[0]);
+
+    uint32_t numDenormalWithout, numDenormalWith;
+    double   nsWithout = bench_runTail(numBlocks, false, &numDenormalWithout);
+    double   nsWith    = bench_runTail(numBlocks, true, &numDenormalWith);
+
+    // The scope alone, as paid by every block including those with no denormals
+    uint32_t numScopes = 1000000;
+    uint64_t start     = bench_nowNS();
+    for (uint32_t i = 0; i < numScopes; i++)
+    {
+        uint64_t floatMode = cplug_disableDenormals();
+        cplug_restoreDenormals(floatMode);
+    }
+    double nsScope = (double)(bench_nowNS() - start) / numScopes;
+
+    printf("%d filters, %d frame blocks, tail of %u blocks\n", BENCH_NUM_FILTERS, BENCH_BLOCK_SIZE, numBlocks);
+    printf("without scope | %9.1fns per block | %u filters denormal\n", nsWithout, numDenormalWithout);
+    printf("with scope    | %9.1fns per block | %u filters denormal\n", nsWith, numDenormalWith);
+    printf("scope only    | %9.1fns\n", nsScope);
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Throughput of every cplug_dsp.h kernel, for each variant this CPU can run, at a few block sizes.
+// Buffers stay in L1, so this measures the kernels rather than memory bandwidth.
+// Usage: ./cplug_bench_dsp [-n iterations]
+#include <cplug_dsp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define bench_check(cond, ...)                                                                                         \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "bench: " __VA_ARGS__);                                                                        \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+#define BENCH_MAX_SAMPLES 4096
+
+static float g_src[BENCH_MAX_SAMPLES * 2];
+static float g_dst[BENCH_MAX_SAMPLES * 2];
+static float g_dst2[BENCH_MAX_SAMPLES];
+
+static uint64_t bench_nowNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+typedef enum BenchKernel
+{
+    BENCH_CLEAR,
+    BENCH_COPY,
+    BENCH_GAIN,
+    BENCH_GAIN_RAMP,
+    BENCH_MIX,
+    BENCH_PAN,
+    BENCH_INTERLEAVE2,
+    BENCH_DEINTERLEAVE2,
+    BENCH_SINE,
+    BENCH_NUM_KERNELS,
+} BenchKernel;
+
+static const char* g_kernelNames[BENCH_NUM_KERNELS] =
+    {"clear", "copy", "gain", "gainRamp", "mix", "pan", "interleave2", "deinterleave2", "sine"};
+
+static void bench_run(const CplugDSPKernels* k, BenchKernel kernel, uint32_t n)
+{
+    switch (kernel)
+    {
+    case BENCH_CLEAR:
+        k->clear(g_dst, n);
+        break;
+    case BENCH_COPY:
+        k->copy(g_dst, g_src, n);
+        break;
+    case BENCH_GAIN:
+        k->gain(g_dst, g_src, 0.5f, n);
+        break;
+    case BENCH_GAIN_RAMP:
+        k->gainRamp(g_dst, g_src, 0.5f, 1.0f, n);
+        break;
+    case BENCH_MIX:
+        k->mix(g_dst, g_src, 0.5f, n);
+        break;
+    case BENCH_PAN:
+        k->pan(g_dst, g_dst2, g_src, 0.8f, 0.6f, n);
+        break;
+    case BENCH_INTERLEAVE2:
+        k->interleave2(g_dst, g_src, g_src + BENCH_MAX_SAMPLES, n);
+        break;
+    case BENCH_DEINTERLEAVE2:
+        k->deinterleave2(g_dst, g_dst2, g_src, n);
+        break;
+    case BENCH_SINE:
+        k->sine(g_dst, 0.25f, 0.01f, 0.5f, n);
+        break;
+    default:
+        break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t numIterations = 20000;
+    if (argc > 2 && ! strcmp(argv[1], "-n"))
+        numIterations = (uint32_t)atoi(argv[2]);
+    bench_check(numIterations > 0, "Usage: %s [-n iterations]", argv[0]);
+
+    for (int i = 0; i < BENCH_MAX_SAMPLES * 2; i++)
+        g_src[i] = (float)(i % 97) / 97.0f - 0.5f;
+
+    static const uint32_t blockSizes[] = {32, 256, 4096};
+
+    cplug_dsp_init();
+    printf("cplug_dsp_init picked %s. Samples per ns:\n", cplug_dsp_getLevelName(cplug_dsp_getLevel()));
+    printf("%-14s %-8s", "kernel", "variant");
+    for (int b = 0; b < 3; b++)
+        printf(" %8u", blockSizes[b]);
+    printf("\n");
+
+    for (int kernel = 0; kernel < BENCH_NUM_KERNELS; kernel++)
+    {
+        for (int level = 0; level < CPLUG_DSP_NUM_LEVELS; level++)
+        {
+            CplugDSPKernels k;
+            if (! cplug_dsp_getKernels((CplugDSPLevel)level, &k))
+                continue;
+
+            printf("%-14s %-8s", g_kernelNames[kernel], cplug_dsp_getLevelName((CplugDSPLevel)level));
+            for (int b = 0; b < 3; b++)
+            {
+                uint32_t n = blockSizes[b];
+                // Same total number of samples for every block size
+                uint32_t numCalls = (uint32_t)((uint64_t)numIterations * 256 / n);
+                for (uint32_t i = 0; i < numCalls / 10; i++)
+                    bench_run(&k, (BenchKernel)kernel, n);
+
+                uint64_t start = bench_nowNS();
+                for (uint32_t i = 0; i < numCalls; i++)
+                    bench_run(&k, (BenchKernel)kernel, n);
+                uint64_t elapsed = bench_nowNS() - start;
+                printf(" %8.2f", (double)numCalls * n / (double)(elapsed ? elapsed : 1));
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
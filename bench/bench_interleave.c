@@ -0,0 +1,129 @@
+// Times cplug_interleave against the nested frame/channel loop the standalones used, for common channel counts at
+// small & large block sizes. The integer device formats are compared against the same loop converting & dithering one
+// sample at a time.
+// Usage: ./cplug_bench_interleave [-n iterations]
+#include <cplug_interleave.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define bench_check(cond, ...)                                                                                         \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "bench: " __VA_ARGS__);                                                                        \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+#define BENCH_MAX_CHANNELS 8
+#define BENCH_MAX_FRAMES   1024
+
+static float   g_planar[BENCH_MAX_CHANNELS][BENCH_MAX_FRAMES];
+static uint8_t g_interleaved[BENCH_MAX_CHANNELS * BENCH_MAX_FRAMES * 4];
+
+static uint64_t bench_nowNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_nestedLoop(
+    uint8_t*          dst,
+    CplugSampleFormat format,
+    float* const*     src,
+    uint32_t          numChannels,
+    uint32_t          numFrames,
+    CplugDither*      dither)
+{
+    if (format == CPLUG_SAMPLE_FLOAT32)
+    {
+        float* out = (float*)dst;
+        for (uint32_t i = 0; i < numFrames; i++)
+            for (uint32_t ch = 0; ch < numChannels; ch++)
+                *out++ = src[ch][i];
+        return;
+    }
+
+    uint32_t size     = cplug_sampleFormatSize(format);
+    float    scale    = size == 2 ? 32768.0f : size == 3 ? 8388608.0f : 2147483648.0f;
+    float    maxValue = size == 2 ? 32767.0f : size == 3 ? 8388607.0f : 2147483520.0f;
+    float    noise[8] = {0};
+    uint32_t n        = 0;
+    for (uint32_t i = 0; i < numFrames; i++)
+    {
+        for (uint32_t ch = 0; ch < numChannels; ch++, n++)
+        {
+            if (format != CPLUG_SAMPLE_INT32 && n % 8 == 0)
+                cplug_dither_step(dither, noise);
+            int32_t v = cplug_interleave_round(src[ch][i], scale, maxValue, noise[n % 8]);
+            memcpy(dst, &v, size);
+            dst += size;
+        }
+    }
+}
+
+// Nanoseconds per call
+static double bench_run(int useNestedLoop, CplugSampleFormat format, uint32_t numChannels, uint32_t numFrames, int n)
+{
+    float* src[BENCH_MAX_CHANNELS];
+    for (uint32_t ch = 0; ch < numChannels; ch++)
+        src[ch] = g_planar[ch];
+    CplugDither dither;
+    cplug_dither_init(&dither, 1);
+
+    // Same number of samples for every block size
+    uint32_t numCalls = (uint32_t)((uint64_t)n * 256 / numFrames);
+    uint64_t start    = 0;
+    for (uint32_t i = 0; i < numCalls + numCalls / 10; i++)
+    {
+        if (i == numCalls / 10)
+            start = bench_nowNS();
+        if (useNestedLoop)
+            bench_nestedLoop(g_interleaved, format, src, numChannels, numFrames, &dither);
+        else
+            cplug_interleave(g_interleaved, format, src, numChannels, numFrames, &dither);
+    }
+    return (double)(bench_nowNS() - start) / numCalls;
+}
+
+int main(int argc, char** argv)
+{
+    int n = 20000;
+    if (argc > 2 && ! strcmp(argv[1], "-n"))
+        n = atoi(argv[2]);
+    bench_check(n > 0, "Usage: %s [-n iterations]", argv[0]);
+
+    for (int ch = 0; ch < BENCH_MAX_CHANNELS; ch++)
+        for (int i = 0; i < BENCH_MAX_FRAMES; i++)
+            g_planar[ch][i] = (float)((i * 7 + ch * 13) % 101) / 101.0f - 0.5f;
+
+    static const uint32_t channelCounts[] = {1, 2, 4, 6, 8};
+    static const uint32_t blockSizes[]    = {32, 128, 1024};
+    static const char*    formatNames[]   = {"float32", "int16", "int24", "int32"};
+
+    printf("ns per block\n%-8s %-8s %-5s %10s %10s %8s\n", "format", "channels", "block", "nested", "cplug", "speedup");
+    for (int format = CPLUG_SAMPLE_FLOAT32; format <= CPLUG_SAMPLE_INT32; format++)
+    {
+        for (int c = 0; c < 5; c++)
+        {
+            for (int b = 0; b < 3; b++)
+            {
+                uint32_t numChannels = channelCounts[c];
+                uint32_t numFrames   = blockSizes[b];
+                double nested = bench_run(1, (CplugSampleFormat)format, numChannels, numFrames, n);
+                double cplug  = bench_run(0, (CplugSampleFormat)format, numChannels, numFrames, n);
+                printf(
+                    "%-8s %-8u %-5u %10.1f %10.1f %7.2fx\n",
+                    formatNames[format],
+                    numChannels,
+                    numFrames,
+                    nested,
+                    cplug,
+                    nested / cplug);
+            }
+        }
+    }
+    return 0;
+}
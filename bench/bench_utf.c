@@ -0,0 +1,159 @@
+// Times cplug_utf.h on the kind of strings the VST3 wrapper converts (parameter names & values, bus names), against
+// the per character loop it replaced. Usage: ./cplug_bench_utf [-n iterations]
+#include <cplug_utf.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define bench_check(cond, ...)                                                                                         \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "bench: " __VA_ARGS__);                                                                        \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+static uint64_t bench_nowNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// The previous conversion: decode & encode one character at a time, no validation
+static const uint8_t* bench_decode8(const uint8_t* text, uint32_t* cp)
+{
+    uint32_t c = *text++, extra = 0;
+    if (c >= 0xf0)
+        *cp = c & 0x07, extra = 3;
+    else if (c >= 0xe0)
+        *cp = c & 0x0f, extra = 2;
+    else if (c >= 0xc0)
+        *cp = c & 0x1f, extra = 1;
+    else
+        *cp = c;
+    while (extra--)
+        *cp = (*cp << 6) | (*text++ & 0x3f);
+    return text;
+}
+
+static void bench_scalarUtf8To16(uint16_t* dst, const char* src, int len)
+{
+    const uint8_t* in = (const uint8_t*)src;
+    uint16_t*      it = dst;
+    uint32_t       cp;
+    while (*in && it < dst + len - 1)
+    {
+        in = bench_decode8(in, &cp);
+        if (cp < 0x10000)
+            *it++ = (uint16_t)cp;
+        else
+        {
+            *it++ = (uint16_t)(0xd800 | ((cp - 0x10000) >> 10));
+            *it++ = (uint16_t)(0xdc00 | ((cp - 0x10000) & 0x3ff));
+        }
+    }
+    *it = 0;
+}
+
+static void bench_scalarUtf16To8(char* dst, const uint16_t* src, int len)
+{
+    uint8_t* it = (uint8_t*)dst;
+    while (*src && it < (uint8_t*)dst + len - 1)
+    {
+        uint32_t cp = *src++;
+        if (cp >= 0xd800 && cp <= 0xdbff)
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (*src++ - 0xdc00);
+        if (cp < 0x80)
+            *it++ = (uint8_t)cp;
+        else if (cp < 0x800)
+        {
+            *it++ = (uint8_t)(0xc0 | (cp >> 6));
+            *it++ = (uint8_t)(0x80 | (cp & 0x3f));
+        }
+        else if (cp < 0x10000)
+        {
+            *it++ = (uint8_t)(0xe0 | (cp >> 12));
+            *it++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+            *it++ = (uint8_t)(0x80 | (cp & 0x3f));
+        }
+        else
+        {
+            *it++ = (uint8_t)(0xf0 | (cp >> 18));
+            *it++ = (uint8_t)(0x80 | ((cp >> 12) & 0x3f));
+            *it++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+            *it++ = (uint8_t)(0x80 | (cp & 0x3f));
+        }
+    }
+    *it = 0;
+}
+
+static const char* g_strings[] = {
+    "-12.5 dB",
+    "Filter Cutoff Frequency",
+    "Sidechain Input (Stereo) - Ducking amount applied to the main bus",
+    "Long ASCII text, the size of a full String128 buffer from a verbose host or plugin. Lorem ipsum dolor sit amet, c",
+    "Fréquence de coupure du filtre",
+    "Частота среза фильтра",
+    "フィルターのカットオフ周波数",
+    "Mix 🎛️ Wet/Dry 🔊",
+};
+
+int main(int argc, char** argv)
+{
+    uint32_t numIterations = 1000000;
+    if (argc > 2 && ! strcmp(argv[1], "-n"))
+        numIterations = (uint32_t)atoi(argv[2]);
+    bench_check(numIterations > 0, "Usage: %s [-n iterations]", argv[0]);
+
+    printf("%-28s %6s | %12s %12s | %12s %12s\n", "string", "bytes", "8>16 old", "8>16 new", "16>8 old", "16>8 new");
+
+    // The volatile sink stops the compiler from skipping conversions whose results we never read
+    volatile uint32_t sink = 0;
+    for (size_t s = 0; s < sizeof(g_strings) / sizeof(g_strings[0]); s++)
+    {
+        const char* str = g_strings[s];
+        uint32_t    len = (uint32_t)strlen(str);
+        uint16_t    utf16[128];
+        char        utf8[128];
+
+        uint64_t t0 = bench_nowNS();
+        for (uint32_t i = 0; i < numIterations; i++)
+        {
+            bench_scalarUtf8To16(utf16, str, 128);
+            sink += utf16[i & 7];
+        }
+        uint64_t t1 = bench_nowNS();
+        for (uint32_t i = 0; i < numIterations; i++)
+        {
+            cplug_utf8To16(utf16, 128, str, len);
+            sink += utf16[i & 7];
+        }
+        uint64_t t2 = bench_nowNS();
+        for (uint32_t i = 0; i < numIterations; i++)
+        {
+            bench_scalarUtf16To8(utf8, utf16, 128);
+            sink += (uint8_t)utf8[i & 7];
+        }
+        uint64_t t3 = bench_nowNS();
+        for (uint32_t i = 0; i < numIterations; i++)
+        {
+            cplug_utf16To8(utf8, 128, utf16, 128);
+            sink += (uint8_t)utf8[i & 7];
+        }
+        uint64_t t4 = bench_nowNS();
+        bench_check(! strcmp(utf8, str), "Round trip failed for \"%s\"", str);
+
+        printf(
+            "%-28.28s %6u | %9.1fns %9.1fns | %9.1fns %9.1fns\n",
+            str,
+            len,
+            (double)(t1 - t0) / numIterations,
+            (double)(t2 - t1) / numIterations,
+            (double)(t3 - t2) / numIterations,
+            (double)(t4 - t3) / numIterations);
+    }
+    return 0;
+}
@@ -0,0 +1,441 @@
+/* Headless VST3 benchmark host (Linux)
+ * Loads a VST3 module through ModuleEntry & GetPluginFactory, runs it with synthetic audio, note events, parameter
+ * automation & a MIDI CC lane and reports the time spent inside IAudioProcessor::process per block.
+ * No DAW, SDK or audio device required.
+ *
+ * Usage: cplug_bench_vst3 [-b blockSize] [-r sampleRate] [-n numBlocks] [-a automationPointsPerBlock] [plugin.so] */
+#include "bench.h"
+#include <dlfcn.h>
+#include <vst3_c_api.h>
+
+#ifndef CPLUG_BENCH_VST3_PATH
+#define CPLUG_BENCH_VST3_PATH "cplug_example.vst3/Contents/x86_64-linux/cplug_example.so"
+#endif
+
+#define BENCH_MAX_BUSES 8
+#define BENCH_MAX_CHANNELS 32
+#define BENCH_MAX_NOTE_EVENTS 2
+
+typedef bool (*BenchModuleEntryProc)(void*);
+typedef bool (*BenchModuleExitProc)(void);
+typedef Steinberg_IPluginFactory* (*BenchGetPluginFactoryProc)(void);
+
+typedef struct BenchParamValueQueue
+{
+    Steinberg_Vst_IParamValueQueueVtbl* lpVtbl;
+    Steinberg_Vst_ParamID               id;
+    Steinberg_int32                     numPoints;
+    Steinberg_int32*                    offsets;
+    Steinberg_Vst_ParamValue*           values;
+} BenchParamValueQueue;
+
+typedef struct BenchParameterChanges
+{
+    Steinberg_Vst_IParameterChangesVtbl* lpVtbl;
+    BenchParamValueQueue*                queues;
+    Steinberg_int32                      numQueues;
+} BenchParameterChanges;
+
+typedef struct BenchEventList
+{
+    Steinberg_Vst_IEventListVtbl* lpVtbl;
+    struct Steinberg_Vst_Event    events[BENCH_MAX_NOTE_EVENTS];
+    Steinberg_int32               numEvents;
+} BenchEventList;
+
+////////////////
+// Mock lists //
+////////////////
+
+// None of the mocks are reference counted. They live on the stack of main() for the whole run
+static Steinberg_tresult SMTG_STDMETHODCALLTYPE
+BenchUnknown_queryInterface(void* thisInterface, const Steinberg_TUID iid, void** obj)
+{
+    *obj = NULL;
+    return Steinberg_kNoInterface;
+}
+
+static Steinberg_uint32 SMTG_STDMETHODCALLTYPE BenchUnknown_addRef(void* thisInterface) { return 1; }
+static Steinberg_uint32 SMTG_STDMETHODCALLTYPE BenchUnknown_release(void* thisInterface) { return 1; }
+
+static Steinberg_Vst_ParamID SMTG_STDMETHODCALLTYPE BenchParamValueQueue_getParameterId(void* thisInterface)
+{
+    return ((BenchParamValueQueue*)thisInterface)->id;
+}
+
+static Steinberg_int32 SMTG_STDMETHODCALLTYPE BenchParamValueQueue_getPointCount(void* thisInterface)
+{
+    return ((BenchParamValueQueue*)thisInterface)->numPoints;
+}
+
+static Steinberg_tresult SMTG_STDMETHODCALLTYPE BenchParamValueQueue_getPoint(
+    void*                     thisInterface,
+    Steinberg_int32           index,
+    Steinberg_int32*          sampleOffset,
+    Steinberg_Vst_ParamValue* value)
+{
+    BenchParamValueQueue* queue = (BenchParamValueQueue*)thisInterface;
+    if (index < 0 || index >= queue->numPoints)
+        return Steinberg_kInvalidArgument;
+    *sampleOffset = queue->offsets[index];
+    *value        = queue->values[index];
+    return Steinberg_kResultOk;
+}
+
+static Steinberg_tresult SMTG_STDMETHODCALLTYPE BenchParamValueQueue_addPoint(
+    void*                    thisInterface,
+    Steinberg_int32          sampleOffset,
+    Steinberg_Vst_ParamValue value,
+    Steinberg_int32*         index)
+{
+    return Steinberg_kResultFalse;
+}
+
+static Steinberg_Vst_IParamValueQueueVtbl s_bench_param_value_queue = {
+    .queryInterface = BenchUnknown_queryInterface,
+    .addRef         = BenchUnknown_addRef,
+    .release        = BenchUnknown_release,
+    .getParameterId = BenchParamValueQueue_getParameterId,
+    .getPointCount  = BenchParamValueQueue_getPointCount,
+    .getPoint       = BenchParamValueQueue_getPoint,
+    .addPoint       = BenchParamValueQueue_addPoint,
+};
+
+static Steinberg_int32 SMTG_STDMETHODCALLTYPE BenchParameterChanges_getParameterCount(void* thisInterface)
+{
+    return ((BenchParameterChanges*)thisInterface)->numQueues;
+}
+
+static struct Steinberg_Vst_IParamValueQueue* SMTG_STDMETHODCALLTYPE
+BenchParameterChanges_getParameterData(void* thisInterface, Steinberg_int32 index)
+{
+    BenchParameterChanges* changes = (BenchParameterChanges*)thisInterface;
+    if (index < 0 || index >= changes->numQueues)
+        return NULL;
+    return (struct Steinberg_Vst_IParamValueQueue*)&changes->queues[index];
+}
+
+static struct Steinberg_Vst_IParamValueQueue* SMTG_STDMETHODCALLTYPE
+BenchParameterChanges_addParameterData(void* thisInterface, const Steinberg_Vst_ParamID* id, Steinberg_int32* index)
+{
+    return NULL;
+}
+
+static Steinberg_Vst_IParameterChangesVtbl s_bench_parameter_changes = {
+    .queryInterface    = BenchUnknown_queryInterface,
+    .addRef            = BenchUnknown_addRef,
+    .release           = BenchUnknown_release,
+    .getParameterCount = BenchParameterChanges_getParameterCount,
+    .getParameterData  = BenchParameterChanges_getParameterData,
+    .addParameterData  = BenchParameterChanges_addParameterData,
+};
+
+static Steinberg_int32 SMTG_STDMETHODCALLTYPE BenchEventList_getEventCount(void* thisInterface)
+{
+    return ((BenchEventList*)thisInterface)->numEvents;
+}
+
+static Steinberg_tresult SMTG_STDMETHODCALLTYPE
+BenchEventList_getEvent(void* thisInterface, Steinberg_int32 index, struct Steinberg_Vst_Event* e)
+{
+    BenchEventList* list = (BenchEventList*)thisInterface;
+    if (index < 0 || index >= list->numEvents)
+        return Steinberg_kInvalidArgument;
+    *e = list->events[index];
+    return Steinberg_kResultOk;
+}
+
+// Used for output events. Anything the plugin sends is dropped
+static Steinberg_tresult SMTG_STDMETHODCALLTYPE
+BenchEventList_addEvent(void* thisInterface, struct Steinberg_Vst_Event* e)
+{
+    return Steinberg_kResultOk;
+}
+
+static Steinberg_Vst_IEventListVtbl s_bench_event_list = {
+    .queryInterface = BenchUnknown_queryInterface,
+    .addRef         = BenchUnknown_addRef,
+    .release        = BenchUnknown_release,
+    .getEventCount  = BenchEventList_getEventCount,
+    .getEvent       = BenchEventList_getEvent,
+    .addEvent       = BenchEventList_addEvent,
+};
+
+static void bench_pushNote(BenchEventList* list, Steinberg_uint16 type, Steinberg_int16 pitch, float velocity)
+{
+    bench_check(list->numEvents < BENCH_MAX_NOTE_EVENTS, "Event list overflow");
+    struct Steinberg_Vst_Event* event = &list->events[list->numEvents++];
+    memset(event, 0, sizeof(*event));
+    event->type = type;
+    if (type == Steinberg_Vst_Event_EventTypes_kNoteOnEvent)
+    {
+        event->Steinberg_Vst_Event_noteOn.pitch    = pitch;
+        event->Steinberg_Vst_Event_noteOn.velocity = velocity;
+        event->Steinberg_Vst_Event_noteOn.noteId   = -1;
+    }
+    else
+    {
+        event->Steinberg_Vst_Event_noteOff.pitch    = pitch;
+        event->Steinberg_Vst_Event_noteOff.velocity = velocity;
+        event->Steinberg_Vst_Event_noteOff.noteId   = -1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions opts;
+    bench_parseArgs(&opts, argc, argv, CPLUG_BENCH_VST3_PATH);
+    const char* path                = opts.path;
+    uint32_t    blockSize           = opts.blockSize;
+    double      sampleRate          = opts.sampleRate;
+    uint32_t    numBlocks           = opts.numBlocks;
+    uint32_t    numAutomationPoints = opts.numAutomationPoints;
+
+    //////////
+    // Load //
+    //////////
+
+    void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    bench_check(library != NULL, "Failed to load %s: %s", path, dlerror());
+    BenchModuleEntryProc      moduleEntry      = (BenchModuleEntryProc)dlsym(library, "ModuleEntry");
+    BenchModuleExitProc       moduleExit       = (BenchModuleExitProc)dlsym(library, "ModuleExit");
+    BenchGetPluginFactoryProc getPluginFactory = (BenchGetPluginFactoryProc)dlsym(library, "GetPluginFactory");
+    bench_check(moduleEntry != NULL && moduleExit != NULL, "Missing ModuleEntry/ModuleExit in %s", path);
+    bench_check(getPluginFactory != NULL, "Missing GetPluginFactory in %s", path);
+    bench_check(moduleEntry(library), "ModuleEntry failed");
+
+    Steinberg_IPluginFactory* factory = getPluginFactory();
+    bench_check(factory != NULL, "GetPluginFactory returned NULL");
+
+    struct Steinberg_PClassInfo classInfo;
+    bool                        foundClass = false;
+    int                         numClasses = factory->lpVtbl->countClasses(factory);
+    for (int i = 0; i < numClasses && ! foundClass; i++)
+    {
+        if (factory->lpVtbl->getClassInfo(factory, i, &classInfo) == Steinberg_kResultOk)
+            foundClass = ! strcmp(classInfo.category, "Audio Module Class");
+    }
+    bench_check(foundClass, "No audio module class found in factory");
+
+    Steinberg_Vst_IComponent* component = NULL;
+    factory->lpVtbl->createInstance(factory, classInfo.cid, Steinberg_Vst_IComponent_iid, (void**)&component);
+    bench_check(component != NULL, "Failed to create component %s", classInfo.name);
+    bench_check(component->lpVtbl->initialize(component, NULL) == Steinberg_kResultOk, "IComponent::initialize failed");
+
+    Steinberg_Vst_IAudioProcessor* processor  = NULL;
+    Steinberg_Vst_IEditController* controller = NULL;
+    component->lpVtbl->queryInterface(component, Steinberg_Vst_IAudioProcessor_iid, (void**)&processor);
+    bench_check(processor != NULL, "Component does not implement IAudioProcessor");
+    // Single component plugins implement the controller on the same object. Separate controllers aren't supported
+    component->lpVtbl->queryInterface(component, Steinberg_Vst_IEditController_iid, (void**)&controller);
+    bench_check(controller != NULL, "Component does not implement IEditController");
+    controller->lpVtbl->initialize(controller, NULL);
+
+    ///////////
+    // Buses //
+    ///////////
+
+    struct Steinberg_Vst_AudioBusBuffers inputs[BENCH_MAX_BUSES]  = {0};
+    struct Steinberg_Vst_AudioBusBuffers outputs[BENCH_MAX_BUSES] = {0};
+    int                                  numInputs                = 0;
+    int                                  numOutputs               = 0;
+    float*                               channels[2][BENCH_MAX_BUSES][BENCH_MAX_CHANNELS];
+
+    for (int isInput = 0; isInput < 2; isInput++)
+    {
+        struct Steinberg_Vst_AudioBusBuffers* buffers  = isInput ? inputs : outputs;
+        Steinberg_Vst_BusDirection            dir      = isInput ? Steinberg_Vst_BusDirections_kInput
+                                                                 : Steinberg_Vst_BusDirections_kOutput;
+        int numBuses = component->lpVtbl->getBusCount(component, Steinberg_Vst_MediaTypes_kAudio, dir);
+        bench_check(numBuses >= 0 && numBuses <= BENCH_MAX_BUSES, "Too many audio buses");
+        for (int i = 0; i < numBuses; i++)
+        {
+            struct Steinberg_Vst_BusInfo info;
+            bench_check(
+                component->lpVtbl->getBusInfo(component, Steinberg_Vst_MediaTypes_kAudio, dir, i, &info) ==
+                    Steinberg_kResultOk,
+                "Failed to get audio bus info");
+            bench_check(info.channelCount <= BENCH_MAX_CHANNELS, "Too many audio channels");
+            component->lpVtbl->activateBus(component, Steinberg_Vst_MediaTypes_kAudio, dir, i, 1);
+
+            for (int ch = 0; ch < info.channelCount; ch++)
+                channels[isInput][i][ch] = (float*)calloc(blockSize, sizeof(float));
+            buffers[i].numChannels                                    = info.channelCount;
+            buffers[i].Steinberg_Vst_AudioBusBuffers_channelBuffers32 = channels[isInput][i];
+        }
+        if (isInput)
+            numInputs = numBuses;
+        else
+            numOutputs = numBuses;
+    }
+
+    ////////////
+    // Params //
+    ////////////
+
+    // One queue for every writable param, plus one for the mod wheel if the plugin maps MIDI CCs to params
+    int                   numParams = controller->lpVtbl->getParameterCount(controller);
+    BenchParamValueQueue* queues    = (BenchParamValueQueue*)calloc(numParams + 1, sizeof(BenchParamValueQueue));
+    int                   numQueues = 0;
+    for (int i = 0; i < numParams; i++)
+    {
+        struct Steinberg_Vst_ParameterInfo info;
+        bench_check(
+            controller->lpVtbl->getParameterInfo(controller, i, &info) == Steinberg_kResultOk,
+            "Failed to get param info %d",
+            i);
+        if (info.flags & Steinberg_Vst_ParameterInfo_ParameterFlags_kIsReadOnly)
+            continue;
+        queues[numQueues++].id = info.id;
+    }
+
+    Steinberg_Vst_IMidiMapping* midiMapping = NULL;
+    controller->lpVtbl->queryInterface(controller, Steinberg_Vst_IMidiMapping_iid, (void**)&midiMapping);
+    if (midiMapping != NULL)
+    {
+        Steinberg_Vst_ParamID ccParamId = 0;
+        if (midiMapping->lpVtbl->getMidiControllerAssignment(
+                midiMapping,
+                0,
+                0,
+                Steinberg_Vst_ControllerNumbers_kCtrlModWheel,
+                &ccParamId) == Steinberg_kResultTrue)
+            queues[numQueues++].id = ccParamId;
+        midiMapping->lpVtbl->release(midiMapping);
+    }
+
+    uint32_t                  numPoints = numQueues * numAutomationPoints + 1;
+    Steinberg_int32*          offsets   = (Steinberg_int32*)calloc(numPoints, sizeof(Steinberg_int32));
+    Steinberg_Vst_ParamValue* values    = (Steinberg_Vst_ParamValue*)calloc(numPoints, sizeof(double));
+    for (int i = 0; i < numQueues; i++)
+    {
+        queues[i].lpVtbl    = &s_bench_param_value_queue;
+        queues[i].numPoints = numAutomationPoints;
+        queues[i].offsets   = offsets + i * numAutomationPoints;
+        queues[i].values    = values + i * numAutomationPoints;
+    }
+
+    BenchParameterChanges paramChanges = {.lpVtbl = &s_bench_parameter_changes, .queues = queues};
+    paramChanges.numQueues             = numAutomationPoints > 0 ? numQueues : 0;
+    BenchEventList inEvents            = {.lpVtbl = &s_bench_event_list};
+    BenchEventList outEvents           = {.lpVtbl = &s_bench_event_list};
+
+    struct Steinberg_Vst_ProcessContext context = {0};
+    context.state       = Steinberg_Vst_ProcessContext_StatesAndFlags_kPlaying;
+    context.state      |= Steinberg_Vst_ProcessContext_StatesAndFlags_kTempoValid;
+    context.state      |= Steinberg_Vst_ProcessContext_StatesAndFlags_kProjectTimeMusicValid;
+    context.sampleRate  = sampleRate;
+    context.tempo       = 120;
+
+    struct Steinberg_Vst_ProcessData data = {0};
+    data.processMode                      = Steinberg_Vst_ProcessModes_kRealtime;
+    data.symbolicSampleSize               = Steinberg_Vst_SymbolicSampleSizes_kSample32;
+    data.numSamples                       = blockSize;
+    data.numInputs                        = numInputs;
+    data.numOutputs                       = numOutputs;
+    data.inputs                           = inputs;
+    data.outputs                          = outputs;
+    data.inputParameterChanges            = (struct Steinberg_Vst_IParameterChanges*)&paramChanges;
+    data.inputEvents                      = (struct Steinberg_Vst_IEventList*)&inEvents;
+    data.outputEvents                     = (struct Steinberg_Vst_IEventList*)&outEvents;
+    data.processContext                   = &context;
+
+    /////////
+    // Run //
+    /////////
+
+    struct Steinberg_Vst_ProcessSetup setup = {0};
+    setup.processMode                       = Steinberg_Vst_ProcessModes_kRealtime;
+    setup.symbolicSampleSize                = Steinberg_Vst_SymbolicSampleSizes_kSample32;
+    setup.maxSamplesPerBlock                = blockSize;
+    setup.sampleRate                        = sampleRate;
+    bench_check(
+        processor->lpVtbl->setupProcessing(processor, &setup) == Steinberg_kResultOk,
+        "IAudioProcessor::setupProcessing failed");
+    bench_check(component->lpVtbl->setActive(component, 1) == Steinberg_kResultOk, "IComponent::setActive failed");
+    processor->lpVtbl->setProcessing(processor, 1);
+
+    uint64_t* times       = (uint64_t*)malloc(sizeof(uint64_t) * numBlocks);
+    uint32_t  totalBlocks = numBlocks + BENCH_NUM_WARMUP_BLOCKS;
+    double    phase       = 0;
+    double    phaseInc    = 220.0 / sampleRate;
+
+    for (uint32_t block = 0; block < totalBlocks; block++)
+    {
+        // Synthetic input
+        for (int i = 0; i < numInputs; i++)
+        {
+            for (int ch = 0; ch < inputs[i].numChannels; ch++)
+            {
+                double p = phase;
+                for (uint32_t f = 0; f < blockSize; f++, p += phaseInc)
+                    inputs[i].Steinberg_Vst_AudioBusBuffers_channelBuffers32[ch][f] = (float)sin(2 * M_PI * p);
+            }
+        }
+        phase = fmod(phase + phaseInc * blockSize, 1.0);
+
+        // Note on every 8 blocks, released 4 blocks later. Automation ramps across each param range every 16 blocks
+        inEvents.numEvents = 0;
+        if (block % 8 == 0)
+            bench_pushNote(&inEvents, Steinberg_Vst_Event_EventTypes_kNoteOnEvent, 48 + (block / 8) % 24, 100 / 127.0f);
+        if (block % 8 == 4)
+            bench_pushNote(&inEvents, Steinberg_Vst_Event_EventTypes_kNoteOffEvent, 48 + (block / 8) % 24, 0);
+        for (uint32_t pt = 0; pt < numAutomationPoints; pt++)
+        {
+            uint32_t frame = pt * blockSize / numAutomationPoints;
+            double   ramp  = fmod((block + (double)frame / blockSize) / 16.0, 1.0);
+            for (int i = 0; i < numQueues; i++)
+            {
+                queues[i].offsets[pt] = frame;
+                queues[i].values[pt]  = ramp;
+            }
+        }
+
+        context.projectTimeSamples   = (Steinberg_Vst_TSamples)block * blockSize;
+        context.continousTimeSamples = context.projectTimeSamples;
+        context.projectTimeMusic     = context.projectTimeSamples / sampleRate * 2.0;
+
+        uint64_t start = bench_nowNS();
+        processor->lpVtbl->process(processor, &data);
+        uint64_t end = bench_nowNS();
+
+        if (block >= BENCH_NUM_WARMUP_BLOCKS)
+            times[block - BENCH_NUM_WARMUP_BLOCKS] = end - start;
+    }
+
+    processor->lpVtbl->setProcessing(processor, 0);
+    component->lpVtbl->setActive(component, 0);
+
+    ///////////
+    // Stats //
+    ///////////
+
+    bench_printStats(classInfo.name, &opts, times);
+
+    //////////////
+    // Teardown //
+    //////////////
+
+    controller->lpVtbl->terminate(controller);
+    controller->lpVtbl->release(controller);
+    processor->lpVtbl->release(processor);
+    component->lpVtbl->terminate(component);
+    component->lpVtbl->release(component);
+    factory->lpVtbl->release(factory);
+    moduleExit();
+    dlclose(library);
+
+    for (int isInput = 0; isInput < 2; isInput++)
+    {
+        struct Steinberg_Vst_AudioBusBuffers* buffers = isInput ? inputs : outputs;
+        int                                   numBuses = isInput ? numInputs : numOutputs;
+        for (int i = 0; i < numBuses; i++)
+            for (int ch = 0; ch < buffers[i].numChannels; ch++)
+                free(buffers[i].Steinberg_Vst_AudioBusBuffers_channelBuffers32[ch]);
+    }
+    free(times);
+    free(queues);
+    free(offsets);
+    free(values);
+    return 0;
+}
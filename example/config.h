@@ -13,8 +13,27 @@
 #define CPLUG_NUM_OUTPUT_BUSSES 1
 #define CPLUG_WANT_MIDI_INPUT 1
 #define CPLUG_WANT_MIDI_OUTPUT 1
+// VST3 only. Store all automation points sent by the host, see getAutomation in CplugProcessContext
+#define CPLUG_WANT_DENSE_AUTOMATION 0
+// Start a worker thread per core for parallelFor in CplugProcessContext when the host doesn't provide a thread pool.
+// One pool is shared by every plugin instance in the process
+#define CPLUG_WANT_THREAD_POOL 0
+// (VST3 | CLAP) Implement cplug_getParameterCookie to receive a pointer to your parameter state with param events
+#define CPLUG_WANT_PARAMETER_COOKIES 0
+// Give parameters stable IDs, so they can be reordered without breaking automation. Implement cplug_getParameterID,
+// or with CPLUG_PARAMETER_DESCRIPTORS the 'id' column is used
+#define CPLUG_WANT_SPARSE_PARAMETER_IDS 0
+// (VST3 | CLAP) Cache formatted parameter values. Implement cplug_getParameterTextVersion
+#define CPLUG_WANT_PARAMETER_TEXT_CACHE 1
+// Keep denormals enabled while processing. By default they're flushed to zero, see cplug_disableDenormals
+#define CPLUG_WANT_DENORMALS 0
 
+// The example doesn't have a Linux GUI
+#ifdef __linux__
+#define CPLUG_WANT_GUI 0
+#else
 #define CPLUG_WANT_GUI 1
+#endif
 #define CPLUG_GUI_RESIZABLE 1
 
 // See list of categories here: https://steinbergmedia.github.io/vst3_doc/vstinterfaces/namespaceSteinberg_1_1Vst_1_1PlugType.html
@@ -32,15 +51,26 @@ static const unsigned kAudioUnitProperty_UserPlugin = 'plug';
 #define CPLUG_CLAP_FEATURES CLAP_PLUGIN_FEATURE_INSTRUMENT, CLAP_PLUGIN_FEATURE_STEREO
 
 // Examples of using common parameter types
+// X(id, name, min, max, defaultValue, flags, taper). See CplugParamDescriptor in cplug.h
+// UTF8 names: https://utf8everywhere.org/
+// clang-format off
+#define CPLUG_PARAMETER_DESCRIPTORS(X)                                                                                 \
+    X(kParameterFloat, "Parameter Float", 0.0, 100.0, 50.0, CPLUG_FLAG_PARAMETER_IS_AUTOMATABLE, 1.0)                  \
+    X(kParameterInt, "Parameter Int", 2.0, 5.0, 2.0,                                                                   \
+      CPLUG_FLAG_PARAMETER_IS_AUTOMATABLE | CPLUG_FLAG_PARAMETER_IS_INTEGER, 1.0)                                      \
+    X(kParameterBool, "Parameter Bool", 0.0, 1.0, 0.0, CPLUG_FLAG_PARAMETER_IS_BOOL, 1.0)                              \
+    X(kParameterUTF8, "UTF8 Приве́т नमस्ते שָׁלוֹם 🐨", 0.0, 1.0, 0.0, CPLUG_FLAG_PARAMETER_IS_AUTOMATABLE, 1.0)             \
+    X(kParameterGain, "Gain (dB)", -60.0, 6.0, 0.0, CPLUG_FLAG_PARAMETER_IS_AUTOMATABLE, 1.0)
+// clang-format on
+
 enum Parameters
 {
-    kParameterFloat,
-    kParameterInt,
-    kParameterBool,
-    kParameterUTF8,
+#define PARAMETER_ENUM(id, ...) id,
+    CPLUG_PARAMETER_DESCRIPTORS(PARAMETER_ENUM)
+#undef PARAMETER_ENUM
     kParameterCount
 };
 
-#define CPLUG_NUM_PARAMS 4
+#define CPLUG_NUM_PARAMS 5
 
 #endif // PLUGIN_CONFIG_H
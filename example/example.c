@@ -1,51 +1,33 @@
 #include <cplug.h>
+#include <cplug_dsp.h>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
 
 #ifdef _WIN32
 #define my_assert(cond) (cond) ? (void)0 : __debugbreak()
-#else
+#elif defined(__clang__)
 #define my_assert(cond) (cond) ? (void)0 : __builtin_debugtrap()
-#endif
-
-// Apparently denormals aren't a problem on ARM & M1?
-// https://en.wikipedia.org/wiki/Subnormal_number
-// https://www.kvraudio.com/forum/viewtopic.php?t=575799
-#if __arm64__
-#define DISABLE_DENORMALS
-#define ENABLE_DENORMALS
-#elif defined(_WIN32)
-#include <immintrin.h>
-#define DISABLE_DENORMALS _mm_setcsr(_mm_getcsr() & ~0x8040);
-#define ENABLE_DENORMALS _mm_setcsr(_mm_getcsr() | 0x8040);
 #else
-#include <fenv.h>
-#define DISABLE_DENORMALS                                                                                              \
-    fenv_t _fenv;                                                                                                      \
-    fegetenv(&_fenv);                                                                                                  \
-    fesetenv(FE_DFL_DISABLE_SSE_DENORMS_ENV);
-#define ENABLE_DENORMALS fesetenv(&_fenv);
+#define my_assert(cond) (cond) ? (void)0 : __builtin_trap()
 #endif
 
 static_assert((int)CPLUG_NUM_PARAMS == kParameterCount, "Must be equal");
 
-typedef struct ParamInfo
+// Built on the main thread by cplug_loadState, then adopted by the audio thread
+typedef struct MyPreset
 {
-    float min;
-    float max;
-    float defaultValue;
-    int   flags;
-} ParamInfo;
+    float paramValues[kParameterCount];
+} MyPreset;
 
 typedef struct MyPlugin
 {
-    ParamInfo paramInfo[kParameterCount];
-
     float    sampleRate;
     uint32_t maxBufferSize;
 
     float paramValuesAudio[kParameterCount];
+    // Ramps the linear gain, so automating kParameterGain doesn't click
+    CplugSmoother gainSmoother;
 
     float oscPhase; // 0-1
     int   midiNote; // -1 == not playing, 0-127+ playing
@@ -53,21 +35,20 @@ typedef struct MyPlugin
 
     // GUI zone
     void* gui;
+    // What the host & GUI see. Only written on the main thread: by the GUI, by tickGUI draining audioToMainQueue, and
+    // by cplug_loadState before the audio thread adopts the preset
     float paramValuesMain[kParameterCount];
 
-    // Single reader writer queue. Pretty sure atomics aren't required, but here anyway
-    cplug_atomic_i32 mainToAudioHead;
-    cplug_atomic_i32 mainToAudioTail;
-    CplugEvent       mainToAudioQueue[CPLUG_EVENT_QUEUE_SIZE];
-
-    cplug_atomic_i32 audioToMainHead;
-    cplug_atomic_i32 audioToMainTail;
-    CplugEvent       audioToMainQueue[CPLUG_EVENT_QUEUE_SIZE];
+    CplugEventQueue mainToAudioQueue;
+    CplugEventQueue audioToMainQueue;
+    CplugRCU        presetRCU;
 } MyPlugin;
 
 void sendParamEventFromMain(MyPlugin* plugin, uint32_t type, uint32_t paramIdx, double value);
 
-void cplug_libraryLoad(){};
+static float dBToGain(float dB) { return powf(10.0f, dB / 20.0f); }
+
+void cplug_libraryLoad() { cplug_dsp_init(); };
 void cplug_libraryUnload(){};
 
 void* cplug_createPlugin()
@@ -75,33 +56,22 @@ void* cplug_createPlugin()
     MyPlugin* plugin = (MyPlugin*)malloc(sizeof(MyPlugin));
     memset(plugin, 0, sizeof(*plugin));
 
-    // Init params
-    plugin->paramInfo[kParameterFloat].flags        = CPLUG_FLAG_PARAMETER_IS_AUTOMATABLE;
-    plugin->paramInfo[kParameterFloat].max          = 100.0f;
-    plugin->paramInfo[kParameterFloat].defaultValue = 50.0f;
-
-    plugin->paramValuesAudio[kParameterInt] = 2.0f;
-    plugin->paramInfo[kParameterInt].flags  = CPLUG_FLAG_PARAMETER_IS_AUTOMATABLE | CPLUG_FLAG_PARAMETER_IS_INTEGER;
-    plugin->paramInfo[kParameterInt].min    = 2.0f;
-    plugin->paramInfo[kParameterInt].max    = 5.0f;
-    plugin->paramInfo[kParameterInt].defaultValue = 2.0f;
-
-    plugin->paramInfo[kParameterBool].flags = CPLUG_FLAG_PARAMETER_IS_BOOL;
-    plugin->paramInfo[kParameterBool].max   = 1.0f;
-
-    plugin->paramValuesAudio[kParameterUTF8]       = 0.0f;
-    plugin->paramInfo[kParameterUTF8].flags        = CPLUG_FLAG_PARAMETER_IS_AUTOMATABLE;
-    plugin->paramInfo[kParameterUTF8].min          = 0.0f;
-    plugin->paramInfo[kParameterUTF8].max          = 1.0f;
-    plugin->paramInfo[kParameterUTF8].defaultValue = 0.0f;
+    // Init params. Ranges, flags & names are declared in config.h, see CPLUG_PARAMETER_DESCRIPTORS
+    for (uint32_t i = 0; i < kParameterCount; i++)
+        plugin->paramValuesAudio[i] = (float)cplug_getParamDescriptor(i)->defaultValue;
+    memcpy(plugin->paramValuesMain, plugin->paramValuesAudio, sizeof(plugin->paramValuesMain));
 
     plugin->midiNote = -1;
 
+    plugin->presetRCU.freeProc = free;
+
     return plugin;
 }
 void cplug_destroyPlugin(void* ptr)
 {
     // Free any allocated resources in your plugin here
+    MyPlugin* plugin = (MyPlugin*)ptr;
+    cplug_rcu_destroy(&plugin->presetRCU);
     free(ptr);
 }
 
@@ -141,41 +111,28 @@ const char* cplug_getOutputBusName(void* ptr, uint32_t idx)
 
 const char* cplug_getParameterName(void* ptr, uint32_t index)
 {
-    static const char* param_names[] = {
-        "Parameter Float",
-        "Parameter Int",
-        "Parameter Bool",
-        // https://utf8everywhere.org/
-        // UTF8    = 1 byte per character
-        // Приве́т  = 2 bytes
-        // नमस्ते     = 3 bytes
-        // שלום = 3 בייטים
-        // 🐨       = 4 bytes
-        "UTF8 Приве́т नमस्ते שָׁלוֹם 🐨"};
-    static_assert((sizeof(param_names) / sizeof(param_names[0])) == kParameterCount, "Invalid length");
-    return param_names[index];
+    return cplug_getParamDescriptor(index)->name;
 }
 
 double cplug_getParameterValue(void* ptr, uint32_t index)
 {
     const MyPlugin* plugin = (MyPlugin*)ptr;
-    double          val    = plugin->paramValuesAudio[index];
-    if (plugin->paramInfo[index].flags & CPLUG_FLAG_PARAMETER_IS_INTEGER)
+    double          val    = plugin->paramValuesMain[index];
+    if (cplug_getParamDescriptor(index)->flags & CPLUG_FLAG_PARAMETER_IS_INTEGER)
         val = round(val);
     return val;
 }
 
 double cplug_getDefaultParameterValue(void* ptr, uint32_t index)
 {
-    MyPlugin* plugin = (MyPlugin*)ptr;
-    return plugin->paramInfo[index].defaultValue;
+    return cplug_getParamDescriptor(index)->defaultValue;
 }
 
 void cplug_setParameterValue(void* ptr, uint32_t index, double value)
 {
     MyPlugin* plugin = (MyPlugin*)ptr;
 
-    ParamInfo* info = &plugin->paramInfo[index];
+    const CplugParamDescriptor* info = cplug_getParamDescriptor(index);
     if (value < info->min)
         value = info->min;
     if (value > info->max)
@@ -185,52 +142,28 @@ void cplug_setParameterValue(void* ptr, uint32_t index, double value)
     // Send incoming param update to GUI
     if (plugin->gui)
     {
-        int queueWritePos = cplug_atomic_load_i32(&plugin->audioToMainHead) & CPLUG_EVENT_QUEUE_MASK;
-
-        plugin->audioToMainQueue[queueWritePos].parameter.type  = CPLUG_EVENT_PARAM_CHANGE_UPDATE;
-        plugin->audioToMainQueue[queueWritePos].parameter.idx   = index;
-        plugin->audioToMainQueue[queueWritePos].parameter.value = value;
-
-        cplug_atomic_fetch_add_i32(&plugin->audioToMainHead, 1);
-        cplug_atomic_fetch_and_i32(&plugin->audioToMainHead, CPLUG_EVENT_QUEUE_MASK);
+        CplugEvent event;
+        event.parameter.type  = CPLUG_EVENT_PARAM_CHANGE_UPDATE;
+        event.parameter.idx   = index;
+        event.parameter.value = value;
+        cplug_eventQueue_push(&plugin->audioToMainQueue, &event);
     }
 }
 
 double cplug_denormaliseParameterValue(void* ptr, uint32_t index, double normalised)
 {
-    const MyPlugin*  plugin = (MyPlugin*)ptr;
-    const ParamInfo* info   = &plugin->paramInfo[index];
-
-    double denormalised = normalised * (info->max - info->min) + info->min;
-
-    if (denormalised < info->min)
-        denormalised = info->min;
-    if (denormalised > info->max)
-        denormalised = info->max;
-    return denormalised;
+    return cplug_paramDescriptor_denormalise(cplug_getParamDescriptor(index), normalised);
 }
 
 double cplug_normaliseParameterValue(void* ptr, uint32_t index, double denormalised)
 {
-    const MyPlugin*  plugin = (MyPlugin*)ptr;
-    const ParamInfo* info   = &plugin->paramInfo[index];
-
-    // If this fails, your param range is likely not initialised, causing a division by zero and producing infinity
-    double normalised = (denormalised - info->min) / (info->max - info->min);
-    my_assert(normalised == normalised);
-
-    if (normalised < 0.0f)
-        normalised = 0.0f;
-    if (normalised > 1.0f)
-        normalised = 1.0f;
-    return normalised;
+    return cplug_paramDescriptor_normalise(cplug_getParamDescriptor(index), denormalised);
 }
 
 double cplug_parameterStringToValue(void* ptr, uint32_t index, const char* str)
 {
-    double          value;
-    const MyPlugin* plugin = (MyPlugin*)ptr;
-    const unsigned  flags  = plugin->paramInfo[index].flags;
+    double         value;
+    const uint32_t flags = cplug_getParamDescriptor(index)->flags;
 
     if (flags & CPLUG_FLAG_PARAMETER_IS_INTEGER)
         value = (double)atoi(str);
@@ -242,8 +175,7 @@ double cplug_parameterStringToValue(void* ptr, uint32_t index, const char* str)
 
 void cplug_parameterValueToString(void* ptr, uint32_t index, char* buf, size_t bufsize, double value)
 {
-    const MyPlugin* plugin = (MyPlugin*)ptr;
-    const uint32_t  flags  = plugin->paramInfo[index].flags;
+    const uint32_t flags = cplug_getParamDescriptor(index)->flags;
 
     if (flags & CPLUG_FLAG_PARAMETER_IS_BOOL)
         value = value >= 0.5 ? 1 : 0;
@@ -256,17 +188,18 @@ void cplug_parameterValueToString(void* ptr, uint32_t index, char* buf, size_t b
         snprintf(buf, bufsize, "%.2f", value);
 }
 
+// Our text only depends on the value, so cached text never goes stale
+uint32_t cplug_getParameterTextVersion(void* ptr) { return 0; }
+
 void cplug_getParameterRange(void* ptr, uint32_t index, double* min, double* max)
 {
-    const MyPlugin* plugin = (MyPlugin*)ptr;
-    *min                   = plugin->paramInfo[index].min;
-    *max                   = plugin->paramInfo[index].max;
+    *min = cplug_getParamDescriptor(index)->min;
+    *max = cplug_getParamDescriptor(index)->max;
 }
 
 uint32_t cplug_getParameterFlags(void* ptr, uint32_t index)
 {
-    const MyPlugin* plugin = (MyPlugin*)ptr;
-    return plugin->paramInfo[index].flags;
+    return cplug_getParamDescriptor(index)->flags;
 }
 
 /* --------------------------------------------------------------------------------------------------------
@@ -274,120 +207,151 @@ uint32_t cplug_getParameterFlags(void* ptr, uint32_t index)
 
 uint32_t cplug_getLatencyInSamples(void* ptr) { return 0; }
 uint32_t cplug_getTailInSamples(void* ptr) { return 0; }
+uint32_t cplug_getEventQuantize(void* ptr) { return CPLUG_EVENT_FRAME_QUANTIZE; }
+bool cplug_canProcessDouble(void* ptr) { return false; }
+void cplug_setRenderMode(void* ptr, uint32_t renderMode) {}
 
 void cplug_setSampleRateAndBlockSize(void* ptr, double sampleRate, uint32_t maxBlockSize)
 {
     MyPlugin* plugin      = (MyPlugin*)ptr;
     plugin->sampleRate    = (float)sampleRate;
     plugin->maxBufferSize = maxBlockSize;
+
+    float gain = dBToGain(plugin->paramValuesAudio[kParameterGain]);
+    cplug_smoother_init(&plugin->gainSmoother, CPLUG_SMOOTHER_MULTIPLICATIVE, 20.0f, sampleRate, gain);
 }
 
-void cplug_process(void* ptr, CplugProcessContext* ctx)
+// Applies the smoothed gain in chunks, so the per frame gains fit on the stack
+static void applyGain(MyPlugin* plugin, float* buf, uint32_t numFrames)
 {
-    DISABLE_DENORMALS
-
-    MyPlugin* plugin = (MyPlugin*)ptr;
+    float gains[64];
+    for (uint32_t frame = 0; frame < numFrames; frame += 64)
+    {
+        uint32_t n = numFrames - frame < 64 ? numFrames - frame : 64;
+        if (cplug_smoother_process(&plugin->gainSmoother, gains, n))
+            cplug_dsp_gain(&buf[frame], &buf[frame], plugin->gainSmoother.current, n);
+        else
+            for (uint32_t i = 0; i < n; i++)
+                buf[frame + i] *= gains[i];
+    }
+}
 
-    // Audio thread has chance to respond to incoming GUI events before being sent to the host
-    int head = cplug_atomic_load_i32(&plugin->mainToAudioHead) & CPLUG_EVENT_QUEUE_MASK;
-    int tail = cplug_atomic_load_i32(&plugin->mainToAudioTail);
+void cplug_process(void* ptr, CplugProcessContext* ctx)
+{
+    MyPlugin*  plugin = (MyPlugin*)ptr;
+    CplugEvent event;
 
-    while (tail != head)
+    // Adopt a preset loaded on the main thread, then notify the host of the new values
+    if (cplug_rcu_adopt(&plugin->presetRCU))
     {
-        CplugEvent* event = &plugin->mainToAudioQueue[tail];
+        const MyPreset* preset = (const MyPreset*)plugin->presetRCU.current;
+        for (uint32_t i = 0; i < kParameterCount; i++)
+        {
+            plugin->paramValuesAudio[i] = preset->paramValues[i];
 
-        if (event->type == CPLUG_EVENT_PARAM_CHANGE_UPDATE)
-            plugin->paramValuesAudio[event->parameter.idx] = event->parameter.value;
+            event.parameter.type  = CPLUG_EVENT_PARAM_CHANGE_UPDATE;
+            event.parameter.idx   = i;
+            event.parameter.value = preset->paramValues[i];
+            ctx->enqueueEvent(ctx, &event, 0);
+        }
+    }
 
-        ctx->enqueueEvent(ctx, event, 0);
+    // Audio thread has chance to respond to incoming GUI events before being sent to the host
+    while (cplug_eventQueue_pop(&plugin->mainToAudioQueue, &event))
+    {
+        if (event.type == CPLUG_EVENT_PARAM_CHANGE_UPDATE)
+            plugin->paramValuesAudio[event.parameter.idx] = event.parameter.value;
 
-        tail++;
-        tail &= CPLUG_EVENT_QUEUE_MASK;
+        ctx->enqueueEvent(ctx, &event, 0);
     }
-    cplug_atomic_exchange_i32(&plugin->mainToAudioTail, tail);
 
     // "Sample accurate" process loop
-    CplugEvent event;
-    int        frame = 0;
-    while (ctx->dequeueEvent(ctx, &event, frame))
+    CplugEvent events[64];
+    uint32_t   numEvents;
+    int        frame    = 0;
+    bool       isSilent = true;
+    while ((numEvents = ctx->dequeueEvents(ctx, events, 64, frame)) != 0)
     {
-        switch (event.type)
-        {
-        case CPLUG_EVENT_PARAM_CHANGE_UPDATE:
-            cplug_setParameterValue(plugin, event.parameter.idx, event.parameter.value);
-            break;
-        case CPLUG_EVENT_MIDI:
+        for (uint32_t i = 0; i < numEvents; i++)
         {
-            static const uint8_t MIDI_NOTE_OFF         = 0x80;
-            static const uint8_t MIDI_NOTE_ON          = 0x90;
-            static const uint8_t MIDI_NOTE_PITCH_WHEEL = 0xe0;
+            event = events[i];
 
-            if ((event.midi.status & 0xf0) == MIDI_NOTE_ON)
+            switch (event.type)
             {
-                plugin->midiNote = event.midi.data1;
-                plugin->velocity = (float)event.midi.data2 / 127.0f;
-            }
-            if ((event.midi.status & 0xf0) == MIDI_NOTE_OFF)
-            {
-                int note = event.midi.data1;
-                if (note == plugin->midiNote)
-                    plugin->midiNote = -1;
-                plugin->velocity = (float)event.midi.data2 / 127.0f;
-            }
-            if ((event.midi.status & 0xf0) == MIDI_NOTE_PITCH_WHEEL)
+            case CPLUG_EVENT_PARAM_CHANGE_UPDATE:
+                cplug_setParameterValue(plugin, event.parameter.idx, event.parameter.value);
+                break;
+            case CPLUG_EVENT_MIDI:
             {
-                int pb = (int)event.midi.data1 | ((int)event.midi.data2 << 7);
-            }
-            break;
-        }
-        case CPLUG_EVENT_PROCESS_AUDIO:
-        {
-            // If your plugin does not require sample accurate processing, use this line below to break the loop
-            // frame = event.processAudio.endFrame;
-
-            float** output = ctx->getAudioOutput(ctx, 0);
-            CPLUG_LOG_ASSERT(output != NULL)
-            CPLUG_LOG_ASSERT(output[0] != NULL);
-            CPLUG_LOG_ASSERT(output[1] != NULL);
+                static const uint8_t MIDI_NOTE_OFF         = 0x80;
+                static const uint8_t MIDI_NOTE_ON          = 0x90;
+                static const uint8_t MIDI_NOTE_PITCH_WHEEL = 0xe0;
 
-            if (plugin->midiNote == -1)
-            {
-                // Silence
-                memset(&output[0][frame], 0, sizeof(float) * (event.processAudio.endFrame - frame));
-                memset(&output[1][frame], 0, sizeof(float) * (event.processAudio.endFrame - frame));
-                frame = event.processAudio.endFrame;
+                if ((event.midi.status & 0xf0) == MIDI_NOTE_ON)
+                {
+                    plugin->midiNote = event.midi.data1;
+                    plugin->velocity = (float)event.midi.data2 / 127.0f;
+                }
+                if ((event.midi.status & 0xf0) == MIDI_NOTE_OFF)
+                {
+                    int note = event.midi.data1;
+                    if (note == plugin->midiNote)
+                        plugin->midiNote = -1;
+                    plugin->velocity = (float)event.midi.data2 / 127.0f;
+                }
+                if ((event.midi.status & 0xf0) == MIDI_NOTE_PITCH_WHEEL)
+                {
+                    int pb = (int)event.midi.data1 | ((int)event.midi.data2 << 7);
+                }
+                break;
             }
-            else
+            case CPLUG_EVENT_PROCESS_AUDIO:
             {
-                float phase = plugin->oscPhase;
+                // If your plugin does not require sample accurate processing, use this line below to break the loop
+                // frame = event.processAudio.endFrame;
 
-                float Hz  = 440.0f * exp2f(((float)plugin->midiNote - 69.0f) * 0.0833333f);
-                float inc = Hz / plugin->sampleRate;
-                float dB  = -60.0f + plugin->velocity * 54; // -6dB max
-                float vol = powf(10.0f, dB / 20.0f);
+                float** output = ctx->getAudioOutput(ctx, 0);
+                CPLUG_LOG_ASSERT(output != NULL)
+                CPLUG_LOG_ASSERT(output[0] != NULL);
+                CPLUG_LOG_ASSERT(output[1] != NULL);
 
-                for (; frame < event.processAudio.endFrame; frame++)
+                if (plugin->midiNote == -1)
                 {
-                    static const float pi = 3.141592653589793f;
-
-                    float sample = vol * sinf(2 * pi * phase);
-
-                    for (int ch = 0; ch < 2; ch++)
-                        output[ch][frame] = sample;
-
-                    phase += inc;
-                    phase -= (int)phase;
+                    // Silence
+                    cplug_dsp_clear(&output[0][frame], event.processAudio.endFrame - frame);
+                    cplug_dsp_clear(&output[1][frame], event.processAudio.endFrame - frame);
+                    frame = event.processAudio.endFrame;
                 }
-
-                plugin->oscPhase = phase;
+                else
+                {
+                    float Hz  = 440.0f * exp2f(((float)plugin->midiNote - 69.0f) * 0.0833333f);
+                    float inc = Hz / plugin->sampleRate;
+                    float dB  = -60.0f + plugin->velocity * 54; // -6dB max
+                    float vol = dBToGain(dB);
+
+                    // The host, GUI, AUv2 & presets all change paramValuesAudio, so follow it from here
+                    float gain = dBToGain(plugin->paramValuesAudio[kParameterGain]);
+                    if (gain != plugin->gainSmoother.target)
+                        cplug_smoother_setTarget(&plugin->gainSmoother, gain);
+
+                    isSilent           = false;
+                    uint32_t numFrames = event.processAudio.endFrame - frame;
+                    plugin->oscPhase   = cplug_dsp_sine(&output[0][frame], plugin->oscPhase, inc, vol, numFrames);
+                    applyGain(plugin, &output[0][frame], numFrames);
+                    cplug_dsp_copy(&output[1][frame], &output[0][frame], numFrames);
+                    frame = event.processAudio.endFrame;
+                }
+                break;
+            }
+            default:
+                break;
             }
-            break;
-        }
-        default:
-            break;
         }
     }
-    ENABLE_DENORMALS
+
+    // Hosts can skip processing further down the chain while no note is playing
+    if (isSilent)
+        cplug_setOutputSilence(ctx, 0, 0x3);
 }
 
 /* --------------------------------------------------------------------------------------------------------
@@ -398,7 +362,7 @@ void cplug_process(void* ptr, CplugProcessContext* ctx)
 void cplug_saveState(void* userPlugin, const void* stateCtx, cplug_writeProc writeProc)
 {
     MyPlugin* plugin = (MyPlugin*)userPlugin;
-    writeProc(stateCtx, plugin->paramValuesAudio, sizeof(plugin->paramValuesAudio));
+    writeProc(stateCtx, plugin->paramValuesMain, sizeof(plugin->paramValuesMain));
 }
 
 void cplug_loadState(void* userPlugin, const void* stateCtx, cplug_readProc readProc)
@@ -409,33 +373,29 @@ void cplug_loadState(void* userPlugin, const void* stateCtx, cplug_readProc read
 
     int64_t bytesRead = readProc(stateCtx, vals, sizeof(vals));
 
-    if (bytesRead == sizeof(plugin->paramValuesAudio))
+    if (bytesRead == sizeof(plugin->paramValuesMain))
     {
-        // Send update to queue so we notify host
-        for (int i = 0; i < kParameterCount; i++)
-        {
-            plugin->paramValuesAudio[i] = vals[i];
-            plugin->paramValuesMain[i]  = vals[i];
-            sendParamEventFromMain(plugin, CPLUG_EVENT_PARAM_CHANGE_UPDATE, i, vals[i]);
-        }
+        // The audio thread may be running. Build the whole preset here & let it swap the preset in on its next block
+        MyPreset* preset = (MyPreset*)malloc(sizeof(MyPreset));
+        memcpy(preset->paramValues, vals, sizeof(preset->paramValues));
+        memcpy(plugin->paramValuesMain, vals, sizeof(plugin->paramValuesMain));
+        cplug_rcu_publish(&plugin->presetRCU, preset);
     }
 }
 
 void sendParamEventFromMain(MyPlugin* plugin, uint32_t type, uint32_t paramIdx, double value)
 {
-    int         mainToAudioHead = cplug_atomic_load_i32(&plugin->mainToAudioHead) & CPLUG_EVENT_QUEUE_MASK;
-    CplugEvent* paramEvent      = &plugin->mainToAudioQueue[mainToAudioHead];
-    paramEvent->parameter.type  = type;
-    paramEvent->parameter.idx   = paramIdx;
-    paramEvent->parameter.value = value;
-
-    cplug_atomic_fetch_add_i32(&plugin->mainToAudioHead, 1);
-    cplug_atomic_fetch_and_i32(&plugin->mainToAudioHead, CPLUG_EVENT_QUEUE_MASK);
+    CplugEvent paramEvent;
+    paramEvent.parameter.type  = type;
+    paramEvent.parameter.idx   = paramIdx;
+    paramEvent.parameter.value = value;
+    if (! cplug_eventQueue_push(&plugin->mainToAudioQueue, &paramEvent))
+        cplug_log("Main to audio event queue is full. Dropped param event %u", paramIdx);
 
     // request_flush from CLAP host? Doesn't seem to be required
 }
 
-#ifdef CPLUG_WANT_GUI
+#if CPLUG_WANT_GUI
 
 #define GUI_DEFAULT_WIDTH 640
 #define GUI_DEFAULT_HEIGHT 360
@@ -535,28 +495,30 @@ bool tickGUI(MyGUI* gui)
     bool needRedraw = false;
 
     MyPlugin* plugin = gui->plugin;
-    int       head   = cplug_atomic_load_i32(&plugin->audioToMainHead) & CPLUG_EVENT_QUEUE_MASK;
-    int       tail   = cplug_atomic_load_i32(&plugin->audioToMainTail);
-
-    needRedraw = tail != head;
 
-    while (tail != head)
+    CplugEvent events[32];
+    uint32_t   numEvents;
+    while ((numEvents = cplug_eventQueue_pop_n(&plugin->audioToMainQueue, events, 32)) != 0)
     {
-        CplugEvent* event = &plugin->audioToMainQueue[tail];
+        needRedraw = true;
 
-        switch (event->type)
+        for (uint32_t i = 0; i < numEvents; i++)
         {
-        case CPLUG_EVENT_PARAM_CHANGE_UPDATE:
-            plugin->paramValuesMain[event->parameter.idx] = event->parameter.value;
-            break;
-        default:
-            break;
+            switch (events[i].type)
+            {
+            case CPLUG_EVENT_PARAM_CHANGE_UPDATE:
+                plugin->paramValuesMain[events[i].parameter.idx] = events[i].parameter.value;
+                break;
+            default:
+                break;
+            }
         }
-
-        tail++;
-        tail &= CPLUG_EVENT_QUEUE_MASK;
     }
-    cplug_atomic_exchange_i32(&plugin->audioToMainTail, tail);
+
+    // The audio thread has sent more param updates than we could keep up with
+    int numOverflows = cplug_atomic_exchange_i32(&plugin->audioToMainQueue.numOverflows, 0);
+    if (numOverflows)
+        cplug_log("Audio to main event queue overflowed. Dropped %d events", numOverflows);
 
     return needRedraw;
 }
@@ -701,7 +663,6 @@ void cplug_setParent(void* userGUI, void* newParent)
     if (newParent)
     {
         SetParent((HWND)gui->window, (HWND)newParent);
-        memcpy(gui->plugin->paramValuesMain, gui->plugin->paramValuesAudio, sizeof(gui->plugin->paramValuesMain));
         DefWindowProcA((HWND)gui->window, WM_UPDATEUISTATE, UIS_CLEAR, WS_POPUP);
         DefWindowProcA((HWND)gui->window, WM_UPDATEUISTATE, UIS_SET, WS_CHILD);
 
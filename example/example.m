@@ -145,8 +145,6 @@ void* cplug_createGUI(void* userPlugin)
     gui->height = GUI_DEFAULT_HEIGHT;
     gui->img    = (uint32_t*)realloc(gui->img, gui->width * gui->height * sizeof(*gui->img));
 
-    memcpy(gui->plugin->paramValuesMain, gui->plugin->paramValuesAudio, sizeof(gui->plugin->paramValuesMain));
-
     CFRunLoopTimerContext context = {};
     context.info                  = wrapper;
     double interval               = 0.01; // 10ms
@@ -34,11 +34,16 @@ extern "C" {
 #endif
 #define CPLUG_EVENT_QUEUE_MASK (CPLUG_EVENT_QUEUE_SIZE - 1)
 
-// How sample accurate do you need your events?
+// How sample accurate do you need your events? Default value for cplug_getEventQuantize
 #ifndef CPLUG_EVENT_FRAME_QUANTIZE
 #define CPLUG_EVENT_FRAME_QUANTIZE 64
 #endif
 
+// Max bytes passed to a host stream in a single read or write. Wrappers loop over short reads & writes
+#ifndef CPLUG_STATE_CHUNK_SIZE
+#define CPLUG_STATE_CHUNK_SIZE (1 << 20)
+#endif
+
 CPLUG_API void cplug_libraryLoad();
 CPLUG_API void cplug_libraryUnload();
 
@@ -56,6 +61,22 @@ CPLUG_API uint32_t cplug_getLatencyInSamples(void*);
 CPLUG_API uint32_t cplug_getTailInSamples(void*);
 
 CPLUG_API void cplug_setSampleRateAndBlockSize(void*, double sampleRate, uint32_t maxBlockSize);
+// Called after cplug_setSampleRateAndBlockSize. Events are aligned to multiples of this many frames, and only the last
+// change to a parameter within each multiple is kept. Must be a power of 2. Return 1 for sample accurate events
+CPLUG_API uint32_t cplug_getEventQuantize(void*);
+// (VST3 | CLAP) Return true if your process method can handle double precision buffers. See getAudioInput64
+CPLUG_API bool cplug_canProcessDouble(void*);
+
+enum
+{
+    CPLUG_RENDER_MODE_REALTIME, // Default
+    CPLUG_RENDER_MODE_PREFETCH, // (VST3) Not realtime, but the host may be playing back what you render soon
+    CPLUG_RENDER_MODE_OFFLINE,  // Bouncing/exporting. Safe to use more expensive algorithms
+};
+// Main thread. Called when the host changes the render mode. VST3 & AUv2 only change it before audio processing
+// starts. CLAP may change it while processing, so this can run concurrently with cplug_process on the audio thread.
+// Blocks processed after it returns see the new mode in CplugProcessContext
+CPLUG_API void cplug_setRenderMode(void*, uint32_t renderMode);
 
 enum
 {
@@ -81,6 +102,10 @@ typedef union CplugEvent
         uint32_t type;
         uint32_t idx;
         double   value;
+#if CPLUG_WANT_PARAMETER_COOKIES
+        // Pointer from cplug_getParameterCookie, sent with host parameter changes (VST3 & CLAP). Otherwise NULL
+        void* cookie;
+#endif
     } parameter;
 
     struct
@@ -111,6 +136,37 @@ enum
     CPLUG_FLAG_TRANSPORT_HAS_PLAYHEAD_BEATS = 1 << 5,
 };
 
+enum
+{
+    CPLUG_SMOOTHER_NONE,           // Jumps straight to the new value
+    CPLUG_SMOOTHER_LINEAR,         // Reaches the new value in 'timeMs'
+    CPLUG_SMOOTHER_ONE_POLE,       // Exponential approach, 'timeMs' is the time constant
+    CPLUG_SMOOTHER_MULTIPLICATIVE, // Constant ratio per frame, reaches the new value in 'timeMs'. Good for freq & gain
+};
+
+// See getAutomation in CplugProcessContext. Use cplug_renderAutomation in UTILS to render linear ramps
+typedef struct CplugAutomationPoint
+{
+    uint32_t frame;
+    double   value;
+} CplugAutomationPoint;
+
+// Use cplug_smoother_init & cplug_smoother_process in UTILS
+typedef struct CplugSmoother
+{
+    uint32_t type;
+    uint32_t rampType;
+    uint32_t rampFrames;
+    float    coefficient;
+    float    current;
+    float    target;
+    float    step; // Increment (linear) or ratio (multiplicative) per frame
+    uint32_t remainingFrames;
+} CplugSmoother;
+
+// Called once for every task index. See parallelFor in CplugProcessContext
+typedef void (*cplug_taskProc)(void* userdata, uint32_t taskIdx);
+
 typedef struct CplugProcessContext
 {
     uint32_t numFrames;
@@ -123,11 +179,67 @@ typedef struct CplugProcessContext
     uint32_t timeSigNumerator;
     uint32_t timeSigDenominator;
 
+    uint32_t renderMode; // CPLUG_RENDER_MODE_*
+
     bool (*enqueueEvent)(struct CplugProcessContext* ctx, const CplugEvent*, uint32_t frameIdx);
     bool (*dequeueEvent)(struct CplugProcessContext* ctx, CplugEvent*, uint32_t frameIdx);
+    // Batched version of dequeueEvent. Fills 'events' with every event starting from 'frameIdx', up to and including
+    // the next CPLUG_EVENT_PROCESS_AUDIO event. Returns the number of events written, or 0 when all frames are
+    // processed. If 'maxEvents' is reached before a CPLUG_EVENT_PROCESS_AUDIO event, call again with the same frameIdx
+    uint32_t (*dequeueEvents)(struct CplugProcessContext* ctx, CplugEvent*, uint32_t maxEvents, uint32_t frameIdx);
 
     float** (*getAudioInput)(const struct CplugProcessContext* ctx, uint32_t busIdx);
     float** (*getAudioOutput)(const struct CplugProcessContext* ctx, uint32_t busIdx);
+
+    // (VST3 | CLAP) Only if cplug_canProcessDouble returns true. When the host is processing in double precision,
+    // 'isDoublePrecision' is true and the buffers must be accessed with the methods below. getAudioInput &
+    // getAudioOutput will return NULL. Otherwise the methods below return NULL
+    bool isDoublePrecision;
+    double** (*getAudioInput64)(const struct CplugProcessContext* ctx, uint32_t busIdx);
+    double** (*getAudioOutput64)(const struct CplugProcessContext* ctx, uint32_t busIdx);
+
+    // Hosts may process in place, passing the same buffer as a channel's input & output. Bit N is set when every
+    // channel of output bus N is the same buffer as that channel of input bus N (busses 0 to 31). Effects can then
+    // process the output directly instead of copying the input first, as long as each sample is read before it is
+    // written. Applies to the 32 or 64bit buffers, whichever isDoublePrecision selects. Always 0 in the standalones
+    uint32_t inPlaceBusses;
+    // Per channel version of inPlaceBusses, for hosts that share only some channels. NULL in the standalones.
+    // Prefer calling cplug_isInPlace in UTILS
+    bool (*isInPlace)(const struct CplugProcessContext* ctx, uint32_t busIdx, uint32_t channelIdx);
+
+    // (VST3 | CLAP) Host hints for input bus 'busIdx', one bit per channel (channels 0 to 63). Silent channels are all
+    // zeros. Constant channels repeat sample 0 for the whole block, silent channels included. Buffers are still filled,
+    // so reading them is always safe. Effects can skip work on silent input. NULL in other formats.
+    // Prefer calling cplug_getInputSilence & cplug_getInputConstant in UTILS
+    uint64_t (*getInputSilence)(const struct CplugProcessContext* ctx, uint32_t busIdx);
+    uint64_t (*getInputConstant)(const struct CplugProcessContext* ctx, uint32_t busIdx);
+    // (VST3 | CLAP | AUv2) Tells the host which channels of output bus 'busIdx' are silent this block, one bit per
+    // channel. The buffers must still be filled with zeros. Outputs are reported as not silent unless this is called.
+    // AUv2 only reports bus 0, once all its channels are silent. Prefer calling cplug_setOutputSilence in UTILS
+    void (*setOutputSilence)(struct CplugProcessContext* ctx, uint32_t busIdx, uint64_t channelMask);
+
+    // VST3 only, requires CPLUG_WANT_DENSE_AUTOMATION. NULL otherwise.
+    // Returns every automation point the host sent for a parameter in this block, unquantized & sorted by frame.
+    // Host intend for values between points to be linearly interpolated. Parameter change events are still sent
+    uint32_t (*getAutomation)(
+        const struct CplugProcessContext* ctx,
+        uint32_t                          paramIdx,
+        const CplugAutomationPoint**      points);
+
+    // Optional. Set these in cplug_process before dequeuing events, and every CPLUG_EVENT_PARAM_CHANGE_UPDATE event
+    // will set the target of smoothers[event.parameter.idx]. (CLAP | VST3). AUv2 uses cplug_setParameterValue
+    CplugSmoother* smoothers;
+    uint32_t       numSmoothers;
+
+    // Runs 'taskProc' for every task index in [0, taskCount) across multiple threads, including the calling thread,
+    // and returns once all tasks are complete. CLAP uses the hosts thread pool when available. VST3, CLAP & the
+    // standalones otherwise use a cplug owned pool when CPLUG_WANT_THREAD_POOL is set. May be NULL (AUv2).
+    // Prefer calling cplug_parallelFor in UTILS, which runs tasks serially when this is NULL
+    void (*parallelFor)(
+        struct CplugProcessContext* ctx,
+        uint32_t                    taskCount,
+        cplug_taskProc              taskProc,
+        void*                       userdata);
 } CplugProcessContext;
 
 CPLUG_API void cplug_process(void* userPlugin, CplugProcessContext* ctx);
@@ -146,6 +258,19 @@ enum
 
 CPLUG_API uint32_t cplug_getParameterFlags(void*, uint32_t index);
 
+#if CPLUG_WANT_PARAMETER_COOKIES
+// (VST3 | CLAP) Called once per parameter after cplug_createPlugin. Return a pointer to the parameters runtime state,
+// eg. its smoother. It is passed back in CplugEvent.parameter.cookie, so the audio thread can skip the lookup by index
+CPLUG_API void* cplug_getParameterCookie(void* userPlugin, uint32_t index);
+#endif
+
+#if CPLUG_WANT_SPARSE_PARAMETER_IDS
+// Stable ID hosts use to save automation & presets. Called once per parameter when the library is loaded, so it must
+// not depend on a plugin instance. IDs must be unique and below 0x80000000. All other methods still use indexes.
+// Not called when CPLUG_PARAMETER_DESCRIPTORS is defined, the 'id' column is used instead
+CPLUG_API uint32_t cplug_getParameterID(uint32_t index);
+#endif
+
 CPLUG_API void cplug_getParameterRange(void*, uint32_t index, double* min, double* max);
 
 // NOTE: AUv2 supports a max length of 52 bytes, VST3 128, CLAP 256
@@ -162,14 +287,72 @@ CPLUG_API double cplug_normaliseParameterValue(void*, uint32_t index, double val
 CPLUG_API double cplug_parameterStringToValue(void*, uint32_t index, const char*);
 CPLUG_API void   cplug_parameterValueToString(void*, uint32_t index, char* buf, size_t bufsize, double value);
 
-// Returns -1 on error and 'numBytesToWrite' on success
+#if CPLUG_WANT_PARAMETER_TEXT_CACHE
+// (VST3 | CLAP) Formatted values are cached per instance. Return a number that changes whenever
+// cplug_parameterValueToString would format a value differently, eg. after the user switches units. Called on every
+// lookup, so keep it cheap. Return 0 if your text only ever depends on the value
+CPLUG_API uint32_t cplug_getParameterTextVersion(void* userPlugin);
+#endif
+
+// Returns -1 on error and 'numBytesToWrite' on success. May be called many times, so large states don't need to be
+// assembled into one buffer. See cplug_writeStateSegments
 typedef int64_t (*cplug_writeProc)(const void* stateCtx, void* writePos, size_t numBytesToWrite);
 CPLUG_API void cplug_saveState(void* userPlugin, const void* stateCtx, cplug_writeProc writeProc);
 
-// Returns 0 if all bytes are read, -1 on error, and 'maxBytesToRead' when there are remaining bytes to read
+// Returns -1 on error, otherwise the number of bytes read. This is only less than 'maxBytesToRead' when the end of the
+// state is reached, and 0 when there is nothing left to read. Large states can be read in pieces
 typedef int64_t (*cplug_readProc)(const void* stateCtx, void* readPos, size_t maxBytesToRead);
 CPLUG_API void cplug_loadState(void* userPlugin, const void* stateCtx, cplug_readProc readProc);
 
+// A piece of your state, eg. a header or a buffer of samples. Segments are written & read in order, straight to/from
+// the hosts stream with no intermediate copy
+typedef struct CplugStateSegment
+{
+    void*  data;
+    size_t size;
+} CplugStateSegment;
+
+// Returns the total number of bytes written, or -1 on error
+static inline int64_t cplug_writeStateSegments(
+    const void*              stateCtx,
+    cplug_writeProc          writeProc,
+    const CplugStateSegment* segments,
+    uint32_t                 numSegments)
+{
+    int64_t total = 0;
+    for (uint32_t i = 0; i < numSegments; i++)
+    {
+        if (segments[i].size == 0)
+            continue;
+        if (writeProc(stateCtx, segments[i].data, segments[i].size) != (int64_t)segments[i].size)
+            return -1;
+        total += segments[i].size;
+    }
+    return total;
+}
+
+// Returns the total number of bytes read, or -1 on error. Stops early if the state is shorter than the segments
+static inline int64_t cplug_readStateSegments(
+    const void*              stateCtx,
+    cplug_readProc           readProc,
+    const CplugStateSegment* segments,
+    uint32_t                 numSegments)
+{
+    int64_t total = 0;
+    for (uint32_t i = 0; i < numSegments; i++)
+    {
+        if (segments[i].size == 0)
+            continue;
+        int64_t bytesRead = readProc(stateCtx, segments[i].data, segments[i].size);
+        if (bytesRead < 0)
+            return -1;
+        total += bytesRead;
+        if (bytesRead != (int64_t)segments[i].size)
+            break;
+    }
+    return total;
+}
+
 // NOTE: For AUv2, your pointer MUST be castable to NSView. AUv2 hosts expect an NSView & you simply override methods
 // This is the only CPLUG method used in AUv2 builds.
 CPLUG_API void* cplug_createGUI(void* userPlugin);
@@ -202,6 +385,7 @@ CPLUG_API bool cplug_getResizeHints(
 
 // clang-format off
 typedef volatile int cplug_atomic_i32;
+typedef void* volatile cplug_atomic_ptr;
 #if defined(_MSC_VER) && ! (__clang__)
 extern long _InterlockedExchange(long volatile *Target, long Value);
 extern long _InterlockedCompareExchange(long volatile *Destination, long ExChange, long Comperand);
@@ -211,14 +395,771 @@ static inline int cplug_atomic_exchange_i32 ( cplug_atomic_i32* ptr, int v) { re
 static inline int cplug_atomic_load_i32(const cplug_atomic_i32* ptr)        { return _InterlockedCompareExchange((volatile long*)ptr, 0, 0); }
 static inline int cplug_atomic_fetch_add_i32( cplug_atomic_i32* ptr, int v) { return _InterlockedExchangeAdd    ((volatile long*)ptr, v); }
 static inline int cplug_atomic_fetch_and_i32( cplug_atomic_i32* ptr, int v) { return _InterlockedAnd            ((volatile long*)ptr, v); }
+static inline int  cplug_atomic_load_acquire_i32(const cplug_atomic_i32* ptr)  { return _InterlockedCompareExchange((volatile long*)ptr, 0, 0); }
+static inline void cplug_atomic_store_release_i32( cplug_atomic_i32* ptr, int v) { _InterlockedExchange((volatile long*)ptr, v); }
+static inline bool cplug_atomic_compare_exchange_i32(cplug_atomic_i32* ptr, int expected, int desired)
+{ return _InterlockedCompareExchange((volatile long*)ptr, desired, expected) == expected; }
+#ifdef _WIN64
+extern void* _InterlockedExchangePointer(void* volatile *Target, void* Value);
+extern void* _InterlockedCompareExchangePointer(void* volatile *Destination, void* ExChange, void* Comperand);
+static inline void* cplug_atomic_exchange_ptr(cplug_atomic_ptr* ptr, void* v) { return _InterlockedExchangePointer(ptr, v); }
+static inline void* cplug_atomic_load_acquire_ptr(cplug_atomic_ptr* ptr)      { return _InterlockedCompareExchangePointer(ptr, 0, 0); }
+#else
+static inline void* cplug_atomic_exchange_ptr(cplug_atomic_ptr* ptr, void* v) { return (void*)_InterlockedExchange((volatile long*)ptr, (long)v); }
+static inline void* cplug_atomic_load_acquire_ptr(cplug_atomic_ptr* ptr)      { return (void*)_InterlockedCompareExchange((volatile long*)ptr, 0, 0); }
+#endif
 #else
 static inline int cplug_atomic_exchange_i32 ( cplug_atomic_i32* ptr, int v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
 static inline int cplug_atomic_load_i32(const cplug_atomic_i32* ptr)        { return __atomic_load_n    (ptr,    __ATOMIC_SEQ_CST); }
 static inline int cplug_atomic_fetch_add_i32( cplug_atomic_i32* ptr, int v) { return __atomic_fetch_add (ptr, v, __ATOMIC_SEQ_CST); }
 static inline int cplug_atomic_fetch_and_i32( cplug_atomic_i32* ptr, int v) { return __atomic_fetch_and (ptr, v, __ATOMIC_SEQ_CST); }
+static inline int  cplug_atomic_load_acquire_i32(const cplug_atomic_i32* ptr)  { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+static inline void cplug_atomic_store_release_i32( cplug_atomic_i32* ptr, int v) { __atomic_store_n(ptr, v, __ATOMIC_RELEASE); }
+static inline bool cplug_atomic_compare_exchange_i32(cplug_atomic_i32* ptr, int expected, int desired)
+{ return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+static inline void* cplug_atomic_exchange_ptr(cplug_atomic_ptr* ptr, void* v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+static inline void* cplug_atomic_load_acquire_ptr(cplug_atomic_ptr* ptr)      { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+#endif
+// clang-format on
+
+#ifndef CPLUG_CACHE_LINE_SIZE
+#if defined(__APPLE__) && defined(__aarch64__)
+#define CPLUG_CACHE_LINE_SIZE 128
+#else
+#define CPLUG_CACHE_LINE_SIZE 64
+#endif
+#endif
+
+static inline void
+cplug_parallelFor(CplugProcessContext* ctx, uint32_t taskCount, cplug_taskProc taskProc, void* userdata)
+{
+    if (ctx->parallelFor != NULL)
+        ctx->parallelFor(ctx, taskCount, taskProc, userdata);
+    else
+        for (uint32_t i = 0; i < taskCount; i++)
+            taskProc(userdata, i);
+}
+
+// dequeueEvents for wrappers with no cheaper way to batch events. Calls dequeueEvent until it returns
+// CPLUG_EVENT_PROCESS_AUDIO or 'maxEvents' is reached
+static inline uint32_t cplug_dequeueEventsSerially(
+    struct CplugProcessContext* ctx,
+    CplugEvent*                 events,
+    uint32_t                    maxEvents,
+    uint32_t                    frameIdx)
+{
+    uint32_t numEvents = 0;
+    while (numEvents < maxEvents && ctx->dequeueEvent(ctx, &events[numEvents], frameIdx))
+    {
+        if (events[numEvents++].type == CPLUG_EVENT_PROCESS_AUDIO)
+            break;
+    }
+    return numEvents;
+}
+
+static inline bool cplug_isInPlace(const CplugProcessContext* ctx, uint32_t busIdx, uint32_t channelIdx)
+{
+    return ctx->isInPlace != NULL && ctx->isInPlace(ctx, busIdx, channelIdx);
+}
+
+static inline uint64_t cplug_getInputSilence(const CplugProcessContext* ctx, uint32_t busIdx)
+{
+    return ctx->getInputSilence != NULL ? ctx->getInputSilence(ctx, busIdx) : 0;
+}
+
+static inline uint64_t cplug_getInputConstant(const CplugProcessContext* ctx, uint32_t busIdx)
+{
+    return ctx->getInputConstant != NULL ? ctx->getInputConstant(ctx, busIdx) : 0;
+}
+
+static inline void cplug_setOutputSilence(CplugProcessContext* ctx, uint32_t busIdx, uint64_t channelMask)
+{
+    if (ctx->setOutputSilence != NULL)
+        ctx->setOutputSilence(ctx, busIdx, channelMask);
+}
+
+// Flushes denormals to zero on the calling thread (FTZ & DAZ on x86, FZ on AArch64) & returns the previous floating
+// point mode. Denormals can make some maths ~100x slower, eg. filter & reverb tails decaying into silence.
+// The wrappers & standalones already do this around cplug_process & on thread pool workers. Set CPLUG_WANT_DENORMALS
+// in your config to opt out, otherwise you only need these on threads of your own
+// clang-format off
+#if defined(_MSC_VER) && ! (__clang__) && (defined(_M_X64) || defined(_M_IX86))
+extern unsigned int _mm_getcsr(void);
+extern void _mm_setcsr(unsigned int);
+#define CPLUG_FLOAT_MODE_FLUSH_DENORMALS 0x8040 // MXCSR FTZ | DAZ
+static inline uint64_t cplug_getFloatMode()              { return _mm_getcsr(); }
+static inline void     cplug_setFloatMode(uint64_t mode) { _mm_setcsr((unsigned int)mode); }
+#elif defined(_MSC_VER) && ! (__clang__) && defined(_M_ARM64)
+extern __int64 _ReadStatusReg(int);
+extern void _WriteStatusReg(int, __int64);
+#define CPLUG_FLOAT_MODE_FLUSH_DENORMALS (1 << 24) // FPCR FZ
+static inline uint64_t cplug_getFloatMode()              { return (uint64_t)_ReadStatusReg(0x5a20); } // ARM64_FPCR
+static inline void     cplug_setFloatMode(uint64_t mode) { _WriteStatusReg(0x5a20, (__int64)mode); }
+#elif defined(__x86_64__) || (defined(__i386__) && defined(__SSE__))
+#define CPLUG_FLOAT_MODE_FLUSH_DENORMALS 0x8040 // MXCSR FTZ | DAZ
+static inline uint64_t cplug_getFloatMode()              { return __builtin_ia32_stmxcsr(); }
+static inline void     cplug_setFloatMode(uint64_t mode) { __builtin_ia32_ldmxcsr((unsigned int)mode); }
+#elif defined(__aarch64__)
+#define CPLUG_FLOAT_MODE_FLUSH_DENORMALS (1 << 24) // FPCR FZ
+static inline uint64_t cplug_getFloatMode()
+{ uint64_t mode; __asm__ __volatile__("mrs %0, fpcr" : "=r"(mode)); return mode; }
+static inline void     cplug_setFloatMode(uint64_t mode) { __asm__ __volatile__("msr fpcr, %0" : : "r"(mode)); }
+#else
+#define CPLUG_FLOAT_MODE_FLUSH_DENORMALS 0
+static inline uint64_t cplug_getFloatMode()              { return 0; }
+static inline void     cplug_setFloatMode(uint64_t mode) { (void)mode; }
 #endif
 // clang-format on
 
+static inline uint64_t cplug_disableDenormals()
+{
+    uint64_t mode = cplug_getFloatMode();
+    // Writing the control register can stall the pipeline, so skip it when the host already flushes denormals
+    if ((mode & CPLUG_FLOAT_MODE_FLUSH_DENORMALS) != CPLUG_FLOAT_MODE_FLUSH_DENORMALS)
+        cplug_setFloatMode(mode | CPLUG_FLOAT_MODE_FLUSH_DENORMALS);
+    return mode;
+}
+
+// Pass the mode returned by cplug_disableDenormals. Only the flush bits are restored. Other bits, like the sticky
+// exception flags in MXCSR, keep their current value, so the register is only written if the flush bits changed
+static inline void cplug_restoreDenormals(uint64_t prevMode)
+{
+    const uint64_t mask = CPLUG_FLOAT_MODE_FLUSH_DENORMALS;
+
+    uint64_t mode = cplug_getFloatMode();
+    if ((mode ^ prevMode) & mask)
+        cplug_setFloatMode((mode & ~mask) | (prevMode & mask));
+}
+
+#include <math.h>
+
+#ifdef CPLUG_PARAMETER_DESCRIPTORS
+// Optional compile time parameter list. Define CPLUG_PARAMETER_DESCRIPTORS(X) in your config.h as a list of
+// X(id, name, min, max, defaultValue, flags, taper), one per parameter, in index order.
+// The CLAP & VST3 wrappers then build their parameter info once when the library is loaded, rather than calling your
+// parameter callbacks on every host query. Your callbacks should return the same values as your descriptors.
+// 'id' must be a constant. With CPLUG_WANT_SPARSE_PARAMETER_IDS it's the parameters stable ID, see cplug_getParameterID
+typedef struct CplugParamDescriptor
+{
+    uint32_t    id;
+    const char* name;
+    double      min;
+    double      max;
+    double      defaultValue;
+    uint32_t    flags;
+    // Shape of the normalised range. 1 is linear. Below 1 gives more of the range to low values (eg. frequency)
+    double taper;
+} CplugParamDescriptor;
+
+static inline const CplugParamDescriptor* cplug_getParamDescriptor(uint32_t index)
+{
+#define CPLUG_PARAMETER_DESCRIPTOR(id, name, min, max, defaultValue, flags, taper)                                     \
+    {(uint32_t)(id), name, min, max, defaultValue, flags, taper},
+    static const CplugParamDescriptor descriptors[CPLUG_NUM_PARAMS] = {
+        CPLUG_PARAMETER_DESCRIPTORS(CPLUG_PARAMETER_DESCRIPTOR)};
+#undef CPLUG_PARAMETER_DESCRIPTOR
+    return &descriptors[index];
+}
+
+static inline double cplug_paramDescriptor_normalise(const CplugParamDescriptor* desc, double value)
+{
+    if (desc->max <= desc->min)
+        return 0.0;
+    double normalised = (value - desc->min) / (desc->max - desc->min);
+    normalised        = normalised < 0.0 ? 0.0 : normalised > 1.0 ? 1.0 : normalised;
+    if (desc->taper != 1.0)
+        normalised = pow(normalised, desc->taper);
+    return normalised;
+}
+
+static inline double cplug_paramDescriptor_denormalise(const CplugParamDescriptor* desc, double normalised)
+{
+    normalised = normalised < 0.0 ? 0.0 : normalised > 1.0 ? 1.0 : normalised;
+    if (desc->taper != 1.0)
+        normalised = pow(normalised, 1.0 / desc->taper);
+    return desc->min + normalised * (desc->max - desc->min);
+}
+#endif // CPLUG_PARAMETER_DESCRIPTORS
+
+#if CPLUG_WANT_SPARSE_PARAMETER_IDS && CPLUG_NUM_PARAMS
+// Minimal perfect hash from parameter IDs to indexes, built by the wrappers when the library is loaded.
+// IDs are hashed into buckets, and each bucket stores a seed that sends its IDs to free slots (hash & displace).
+// Lookups cost two hashes and three loads with no probing, so they are safe on the audio thread
+typedef struct CplugParamIdMap
+{
+    uint32_t ids[CPLUG_NUM_PARAMS];   // Index -> ID
+    uint32_t seeds[CPLUG_NUM_PARAMS]; // Bucket -> seed
+    uint32_t slots[CPLUG_NUM_PARAMS]; // Slot -> index
+} CplugParamIdMap;
+
+static inline uint32_t cplug_paramIdMap_hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    return x;
+}
+
+// Maps a hash to [0, CPLUG_NUM_PARAMS) without dividing
+static inline uint32_t cplug_paramIdMap_reduce(uint32_t hash)
+{
+    return (uint32_t)(((uint64_t)hash * CPLUG_NUM_PARAMS) >> 32);
+}
+
+static inline uint32_t cplug_paramIdMap_slot(uint32_t hash, uint32_t seed)
+{
+    return cplug_paramIdMap_reduce(cplug_paramIdMap_hash(hash ^ seed));
+}
+
+// Returns the index of the parameter, or CPLUG_NUM_PARAMS if no parameter has this ID
+static inline uint32_t cplug_paramIdMap_find(const CplugParamIdMap* map, uint32_t id)
+{
+    uint32_t hash  = cplug_paramIdMap_hash(id);
+    uint32_t seed  = map->seeds[cplug_paramIdMap_reduce(hash)];
+    uint32_t index = map->slots[cplug_paramIdMap_slot(hash, seed)];
+    return map->ids[index] == id ? index : CPLUG_NUM_PARAMS;
+}
+
+// Fetches every ID from the descriptors or cplug_getParameterID. Returns false if an ID is repeated or out of range
+static inline bool cplug_paramIdMap_build(CplugParamIdMap* map)
+{
+    const uint32_t n           = CPLUG_NUM_PARAMS;
+    const uint32_t emptySlot   = 0xffffffff;
+    const uint32_t maxAttempts = 1 << 24;
+
+    // Indexes are grouped by bucket with a counting sort
+    uint32_t* hashes        = (uint32_t*)malloc(sizeof(uint32_t) * n);
+    uint32_t* bucketOffsets = (uint32_t*)calloc(n + 1, sizeof(uint32_t));
+    uint32_t* bucketItems   = (uint32_t*)malloc(sizeof(uint32_t) * n);
+    bool      ok            = hashes != NULL && bucketOffsets != NULL && bucketItems != NULL;
+    uint32_t  maxBucketSize = 0;
+
+    for (uint32_t i = 0; ok && i < n; i++)
+    {
+#ifdef CPLUG_PARAMETER_DESCRIPTORS
+        map->ids[i] = cplug_getParamDescriptor(i)->id;
+#else
+        map->ids[i] = cplug_getParameterID(i);
+#endif
+        map->seeds[i] = 0;
+        map->slots[i] = 0;
+        hashes[i]     = cplug_paramIdMap_hash(map->ids[i]);
+        ok            = map->ids[i] < 0x80000000;
+        bucketOffsets[cplug_paramIdMap_reduce(hashes[i]) + 1]++;
+    }
+    for (uint32_t b = 0; ok && b < n; b++)
+    {
+        if (bucketOffsets[b + 1] > maxBucketSize)
+            maxBucketSize = bucketOffsets[b + 1];
+        bucketOffsets[b + 1] += bucketOffsets[b];
+    }
+    // The slots aren't used yet, so they count the indexes grouped into each bucket so far
+    for (uint32_t i = 0; ok && i < n; i++)
+    {
+        uint32_t b                                      = cplug_paramIdMap_reduce(hashes[i]);
+        bucketItems[bucketOffsets[b] + map->slots[b]++] = i;
+    }
+    for (uint32_t i = 0; ok && i < n; i++)
+        map->slots[i] = emptySlot;
+
+    // Place the largest buckets first, while there are still plenty of free slots
+    for (uint32_t size = maxBucketSize; ok && size > 0; size--)
+    {
+        for (uint32_t b = 0; ok && b < n; b++)
+        {
+            uint32_t  begin = bucketOffsets[b];
+            uint32_t* items = bucketItems + begin;
+            if (bucketOffsets[b + 1] - begin != size)
+                continue;
+
+            // Repeated IDs land in the same slot whatever the seed is
+            for (uint32_t i = 0; ok && i < size; i++)
+                for (uint32_t j = i + 1; ok && j < size; j++)
+                    ok = map->ids[items[i]] != map->ids[items[j]];
+
+            uint32_t seed = 0;
+            for (; ok && seed < maxAttempts; seed++)
+            {
+                uint32_t numPlaced = 0;
+                for (; numPlaced < size; numPlaced++)
+                {
+                    uint32_t slot = cplug_paramIdMap_slot(hashes[items[numPlaced]], seed);
+                    if (map->slots[slot] != emptySlot)
+                        break;
+                    map->slots[slot] = items[numPlaced];
+                }
+                if (numPlaced == size)
+                    break;
+                // Collision, undo & try the next seed
+                while (numPlaced--)
+                    map->slots[cplug_paramIdMap_slot(hashes[items[numPlaced]], seed)] = emptySlot;
+            }
+            ok = ok && seed < maxAttempts;
+            if (ok)
+                map->seeds[b] = seed;
+        }
+    }
+
+    free(hashes);
+    free(bucketOffsets);
+    free(bucketItems);
+    return ok;
+}
+#endif // CPLUG_WANT_SPARSE_PARAMETER_IDS
+
+// Frames per group in the MULTIPLICATIVE & ONE_POLE ramps of cplug_smoother_process
+#ifndef CPLUG_SMOOTHER_LANES
+#define CPLUG_SMOOTHER_LANES 8
+#endif
+
+static inline void
+cplug_smoother_init(CplugSmoother* smoother, uint32_t type, float timeMs, double sampleRate, float value)
+{
+    float frames = (float)(timeMs * 0.001 * sampleRate);
+
+    smoother->type            = type;
+    smoother->rampType        = CPLUG_SMOOTHER_NONE;
+    smoother->rampFrames      = frames > 1.0f ? (uint32_t)frames : 1;
+    smoother->coefficient     = frames > 1.0f ? expf(-1.0f / frames) : 0.0f;
+    smoother->current         = value;
+    smoother->target          = value;
+    smoother->step            = 0.0f;
+    smoother->remainingFrames = 0;
+}
+
+static inline void cplug_smoother_setTarget(CplugSmoother* smoother, float target)
+{
+    smoother->target          = target;
+    smoother->rampType        = smoother->type;
+    smoother->remainingFrames = smoother->rampFrames;
+
+    // Ratios are only valid between two values of the same sign. Fall back to a linear ramp
+    if (smoother->rampType == CPLUG_SMOOTHER_MULTIPLICATIVE && smoother->current * target <= 0.0f)
+        smoother->rampType = CPLUG_SMOOTHER_LINEAR;
+
+    if (smoother->rampType == CPLUG_SMOOTHER_NONE || smoother->current == target)
+    {
+        smoother->current         = target;
+        smoother->remainingFrames = 0;
+    }
+    else if (smoother->rampType == CPLUG_SMOOTHER_LINEAR)
+        smoother->step = (target - smoother->current) / (float)smoother->rampFrames;
+    else if (smoother->rampType == CPLUG_SMOOTHER_MULTIPLICATIVE)
+        smoother->step = powf(target / smoother->current, 1.0f / (float)smoother->rampFrames);
+}
+
+// Writes linear ramps between automation points to 'out'. 'startValue' is the parameter value at the start of the block
+static inline void cplug_renderAutomation(
+    const CplugAutomationPoint* points,
+    uint32_t                    numPoints,
+    float                       startValue,
+    float*                      out,
+    uint32_t                    numFrames)
+{
+    uint32_t frame     = 0;
+    uint32_t prevFrame = 0;
+    float    prevValue = startValue;
+
+    for (uint32_t i = 0; i < numPoints && frame < numFrames; i++)
+    {
+        uint32_t endFrame = points[i].frame < numFrames ? points[i].frame : numFrames - 1;
+        float    endValue = (float)points[i].value;
+        float    inc      = endFrame > prevFrame ? (endValue - prevValue) / (float)(endFrame - prevFrame) : 0.0f;
+
+        for (; frame < endFrame; frame++)
+            out[frame] = prevValue + inc * (float)(frame - prevFrame);
+        if (frame == endFrame)
+            out[frame++] = endValue;
+
+        prevFrame = endFrame;
+        prevValue = endValue;
+    }
+
+    for (; frame < numFrames; frame++)
+        out[frame] = prevValue;
+}
+
+// Called by the CLAP & VST3 wrappers for every dequeued event
+static inline void cplug_smoothers_handleEvent(CplugProcessContext* ctx, const CplugEvent* event)
+{
+    if (ctx->smoothers != NULL && event->type == CPLUG_EVENT_PARAM_CHANGE_UPDATE &&
+        event->parameter.idx < ctx->numSmoothers)
+        cplug_smoother_setTarget(&ctx->smoothers[event->parameter.idx], (float)event->parameter.value);
+}
+
+// Returns true if the value is constant for 'numFrames', in which case 'out' is untouched & the value is 'current'.
+// Otherwise 'out' is filled with 'numFrames' values
+static inline bool cplug_smoother_process(CplugSmoother* smoother, float* out, uint32_t numFrames)
+{
+    if (smoother->remainingFrames == 0 || numFrames == 0)
+        return true;
+
+    uint32_t numRamp = numFrames < smoother->remainingFrames ? numFrames : smoother->remainingFrames;
+    float    current = smoother->current;
+    float    target  = smoother->target;
+    uint32_t i       = 0;
+
+    if (smoother->rampType == CPLUG_SMOOTHER_LINEAR)
+    {
+        // No dependency between frames, leaving the compiler free to vectorise this loop
+        float step = smoother->step;
+        for (; i < numRamp; i++)
+            out[i] = current + step * (float)(i + 1);
+        current = out[numRamp - 1];
+
+        smoother->remainingFrames -= numRamp;
+    }
+    else // CPLUG_SMOOTHER_MULTIPLICATIVE & CPLUG_SMOOTHER_ONE_POLE
+    {
+        // Frame i is origin + (current - origin) * ratio^(i+1): a constant ratio when the origin is 0, an exponential
+        // approach to the target otherwise. Each group of lanes restarts from the last frame of the previous group,
+        // using precomputed powers, so frames within a group don't depend on each other & the loop can be vectorised.
+        // ONE_POLE never truly reaches the target, so it runs for the whole block & stops once it's close enough
+        bool     onePole = smoother->rampType == CPLUG_SMOOTHER_ONE_POLE;
+        float    ratio   = onePole ? smoother->coefficient : smoother->step;
+        float    origin  = onePole ? target : 0.0f;
+        uint32_t numCalc = onePole ? numFrames : numRamp;
+
+        float powers[CPLUG_SMOOTHER_LANES];
+        float power = 1.0f;
+        for (uint32_t k = 0; k < CPLUG_SMOOTHER_LANES; k++)
+        {
+            power     *= ratio;
+            powers[k]  = power;
+        }
+
+        for (; i + CPLUG_SMOOTHER_LANES <= numCalc; i += CPLUG_SMOOTHER_LANES)
+        {
+            float delta = current - origin;
+            for (uint32_t k = 0; k < CPLUG_SMOOTHER_LANES; k++)
+                out[i + k] = origin + delta * powers[k];
+            current = out[i + CPLUG_SMOOTHER_LANES - 1];
+        }
+        for (; i < numCalc; i++)
+        {
+            current = origin + (current - origin) * ratio;
+            out[i]  = current;
+        }
+
+        // ONE_POLE also stops once float rounding keeps it from getting any closer. With long times that happens
+        // before the threshold is reached
+        float previous = numCalc > 1 ? out[numCalc - 2] : smoother->current;
+        if (! onePole)
+            smoother->remainingFrames -= numRamp;
+        else if (fabsf(current - target) <= 1e-5f * (fabsf(target) + 1e-3f) || current == previous)
+            smoother->remainingFrames = 0;
+    }
+
+    if (smoother->remainingFrames == 0)
+        current = target;
+    smoother->current = current;
+
+    for (; i < numFrames; i++)
+        out[i] = current;
+    return false;
+}
+
+#if (CPLUG_EVENT_QUEUE_SIZE & CPLUG_EVENT_QUEUE_MASK) != 0
+#error CPLUG_EVENT_QUEUE_SIZE must be a power of 2
+#endif
+
+// Single producer, single consumer event queue. Zero initialise before use.
+// 'head' and 'tail' are free running counters, wrapped using CPLUG_EVENT_QUEUE_MASK when indexing 'events'.
+// Pushing to a full queue drops the event and increments 'numOverflows'.
+typedef struct CplugEventQueue
+{
+    cplug_atomic_i32 head; // Written by the producer
+    char             _pad0[CPLUG_CACHE_LINE_SIZE - sizeof(cplug_atomic_i32)];
+    cplug_atomic_i32 tail; // Written by the consumer
+    char             _pad1[CPLUG_CACHE_LINE_SIZE - sizeof(cplug_atomic_i32)];
+    cplug_atomic_i32 numOverflows;
+    char             _pad2[CPLUG_CACHE_LINE_SIZE - sizeof(cplug_atomic_i32)];
+    CplugEvent       events[CPLUG_EVENT_QUEUE_SIZE];
+} CplugEventQueue;
+
+// [producer thread] Returns the number of events pushed. Events that don't fit are dropped & counted as overflows
+static inline uint32_t cplug_eventQueue_push_n(CplugEventQueue* queue, const CplugEvent* events, uint32_t numEvents)
+{
+    uint32_t head    = (uint32_t)cplug_atomic_load_acquire_i32(&queue->head);
+    uint32_t tail    = (uint32_t)cplug_atomic_load_acquire_i32(&queue->tail);
+    uint32_t numFree = CPLUG_EVENT_QUEUE_SIZE - (head - tail);
+    uint32_t numPush = numEvents < numFree ? numEvents : numFree;
+
+    for (uint32_t i = 0; i < numPush; i++)
+        queue->events[(head + i) & CPLUG_EVENT_QUEUE_MASK] = events[i];
+
+    cplug_atomic_store_release_i32(&queue->head, (int)(head + numPush));
+
+    if (numPush != numEvents)
+        cplug_atomic_fetch_add_i32(&queue->numOverflows, (int)(numEvents - numPush));
+    return numPush;
+}
+
+// [consumer thread] Returns the number of events written to 'events'
+static inline uint32_t cplug_eventQueue_pop_n(CplugEventQueue* queue, CplugEvent* events, uint32_t maxEvents)
+{
+    uint32_t tail    = (uint32_t)cplug_atomic_load_acquire_i32(&queue->tail);
+    uint32_t head    = (uint32_t)cplug_atomic_load_acquire_i32(&queue->head);
+    uint32_t numUsed = head - tail;
+    uint32_t numPop  = maxEvents < numUsed ? maxEvents : numUsed;
+
+    for (uint32_t i = 0; i < numPop; i++)
+        events[i] = queue->events[(tail + i) & CPLUG_EVENT_QUEUE_MASK];
+
+    cplug_atomic_store_release_i32(&queue->tail, (int)(tail + numPop));
+    return numPop;
+}
+
+static inline bool cplug_eventQueue_push(CplugEventQueue* queue, const CplugEvent* event)
+{
+    return cplug_eventQueue_push_n(queue, event, 1) == 1;
+}
+
+static inline bool cplug_eventQueue_pop(CplugEventQueue* queue, CplugEvent* event)
+{
+    return cplug_eventQueue_pop_n(queue, event, 1) == 1;
+}
+
+typedef void (*cplug_rcuFreeProc)(void* obj);
+
+// Hands whole objects (eg. a DSP state built in cplug_loadState) from the main thread to the audio thread without locks.
+// The audio thread adopts the newest published object with a single atomic exchange at the top of cplug_process.
+// Each publish starts an epoch. Objects from epochs before the one last adopted by the audio thread are no longer in use
+// and are freed on the main thread. Zero initialise, then set 'freeProc'.
+typedef struct CplugRCU
+{
+    cplug_atomic_ptr pending; // Written by the main thread, taken by the audio thread
+    char             _pad0[CPLUG_CACHE_LINE_SIZE - sizeof(cplug_atomic_ptr)];
+    cplug_atomic_ptr adopted; // Written by the audio thread after taking 'pending'
+    char             _pad1[CPLUG_CACHE_LINE_SIZE - sizeof(cplug_atomic_ptr)];
+    void*            current; // [audio thread] Latest adopted object. May be NULL
+
+    // [main thread] Published objects not yet freed, oldest epoch first. Never holds more than 3
+    void*             objects[4];
+    uint32_t          numObjects;
+    cplug_rcuFreeProc freeProc;
+} CplugRCU;
+
+// [main thread] Frees objects from epochs before the one last adopted by the audio thread
+static inline void cplug_rcu_collect(CplugRCU* rcu)
+{
+    void*    adopted = cplug_atomic_load_acquire_ptr(&rcu->adopted);
+    uint32_t numOld  = 0;
+    while (numOld < rcu->numObjects && rcu->objects[numOld] != adopted)
+        numOld++;
+    if (numOld == rcu->numObjects) // Audio thread hasn't adopted anything we own yet
+        return;
+
+    for (uint32_t i = 0; i < numOld; i++)
+        rcu->freeProc(rcu->objects[i]);
+    rcu->numObjects -= numOld;
+    for (uint32_t i = 0; i < rcu->numObjects; i++)
+        rcu->objects[i] = rcu->objects[i + numOld];
+}
+
+// [main thread] Takes ownership of 'obj'. Don't modify it after publishing
+static inline void cplug_rcu_publish(CplugRCU* rcu, void* obj)
+{
+    assert(obj != NULL);
+    void* unused = cplug_atomic_exchange_ptr(&rcu->pending, obj);
+    if (unused != NULL)
+    {
+        // The previous pending object is always the newest one we own
+        assert(rcu->numObjects > 0 && rcu->objects[rcu->numObjects - 1] == unused);
+        rcu->numObjects--;
+        rcu->freeProc(unused);
+    }
+    cplug_rcu_collect(rcu);
+
+    assert(rcu->numObjects < sizeof(rcu->objects) / sizeof(rcu->objects[0]));
+    rcu->objects[rcu->numObjects++] = obj;
+}
+
+// [audio thread] Call at the top of cplug_process. Returns true if a new object was adopted into 'current'
+static inline bool cplug_rcu_adopt(CplugRCU* rcu)
+{
+    void* obj = cplug_atomic_exchange_ptr(&rcu->pending, NULL);
+    if (obj == NULL)
+        return false;
+    rcu->current = obj;
+    cplug_atomic_exchange_ptr(&rcu->adopted, obj);
+    return true;
+}
+
+// [main thread] Frees every object. The audio thread must not be processing
+static inline void cplug_rcu_destroy(CplugRCU* rcu)
+{
+    for (uint32_t i = 0; i < rcu->numObjects; i++)
+        rcu->freeProc(rcu->objects[i]);
+    rcu->numObjects = 0;
+    rcu->pending    = NULL;
+    rcu->adopted    = NULL;
+    rcu->current    = NULL;
+}
+
+#if CPLUG_WANT_PARAMETER_TEXT_CACHE
+// Entries, must be a power of 2
+#ifndef CPLUG_PARAM_TEXT_CACHE_SIZE
+#define CPLUG_PARAM_TEXT_CACHE_SIZE 512
+#endif
+// Bytes/code units including the null terminator. Longer text isn't cached
+#ifndef CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH
+#define CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH 32
+#endif
+
+typedef struct CplugParamTextCacheEntry
+{
+    cplug_atomic_i32 lock;
+    uint32_t         paramIdxPlusOne; // 0 when empty
+    uint32_t         valueBits;       // Value rounded to float precision
+    uint32_t         version;
+    bool             hasUTF16;
+    char             utf8[CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH];
+    uint16_t         utf16[CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH];
+} CplugParamTextCacheEntry;
+
+// Bounded, 2 way set associative cache of formatted parameter values, used by the wrappers for host value to text
+// requests. Zero initialise before use. Lock free: each entry has a try lock, and a busy entry is treated as a miss, so
+// any number of threads can read & write without waiting on each other
+typedef struct CplugParamTextCache
+{
+    CplugParamTextCacheEntry entries[CPLUG_PARAM_TEXT_CACHE_SIZE];
+} CplugParamTextCache;
+
+#if (CPLUG_PARAM_TEXT_CACHE_SIZE & (CPLUG_PARAM_TEXT_CACHE_SIZE - 1)) != 0
+#error CPLUG_PARAM_TEXT_CACHE_SIZE must be a power of 2
+#endif
+
+static inline uint32_t cplug_paramTextCache_valueBits(double value)
+{
+    union
+    {
+        float    f;
+        uint32_t u;
+    } bits;
+    bits.f = (float)value;
+    return bits.u;
+}
+
+// Each param & value maps to a pair of entries. New text goes in the first and moves the old text to the second
+static inline CplugParamTextCacheEntry*
+cplug_paramTextCache_getPair(CplugParamTextCache* cache, uint32_t paramIdx, uint32_t valueBits)
+{
+    uint32_t hash = (paramIdx * 0x9e3779b1u) ^ valueBits;
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6du;
+    hash ^= hash >> 12;
+    return &cache->entries[(hash * 2) & (CPLUG_PARAM_TEXT_CACHE_SIZE - 1)];
+}
+
+// Returns false if another thread is using the entry
+static inline bool cplug_paramTextCache_tryLock(CplugParamTextCacheEntry* entry)
+{
+    return cplug_atomic_compare_exchange_i32(&entry->lock, 0, 1);
+}
+
+static inline void cplug_paramTextCache_unlock(CplugParamTextCacheEntry* entry)
+{
+    cplug_atomic_store_release_i32(&entry->lock, 0);
+}
+
+// On a hit, copies the text to 'utf8' and/or 'utf16' (either may be NULL) and returns true. Text longer than the
+// capacity is truncated & null terminated. 'version' comes from cplug_getParameterTextVersion
+static inline bool cplug_paramTextCache_get(
+    CplugParamTextCache* cache,
+    uint32_t             paramIdx,
+    double               value,
+    uint32_t             version,
+    char*                utf8,
+    uint32_t             utf8Capacity,
+    uint16_t*            utf16,
+    uint32_t             utf16Capacity)
+{
+    uint32_t                  valueBits = cplug_paramTextCache_valueBits(value);
+    CplugParamTextCacheEntry* pair      = cplug_paramTextCache_getPair(cache, paramIdx, valueBits);
+
+    for (int i = 0; i < 2; i++)
+    {
+        CplugParamTextCacheEntry* entry = &pair[i];
+        if (! cplug_paramTextCache_tryLock(entry))
+            continue;
+
+        bool hit = entry->paramIdxPlusOne == paramIdx + 1 && entry->valueBits == valueBits &&
+                   entry->version == version && (utf16 == NULL || entry->hasUTF16);
+        if (hit && utf8 != NULL && utf8Capacity > 0)
+        {
+            uint32_t j = 0;
+            for (; j + 1 < utf8Capacity && entry->utf8[j] != 0; j++)
+                utf8[j] = entry->utf8[j];
+            utf8[j] = 0;
+        }
+        if (hit && utf16 != NULL && utf16Capacity > 0)
+        {
+            uint32_t j = 0;
+            for (; j + 1 < utf16Capacity && entry->utf16[j] != 0; j++)
+                utf16[j] = entry->utf16[j];
+            utf16[j] = 0;
+        }
+
+        cplug_paramTextCache_unlock(entry);
+        if (hit)
+            return true;
+    }
+    return false;
+}
+
+// Stores the null terminated text for a value. 'utf16' may be NULL
+static inline void cplug_paramTextCache_put(
+    CplugParamTextCache* cache,
+    uint32_t             paramIdx,
+    double               value,
+    uint32_t             version,
+    const char*          utf8,
+    const uint16_t*      utf16)
+{
+    uint32_t utf8Length = 0, utf16Length = 0;
+    while (utf8Length < CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH && utf8[utf8Length] != 0)
+        utf8Length++;
+    while (utf16 != NULL && utf16Length < CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH && utf16[utf16Length] != 0)
+        utf16Length++;
+    if (utf8Length == CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH || utf16Length == CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH)
+        return;
+
+    uint32_t                  valueBits = cplug_paramTextCache_valueBits(value);
+    CplugParamTextCacheEntry* pair      = cplug_paramTextCache_getPair(cache, paramIdx, valueBits);
+    if (! cplug_paramTextCache_tryLock(&pair[0]))
+        return;
+    if (! cplug_paramTextCache_tryLock(&pair[1]))
+    {
+        cplug_paramTextCache_unlock(&pair[0]);
+        return;
+    }
+
+    pair[1].paramIdxPlusOne = pair[0].paramIdxPlusOne;
+    pair[1].valueBits       = pair[0].valueBits;
+    pair[1].version         = pair[0].version;
+    pair[1].hasUTF16        = pair[0].hasUTF16;
+    for (uint32_t i = 0; i < CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH; i++)
+        pair[1].utf8[i] = pair[0].utf8[i];
+    for (uint32_t i = 0; i < CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH; i++)
+        pair[1].utf16[i] = pair[0].utf16[i];
+
+    pair[0].paramIdxPlusOne = paramIdx + 1;
+    pair[0].valueBits       = valueBits;
+    pair[0].version         = version;
+    pair[0].hasUTF16        = utf16 != NULL;
+    for (uint32_t i = 0; i <= utf8Length; i++)
+        pair[0].utf8[i] = utf8[i];
+    for (uint32_t i = 0; utf16 != NULL && i <= utf16Length; i++)
+        pair[0].utf16[i] = utf16[i];
+
+    cplug_paramTextCache_unlock(&pair[1]);
+    cplug_paramTextCache_unlock(&pair[0]);
+}
+#endif // CPLUG_WANT_PARAMETER_TEXT_CACHE
+
 /*  ██████╗ ███████╗██████╗ ██╗   ██╗ ██████╗
     ██╔══██╗██╔════╝██╔══██╗██║   ██║██╔════╝
     ██║  ██║█████╗  ██████╔╝██║   ██║██║  ███╗
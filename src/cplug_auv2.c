@@ -5,6 +5,7 @@
 #include <AudioToolbox/AudioUnitUtilities.h>
 #include <CoreMIDI/MIDIServices.h>
 #include <cplug.h>
+#include <cplug_state_buffer.h>
 
 // Audio Units have no way (to my knowldge) of calling a DLL load/unload function, so we have to make one
 volatile int g_auv2InstanceCount = 0;
@@ -183,18 +184,23 @@ typedef struct AUv2Plugin
     // Store events here because AUv2 won't simply pass us all events in a single process callback
     UInt32     numEvents;
     CplugEvent events[CPLUG_EVENT_QUEUE_SIZE];
+    UInt32     eventQuantize;
+    UInt32     renderMode;
 } AUv2Plugin;
 
-int64_t AUv2WriteProc(const void* stateCtx, void* writePos, size_t numBytesToWrite)
-{
-    CFMutableDataRef* dataRef = (CFMutableDataRef*)stateCtx;
-
-    if (*dataRef == NULL)
-        *dataRef = CFDataCreateMutable(NULL, numBytesToWrite);
+// Parameter IDs are indexes, unless CPLUG_WANT_SPARSE_PARAMETER_IDS is set
+#if CPLUG_WANT_SPARSE_PARAMETER_IDS && CPLUG_NUM_PARAMS
+static CplugParamIdMap g_auv2ParamIds;
 
-    CFDataAppendBytes(*dataRef, writePos, numBytesToWrite);
-    return numBytesToWrite;
+static inline AudioUnitParameterID AUv2Params_getID(uint32_t index) { return g_auv2ParamIds.ids[index]; }
+static inline uint32_t AUv2Params_getIndex(AudioUnitParameterID id)
+{
+    return cplug_paramIdMap_find(&g_auv2ParamIds, id);
 }
+#else
+static inline AudioUnitParameterID AUv2Params_getID(uint32_t index) { return index; }
+static inline uint32_t             AUv2Params_getIndex(AudioUnitParameterID id) { return id; }
+#endif
 
 struct AUv2ReadStateContext
 {
@@ -335,6 +341,12 @@ OSStatus AUMethodGetPropertyInfo(
         CPLUG_SAFE_SET_PTR(outWritable, true);
         break;
 
+    case kAudioUnitProperty_OfflineRender:
+        CPLUG_LOG_ASSERT_RETURN(inScope == kAudioUnitScope_Global, kAudioUnitErr_InvalidScope);
+        CPLUG_SAFE_SET_PTR(outDataSize, sizeof(UInt32));
+        CPLUG_SAFE_SET_PTR(outWritable, true);
+        break;
+
     case kAudioUnitProperty_InPlaceProcessing:
         CPLUG_LOG_ASSERT_RETURN(inScope == kAudioUnitScope_Global, kAudioUnitErr_InvalidScope);
         CPLUG_SAFE_SET_PTR(outDataSize, sizeof(UInt32));
@@ -410,6 +422,45 @@ OSStatus AUMethodGetPropertyInfo(
 
 // ------------------------------------------------------------------------------------------------
 
+// Frees a saved state's buffer once the host releases the CFData that wraps it. 'info' is the CplugStateBuffer*
+static void AUv2State_deallocate(void* ptr, void* info)
+{
+    CplugStateBuffer* buf = (CplugStateBuffer*)info;
+    cplug_stateBuffer_free(buf);
+    free(buf);
+}
+
+// Saves the plugin state into CFData without copying it. The CFData owns the buffer, so no memory is kept around
+// between saves and the state is never held twice. Returns NULL for an empty state
+static CFDataRef AUv2State_save(AUv2Plugin* auv2)
+{
+    CplugStateBuffer* buf = (CplugStateBuffer*)calloc(1, sizeof(CplugStateBuffer));
+    CPLUG_LOG_ASSERT_RETURN(buf != NULL, NULL);
+    // Hosts may keep many saved states alive, so don't reserve the full CPLUG_STATE_BUFFER_RESERVE for each one.
+    // Larger states grow the reservation by doubling
+    buf->initialReserve = CPLUG_STATE_BUFFER_MIN_COMMIT;
+    cplug_saveState(auv2->userPlugin, buf, cplug_stateBuffer_writeProc);
+
+    CFDataRef data = NULL;
+    if (buf->bytesWritten)
+    {
+        CFAllocatorContext context = {0, buf, NULL, NULL, NULL, NULL, NULL, AUv2State_deallocate, NULL};
+        CFAllocatorRef     dealloc = CFAllocatorCreate(kCFAllocatorDefault, &context);
+        if (dealloc != NULL)
+        {
+            // The CFData retains the allocator
+            data = CFDataCreateWithBytesNoCopy(NULL, buf->data, buf->bytesWritten, dealloc);
+            CFRelease(dealloc);
+        }
+    }
+    if (data == NULL)
+    {
+        cplug_stateBuffer_free(buf);
+        free(buf);
+    }
+    return data;
+}
+
 /*
 NOTE: auval may pass you more data then you requested. They want you to update this to the number of bytes written
 You will fail auval REQUIRED PROPERTIES tests if you fail to do this.
@@ -461,13 +512,12 @@ static OSStatus AUMethodGetProperty(
         int subtype      = auv2->desc.componentSubType;
         int manufacturer = auv2->desc.componentManufacturer;
 
-        CFNumberRef      versionRef      = CFNumberCreate(0, kCFNumberSInt32Type, &version);
-        CFNumberRef      typeRef         = CFNumberCreate(0, kCFNumberSInt32Type, &type);
-        CFNumberRef      subtypeRef      = CFNumberCreate(0, kCFNumberSInt32Type, &subtype);
-        CFNumberRef      manufacturerRef = CFNumberCreate(0, kCFNumberSInt32Type, &manufacturer);
-        CFStringRef      presetNameRef   = CFStringCreateWithCString(0, "state", 0);
-        CFMutableDataRef presetDataRef   = NULL;
-        cplug_saveState(auv2->userPlugin, &presetDataRef, AUv2WriteProc);
+        CFNumberRef versionRef      = CFNumberCreate(0, kCFNumberSInt32Type, &version);
+        CFNumberRef typeRef         = CFNumberCreate(0, kCFNumberSInt32Type, &type);
+        CFNumberRef subtypeRef      = CFNumberCreate(0, kCFNumberSInt32Type, &subtype);
+        CFNumberRef manufacturerRef = CFNumberCreate(0, kCFNumberSInt32Type, &manufacturer);
+        CFStringRef presetNameRef   = CFStringCreateWithCString(0, "state", 0);
+        CFDataRef   presetDataRef   = AUv2State_save(auv2);
 
         CFDictionarySetValue(dict, versionKey, versionRef);
         CFDictionarySetValue(dict, typeKey, typeRef);
@@ -489,7 +539,8 @@ static OSStatus AUMethodGetProperty(
         CFRelease(subtypeRef);
         CFRelease(manufacturerRef);
         CFRelease(presetNameRef);
-        CFRelease(presetDataRef);
+        if (presetDataRef)
+            CFRelease(presetDataRef);
 
         *(CFPropertyListRef*)outData = dict;
         break;
@@ -503,24 +554,26 @@ static OSStatus AUMethodGetProperty(
     {
         AudioUnitParameterID* paramList = (AudioUnitParameterID*)(outData);
         for (UInt32 i = 0; i < CPLUG_NUM_PARAMS; i++)
-            paramList[i] = i;
+            paramList[i] = AUv2Params_getID(i);
         break;
     }
 
     case kAudioUnitProperty_ParameterInfo:
     {
         AudioUnitParameterInfo* paramInfo = outData;
+        const uint32_t          index     = AUv2Params_getIndex(inElement);
+        CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, kAudioUnitErr_InvalidParameter);
 
-        const char* name = cplug_getParameterName(auv2->userPlugin, inElement);
+        const char* name = cplug_getParameterName(auv2->userPlugin, index);
         snprintf(paramInfo->name, sizeof(paramInfo->name), "%s", name);
 
         // Support unit names? Nah. The less CFStrings the better
         // paramInfo->unitName
 
         double min, max;
-        cplug_getParameterRange(auv2->userPlugin, inElement, &min, &max);
-        const uint32_t hints      = cplug_getParameterFlags(auv2->userPlugin, inElement);
-        const float    defaultVal = cplug_getDefaultParameterValue(auv2->userPlugin, inElement);
+        cplug_getParameterRange(auv2->userPlugin, index, &min, &max);
+        const uint32_t hints      = cplug_getParameterFlags(auv2->userPlugin, index);
+        const float    defaultVal = cplug_getDefaultParameterValue(auv2->userPlugin, index);
 
         paramInfo->unit = 0;
         if (hints & CPLUG_FLAG_PARAMETER_IS_BOOL)
@@ -609,6 +662,12 @@ static OSStatus AUMethodGetProperty(
         *ioDataSize         = sizeof(auv2->mMaxFramesPerSlice);
         break;
 
+    case kAudioUnitProperty_OfflineRender:
+        CPLUG_LOG_ASSERT_RETURN(inScope == kAudioUnitScope_Global, kAudioUnitErr_InvalidScope);
+        *(UInt32*)outData = auv2->renderMode == CPLUG_RENDER_MODE_OFFLINE;
+        *ioDataSize       = sizeof(UInt32);
+        break;
+
     case kAudioUnitProperty_TailTime:
         CPLUG_LOG_ASSERT_RETURN(inScope == kAudioUnitScope_Global, kAudioUnitErr_InvalidScope);
         *(Float64*)outData = cplug_getTailInSamples(auv2->userPlugin);
@@ -670,21 +729,25 @@ static OSStatus AUMethodGetProperty(
 
     case kAudioUnitProperty_ParameterStringFromValue:
     {
-        AudioUnitParameterStringFromValue* sfv = (AudioUnitParameterStringFromValue*)outData;
+        AudioUnitParameterStringFromValue* sfv   = (AudioUnitParameterStringFromValue*)outData;
+        const uint32_t                     index = AUv2Params_getIndex(sfv->inParamID);
+        CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, kAudioUnitErr_InvalidParameter);
 
         char   buf[64];
         double value = (double)*sfv->inValue;
-        cplug_parameterValueToString(auv2->userPlugin, sfv->inParamID, buf, sizeof(buf), value);
+        cplug_parameterValueToString(auv2->userPlugin, index, buf, sizeof(buf), value);
         sfv->outString = CFStringCreateWithCString(0, buf, kCFStringEncodingUTF8);
         break;
     }
 
     case kAudioUnitProperty_ParameterValueFromString:
     {
-        AudioUnitParameterValueFromString* vfs = (AudioUnitParameterValueFromString*)outData;
+        AudioUnitParameterValueFromString* vfs   = (AudioUnitParameterValueFromString*)outData;
+        const uint32_t                     index = AUv2Params_getIndex(vfs->inParamID);
+        CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, kAudioUnitErr_InvalidParameter);
 
         const char* str = CFStringGetCStringPtr(vfs->inString, kCFStringEncodingUTF8);
-        vfs->outValue   = cplug_parameterStringToValue(auv2->userPlugin, vfs->inParamID, str);
+        vfs->outValue   = cplug_parameterStringToValue(auv2->userPlugin, index, str);
         break;
     }
 
@@ -811,6 +874,19 @@ static OSStatus AUMethodSetProperty(
             auv2->maxFramesListenerProc(auv2->maxFramesListenerData, (AudioUnit)auv2, inID, inScope, inElement);
         break;
 
+    case kAudioUnitProperty_OfflineRender:
+    {
+        CPLUG_LOG_ASSERT_RETURN(inDataSize == sizeof(UInt32), kAudioUnitErr_InvalidPropertyValue);
+        CPLUG_LOG_ASSERT_RETURN(inScope == kAudioUnitScope_Global, kAudioUnitErr_InvalidScope);
+        UInt32 renderMode = *(UInt32*)inData ? CPLUG_RENDER_MODE_OFFLINE : CPLUG_RENDER_MODE_REALTIME;
+        if (renderMode != auv2->renderMode)
+        {
+            auv2->renderMode = renderMode;
+            cplug_setRenderMode(auv2->userPlugin, renderMode);
+        }
+        break;
+    }
+
     case kAudioUnitProperty_SetRenderCallback:
     {
         // Pretend to set this. auval only test that you set it, not that you use it
@@ -926,9 +1002,10 @@ static OSStatus AUMethodGetParameter(
     AudioUnitParameterValue* value)
 {
     // cplug_log("AUMethodGetParameter => %u %s %u %p", param, _cplugScope2Str(scope), elem, value);
-    CPLUG_LOG_ASSERT_RETURN(elem < CPLUG_NUM_PARAMS, kAudioUnitErr_InvalidParameter);
+    const uint32_t index = AUv2Params_getIndex(param);
+    CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, kAudioUnitErr_InvalidParameter);
     CPLUG_LOG_ASSERT_RETURN(auv2->userPlugin != NULL, kAudioUnitErr_Uninitialized);
-    *value = (AudioUnitParameterValue)cplug_getParameterValue(auv2->userPlugin, param);
+    *value = (AudioUnitParameterValue)cplug_getParameterValue(auv2->userPlugin, index);
     return noErr;
 }
 
@@ -943,13 +1020,14 @@ static OSStatus AUMethodSetParameter(
 {
     // cplug_log("AUMethodSetParameter => %u %s %u %f %u", param, _cplugScope2Str(scope), elem, value, bufferOffset);
     CPLUG_LOG_ASSERT_RETURN(isfinite(value), kAudioUnitErr_InvalidParameter);
-    CPLUG_LOG_ASSERT_RETURN(param < CPLUG_NUM_PARAMS, kAudioUnitErr_InvalidParameter);
+    const uint32_t index = AUv2Params_getIndex(param);
+    CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, kAudioUnitErr_InvalidParameter);
     CPLUG_LOG_ASSERT_RETURN(auv2->userPlugin != NULL, kAudioUnitErr_Uninitialized);
 
     if (! isfinite(value))
         return kAudioUnitErr_InvalidParameterValue;
 
-    cplug_setParameterValue(auv2->userPlugin, param, value);
+    cplug_setParameterValue(auv2->userPlugin, index, value);
     return noErr;
 }
 
@@ -963,11 +1041,17 @@ static OSStatus AUMethodScheduleParameters(AUv2Plugin* auv2, const AudioUnitPara
     for (UInt32 i = 0; i < numEvents; ++i)
     {
         const AudioUnitParameterEvent* event = &events[i];
+        const uint32_t                 index = AUv2Params_getIndex(event->parameter);
+        if (index >= CPLUG_NUM_PARAMS)
+        {
+            status = kAudioUnitErr_InvalidParameter;
+            continue;
+        }
         switch (event->eventType)
         {
         case kParameterEvent_Immediate:
             CPLUG_LOG_ASSERT(isfinite(event->eventValues.immediate.value));
-            cplug_setParameterValue(auv2->userPlugin, event->parameter, event->eventValues.immediate.value);
+            cplug_setParameterValue(auv2->userPlugin, index, event->eventValues.immediate.value);
             break;
         case kParameterEvent_Ramped:
             CPLUG_LOG_ASSERT(isfinite(event->eventValues.ramp.startValue));
@@ -988,6 +1072,12 @@ static OSStatus AUMethodInitializeProcessing(AUv2Plugin* auv2)
     // Despite this 'initialize' naming convention, the bahaviour of this method is more closely aligned with VST3
     // IComponent::setActive. We don't currently support this feature.
     // https://developer.apple.com/documentation/audiotoolbox/1439851-audiounitinitialize?language=objc
+
+    UInt32 quantize = cplug_getEventQuantize(auv2->userPlugin);
+    CPLUG_LOG_ASSERT(quantize > 0 && (quantize & (quantize - 1)) == 0);
+    if (quantize == 0 || (quantize & (quantize - 1)) != 0)
+        quantize = 1;
+    auv2->eventQuantize = quantize;
     return noErr;
 }
 
@@ -1004,6 +1094,8 @@ typedef struct AUv2ProcessContextTranslator
     AUv2Plugin*         auv2;
     UInt32              midiIdx;
     float*              channels[2];
+    uint32_t            numChannels; // Buffers from ioData stored in 'channels'
+    uint64_t            outputSilence;
 } AUv2ProcessContextTranslator;
 
 bool AUv2ProcessContextTranslator_enqueueEvent(CplugProcessContext* ctx, const CplugEvent* event, uint32_t frameIdx)
@@ -1018,7 +1110,7 @@ bool AUv2ProcessContextTranslator_enqueueEvent(CplugProcessContext* ctx, const C
         AudioUnitEvent auevent;
         auevent.mEventType                        = kAudioUnitEvent_ParameterValueChange;
         auevent.mArgument.mParameter.mAudioUnit   = translator->auv2->compInstance;
-        auevent.mArgument.mParameter.mParameterID = event->parameter.idx;
+        auevent.mArgument.mParameter.mParameterID = AUv2Params_getID(event->parameter.idx);
         auevent.mArgument.mParameter.mScope       = kAudioUnitScope_Global;
         auevent.mArgument.mParameter.mElement     = 0;
         OSStatus status                           = AUEventListenerNotify(NULL, NULL, &auevent);
@@ -1030,7 +1122,7 @@ bool AUv2ProcessContextTranslator_enqueueEvent(CplugProcessContext* ctx, const C
         AudioUnitEvent auevent;
         auevent.mEventType                        = kAudioUnitEvent_BeginParameterChangeGesture;
         auevent.mArgument.mParameter.mAudioUnit   = translator->auv2->compInstance;
-        auevent.mArgument.mParameter.mParameterID = event->parameter.idx;
+        auevent.mArgument.mParameter.mParameterID = AUv2Params_getID(event->parameter.idx);
         auevent.mArgument.mParameter.mScope       = kAudioUnitScope_Global;
         auevent.mArgument.mParameter.mElement     = 0;
         OSStatus status                           = AUEventListenerNotify(NULL, NULL, &auevent);
@@ -1042,7 +1134,7 @@ bool AUv2ProcessContextTranslator_enqueueEvent(CplugProcessContext* ctx, const C
         AudioUnitEvent auevent;
         auevent.mEventType                        = kAudioUnitEvent_EndParameterChangeGesture;
         auevent.mArgument.mParameter.mAudioUnit   = translator->auv2->compInstance;
-        auevent.mArgument.mParameter.mParameterID = event->parameter.idx;
+        auevent.mArgument.mParameter.mParameterID = AUv2Params_getID(event->parameter.idx);
         auevent.mArgument.mParameter.mScope       = kAudioUnitScope_Global;
         auevent.mArgument.mParameter.mElement     = 0;
         OSStatus status                           = AUEventListenerNotify(NULL, NULL, &auevent);
@@ -1070,15 +1162,23 @@ bool AUv2ProcessContextTranslator_dequeueEvent(CplugProcessContext* ctx, CplugEv
 
     CPLUG_LOG_ASSERT(translator->midiIdx < ARRSIZE(translator->auv2->events));
     const CplugEvent* cachedEvent = &translator->auv2->events[translator->midiIdx];
-    if (cachedEvent->midi.frame != frameIdx)
+
+    UInt32 quantize  = translator->auv2->eventQuantize > 0 ? translator->auv2->eventQuantize : 1;
+    UInt32 midiFrame = cachedEvent->midi.frame;
+    if (midiFrame >= translator->cplugContext.numFrames)
+        midiFrame = translator->cplugContext.numFrames - 1;
+    midiFrame -= midiFrame & (quantize - 1);
+
+    if (midiFrame > frameIdx)
     {
         event->processAudio.type     = CPLUG_EVENT_PROCESS_AUDIO;
-        event->processAudio.endFrame = cachedEvent->midi.frame;
+        event->processAudio.endFrame = midiFrame;
         return true;
     }
 
     // Send MIDI event
-    *event = *cachedEvent;
+    *event            = *cachedEvent;
+    event->midi.frame = midiFrame;
     translator->midiIdx++;
 
     return true;
@@ -1096,6 +1196,33 @@ float** AUv2ProcessContextTranslator_getAudioOutput(const CplugProcessContext* c
     CPLUG_LOG_ASSERT(busIdx == 0); // TODO: support more busses
     return (float**)translator->channels;
 }
+bool AUv2ProcessContextTranslator_isInPlace(const CplugProcessContext* ctx, uint32_t busIdx, uint32_t channelIdx)
+{
+    const AUv2ProcessContextTranslator* translator = (const AUv2ProcessContextTranslator*)ctx;
+    if (busIdx != 0 || channelIdx >= translator->numChannels)
+        return false;
+    float** input  = ctx->getAudioInput(ctx, busIdx);
+    float** output = ctx->getAudioOutput(ctx, busIdx);
+    return input != NULL && output != NULL && input[channelIdx] == output[channelIdx];
+}
+
+// Like the CLAP wrapper, a bus only counts as in place when every one of its channels is
+static uint32_t AUv2ProcessContextTranslator_getInPlaceBusses(const CplugProcessContext* ctx)
+{
+    const AUv2ProcessContextTranslator* translator = (const AUv2ProcessContextTranslator*)ctx;
+
+    bool inPlace = translator->numChannels > 0;
+    for (uint32_t ch = 0; ch < translator->numChannels && inPlace; ch++)
+        inPlace = AUv2ProcessContextTranslator_isInPlace(ctx, 0, ch);
+    return inPlace ? 1 : 0;
+}
+
+void AUv2ProcessContextTranslator_setOutputSilence(CplugProcessContext* ctx, uint32_t busIdx, uint64_t channelMask)
+{
+    AUv2ProcessContextTranslator* translator = (AUv2ProcessContextTranslator*)ctx;
+    CPLUG_LOG_ASSERT_RETURN(busIdx == 0, ); // TODO: support more busses
+    translator->outputSilence = channelMask;
+}
 
 static OSStatus AUMethodProcessAudio(
     AUv2Plugin*                 auv2,
@@ -1122,7 +1249,8 @@ static OSStatus AUMethodProcessAudio(
         CplugProcessContext* ctx    = &translator.cplugContext;
         HostCallbackInfo*    hostcb = &auv2->mHostCallbackInfo;
 
-        ctx->numFrames = inNumberFrames;
+        ctx->numFrames  = inNumberFrames;
+        ctx->renderMode = auv2->renderMode;
 
         if (hostcb->beatAndTempoProc)
         {
@@ -1169,16 +1297,20 @@ static OSStatus AUMethodProcessAudio(
                 ctx->flags |= CPLUG_FLAG_TRANSPORT_IS_RECORDING;
         }
 
-        ctx->enqueueEvent   = AUv2ProcessContextTranslator_enqueueEvent;
-        ctx->dequeueEvent   = AUv2ProcessContextTranslator_dequeueEvent;
-        ctx->getAudioInput  = AUv2ProcessContextTranslator_getAudioInput;
-        ctx->getAudioOutput = AUv2ProcessContextTranslator_getAudioOutput;
+        ctx->enqueueEvent     = AUv2ProcessContextTranslator_enqueueEvent;
+        ctx->dequeueEvent     = AUv2ProcessContextTranslator_dequeueEvent;
+        ctx->dequeueEvents    = cplug_dequeueEventsSerially;
+        ctx->getAudioInput    = AUv2ProcessContextTranslator_getAudioInput;
+        ctx->getAudioOutput   = AUv2ProcessContextTranslator_getAudioOutput;
+        ctx->isInPlace        = AUv2ProcessContextTranslator_isInPlace;
+        ctx->setOutputSilence = AUv2ProcessContextTranslator_setOutputSilence;
 
         translator.auv2    = auv2;
         translator.midiIdx = 0;
 
         CPLUG_LOG_ASSERT(ioData->mNumberBuffers == 2);
-        for (int i = 0; i < ioData->mNumberBuffers; i++)
+        translator.numChannels = ioData->mNumberBuffers < 2 ? ioData->mNumberBuffers : 2;
+        for (int i = 0; i < translator.numChannels; i++)
         {
             int numChannels = ioData->mBuffers[i].mNumberChannels;
             CPLUG_LOG_ASSERT(numChannels == 1);
@@ -1186,8 +1318,19 @@ static OSStatus AUMethodProcessAudio(
             CPLUG_LOG_ASSERT_RETURN(ioData->mBuffers[i].mData != NULL, noErr);
             translator.channels[i] = (float*)ioData->mBuffers[i].mData;
         }
+        ctx->inPlaceBusses = AUv2ProcessContextTranslator_getInPlaceBusses(ctx);
 
+#if ! CPLUG_WANT_DENORMALS
+        uint64_t floatMode = cplug_disableDenormals();
+#endif
         cplug_process(auv2->userPlugin, &translator.cplugContext);
+#if ! CPLUG_WANT_DENORMALS
+        cplug_restoreDenormals(floatMode);
+#endif
+        // AUv2 can only flag the whole bus as silent
+        uint64_t busMask = ioData->mNumberBuffers < 64 ? (1ull << ioData->mNumberBuffers) - 1 : ~0ull;
+        if (busMask != 0 && (translator.outputSilence & busMask) == busMask)
+            *ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
         // Clear MIDI event list
         auv2->numEvents = 0;
     }
@@ -1320,7 +1463,18 @@ __attribute__((visibility("default"))) void* GetPluginFactory(const AudioCompone
 
     int numInstances = __atomic_fetch_add(&g_auv2InstanceCount, 1, __ATOMIC_SEQ_CST);
     if (numInstances == 0)
+    {
         cplug_libraryLoad();
+#if CPLUG_WANT_SPARSE_PARAMETER_IDS && CPLUG_NUM_PARAMS
+        if (! cplug_paramIdMap_build(&g_auv2ParamIds))
+        {
+            cplug_log("GetPluginFactory => Parameter IDs must be unique and below 0x80000000");
+            cplug_libraryUnload();
+            __atomic_fetch_sub(&g_auv2InstanceCount, 1, __ATOMIC_SEQ_CST);
+            return NULL;
+        }
+#endif
+    }
 
     AUv2Plugin* auv2 = (AUv2Plugin*)(malloc(sizeof(AUv2Plugin)));
     memset(auv2, 0, sizeof(*auv2));
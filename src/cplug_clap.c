@@ -3,6 +3,9 @@
 
 #include <clap/clap.h>
 #include <cplug.h>
+#if CPLUG_WANT_THREAD_POOL
+#include <cplug_thread_pool.h>
+#endif
 #include <stdio.h>
 #include <string.h>
 
@@ -17,8 +20,39 @@ typedef struct CLAPPlugin
     const clap_host_latency_t* host_latency;
     const clap_host_state_t*   host_state;
     const clap_host_params_t*  host_params;
+
+    const clap_host_thread_pool_t* host_thread_pool;
+    // Current parallelFor job, only valid while the host is running the thread pool
+    cplug_taskProc taskProc;
+    void*          taskUserdata;
+
+    uint32_t eventQuantize;
+    // CPLUG_RENDER_MODE_*. Written on the main thread, read by the audio thread
+    cplug_atomic_i32 renderMode;
+    // Scratch for the audio thread, see ClapProcessContext_dequeueEvent. Entries are written by the grid cell scan
+    // before they are read, so they are never cleared
+#if CPLUG_NUM_PARAMS
+    uint32_t lastParamEventIdx[CPLUG_NUM_PARAMS];
+#endif
+#if CPLUG_WANT_PARAMETER_COOKIES && CPLUG_NUM_PARAMS
+    void* paramCookies[CPLUG_NUM_PARAMS];
+#endif
+#if CPLUG_WANT_PARAMETER_TEXT_CACHE
+    CplugParamTextCache paramTextCache;
+#endif
 } CLAPPlugin;
 
+// Parameter IDs are indexes, unless CPLUG_WANT_SPARSE_PARAMETER_IDS is set
+#if CPLUG_WANT_SPARSE_PARAMETER_IDS && CPLUG_NUM_PARAMS
+static CplugParamIdMap g_clapParamIds;
+
+static inline clap_id  CLAPParams_getID(uint32_t index) { return g_clapParamIds.ids[index]; }
+static inline uint32_t CLAPParams_getIndex(clap_id id) { return cplug_paramIdMap_find(&g_clapParamIds, id); }
+#else
+static inline clap_id  CLAPParams_getID(uint32_t index) { return index; }
+static inline uint32_t CLAPParams_getIndex(clap_id id) { return id; }
+#endif
+
 #if CPLUG_NUM_INPUT_BUSSES + CPLUG_NUM_OUTPUT_BUSSES > 0
 /////////////////////////////
 // clap_plugin_audio_ports //
@@ -41,8 +75,9 @@ CLAPExtAudioPorts_get(const clap_plugin_t* plugin, uint32_t index, bool is_input
         info->id = index;
         snprintf(info->name, sizeof(info->name), "%s", cplug_getInputBusName(clap->userPlugin, index));
         info->channel_count = cplug_getInputBusChannelCount(clap->userPlugin, index);
-        // Maybe we will support 64bit one day (probably not)
         info->flags = CLAP_AUDIO_PORT_REQUIRES_COMMON_SAMPLE_SIZE;
+        if (cplug_canProcessDouble(clap->userPlugin))
+            info->flags |= CLAP_AUDIO_PORT_SUPPORTS_64BITS;
         if (index == 0)
             info->flags |= CLAP_AUDIO_PORT_IS_MAIN;
 
@@ -65,8 +100,9 @@ CLAPExtAudioPorts_get(const clap_plugin_t* plugin, uint32_t index, bool is_input
         info->id = CPLUG_NUM_INPUT_BUSSES + index;
         snprintf(info->name, sizeof(info->name), "%s", cplug_getOutputBusName(clap->userPlugin, index));
         info->channel_count = cplug_getOutputBusChannelCount(clap->userPlugin, index);
-        // Maybe we will support 64bit one day (probably not)
         info->flags = CLAP_AUDIO_PORT_REQUIRES_COMMON_SAMPLE_SIZE;
+        if (cplug_canProcessDouble(clap->userPlugin))
+            info->flags |= CLAP_AUDIO_PORT_SUPPORTS_64BITS;
         if (index == 0)
             info->flags |= CLAP_AUDIO_PORT_IS_MAIN;
 
@@ -152,24 +188,137 @@ static const clap_plugin_tail_t s_clap_tail = {
     .get = CLAPExtTail_get,
 };
 
+/////////////////
+// clap_render //
+/////////////////
+
+bool CLAPExtRender_has_hard_realtime_requirement(const clap_plugin_t* plugin)
+{
+    cplug_log("CLAPExtRender_has_hard_realtime_requirement");
+    return false;
+}
+
+bool CLAPExtRender_set(const clap_plugin_t* plugin, clap_plugin_render_mode mode)
+{
+    cplug_log("CLAPExtRender_set => %d", (int)mode);
+    CPLUG_LOG_ASSERT_RETURN(mode == CLAP_RENDER_REALTIME || mode == CLAP_RENDER_OFFLINE, false);
+    CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
+
+    uint32_t renderMode = mode == CLAP_RENDER_OFFLINE ? CPLUG_RENDER_MODE_OFFLINE : CPLUG_RENDER_MODE_REALTIME;
+    if (renderMode != (uint32_t)cplug_atomic_load_acquire_i32(&clap->renderMode))
+    {
+        // Let the plugin prepare before the audio thread sees the new mode
+        cplug_setRenderMode(clap->userPlugin, renderMode);
+        cplug_atomic_store_release_i32(&clap->renderMode, (int)renderMode);
+    }
+    return true;
+}
+
+static const clap_plugin_render_t s_clap_render = {
+    .has_hard_realtime_requirement = CLAPExtRender_has_hard_realtime_requirement,
+    .set                           = CLAPExtRender_set,
+};
+
+//////////////////////
+// clap_thread_pool //
+//////////////////////
+
+void CLAPExtThreadPool_exec(const clap_plugin_t* plugin, uint32_t task_index)
+{
+    CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
+    CPLUG_LOG_ASSERT(clap->taskProc != NULL);
+    if (clap->taskProc != NULL)
+    {
+        // Host threads don't inherit the mode set in CLAPPlugin_process
+#if ! CPLUG_WANT_DENORMALS
+        uint64_t floatMode = cplug_disableDenormals();
+#endif
+        clap->taskProc(clap->taskUserdata, task_index);
+#if ! CPLUG_WANT_DENORMALS
+        cplug_restoreDenormals(floatMode);
+#endif
+    }
+}
+
+static const clap_plugin_thread_pool_t s_clap_thread_pool = {
+    .exec = CLAPExtThreadPool_exec,
+};
+
 ////////////////
 // clap_state //
 ////////////////
 
+// Streams may write or read fewer bytes than asked. We keep calling them until the plugins request is complete
+typedef struct CLAPStateContext
+{
+    const void* stream;
+    bool        failed;
+} CLAPStateContext;
+
+int64_t CLAPState_writeProc(const void* stateCtx, void* writePos, size_t numBytesToWrite)
+{
+    CLAPStateContext*     ctx    = (CLAPStateContext*)stateCtx;
+    const clap_ostream_t* stream = (const clap_ostream_t*)ctx->stream;
+    const uint8_t*        src    = (const uint8_t*)writePos;
+    size_t                remain = numBytesToWrite;
+
+    while (remain > 0 && ! ctx->failed)
+    {
+        uint64_t chunk   = remain > CPLUG_STATE_CHUNK_SIZE ? CPLUG_STATE_CHUNK_SIZE : remain;
+        int64_t  written = stream->write(stream, src, chunk);
+        if (written <= 0)
+        {
+            cplug_log("CLAPState_writeProc => Stream failed with %lld bytes remaining", (long long)remain);
+            ctx->failed = true;
+            break;
+        }
+        src    += written;
+        remain -= written;
+    }
+    return ctx->failed ? -1 : (int64_t)numBytesToWrite;
+}
+
+int64_t CLAPState_readProc(const void* stateCtx, void* readPos, size_t maxBytesToRead)
+{
+    CLAPStateContext*     ctx    = (CLAPStateContext*)stateCtx;
+    const clap_istream_t* stream = (const clap_istream_t*)ctx->stream;
+    uint8_t*              dst    = (uint8_t*)readPos;
+    size_t                remain = maxBytesToRead;
+
+    while (remain > 0 && ! ctx->failed)
+    {
+        uint64_t chunk     = remain > CPLUG_STATE_CHUNK_SIZE ? CPLUG_STATE_CHUNK_SIZE : remain;
+        int64_t  bytesRead = stream->read(stream, dst, chunk);
+        if (bytesRead < 0)
+        {
+            cplug_log("CLAPState_readProc => Stream failed");
+            ctx->failed = true;
+            break;
+        }
+        if (bytesRead == 0) // End of file
+            break;
+        dst    += bytesRead;
+        remain -= bytesRead;
+    }
+    return ctx->failed ? -1 : (int64_t)(maxBytesToRead - remain);
+}
+
 bool CLAPExtState_save(const clap_plugin_t* plugin, const clap_ostream_t* stream)
 {
     cplug_log("CLAPExtState_save => %p", stream);
-    CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
-    cplug_saveState(clap->userPlugin, stream, (cplug_writeProc)stream->write);
-    return true;
+    CLAPPlugin*      clap = (CLAPPlugin*)plugin->plugin_data;
+    CLAPStateContext ctx  = {stream, false};
+    cplug_saveState(clap->userPlugin, &ctx, CLAPState_writeProc);
+    return ! ctx.failed;
 }
 
 bool CLAPExtState_load(const clap_plugin_t* plugin, const clap_istream_t* stream)
 {
     cplug_log("CLAPExtState_load %p", stream);
-    CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
-    cplug_loadState(clap->userPlugin, stream, (cplug_readProc)stream->read);
-    return true;
+    CLAPPlugin*      clap = (CLAPPlugin*)plugin->plugin_data;
+    CLAPStateContext ctx  = {stream, false};
+    cplug_loadState(clap->userPlugin, &ctx, CLAPState_readProc);
+    return ! ctx.failed;
 }
 
 static const clap_plugin_state_t s_clap_state = {
@@ -188,20 +337,27 @@ uint32_t CLAPExtParams_count(const clap_plugin_t* plugin)
     return CPLUG_NUM_PARAMS;
 }
 
-bool CLAPExtParams_get_info(const clap_plugin_t* plugin, uint32_t param_index, clap_param_info_t* param_info)
-{
-    cplug_log("CLAPExtParams_get_info => %u %p", param_index, param_info);
-    CPLUG_LOG_ASSERT_RETURN(param_index < CPLUG_NUM_PARAMS, false);
-
-    CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
+#ifdef CPLUG_PARAMETER_DESCRIPTORS
+// Built once in CLAPEntry_init from your descriptors, then copied out to the host
+static clap_param_info_t g_clapParamInfos[CPLUG_NUM_PARAMS];
+#endif
 
-    param_info->id = param_index;
-    snprintf(param_info->name, sizeof(param_info->name), "%s", cplug_getParameterName(clap->userPlugin, param_index));
+static void CLAPExtParams_fillInfo(
+    clap_param_info_t* param_info,
+    uint32_t           param_index,
+    const char*        name,
+    double             min,
+    double             max,
+    double             defaultValue,
+    uint32_t           flags)
+{
+    param_info->id = CLAPParams_getID(param_index);
+    snprintf(param_info->name, sizeof(param_info->name), "%s", name);
     param_info->module[0]     = 0;
-    param_info->default_value = cplug_getDefaultParameterValue(clap->userPlugin, param_index);
-    cplug_getParameterRange(clap->userPlugin, param_index, &param_info->min_value, &param_info->max_value);
+    param_info->default_value = defaultValue;
+    param_info->min_value     = min;
+    param_info->max_value     = max;
 
-    uint32_t flags    = cplug_getParameterFlags(clap->userPlugin, param_index);
     param_info->flags = 0;
     if (flags & CPLUG_FLAG_PARAMETER_IS_READ_ONLY)
         param_info->flags |= CLAP_PARAM_IS_READONLY;
@@ -213,18 +369,60 @@ bool CLAPExtParams_get_info(const clap_plugin_t* plugin, uint32_t param_index, c
         param_info->flags |= CLAP_PARAM_IS_AUTOMATABLE;
     if (flags & CPLUG_FLAG_PARAMETER_IS_BYPASS)
         param_info->flags |= CLAP_PARAM_IS_BYPASS;
-    // This is a really great feature and I'd love to support it, however, at the time of writing this CLAP still isn't
-    // supported by many hosts and so it's not worth it yet
-    // TODO: Support this
+    // Cookies are per instance, see CLAPExtParams_get_info
     param_info->cookie = NULL;
+}
+
+#ifdef CPLUG_PARAMETER_DESCRIPTORS
+static void CLAPExtParams_buildInfos()
+{
+    for (uint32_t i = 0; i < CPLUG_NUM_PARAMS; i++)
+    {
+        const CplugParamDescriptor* desc = cplug_getParamDescriptor(i);
+        CLAPExtParams_fillInfo(
+            &g_clapParamInfos[i],
+            i,
+            desc->name,
+            desc->min,
+            desc->max,
+            desc->defaultValue,
+            desc->flags);
+    }
+}
+#endif
+
+bool CLAPExtParams_get_info(const clap_plugin_t* plugin, uint32_t param_index, clap_param_info_t* param_info)
+{
+    cplug_log("CLAPExtParams_get_info => %u %p", param_index, param_info);
+    CPLUG_LOG_ASSERT_RETURN(param_index < CPLUG_NUM_PARAMS, false);
+    CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
+
+#ifdef CPLUG_PARAMETER_DESCRIPTORS
+    memcpy(param_info, &g_clapParamInfos[param_index], sizeof(*param_info));
+#else
+    double min, max;
+    cplug_getParameterRange(clap->userPlugin, param_index, &min, &max);
+    CLAPExtParams_fillInfo(
+        param_info,
+        param_index,
+        cplug_getParameterName(clap->userPlugin, param_index),
+        min,
+        max,
+        cplug_getDefaultParameterValue(clap->userPlugin, param_index),
+        cplug_getParameterFlags(clap->userPlugin, param_index));
+#endif
+#if CPLUG_WANT_PARAMETER_COOKIES && CPLUG_NUM_PARAMS
+    param_info->cookie = clap->paramCookies[param_index];
+#endif
     return true;
 }
 
 bool CLAPExtParams_get_value(const clap_plugin_t* plugin, clap_id param_id, double* out_value)
 {
     cplug_log("CLAPExtParams_get_value => %u %p", param_id, out_value);
-    CPLUG_LOG_ASSERT_RETURN(param_id < CPLUG_NUM_PARAMS, false);
-    *out_value = cplug_getParameterValue(((CLAPPlugin*)plugin->plugin_data)->userPlugin, param_id);
+    uint32_t index = CLAPParams_getIndex(param_id);
+    CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, false);
+    *out_value = cplug_getParameterValue(((CLAPPlugin*)plugin->plugin_data)->userPlugin, index);
     return true;
 }
 
@@ -236,10 +434,23 @@ bool CLAPExtParams_value_to_text(
     uint32_t             out_buffer_capacity)
 {
     // cplug_log("CLAPExtParams_value_to_text => %u %f %p %u", param_id, value, out_buffer, out_buffer_capacity);
-    CPLUG_LOG_ASSERT_RETURN(param_id < CPLUG_NUM_PARAMS, false);
+    uint32_t index = CLAPParams_getIndex(param_id);
+    CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, false);
 
     CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
-    cplug_parameterValueToString(clap->userPlugin, param_id, out_buffer, out_buffer_capacity, value);
+#if CPLUG_WANT_PARAMETER_TEXT_CACHE
+    // Smaller buffers may truncate the text, so they skip the cache
+    CplugParamTextCache* cache    = &clap->paramTextCache;
+    uint32_t             version  = cplug_getParameterTextVersion(clap->userPlugin);
+    bool                 useCache = out_buffer_capacity > CPLUG_PARAM_TEXT_CACHE_MAX_LENGTH;
+    if (useCache && cplug_paramTextCache_get(cache, index, value, version, out_buffer, out_buffer_capacity, NULL, 0))
+        return true;
+#endif
+    cplug_parameterValueToString(clap->userPlugin, index, out_buffer, out_buffer_capacity, value);
+#if CPLUG_WANT_PARAMETER_TEXT_CACHE
+    if (useCache)
+        cplug_paramTextCache_put(cache, index, value, version, out_buffer, NULL);
+#endif
     return true;
 }
 
@@ -250,9 +461,10 @@ bool CLAPExtParams_text_to_value(
     double*              out_value)
 {
     cplug_log("CLAPExtParams_text_to_value => %u %p %p", param_id, param_value_text, out_value);
-    CPLUG_LOG_ASSERT_RETURN(param_id < CPLUG_NUM_PARAMS, false);
+    uint32_t index = CLAPParams_getIndex(param_id);
+    CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, false);
     CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
-    *out_value       = cplug_parameterStringToValue(clap->userPlugin, param_id, param_value_text);
+    *out_value       = cplug_parameterStringToValue(clap->userPlugin, index, param_value_text);
     return true;
 }
 
@@ -427,12 +639,19 @@ static bool CLAPPlugin_init(const struct clap_plugin* plugin)
     CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
 
     clap->userPlugin = cplug_createPlugin();
+#if CPLUG_WANT_PARAMETER_COOKIES && CPLUG_NUM_PARAMS
+    for (uint32_t i = 0; i < CPLUG_NUM_PARAMS; i++)
+        clap->paramCookies[i] = cplug_getParameterCookie(clap->userPlugin, i);
+#endif
 
     // Fetch host's extensions here
     // Make sure to check that the interface functions are not null pointers
     clap->host_latency = (const clap_host_latency_t*)clap->host->get_extension(clap->host, CLAP_EXT_LATENCY);
     clap->host_state   = (const clap_host_state_t*)clap->host->get_extension(clap->host, CLAP_EXT_STATE);
     clap->host_params  = (const clap_host_params_t*)clap->host->get_extension(clap->host, CLAP_EXT_PARAMS);
+    // Optional
+    clap->host_thread_pool =
+        (const clap_host_thread_pool_t*)clap->host->get_extension(clap->host, CLAP_EXT_THREAD_POOL);
 
     assert(clap->host_latency != NULL);
     assert(clap->host_state != NULL);
@@ -455,7 +674,14 @@ static bool CLAPPlugin_activate(
     uint32_t             max_frames_count)
 {
     cplug_log("CLAPPlugin_activate => %f %u %u", sample_rate, min_frames_count, max_frames_count);
-    cplug_setSampleRateAndBlockSize(((CLAPPlugin*)plugin->plugin_data)->userPlugin, sample_rate, max_frames_count);
+    CLAPPlugin* clap = (CLAPPlugin*)plugin->plugin_data;
+    cplug_setSampleRateAndBlockSize(clap->userPlugin, sample_rate, max_frames_count);
+
+    uint32_t quantize = cplug_getEventQuantize(clap->userPlugin);
+    CPLUG_LOG_ASSERT(quantize > 0 && (quantize & (quantize - 1)) == 0);
+    if (quantize == 0 || (quantize & (quantize - 1)) != 0)
+        quantize = 1;
+    clap->eventQuantize = quantize;
     return true;
 }
 
@@ -475,9 +701,14 @@ typedef struct ClapProcessContextTranslator
 {
     CplugProcessContext cplugContext;
 
+    CLAPPlugin*           clap;
     const clap_process_t* process;
     uint32_t              eventIdx;
     uint32_t              numEvents;
+
+    // Events are aligned to a grid. Only the last param value event for each param within a grid cell is sent
+    uint32_t eventQuantize;
+    uint32_t cellEndIdx;
 } ClapProcessContextTranslator;
 
 bool ClapProcessContext_enqueueEvent(struct CplugProcessContext* ctx, const CplugEvent* paramEvent, uint32_t frameIdx)
@@ -495,7 +726,7 @@ bool ClapProcessContext_enqueueEvent(struct CplugProcessContext* ctx, const Cplu
         event.header.size = sizeof(event);
         event.header.type = paramEvent->type == CPLUG_EVENT_PARAM_CHANGE_BEGIN ? CLAP_EVENT_PARAM_GESTURE_BEGIN
                                                                                : CLAP_EVENT_PARAM_GESTURE_END;
-        event.param_id    = paramEvent->parameter.idx;
+        event.param_id    = CLAPParams_getID(paramEvent->parameter.idx);
         return process->out_events->try_push(process->out_events, &event.header);
     }
     case CPLUG_EVENT_PARAM_CHANGE_UPDATE:
@@ -504,7 +735,7 @@ bool ClapProcessContext_enqueueEvent(struct CplugProcessContext* ctx, const Cplu
         memset(&event, 0, sizeof(event));
         event.header.size = sizeof(event);
         event.header.type = CLAP_EVENT_PARAM_VALUE;
-        event.param_id    = paramEvent->parameter.idx;
+        event.param_id    = CLAPParams_getID(paramEvent->parameter.idx);
         event.value       = paramEvent->parameter.value;
         return process->out_events->try_push(process->out_events, &event.header);
     }
@@ -514,29 +745,50 @@ bool ClapProcessContext_enqueueEvent(struct CplugProcessContext* ctx, const Cplu
     return false;
 }
 
-bool ClapProcessContext_dequeueEvent(struct CplugProcessContext* ctx, CplugEvent* event, uint32_t frameIdx)
+static uint32_t ClapProcessContext_getEventFrame(const ClapProcessContextTranslator* translator, uint32_t eventIdx)
 {
-    ClapProcessContextTranslator* translator = (ClapProcessContextTranslator*)ctx;
-    const clap_process_t*         process    = translator->process;
+    const clap_input_events_t* in_events = translator->process->in_events;
+    const clap_event_header_t* hdr       = in_events->get(in_events, eventIdx);
 
-    if (frameIdx >= translator->cplugContext.numFrames)
-        return false;
+    uint32_t frame = hdr->time;
+    if (frame >= translator->cplugContext.numFrames)
+        frame = translator->cplugContext.numFrames - 1;
+    return frame - (frame & (translator->eventQuantize - 1));
+}
 
-    if (translator->eventIdx == translator->numEvents)
-    {
-        // we reached the end of the event list
-        event->processAudio.type     = CPLUG_EVENT_PROCESS_AUDIO;
-        event->processAudio.endFrame = translator->cplugContext.numFrames;
-        return true;
-    }
+// Entering a new grid cell. Find the last value event for each param in this cell
+static void ClapProcessContext_scanCell(ClapProcessContextTranslator* translator, uint32_t frameIdx)
+{
+#if CPLUG_NUM_PARAMS
+    const clap_input_events_t* in_events = translator->process->in_events;
+#endif
 
-    const clap_event_header_t* hdr = process->in_events->get(process->in_events, translator->eventIdx);
-    if (hdr->time != frameIdx)
+    uint32_t idx = translator->eventIdx;
+    for (; idx < translator->numEvents && ClapProcessContext_getEventFrame(translator, idx) <= frameIdx; idx++)
     {
-        event->processAudio.type     = CPLUG_EVENT_PROCESS_AUDIO;
-        event->processAudio.endFrame = hdr->time;
-        return true;
+#if CPLUG_NUM_PARAMS
+        const clap_event_header_t* hdr = in_events->get(in_events, idx);
+        if (hdr->type == CLAP_EVENT_PARAM_VALUE)
+        {
+            const clap_event_param_value_t* ev       = (const clap_event_param_value_t*)hdr;
+            uint32_t                        paramIdx = CLAPParams_getIndex(ev->param_id);
+            if (paramIdx < CPLUG_NUM_PARAMS)
+                translator->clap->lastParamEventIdx[paramIdx] = idx;
+        }
+#endif
     }
+    translator->cellEndIdx = idx;
+}
+
+// Returns false if the event at 'eventIdx' is skipped
+static bool ClapProcessContext_translateEvent(
+    ClapProcessContextTranslator* translator,
+    uint32_t                      eventIdx,
+    uint32_t                      eventFrame,
+    CplugEvent*                   event)
+{
+    const clap_input_events_t* in_events = translator->process->in_events;
+    const clap_event_header_t* hdr       = in_events->get(in_events, eventIdx);
 
     switch (hdr->type)
     {
@@ -546,15 +798,28 @@ bool ClapProcessContext_dequeueEvent(struct CplugProcessContext* ctx, CplugEvent
     case CLAP_EVENT_NOTE_END:
         cplug_log("WARNING: Unsupported MIDI format. If you're using Bitwig v5.0, please update to >= v5.1");
         break;
+#if CPLUG_NUM_PARAMS
     case CLAP_EVENT_PARAM_VALUE:
     {
-        const clap_event_param_value_t* ev = (const clap_event_param_value_t*)hdr;
-
-        event->parameter.type  = CPLUG_EVENT_PARAM_CHANGE_UPDATE;
-        event->parameter.idx   = ev->param_id;
-        event->parameter.value = ev->value;
-        break;
+        const clap_event_param_value_t* ev       = (const clap_event_param_value_t*)hdr;
+        uint32_t                        paramIdx = CLAPParams_getIndex(ev->param_id);
+        CPLUG_LOG_ASSERT(paramIdx < CPLUG_NUM_PARAMS);
+        if (paramIdx >= CPLUG_NUM_PARAMS || translator->clap->lastParamEventIdx[paramIdx] != eventIdx)
+            break;
+
+        event->parameter.type   = CPLUG_EVENT_PARAM_CHANGE_UPDATE;
+        event->parameter.idx    = paramIdx;
+        event->parameter.value  = ev->value;
+#if CPLUG_WANT_PARAMETER_COOKIES && CPLUG_NUM_PARAMS
+        event->parameter.cookie = ev->cookie;
+        // Hosts are allowed to send events without a cookie
+        if (event->parameter.cookie == NULL)
+            event->parameter.cookie = translator->clap->paramCookies[paramIdx];
+#endif
+        cplug_smoothers_handleEvent(&translator->cplugContext, event);
+        return true;
     }
+#endif
     case CLAP_EVENT_MIDI:
     {
         const clap_event_midi_t* ev = (const clap_event_midi_t*)hdr;
@@ -564,23 +829,137 @@ bool ClapProcessContext_dequeueEvent(struct CplugProcessContext* ctx, CplugEvent
         event->midi.bytes[1] = ev->data[1];
         event->midi.bytes[2] = ev->data[2];
         event->midi.bytes[3] = 0;
-        event->midi.frame    = ev->header.time;
-        break;
+        event->midi.frame    = eventFrame;
+        return true;
     }
     default:
         cplug_log("ClapProcessContext_dequeueEvent: Unhandled event type: %hu", hdr->type);
         break;
     }
+    return false;
+}
+
+bool ClapProcessContext_dequeueEvent(struct CplugProcessContext* ctx, CplugEvent* event, uint32_t frameIdx)
+{
+    ClapProcessContextTranslator* translator = (ClapProcessContextTranslator*)ctx;
+
+    if (frameIdx >= translator->cplugContext.numFrames)
+        return false;
 
-    translator->eventIdx++;
+    while (translator->eventIdx < translator->numEvents)
+    {
+        uint32_t eventFrame = ClapProcessContext_getEventFrame(translator, translator->eventIdx);
+        if (eventFrame > frameIdx)
+        {
+            event->processAudio.type     = CPLUG_EVENT_PROCESS_AUDIO;
+            event->processAudio.endFrame = eventFrame;
+            return true;
+        }
+
+        if (translator->eventIdx == translator->cellEndIdx)
+            ClapProcessContext_scanCell(translator, frameIdx);
+
+        if (ClapProcessContext_translateEvent(translator, translator->eventIdx++, eventFrame, event))
+            return true;
+    }
 
+    // we reached the end of the event list
+    event->processAudio.type     = CPLUG_EVENT_PROCESS_AUDIO;
+    event->processAudio.endFrame = translator->cplugContext.numFrames;
     return true;
 }
 
+// Walks in_events once, writing straight into 'events'
+uint32_t ClapProcessContext_dequeueEvents(
+    struct CplugProcessContext* ctx,
+    CplugEvent*                 events,
+    uint32_t                    maxEvents,
+    uint32_t                    frameIdx)
+{
+    ClapProcessContextTranslator* translator = (ClapProcessContextTranslator*)ctx;
+
+    if (frameIdx >= translator->cplugContext.numFrames || maxEvents == 0)
+        return 0;
+
+    uint32_t numEvents = 0;
+    uint32_t endFrame  = translator->cplugContext.numFrames;
+    while (translator->eventIdx < translator->numEvents)
+    {
+        uint32_t eventFrame = ClapProcessContext_getEventFrame(translator, translator->eventIdx);
+        if (eventFrame > frameIdx)
+        {
+            endFrame = eventFrame;
+            break;
+        }
+        if (numEvents == maxEvents)
+            return numEvents;
+
+        if (translator->eventIdx == translator->cellEndIdx)
+            ClapProcessContext_scanCell(translator, frameIdx);
+
+        if (ClapProcessContext_translateEvent(translator, translator->eventIdx++, eventFrame, &events[numEvents]))
+            numEvents++;
+    }
+
+    if (numEvents == maxEvents)
+        return numEvents;
+    events[numEvents].processAudio.type     = CPLUG_EVENT_PROCESS_AUDIO;
+    events[numEvents].processAudio.endFrame = endFrame;
+    return numEvents + 1;
+}
+
+void ClapProcessContext_parallelFor(
+    struct CplugProcessContext* ctx,
+    uint32_t                    taskCount,
+    cplug_taskProc              taskProc,
+    void*                       userdata)
+{
+    const ClapProcessContextTranslator* translator = (const ClapProcessContextTranslator*)ctx;
+    CLAPPlugin*                         clap       = translator->clap;
+
+    if (clap->host_thread_pool != NULL && clap->host_thread_pool->request_exec != NULL && taskCount > 1)
+    {
+        clap->taskProc     = taskProc;
+        clap->taskUserdata = userdata;
+        bool didExec       = clap->host_thread_pool->request_exec(clap->host, taskCount);
+        clap->taskProc     = NULL;
+        clap->taskUserdata = NULL;
+        if (didExec)
+            return;
+    }
+#if CPLUG_WANT_THREAD_POOL
+    // Used when the host doesn't provide a thread pool
+    cplug_threadPool_parallelFor(g_cplugThreadPool, taskCount, taskProc, userdata);
+#else
+    for (uint32_t i = 0; i < taskCount; i++)
+        taskProc(userdata, i);
+#endif
+}
+
+double** ClapProcessContext_getAudioInput64(const struct CplugProcessContext* ctx, uint32_t busIdx)
+{
+    const ClapProcessContextTranslator* translator = (const ClapProcessContextTranslator*)ctx;
+    CPLUG_LOG_ASSERT_RETURN(busIdx < translator->process->audio_inputs_count, NULL);
+    if (! ctx->isDoublePrecision)
+        return NULL;
+    return translator->process->audio_inputs[busIdx].data64;
+}
+
+double** ClapProcessContext_getAudioOutput64(const struct CplugProcessContext* ctx, uint32_t busIdx)
+{
+    const ClapProcessContextTranslator* translator = (const ClapProcessContextTranslator*)ctx;
+    CPLUG_LOG_ASSERT_RETURN(busIdx < translator->process->audio_outputs_count, NULL);
+    if (! ctx->isDoublePrecision)
+        return NULL;
+    return translator->process->audio_outputs[busIdx].data64;
+}
+
 float** ClapProcessContext_getAudioInput(const struct CplugProcessContext* ctx, uint32_t busIdx)
 {
     const ClapProcessContextTranslator* translator = (const ClapProcessContextTranslator*)ctx;
     CPLUG_LOG_ASSERT_RETURN(busIdx < translator->process->audio_inputs_count, NULL);
+    if (ctx->isDoublePrecision)
+        return NULL;
     return translator->process->audio_inputs[busIdx].data32;
 }
 
@@ -588,9 +967,85 @@ float** ClapProcessContext_getAudioOutput(const struct CplugProcessContext* ctx,
 {
     const ClapProcessContextTranslator* translator = (const ClapProcessContextTranslator*)ctx;
     CPLUG_LOG_ASSERT_RETURN(busIdx < translator->process->audio_outputs_count, NULL);
+    if (ctx->isDoublePrecision)
+        return NULL;
     return translator->process->audio_outputs[busIdx].data32;
 }
 
+bool ClapProcessContext_isInPlace(const struct CplugProcessContext* ctx, uint32_t busIdx, uint32_t channelIdx)
+{
+    const ClapProcessContextTranslator* translator = (const ClapProcessContextTranslator*)ctx;
+    const clap_process_t*               process    = translator->process;
+    if (busIdx >= process->audio_inputs_count || busIdx >= process->audio_outputs_count)
+        return false;
+
+    const clap_audio_buffer_t* input  = &process->audio_inputs[busIdx];
+    const clap_audio_buffer_t* output = &process->audio_outputs[busIdx];
+    if (channelIdx >= input->channel_count || channelIdx >= output->channel_count)
+        return false;
+    if (ctx->isDoublePrecision)
+        return input->data64 != NULL && output->data64 != NULL &&
+               input->data64[channelIdx] == output->data64[channelIdx];
+    return input->data32 != NULL && output->data32 != NULL && input->data32[channelIdx] == output->data32[channelIdx];
+}
+
+// Hosts pair busses by index, as advertised with in_place_pair in CLAPExtAudioPorts_get
+static uint32_t ClapProcessContext_getInPlaceBusses(const struct CplugProcessContext* ctx)
+{
+    const ClapProcessContextTranslator* translator = (const ClapProcessContextTranslator*)ctx;
+    const clap_process_t*               process    = translator->process;
+
+    uint32_t mask = 0;
+    for (uint32_t bus = 0; bus < process->audio_inputs_count && bus < process->audio_outputs_count && bus < 32; bus++)
+    {
+        uint32_t numChannels = process->audio_outputs[bus].channel_count;
+        bool     inPlace     = numChannels > 0 && numChannels == process->audio_inputs[bus].channel_count;
+        for (uint32_t ch = 0; ch < numChannels && inPlace; ch++)
+            inPlace = ClapProcessContext_isInPlace(ctx, bus, ch);
+        if (inPlace)
+            mask |= 1u << bus;
+    }
+    return mask;
+}
+
+uint64_t ClapProcessContext_getInputConstant(const struct CplugProcessContext* ctx, uint32_t busIdx)
+{
+    const ClapProcessContextTranslator* translator = (const ClapProcessContextTranslator*)ctx;
+    CPLUG_LOG_ASSERT_RETURN(busIdx < translator->process->audio_inputs_count, 0);
+    const clap_audio_buffer_t* input = &translator->process->audio_inputs[busIdx];
+    // Some hosts leave bits set past the last channel
+    uint64_t channelMask = input->channel_count >= 64 ? ~0ull : (1ull << input->channel_count) - 1;
+    return input->constant_mask & channelMask;
+}
+
+// CLAP only flags constant channels, so check whether the constant is 0
+uint64_t ClapProcessContext_getInputSilence(const struct CplugProcessContext* ctx, uint32_t busIdx)
+{
+    const ClapProcessContextTranslator* translator   = (const ClapProcessContextTranslator*)ctx;
+    uint64_t                            constantMask = ClapProcessContext_getInputConstant(ctx, busIdx);
+    if (constantMask == 0 || ctx->numFrames == 0)
+        return 0;
+
+    const clap_audio_buffer_t* input = &translator->process->audio_inputs[busIdx];
+    uint64_t                   mask  = 0;
+    for (uint32_t ch = 0; ch < input->channel_count && ch < 64; ch++)
+    {
+        if ((constantMask & (1ull << ch)) == 0)
+            continue;
+        bool isZero = ctx->isDoublePrecision ? input->data64[ch][0] == 0 : input->data32[ch][0] == 0;
+        if (isZero)
+            mask |= 1ull << ch;
+    }
+    return mask;
+}
+
+void ClapProcessContext_setOutputSilence(struct CplugProcessContext* ctx, uint32_t busIdx, uint64_t channelMask)
+{
+    const ClapProcessContextTranslator* translator = (const ClapProcessContextTranslator*)ctx;
+    CPLUG_LOG_ASSERT_RETURN(busIdx < translator->process->audio_outputs_count, );
+    translator->process->audio_outputs[busIdx].constant_mask = channelMask;
+}
+
 static clap_process_status CLAPPlugin_process(const struct clap_plugin* plugin, const clap_process_t* process)
 {
     // cplug_log("CLAPPlugin_process => %p", process);
@@ -598,6 +1053,7 @@ static clap_process_status CLAPPlugin_process(const struct clap_plugin* plugin,
 
     struct ClapProcessContextTranslator translator = {0};
     translator.cplugContext.numFrames              = process->frames_count;
+    translator.cplugContext.renderMode             = (uint32_t)cplug_atomic_load_acquire_i32(&clap->renderMode);
 
     if (process->transport)
     {
@@ -635,14 +1091,43 @@ static clap_process_status CLAPPlugin_process(const struct clap_plugin* plugin,
 
     translator.cplugContext.enqueueEvent   = &ClapProcessContext_enqueueEvent;
     translator.cplugContext.dequeueEvent   = &ClapProcessContext_dequeueEvent;
+    translator.cplugContext.dequeueEvents  = &ClapProcessContext_dequeueEvents;
     translator.cplugContext.getAudioInput  = &ClapProcessContext_getAudioInput;
     translator.cplugContext.getAudioOutput = &ClapProcessContext_getAudioOutput;
-
-    translator.process   = process;
-    translator.eventIdx  = 0;
-    translator.numEvents = process->in_events->size(process->in_events);
-
+    translator.cplugContext.parallelFor    = &ClapProcessContext_parallelFor;
+
+    // Ports require a common sample size, so the first port tells us the sample size of all ports
+    if (process->audio_outputs_count > 0)
+        translator.cplugContext.isDoublePrecision = process->audio_outputs[0].data64 != NULL;
+    else if (process->audio_inputs_count > 0)
+        translator.cplugContext.isDoublePrecision = process->audio_inputs[0].data64 != NULL;
+    translator.cplugContext.getAudioInput64  = &ClapProcessContext_getAudioInput64;
+    translator.cplugContext.getAudioOutput64 = &ClapProcessContext_getAudioOutput64;
+    translator.cplugContext.isInPlace        = &ClapProcessContext_isInPlace;
+    translator.cplugContext.getInputSilence  = &ClapProcessContext_getInputSilence;
+    translator.cplugContext.getInputConstant = &ClapProcessContext_getInputConstant;
+    translator.cplugContext.setOutputSilence = &ClapProcessContext_setOutputSilence;
+
+    translator.clap          = clap;
+    translator.process       = process;
+    translator.eventIdx      = 0;
+    translator.numEvents     = process->in_events->size(process->in_events);
+    translator.eventQuantize = clap->eventQuantize > 0 ? clap->eventQuantize : 1;
+    translator.cellEndIdx    = 0;
+
+    translator.cplugContext.inPlaceBusses = ClapProcessContext_getInPlaceBusses(&translator.cplugContext);
+
+    // Outputs aren't constant unless the plugin says so
+    for (uint32_t i = 0; i < process->audio_outputs_count; i++)
+        process->audio_outputs[i].constant_mask = 0;
+
+#if ! CPLUG_WANT_DENORMALS
+    uint64_t floatMode = cplug_disableDenormals();
+#endif
     cplug_process(clap->userPlugin, &translator.cplugContext);
+#if ! CPLUG_WANT_DENORMALS
+    cplug_restoreDenormals(floatMode);
+#endif
 
     return CLAP_PROCESS_CONTINUE;
 }
@@ -664,6 +1149,10 @@ static const void* CLAPPlugin_get_extension(const struct clap_plugin* plugin, co
 #endif
     if (! strcmp(id, CLAP_EXT_STATE))
         return &s_clap_state;
+    if (! strcmp(id, CLAP_EXT_RENDER))
+        return &s_clap_render;
+    if (! strcmp(id, CLAP_EXT_THREAD_POOL))
+        return &s_clap_thread_pool;
 #if CPLUG_NUM_PARAMS
     if (! strcmp(id, CLAP_EXT_PARAMS))
         return &s_clap_params;
@@ -750,12 +1239,29 @@ static bool CLAPEntry_init(const char* plugin_path)
 {
     cplug_log("CLAPEntry_init => %s", plugin_path);
     cplug_libraryLoad();
+#if CPLUG_WANT_SPARSE_PARAMETER_IDS && CPLUG_NUM_PARAMS
+    if (! cplug_paramIdMap_build(&g_clapParamIds))
+    {
+        cplug_log("CLAPEntry_init => Parameter IDs must be unique and below 0x80000000");
+        cplug_libraryUnload();
+        return false;
+    }
+#endif
+#if CPLUG_WANT_THREAD_POOL
+    cplug_threadPool_acquire();
+#endif
+#if CPLUG_NUM_PARAMS && defined(CPLUG_PARAMETER_DESCRIPTORS)
+    CLAPExtParams_buildInfos();
+#endif
     return true;
 }
 
 static void CLAPEntry_deinit(void)
 {
     cplug_log("CLAPEntry_deinit");
+#if CPLUG_WANT_THREAD_POOL
+    cplug_threadPool_release();
+#endif
     cplug_libraryUnload();
 }
 
@@ -0,0 +1,839 @@
+/* Released into the public domain by Tré Dudman - 2024
+ * For licensing and more info see https://github.com/Tremus/CPLUG */
+
+#include <cplug_dsp.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPLUG_DSP_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && ! (__clang__)
+#include <intrin.h>
+// MSVC lets any function use any instruction set
+#define CPLUG_DSP_TARGET_AVX2
+#define CPLUG_DSP_TARGET_AVX512
+#else
+#define CPLUG_DSP_TARGET_AVX2 __attribute__((target("avx2")))
+#define CPLUG_DSP_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CPLUG_DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+// sin(2pi * x) for x in [-0.25, 0.25] as x * P(x^2). Least squares fit, max error ~2e-7
+#define CPLUG_DSP_SIN_C0 6.283185274e+00f
+#define CPLUG_DSP_SIN_C1 -4.134167741e+01f
+#define CPLUG_DSP_SIN_C2 8.160222628e+01f
+#define CPLUG_DSP_SIN_C3 -7.657487012e+01f
+#define CPLUG_DSP_SIN_C4 3.970996893e+01f
+
+/*----------------------------------------------------------------------------------------------------------------------
+Scalar. The reference the other variants are tested against, and the fallback for other CPUs */
+
+static void cplug_dsp_clear_scalar(float* dst, uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; i++)
+        dst[i] = 0.0f;
+}
+
+static void cplug_dsp_copy_scalar(float* dst, const float* src, uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; i++)
+        dst[i] = src[i];
+}
+
+static void cplug_dsp_gain_scalar(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; i++)
+        dst[i] = src[i] * gain;
+}
+
+static void cplug_dsp_gainRamp_scalar(float* dst, const float* src, float startGain, float endGain, uint32_t numSamples)
+{
+    float step = numSamples ? (endGain - startGain) / (float)numSamples : 0.0f;
+    for (uint32_t i = 0; i < numSamples; i++)
+        dst[i] = src[i] * (startGain + step * (float)i);
+}
+
+static void cplug_dsp_mix_scalar(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; i++)
+        dst[i] += src[i] * gain;
+}
+
+static void cplug_dsp_pan_scalar(
+    float*       left,
+    float*       right,
+    const float* src,
+    float        leftGain,
+    float        rightGain,
+    uint32_t     numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; i++)
+    {
+        left[i]  = src[i] * leftGain;
+        right[i] = src[i] * rightGain;
+    }
+}
+
+static void cplug_dsp_interleave2_scalar(float* dst, const float* left, const float* right, uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; i++)
+    {
+        dst[2 * i]     = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+static void cplug_dsp_deinterleave2_scalar(float* left, float* right, const float* src, uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; i++)
+    {
+        left[i]  = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+static inline float cplug_dsp_sinCycles(float phase)
+{
+    // Wrap to [-0.5, 0.5), then fold into [-0.25, 0.25] using sin(pi - x) == sin(x)
+    float x = phase - (float)(int)(phase + 0.5f);
+    if (x > 0.25f)
+        x = 0.5f - x;
+    else if (x < -0.25f)
+        x = -0.5f - x;
+    float x2 = x * x;
+    float p  = CPLUG_DSP_SIN_C4;
+    p        = p * x2 + CPLUG_DSP_SIN_C3;
+    p        = p * x2 + CPLUG_DSP_SIN_C2;
+    p        = p * x2 + CPLUG_DSP_SIN_C1;
+    p        = p * x2 + CPLUG_DSP_SIN_C0;
+    return p * x;
+}
+
+static float cplug_dsp_sine_scalar(float* dst, float phase, float phaseInc, float gain, uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; i++)
+    {
+        dst[i]  = cplug_dsp_sinCycles(phase) * gain;
+        phase  += phaseInc;
+        phase  -= (float)(int)phase;
+    }
+    return phase;
+}
+
+// Phases of the next 'width' samples, and how far each one moves per vector
+static float cplug_dsp_sinePhases(float* phases, float phase, float phaseInc, uint32_t width)
+{
+    for (uint32_t i = 0; i < width; i++)
+    {
+        phases[i]  = phase;
+        phase     += phaseInc;
+        phase     -= (float)(int)phase;
+    }
+    float step = phaseInc * (float)width;
+    return step - (float)(int)step;
+}
+
+#ifdef CPLUG_DSP_X86
+/*----------------------------------------------------------------------------------------------------------------------
+SSE2. Always available on x86_64. Clear & copy use libc, which is already vectorised & tuned for each CPU */
+
+static void cplug_dsp_clear_libc(float* dst, uint32_t numSamples) { memset(dst, 0, sizeof(float) * numSamples); }
+
+static void cplug_dsp_copy_libc(float* dst, const float* src, uint32_t numSamples)
+{
+    memcpy(dst, src, sizeof(float) * numSamples);
+}
+
+static void cplug_dsp_gain_sse2(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    __m128   g = _mm_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+    cplug_dsp_gain_scalar(dst + i, src + i, gain, numSamples - i);
+}
+
+static void cplug_dsp_gainRamp_sse2(float* dst, const float* src, float startGain, float endGain, uint32_t numSamples)
+{
+    float    step  = numSamples ? (endGain - startGain) / (float)numSamples : 0.0f;
+    __m128   start = _mm_set1_ps(startGain);
+    __m128   steps = _mm_set1_ps(step);
+    __m128   idx   = _mm_setr_ps(0, 1, 2, 3);
+    __m128   four  = _mm_set1_ps(4);
+    uint32_t i     = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128 g = _mm_add_ps(start, _mm_mul_ps(steps, idx));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+        idx = _mm_add_ps(idx, four);
+    }
+    for (; i < numSamples; i++)
+        dst[i] = src[i] * (startGain + step * (float)i);
+}
+
+static void cplug_dsp_mix_sse2(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    __m128   g = _mm_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    cplug_dsp_mix_scalar(dst + i, src + i, gain, numSamples - i);
+}
+
+static void cplug_dsp_pan_sse2(
+    float*       left,
+    float*       right,
+    const float* src,
+    float        leftGain,
+    float        rightGain,
+    uint32_t     numSamples)
+{
+    __m128   gl = _mm_set1_ps(leftGain);
+    __m128   gr = _mm_set1_ps(rightGain);
+    uint32_t i  = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(left + i, _mm_mul_ps(v, gl));
+        _mm_storeu_ps(right + i, _mm_mul_ps(v, gr));
+    }
+    cplug_dsp_pan_scalar(left + i, right + i, src + i, leftGain, rightGain, numSamples - i);
+}
+
+static void cplug_dsp_interleave2_sse2(float* dst, const float* left, const float* right, uint32_t numSamples)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+    cplug_dsp_interleave2_scalar(dst + 2 * i, left + i, right + i, numSamples - i);
+}
+
+static void cplug_dsp_deinterleave2_sse2(float* left, float* right, const float* src, uint32_t numSamples)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(src + 2 * i);
+        __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    cplug_dsp_deinterleave2_scalar(left + i, right + i, src + 2 * i, numSamples - i);
+}
+
+// Phase must be >= 0, so truncation floors
+static __m128 cplug_dsp_wrap_sse2(__m128 phase)
+{
+    return _mm_sub_ps(phase, _mm_cvtepi32_ps(_mm_cvttps_epi32(phase)));
+}
+
+static float cplug_dsp_sine_sse2(float* dst, float phase, float phaseInc, float gain, uint32_t numSamples)
+{
+    if (numSamples < 4)
+        return cplug_dsp_sine_scalar(dst, phase, phaseInc, gain, numSamples);
+
+    float phases[4];
+    float step = cplug_dsp_sinePhases(phases, phase, phaseInc, 4);
+
+    __m128   p       = _mm_loadu_ps(phases);
+    __m128   steps   = _mm_set1_ps(step);
+    __m128   g       = _mm_set1_ps(gain);
+    __m128   half    = _mm_set1_ps(0.5f);
+    __m128   quarter = _mm_set1_ps(0.25f);
+    __m128   sign    = _mm_set1_ps(-0.0f);
+    uint32_t i       = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128 x    = _mm_sub_ps(p, _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(p, half))));
+        __m128 fold = _mm_sub_ps(_mm_or_ps(half, _mm_and_ps(x, sign)), x);
+        __m128 mask = _mm_cmpgt_ps(_mm_andnot_ps(sign, x), quarter);
+        x           = _mm_or_ps(_mm_and_ps(mask, fold), _mm_andnot_ps(mask, x));
+
+        __m128 x2 = _mm_mul_ps(x, x);
+        __m128 s  = _mm_set1_ps(CPLUG_DSP_SIN_C4);
+        s         = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(CPLUG_DSP_SIN_C3));
+        s         = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(CPLUG_DSP_SIN_C2));
+        s         = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(CPLUG_DSP_SIN_C1));
+        s         = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(CPLUG_DSP_SIN_C0));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_mul_ps(s, x), g));
+
+        p = cplug_dsp_wrap_sse2(_mm_add_ps(p, steps));
+    }
+    return cplug_dsp_sine_scalar(dst + i, _mm_cvtss_f32(p), phaseInc, gain, numSamples - i);
+}
+
+/*----------------------------------------------------------------------------------------------------------------------
+AVX2 */
+
+CPLUG_DSP_TARGET_AVX2 static void cplug_dsp_gain_avx2(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    __m256   g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+    cplug_dsp_gain_scalar(dst + i, src + i, gain, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX2 static void
+cplug_dsp_gainRamp_avx2(float* dst, const float* src, float startGain, float endGain, uint32_t numSamples)
+{
+    float    step  = numSamples ? (endGain - startGain) / (float)numSamples : 0.0f;
+    __m256   start = _mm256_set1_ps(startGain);
+    __m256   steps = _mm256_set1_ps(step);
+    __m256   idx   = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256   eight = _mm256_set1_ps(8);
+    uint32_t i     = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256 g = _mm256_add_ps(start, _mm256_mul_ps(steps, idx));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+        idx = _mm256_add_ps(idx, eight);
+    }
+    for (; i < numSamples; i++)
+        dst[i] = src[i] * (startGain + step * (float)i);
+}
+
+CPLUG_DSP_TARGET_AVX2 static void cplug_dsp_mix_avx2(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    __m256   g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+    cplug_dsp_mix_scalar(dst + i, src + i, gain, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX2 static void cplug_dsp_pan_avx2(
+    float*       left,
+    float*       right,
+    const float* src,
+    float        leftGain,
+    float        rightGain,
+    uint32_t     numSamples)
+{
+    __m256   gl = _mm256_set1_ps(leftGain);
+    __m256   gr = _mm256_set1_ps(rightGain);
+    uint32_t i  = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(src + i);
+        _mm256_storeu_ps(left + i, _mm256_mul_ps(v, gl));
+        _mm256_storeu_ps(right + i, _mm256_mul_ps(v, gr));
+    }
+    cplug_dsp_pan_scalar(left + i, right + i, src + i, leftGain, rightGain, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX2 static void
+cplug_dsp_interleave2_avx2(float* dst, const float* left, const float* right, uint32_t numSamples)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256 l = _mm256_loadu_ps(left + i);
+        __m256 r = _mm256_loadu_ps(right + i);
+        // Unpacking works within 128 bit lanes: lo = L0 R0 L1 R1 | L4 R4 L5 R5, hi = L2 R2 L3 R3 | L6 R6 L7 R7
+        __m256 lo = _mm256_unpacklo_ps(l, r);
+        __m256 hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    cplug_dsp_interleave2_scalar(dst + 2 * i, left + i, right + i, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX2 static void
+cplug_dsp_deinterleave2_avx2(float* left, float* right, const float* src, uint32_t numSamples)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256 a = _mm256_loadu_ps(src + 2 * i);
+        __m256 b = _mm256_loadu_ps(src + 2 * i + 8);
+        // Shuffling works within 128 bit lanes, giving L0 L1 L4 L5 | L2 L3 L6 L7. Then reorder the 64 bit pairs
+        __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm256_storeu_ps(left + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), 0xd8)));
+        _mm256_storeu_ps(right + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), 0xd8)));
+    }
+    cplug_dsp_deinterleave2_scalar(left + i, right + i, src + 2 * i, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX2 static float
+cplug_dsp_sine_avx2(float* dst, float phase, float phaseInc, float gain, uint32_t numSamples)
+{
+    if (numSamples < 8)
+        return cplug_dsp_sine_scalar(dst, phase, phaseInc, gain, numSamples);
+
+    float phases[8];
+    float step = cplug_dsp_sinePhases(phases, phase, phaseInc, 8);
+
+    __m256   p       = _mm256_loadu_ps(phases);
+    __m256   steps   = _mm256_set1_ps(step);
+    __m256   g       = _mm256_set1_ps(gain);
+    __m256   half    = _mm256_set1_ps(0.5f);
+    __m256   quarter = _mm256_set1_ps(0.25f);
+    __m256   sign    = _mm256_set1_ps(-0.0f);
+    uint32_t i       = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256 x    = _mm256_sub_ps(p, _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_add_ps(p, half))));
+        __m256 fold = _mm256_sub_ps(_mm256_or_ps(half, _mm256_and_ps(x, sign)), x);
+        __m256 mask = _mm256_cmp_ps(_mm256_andnot_ps(sign, x), quarter, _CMP_GT_OQ);
+        x           = _mm256_blendv_ps(x, fold, mask);
+
+        __m256 x2 = _mm256_mul_ps(x, x);
+        __m256 s  = _mm256_set1_ps(CPLUG_DSP_SIN_C4);
+        s         = _mm256_add_ps(_mm256_mul_ps(s, x2), _mm256_set1_ps(CPLUG_DSP_SIN_C3));
+        s         = _mm256_add_ps(_mm256_mul_ps(s, x2), _mm256_set1_ps(CPLUG_DSP_SIN_C2));
+        s         = _mm256_add_ps(_mm256_mul_ps(s, x2), _mm256_set1_ps(CPLUG_DSP_SIN_C1));
+        s         = _mm256_add_ps(_mm256_mul_ps(s, x2), _mm256_set1_ps(CPLUG_DSP_SIN_C0));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_mul_ps(s, x), g));
+
+        p = _mm256_add_ps(p, steps);
+        p = _mm256_sub_ps(p, _mm256_cvtepi32_ps(_mm256_cvttps_epi32(p)));
+    }
+    // The tail stays in this function. Calling the SSE encoded scalar kernel here costs more than the whole block
+    // on some CPUs, as GCC may leave the upper halves of the registers dirty across the call
+    phase = _mm256_cvtss_f32(p);
+    for (; i < numSamples; i++)
+    {
+        dst[i]  = cplug_dsp_sinCycles(phase) * gain;
+        phase  += phaseInc;
+        phase  -= (float)(int)phase;
+    }
+    return phase;
+}
+
+/*----------------------------------------------------------------------------------------------------------------------
+AVX-512 (F only, so it runs on every AVX-512 CPU) */
+
+CPLUG_DSP_TARGET_AVX512 static void
+cplug_dsp_gain_avx512(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    __m512   g = _mm512_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_loadu_ps(src + i), g));
+    cplug_dsp_gain_scalar(dst + i, src + i, gain, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX512 static void
+cplug_dsp_gainRamp_avx512(float* dst, const float* src, float startGain, float endGain, uint32_t numSamples)
+{
+    float    step    = numSamples ? (endGain - startGain) / (float)numSamples : 0.0f;
+    __m512   start   = _mm512_set1_ps(startGain);
+    __m512   steps   = _mm512_set1_ps(step);
+    __m512   idx     = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512   sixteen = _mm512_set1_ps(16);
+    uint32_t i       = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m512 g = _mm512_add_ps(start, _mm512_mul_ps(steps, idx));
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_loadu_ps(src + i), g));
+        idx = _mm512_add_ps(idx, sixteen);
+    }
+    for (; i < numSamples; i++)
+        dst[i] = src[i] * (startGain + step * (float)i);
+}
+
+CPLUG_DSP_TARGET_AVX512 static void
+cplug_dsp_mix_avx512(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    __m512   g = _mm512_set1_ps(gain);
+    uint32_t i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i), _mm512_mul_ps(_mm512_loadu_ps(src + i), g)));
+    cplug_dsp_mix_scalar(dst + i, src + i, gain, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX512 static void cplug_dsp_pan_avx512(
+    float*       left,
+    float*       right,
+    const float* src,
+    float        leftGain,
+    float        rightGain,
+    uint32_t     numSamples)
+{
+    __m512   gl = _mm512_set1_ps(leftGain);
+    __m512   gr = _mm512_set1_ps(rightGain);
+    uint32_t i  = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m512 v = _mm512_loadu_ps(src + i);
+        _mm512_storeu_ps(left + i, _mm512_mul_ps(v, gl));
+        _mm512_storeu_ps(right + i, _mm512_mul_ps(v, gr));
+    }
+    cplug_dsp_pan_scalar(left + i, right + i, src + i, leftGain, rightGain, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX512 static void
+cplug_dsp_interleave2_avx512(float* dst, const float* left, const float* right, uint32_t numSamples)
+{
+    // Indexes into the pair (left, right), where right starts at 16
+    __m512i  idxLo = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+    __m512i  idxHi = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+    uint32_t i     = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m512 l = _mm512_loadu_ps(left + i);
+        __m512 r = _mm512_loadu_ps(right + i);
+        _mm512_storeu_ps(dst + 2 * i, _mm512_permutex2var_ps(l, idxLo, r));
+        _mm512_storeu_ps(dst + 2 * i + 16, _mm512_permutex2var_ps(l, idxHi, r));
+    }
+    cplug_dsp_interleave2_scalar(dst + 2 * i, left + i, right + i, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX512 static void
+cplug_dsp_deinterleave2_avx512(float* left, float* right, const float* src, uint32_t numSamples)
+{
+    __m512i  idxL = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    __m512i  idxR = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    uint32_t i    = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m512 a = _mm512_loadu_ps(src + 2 * i);
+        __m512 b = _mm512_loadu_ps(src + 2 * i + 16);
+        _mm512_storeu_ps(left + i, _mm512_permutex2var_ps(a, idxL, b));
+        _mm512_storeu_ps(right + i, _mm512_permutex2var_ps(a, idxR, b));
+    }
+    cplug_dsp_deinterleave2_scalar(left + i, right + i, src + 2 * i, numSamples - i);
+}
+
+CPLUG_DSP_TARGET_AVX512 static float
+cplug_dsp_sine_avx512(float* dst, float phase, float phaseInc, float gain, uint32_t numSamples)
+{
+    if (numSamples < 16)
+        return cplug_dsp_sine_scalar(dst, phase, phaseInc, gain, numSamples);
+
+    float phases[16];
+    float step = cplug_dsp_sinePhases(phases, phase, phaseInc, 16);
+
+    __m512   p       = _mm512_loadu_ps(phases);
+    __m512   steps   = _mm512_set1_ps(step);
+    __m512   g       = _mm512_set1_ps(gain);
+    __m512   half    = _mm512_set1_ps(0.5f);
+    __m512   quarter = _mm512_set1_ps(0.25f);
+    __m512i  sign    = _mm512_set1_epi32((int)0x80000000);
+    uint32_t i       = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        // AVX-512F has no float bitwise ops, so the sign tricks are done on integers
+        __m512    x        = _mm512_sub_ps(p, _mm512_cvtepi32_ps(_mm512_cvttps_epi32(_mm512_add_ps(p, half))));
+        __m512i   xi       = _mm512_castps_si512(x);
+        __m512i   halfSign = _mm512_or_si512(_mm512_castps_si512(half), _mm512_and_si512(xi, sign));
+        __m512    fold     = _mm512_sub_ps(_mm512_castsi512_ps(halfSign), x);
+        __m512    absX     = _mm512_castsi512_ps(_mm512_andnot_si512(sign, xi));
+        __mmask16 mask     = _mm512_cmp_ps_mask(absX, quarter, _CMP_GT_OQ);
+        x                  = _mm512_mask_blend_ps(mask, x, fold);
+
+        __m512 x2 = _mm512_mul_ps(x, x);
+        __m512 s  = _mm512_set1_ps(CPLUG_DSP_SIN_C4);
+        s         = _mm512_add_ps(_mm512_mul_ps(s, x2), _mm512_set1_ps(CPLUG_DSP_SIN_C3));
+        s         = _mm512_add_ps(_mm512_mul_ps(s, x2), _mm512_set1_ps(CPLUG_DSP_SIN_C2));
+        s         = _mm512_add_ps(_mm512_mul_ps(s, x2), _mm512_set1_ps(CPLUG_DSP_SIN_C1));
+        s         = _mm512_add_ps(_mm512_mul_ps(s, x2), _mm512_set1_ps(CPLUG_DSP_SIN_C0));
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_mul_ps(s, x), g));
+
+        p = _mm512_add_ps(p, steps);
+        p = _mm512_sub_ps(p, _mm512_cvtepi32_ps(_mm512_cvttps_epi32(p)));
+    }
+    // The tail stays in this function. Calling the SSE encoded scalar kernel here costs more than the whole block
+    // on some CPUs, as GCC may leave the upper halves of the registers dirty across the call
+    phase = _mm512_cvtss_f32(p);
+    for (; i < numSamples; i++)
+    {
+        dst[i]  = cplug_dsp_sinCycles(phase) * gain;
+        phase  += phaseInc;
+        phase  -= (float)(int)phase;
+    }
+    return phase;
+}
+
+static CplugDSPLevel cplug_dsp_detectLevel()
+{
+#if defined(_MSC_VER) && ! (__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return CPLUG_DSP_SSE2;
+    __cpuidex(info, 1, 0);
+    bool hasAVX = (info[2] & (1 << 28)) != 0;
+    // The OS must also save the wider registers on context switches
+    unsigned long long xcr0 = (info[2] & (1 << 27)) ? _xgetbv(0) : 0;
+    __cpuidex(info, 7, 0);
+    bool hasAVX2    = (info[1] & (1 << 5)) != 0;
+    bool hasAVX512F = (info[1] & (1 << 16)) != 0;
+    if (hasAVX512F && (xcr0 & 0xe6) == 0xe6)
+        return CPLUG_DSP_AVX512;
+    if (hasAVX && hasAVX2 && (xcr0 & 0x6) == 0x6)
+        return CPLUG_DSP_AVX2;
+    return CPLUG_DSP_SSE2;
+#else
+    // These also check the OS saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return CPLUG_DSP_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return CPLUG_DSP_AVX2;
+    return CPLUG_DSP_SSE2;
+#endif
+}
+#endif // CPLUG_DSP_X86
+
+#ifdef CPLUG_DSP_NEON
+/*----------------------------------------------------------------------------------------------------------------------
+NEON. Always available on AArch64. Clear & copy use libc, which is already vectorised */
+
+static void cplug_dsp_clear_libc(float* dst, uint32_t numSamples) { memset(dst, 0, sizeof(float) * numSamples); }
+
+static void cplug_dsp_copy_libc(float* dst, const float* src, uint32_t numSamples)
+{
+    memcpy(dst, src, sizeof(float) * numSamples);
+}
+
+static void cplug_dsp_gain_neon(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+        vst1q_f32(dst + i, vmulq_n_f32(vld1q_f32(src + i), gain));
+    cplug_dsp_gain_scalar(dst + i, src + i, gain, numSamples - i);
+}
+
+static void cplug_dsp_gainRamp_neon(float* dst, const float* src, float startGain, float endGain, uint32_t numSamples)
+{
+    static const float idxInit[4] = {0, 1, 2, 3};
+
+    float       step  = numSamples ? (endGain - startGain) / (float)numSamples : 0.0f;
+    float32x4_t start = vdupq_n_f32(startGain);
+    float32x4_t idx   = vld1q_f32(idxInit);
+    uint32_t    i     = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        float32x4_t g = vaddq_f32(start, vmulq_n_f32(idx, step));
+        vst1q_f32(dst + i, vmulq_f32(vld1q_f32(src + i), g));
+        idx = vaddq_f32(idx, vdupq_n_f32(4));
+    }
+    for (; i < numSamples; i++)
+        dst[i] = src[i] * (startGain + step * (float)i);
+}
+
+static void cplug_dsp_mix_neon(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_n_f32(vld1q_f32(src + i), gain)));
+    cplug_dsp_mix_scalar(dst + i, src + i, gain, numSamples - i);
+}
+
+static void cplug_dsp_pan_neon(
+    float*       left,
+    float*       right,
+    const float* src,
+    float        leftGain,
+    float        rightGain,
+    uint32_t     numSamples)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        float32x4_t v = vld1q_f32(src + i);
+        vst1q_f32(left + i, vmulq_n_f32(v, leftGain));
+        vst1q_f32(right + i, vmulq_n_f32(v, rightGain));
+    }
+    cplug_dsp_pan_scalar(left + i, right + i, src + i, leftGain, rightGain, numSamples - i);
+}
+
+static void cplug_dsp_interleave2_neon(float* dst, const float* left, const float* right, uint32_t numSamples)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        float32x4x2_t lr = {{vld1q_f32(left + i), vld1q_f32(right + i)}};
+        vst2q_f32(dst + 2 * i, lr);
+    }
+    cplug_dsp_interleave2_scalar(dst + 2 * i, left + i, right + i, numSamples - i);
+}
+
+static void cplug_dsp_deinterleave2_neon(float* left, float* right, const float* src, uint32_t numSamples)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        float32x4x2_t lr = vld2q_f32(src + 2 * i);
+        vst1q_f32(left + i, lr.val[0]);
+        vst1q_f32(right + i, lr.val[1]);
+    }
+    cplug_dsp_deinterleave2_scalar(left + i, right + i, src + 2 * i, numSamples - i);
+}
+
+static float cplug_dsp_sine_neon(float* dst, float phase, float phaseInc, float gain, uint32_t numSamples)
+{
+    if (numSamples < 4)
+        return cplug_dsp_sine_scalar(dst, phase, phaseInc, gain, numSamples);
+
+    float phases[4];
+    float step = cplug_dsp_sinePhases(phases, phase, phaseInc, 4);
+
+    float32x4_t p       = vld1q_f32(phases);
+    float32x4_t half    = vdupq_n_f32(0.5f);
+    float32x4_t quarter = vdupq_n_f32(0.25f);
+    uint32_t    i       = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        float32x4_t x    = vsubq_f32(p, vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(p, half))));
+        float32x4_t fold = vsubq_f32(vbslq_f32(vdupq_n_u32(0x80000000), x, half), x);
+        x                = vbslq_f32(vcagtq_f32(x, quarter), fold, x);
+
+        float32x4_t x2 = vmulq_f32(x, x);
+        float32x4_t s  = vdupq_n_f32(CPLUG_DSP_SIN_C4);
+        s              = vaddq_f32(vmulq_f32(s, x2), vdupq_n_f32(CPLUG_DSP_SIN_C3));
+        s              = vaddq_f32(vmulq_f32(s, x2), vdupq_n_f32(CPLUG_DSP_SIN_C2));
+        s              = vaddq_f32(vmulq_f32(s, x2), vdupq_n_f32(CPLUG_DSP_SIN_C1));
+        s              = vaddq_f32(vmulq_f32(s, x2), vdupq_n_f32(CPLUG_DSP_SIN_C0));
+        vst1q_f32(dst + i, vmulq_n_f32(vmulq_f32(s, x), gain));
+
+        p = vaddq_f32(p, vdupq_n_f32(step));
+        p = vsubq_f32(p, vcvtq_f32_s32(vcvtq_s32_f32(p)));
+    }
+    return cplug_dsp_sine_scalar(dst + i, vgetq_lane_f32(p, 0), phaseInc, gain, numSamples - i);
+}
+#endif // CPLUG_DSP_NEON
+
+/*----------------------------------------------------------------------------------------------------------------------
+Dispatch */
+
+CplugDSPKernels g_cplugDSP = {
+    cplug_dsp_clear_scalar,
+    cplug_dsp_copy_scalar,
+    cplug_dsp_gain_scalar,
+    cplug_dsp_gainRamp_scalar,
+    cplug_dsp_mix_scalar,
+    cplug_dsp_pan_scalar,
+    cplug_dsp_interleave2_scalar,
+    cplug_dsp_deinterleave2_scalar,
+    cplug_dsp_sine_scalar,
+};
+static CplugDSPLevel g_cplugDSPLevel = CPLUG_DSP_SCALAR;
+
+bool cplug_dsp_getKernels(CplugDSPLevel level, CplugDSPKernels* kernels)
+{
+    switch (level)
+    {
+    case CPLUG_DSP_SCALAR:
+    {
+        CplugDSPKernels scalar = {
+            cplug_dsp_clear_scalar,
+            cplug_dsp_copy_scalar,
+            cplug_dsp_gain_scalar,
+            cplug_dsp_gainRamp_scalar,
+            cplug_dsp_mix_scalar,
+            cplug_dsp_pan_scalar,
+            cplug_dsp_interleave2_scalar,
+            cplug_dsp_deinterleave2_scalar,
+            cplug_dsp_sine_scalar,
+        };
+        *kernels = scalar;
+        return true;
+    }
+#ifdef CPLUG_DSP_X86
+    case CPLUG_DSP_SSE2:
+    {
+        CplugDSPKernels sse2 = {
+            cplug_dsp_clear_libc,
+            cplug_dsp_copy_libc,
+            cplug_dsp_gain_sse2,
+            cplug_dsp_gainRamp_sse2,
+            cplug_dsp_mix_sse2,
+            cplug_dsp_pan_sse2,
+            cplug_dsp_interleave2_sse2,
+            cplug_dsp_deinterleave2_sse2,
+            cplug_dsp_sine_sse2,
+        };
+        *kernels = sse2;
+        return true;
+    }
+    case CPLUG_DSP_AVX2:
+    {
+        if (cplug_dsp_detectLevel() < CPLUG_DSP_AVX2)
+            return false;
+        CplugDSPKernels avx2 = {
+            cplug_dsp_clear_libc,
+            cplug_dsp_copy_libc,
+            cplug_dsp_gain_avx2,
+            cplug_dsp_gainRamp_avx2,
+            cplug_dsp_mix_avx2,
+            cplug_dsp_pan_avx2,
+            cplug_dsp_interleave2_avx2,
+            cplug_dsp_deinterleave2_avx2,
+            cplug_dsp_sine_avx2,
+        };
+        *kernels = avx2;
+        return true;
+    }
+    case CPLUG_DSP_AVX512:
+    {
+        if (cplug_dsp_detectLevel() < CPLUG_DSP_AVX512)
+            return false;
+        CplugDSPKernels avx512 = {
+            cplug_dsp_clear_libc,
+            cplug_dsp_copy_libc,
+            cplug_dsp_gain_avx512,
+            cplug_dsp_gainRamp_avx512,
+            cplug_dsp_mix_avx512,
+            cplug_dsp_pan_avx512,
+            cplug_dsp_interleave2_avx512,
+            cplug_dsp_deinterleave2_avx512,
+            cplug_dsp_sine_avx512,
+        };
+        *kernels = avx512;
+        return true;
+    }
+#endif
+#ifdef CPLUG_DSP_NEON
+    case CPLUG_DSP_NEON:
+    {
+        CplugDSPKernels neon = {
+            cplug_dsp_clear_libc,
+            cplug_dsp_copy_libc,
+            cplug_dsp_gain_neon,
+            cplug_dsp_gainRamp_neon,
+            cplug_dsp_mix_neon,
+            cplug_dsp_pan_neon,
+            cplug_dsp_interleave2_neon,
+            cplug_dsp_deinterleave2_neon,
+            cplug_dsp_sine_neon,
+        };
+        *kernels = neon;
+        return true;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+void cplug_dsp_init()
+{
+    CplugDSPLevel level = CPLUG_DSP_SCALAR;
+#if defined(CPLUG_DSP_X86)
+    level = cplug_dsp_detectLevel();
+#elif defined(CPLUG_DSP_NEON)
+    level = CPLUG_DSP_NEON;
+#endif
+    if (cplug_dsp_getKernels(level, &g_cplugDSP))
+        g_cplugDSPLevel = level;
+}
+
+CplugDSPLevel cplug_dsp_getLevel() { return g_cplugDSPLevel; }
+
+const char* cplug_dsp_getLevelName(CplugDSPLevel level)
+{
+    static const char* names[CPLUG_DSP_NUM_LEVELS] = {"scalar", "SSE2", "AVX2", "AVX-512", "NEON"};
+    return level < CPLUG_DSP_NUM_LEVELS ? names[level] : "[unknown]";
+}
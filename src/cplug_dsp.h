@@ -0,0 +1,105 @@
+/* Optional block DSP kernels: clearing, copying, gain & gain ramps, mixing, panning, stereo (de)interleaving and a sine
+ * oscillator. Add src/cplug_dsp.c to your build and call cplug_dsp_init in cplug_libraryLoad.
+ * The fastest variant the CPU supports (AVX-512, AVX2, SSE2 or NEON) is chosen once, then calls go through a table of
+ * function pointers. Before cplug_dsp_init, and on other CPUs, the scalar reference kernels are used.
+ * Buffers need no particular alignment. Unless stated otherwise, destinations must not overlap sources */
+#ifndef CPLUG_DSP_H
+#define CPLUG_DSP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum CplugDSPLevel
+{
+    CPLUG_DSP_SCALAR,
+    CPLUG_DSP_SSE2,
+    CPLUG_DSP_AVX2,
+    CPLUG_DSP_AVX512,
+    CPLUG_DSP_NEON,
+    CPLUG_DSP_NUM_LEVELS,
+} CplugDSPLevel;
+
+typedef struct CplugDSPKernels
+{
+    void (*clear)(float* dst, uint32_t numSamples);
+    void (*copy)(float* dst, const float* src, uint32_t numSamples);
+    // dst = src * gain. 'dst' may be 'src'
+    void (*gain)(float* dst, const float* src, float gain, uint32_t numSamples);
+    // Gain moves linearly from 'startGain' on the first sample towards 'endGain', which is reached on the sample after
+    // the last, so consecutive blocks join up. 'dst' may be 'src'
+    void (*gainRamp)(float* dst, const float* src, float startGain, float endGain, uint32_t numSamples);
+    // dst += src * gain
+    void (*mix)(float* dst, const float* src, float gain, uint32_t numSamples);
+    // left = src * leftGain, right = src * rightGain
+    void (*pan)(float* left, float* right, const float* src, float leftGain, float rightGain, uint32_t numSamples);
+    // 'dst' holds 2 * numSamples values, LRLR...
+    void (*interleave2)(float* dst, const float* left, const float* right, uint32_t numSamples);
+    void (*deinterleave2)(float* left, float* right, const float* src, uint32_t numSamples);
+    // dst = sin(2pi * phase) * gain, advancing phase by phaseInc every sample. Phase is in cycles, from 0 to 1.
+    // Returns the phase of the next sample. Accurate to ~2e-7, plus rounding from accumulating the phase
+    float (*sine)(float* dst, float phase, float phaseInc, float gain, uint32_t numSamples);
+} CplugDSPKernels;
+
+// Kernels picked by cplug_dsp_init
+extern CplugDSPKernels g_cplugDSP;
+
+// Detects CPU features and picks the fastest kernels. Safe to call more than once
+void          cplug_dsp_init();
+CplugDSPLevel cplug_dsp_getLevel();
+const char*   cplug_dsp_getLevelName(CplugDSPLevel level);
+// For tests & benchmarks. Returns false if the CPU or compiler can't run 'level'
+bool cplug_dsp_getKernels(CplugDSPLevel level, CplugDSPKernels* kernels);
+
+static inline void cplug_dsp_clear(float* dst, uint32_t numSamples) { g_cplugDSP.clear(dst, numSamples); }
+
+static inline void cplug_dsp_copy(float* dst, const float* src, uint32_t numSamples)
+{
+    g_cplugDSP.copy(dst, src, numSamples);
+}
+
+static inline void cplug_dsp_gain(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    g_cplugDSP.gain(dst, src, gain, numSamples);
+}
+
+static inline void
+cplug_dsp_gainRamp(float* dst, const float* src, float startGain, float endGain, uint32_t numSamples)
+{
+    g_cplugDSP.gainRamp(dst, src, startGain, endGain, numSamples);
+}
+
+static inline void cplug_dsp_mix(float* dst, const float* src, float gain, uint32_t numSamples)
+{
+    g_cplugDSP.mix(dst, src, gain, numSamples);
+}
+
+static inline void
+cplug_dsp_pan(float* left, float* right, const float* src, float leftGain, float rightGain, uint32_t numSamples)
+{
+    g_cplugDSP.pan(left, right, src, leftGain, rightGain, numSamples);
+}
+
+static inline void cplug_dsp_interleave2(float* dst, const float* left, const float* right, uint32_t numSamples)
+{
+    g_cplugDSP.interleave2(dst, left, right, numSamples);
+}
+
+static inline void cplug_dsp_deinterleave2(float* left, float* right, const float* src, uint32_t numSamples)
+{
+    g_cplugDSP.deinterleave2(left, right, src, numSamples);
+}
+
+static inline float cplug_dsp_sine(float* dst, float phase, float phaseInc, float gain, uint32_t numSamples)
+{
+    return g_cplugDSP.sine(dst, phase, phaseInc, gain, numSamples);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CPLUG_DSP_H
@@ -0,0 +1,707 @@
+/* Planar <-> interleaved conversion for the standalones' audio devices, which exchange frames of interleaved samples
+ * while plugins process separate channels. Samples can be 32bit float, 16bit, packed 24bit or 32bit integers.
+ * Converting to 16 or 24bit adds TPDF dither when given a CplugDither.
+ * Channels are transposed 4 at a time with SSE2 or NEON. 1 & 2 channels have their own paths. Other counts of 4 or
+ * more are handled as groups of 4, the last overlapping the one before if needed. Integer formats go through a small
+ * float scratch buffer on the stack, then are converted in a contiguous run.
+ * Buffers need no particular alignment. Integers are stored little endian */
+#ifndef CPLUG_INTERLEAVE_H
+#define CPLUG_INTERLEAVE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPLUG_INTERLEAVE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define CPLUG_INTERLEAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Integer formats are converted in chunks of this many samples
+#define CPLUG_INTERLEAVE_SCRATCH_SIZE 1024
+#define CPLUG_INTERLEAVE_MAX_CHANNELS 256
+
+typedef enum CplugSampleFormat
+{
+    CPLUG_SAMPLE_FLOAT32,
+    CPLUG_SAMPLE_INT16,
+    CPLUG_SAMPLE_INT24, // Packed, 3 bytes per sample
+    CPLUG_SAMPLE_INT32,
+} CplugSampleFormat;
+
+// 8 xorshift generators, one per lane of two vectors, so the SIMD & scalar paths produce the same noise. Two vectors
+// keep two independent dependency chains in flight
+typedef struct CplugDither
+{
+    uint32_t state[8];
+} CplugDither;
+
+static inline void cplug_dither_init(CplugDither* dither, uint32_t seed)
+{
+    for (int i = 0; i < 8; i++)
+        dither->state[i] = ((seed + i) * 0x9e3779b9u) | 1;
+}
+
+static inline uint32_t cplug_sampleFormatSize(CplugSampleFormat format)
+{
+    static const uint8_t sizes[] = {4, 2, 3, 4};
+    return sizes[format];
+}
+
+/*----------------------------------------------------------------------------------------------------------------------
+Float transposes */
+
+#if defined(CPLUG_INTERLEAVE_SSE2)
+// 4 frames of 4 channels. Frame k is stored at dst + k * stride
+static inline void cplug_interleave_transpose4(
+    float*       dst,
+    uint32_t     stride,
+    const float* a,
+    const float* b,
+    const float* c,
+    const float* d)
+{
+    __m128 r0 = _mm_loadu_ps(a);
+    __m128 r1 = _mm_loadu_ps(b);
+    __m128 r2 = _mm_loadu_ps(c);
+    __m128 r3 = _mm_loadu_ps(d);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(dst, r0);
+    _mm_storeu_ps(dst + stride, r1);
+    _mm_storeu_ps(dst + 2 * stride, r2);
+    _mm_storeu_ps(dst + 3 * stride, r3);
+}
+
+static inline void
+cplug_deinterleave_transpose4(float* a, float* b, float* c, float* d, const float* src, uint32_t stride)
+{
+    __m128 r0 = _mm_loadu_ps(src);
+    __m128 r1 = _mm_loadu_ps(src + stride);
+    __m128 r2 = _mm_loadu_ps(src + 2 * stride);
+    __m128 r3 = _mm_loadu_ps(src + 3 * stride);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(a, r0);
+    _mm_storeu_ps(b, r1);
+    _mm_storeu_ps(c, r2);
+    _mm_storeu_ps(d, r3);
+}
+
+// 4 frames of 2 channels
+static inline void cplug_interleave_zip2(float* dst, const float* left, const float* right)
+{
+    __m128 l = _mm_loadu_ps(left);
+    __m128 r = _mm_loadu_ps(right);
+    _mm_storeu_ps(dst, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(dst + 4, _mm_unpackhi_ps(l, r));
+}
+
+static inline void cplug_interleave_unzip2(float* left, float* right, const float* src)
+{
+    __m128 a = _mm_loadu_ps(src);
+    __m128 b = _mm_loadu_ps(src + 4);
+    _mm_storeu_ps(left, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+#elif defined(CPLUG_INTERLEAVE_NEON)
+static inline float32x4x4_t
+cplug_interleave_transpose4x4(float32x4_t r0, float32x4_t r1, float32x4_t r2, float32x4_t r3)
+{
+    float32x4x2_t t01 = vtrnq_f32(r0, r1);
+    float32x4x2_t t23 = vtrnq_f32(r2, r3);
+    float32x4x4_t out;
+    out.val[0] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    out.val[1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    out.val[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    out.val[3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    return out;
+}
+
+static inline void cplug_interleave_transpose4(
+    float*       dst,
+    uint32_t     stride,
+    const float* a,
+    const float* b,
+    const float* c,
+    const float* d)
+{
+    float32x4x4_t t = cplug_interleave_transpose4x4(vld1q_f32(a), vld1q_f32(b), vld1q_f32(c), vld1q_f32(d));
+    vst1q_f32(dst, t.val[0]);
+    vst1q_f32(dst + stride, t.val[1]);
+    vst1q_f32(dst + 2 * stride, t.val[2]);
+    vst1q_f32(dst + 3 * stride, t.val[3]);
+}
+
+static inline void
+cplug_deinterleave_transpose4(float* a, float* b, float* c, float* d, const float* src, uint32_t stride)
+{
+    float32x4x4_t t = cplug_interleave_transpose4x4(
+        vld1q_f32(src),
+        vld1q_f32(src + stride),
+        vld1q_f32(src + 2 * stride),
+        vld1q_f32(src + 3 * stride));
+    vst1q_f32(a, t.val[0]);
+    vst1q_f32(b, t.val[1]);
+    vst1q_f32(c, t.val[2]);
+    vst1q_f32(d, t.val[3]);
+}
+
+static inline void cplug_interleave_zip2(float* dst, const float* left, const float* right)
+{
+    float32x4x2_t lr = {{vld1q_f32(left), vld1q_f32(right)}};
+    vst2q_f32(dst, lr);
+}
+
+static inline void cplug_interleave_unzip2(float* left, float* right, const float* src)
+{
+    float32x4x2_t lr = vld2q_f32(src);
+    vst1q_f32(left, lr.val[0]);
+    vst1q_f32(right, lr.val[1]);
+}
+#else
+static inline void cplug_interleave_transpose4(
+    float*       dst,
+    uint32_t     stride,
+    const float* a,
+    const float* b,
+    const float* c,
+    const float* d)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        dst[i * stride]     = a[i];
+        dst[i * stride + 1] = b[i];
+        dst[i * stride + 2] = c[i];
+        dst[i * stride + 3] = d[i];
+    }
+}
+
+static inline void
+cplug_deinterleave_transpose4(float* a, float* b, float* c, float* d, const float* src, uint32_t stride)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        a[i] = src[i * stride];
+        b[i] = src[i * stride + 1];
+        c[i] = src[i * stride + 2];
+        d[i] = src[i * stride + 3];
+    }
+}
+
+static inline void cplug_interleave_zip2(float* dst, const float* left, const float* right)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        dst[2 * i]     = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+static inline void cplug_interleave_unzip2(float* left, float* right, const float* src)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        left[i]  = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+#endif
+
+// Frames 'offset' to 'offset + numFrames' of 'src' are written to the start of 'dst'
+static inline void cplug_interleave_float(
+    float*        dst,
+    float* const* src,
+    uint32_t      offset,
+    uint32_t      numChannels,
+    uint32_t      numFrames)
+{
+    if (numChannels == 1)
+    {
+        memcpy(dst, src[0] + offset, sizeof(float) * numFrames);
+        return;
+    }
+    if (numChannels == 2)
+    {
+        const float* left  = src[0] + offset;
+        const float* right = src[1] + offset;
+        uint32_t     i     = 0;
+        for (; i + 4 <= numFrames; i += 4)
+            cplug_interleave_zip2(dst + 2 * i, left + i, right + i);
+        for (; i < numFrames; i++)
+        {
+            dst[2 * i]     = left[i];
+            dst[2 * i + 1] = right[i];
+        }
+        return;
+    }
+    if (numChannels == 3)
+    {
+        for (uint32_t i = 0; i < numFrames; i++)
+            for (uint32_t ch = 0; ch < 3; ch++)
+                dst[i * 3 + ch] = src[ch][offset + i];
+        return;
+    }
+
+    for (uint32_t ch = 0; ch < numChannels; ch += 4)
+    {
+        // When the count isn't a multiple of 4 the last group overlaps the one before, rewriting the same values
+        uint32_t     group = ch + 4 <= numChannels ? ch : numChannels - 4;
+        const float* a     = src[group] + offset;
+        const float* b     = src[group + 1] + offset;
+        const float* c     = src[group + 2] + offset;
+        const float* d     = src[group + 3] + offset;
+        float*       out   = dst + group;
+        uint32_t     i     = 0;
+        for (; i + 4 <= numFrames; i += 4)
+            cplug_interleave_transpose4(out + i * numChannels, numChannels, a + i, b + i, c + i, d + i);
+        for (; i < numFrames; i++)
+        {
+            out[i * numChannels]     = a[i];
+            out[i * numChannels + 1] = b[i];
+            out[i * numChannels + 2] = c[i];
+            out[i * numChannels + 3] = d[i];
+        }
+    }
+}
+
+// The start of 'src' is written to frames 'offset' to 'offset + numFrames' of 'dst'
+static inline void cplug_deinterleave_float(
+    float* const* dst,
+    uint32_t      offset,
+    const float*  src,
+    uint32_t      numChannels,
+    uint32_t      numFrames)
+{
+    if (numChannels == 1)
+    {
+        memcpy(dst[0] + offset, src, sizeof(float) * numFrames);
+        return;
+    }
+    if (numChannels == 2)
+    {
+        float*   left  = dst[0] + offset;
+        float*   right = dst[1] + offset;
+        uint32_t i     = 0;
+        for (; i + 4 <= numFrames; i += 4)
+            cplug_interleave_unzip2(left + i, right + i, src + 2 * i);
+        for (; i < numFrames; i++)
+        {
+            left[i]  = src[2 * i];
+            right[i] = src[2 * i + 1];
+        }
+        return;
+    }
+    if (numChannels == 3)
+    {
+        for (uint32_t i = 0; i < numFrames; i++)
+            for (uint32_t ch = 0; ch < 3; ch++)
+                dst[ch][offset + i] = src[i * 3 + ch];
+        return;
+    }
+
+    for (uint32_t ch = 0; ch < numChannels; ch += 4)
+    {
+        uint32_t     group = ch + 4 <= numChannels ? ch : numChannels - 4;
+        float*       a     = dst[group] + offset;
+        float*       b     = dst[group + 1] + offset;
+        float*       c     = dst[group + 2] + offset;
+        float*       d     = dst[group + 3] + offset;
+        const float* in    = src + group;
+        uint32_t     i     = 0;
+        for (; i + 4 <= numFrames; i += 4)
+            cplug_deinterleave_transpose4(a + i, b + i, c + i, d + i, in + i * numChannels, numChannels);
+        for (; i < numFrames; i++)
+        {
+            a[i] = in[i * numChannels];
+            b[i] = in[i * numChannels + 1];
+            c[i] = in[i * numChannels + 2];
+            d[i] = in[i * numChannels + 3];
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------------------------------------------------
+Integer conversion of contiguous runs.
+Clamps to the format's range & rounds to nearest even, as the SIMD conversions do by default. Dither is 1 LSB peak
+TPDF, made from the low & high halves of one random number per sample. Samples are taken in groups of 8, each stepping
+every generator once */
+
+static inline void cplug_dither_step(CplugDither* dither, float* noise)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        uint32_t x        = dither->state[i];
+        x                ^= x << 13;
+        x                ^= x >> 17;
+        x                ^= x << 5;
+        dither->state[i]  = x;
+        noise[i]          = (float)((int32_t)(x & 0xffff) - (int32_t)(x >> 16)) * (1.0f / 65536.0f);
+    }
+}
+
+static inline int32_t cplug_interleave_round(float v, float scale, float maxValue, float noise)
+{
+    v = v * scale + noise;
+    v = v < -scale ? -scale : v;
+    v = v > maxValue ? maxValue : v;
+
+    // Exact, as any float that doesn't fit the mantissa is already a whole number
+    int32_t i    = (int32_t)v;
+    float   frac = v - (float)i;
+    if (frac > 0.5f || (frac == 0.5f && (i & 1)))
+        i++;
+    else if (frac < -0.5f || (frac == -0.5f && (i & 1)))
+        i--;
+    return i;
+}
+
+#if defined(CPLUG_INTERLEAVE_SSE2)
+// As cplug_dither_step for 4 generators. The state is passed by value so it stays in a register
+static inline __m128i cplug_dither_step4(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+static inline __m128 cplug_dither_noise4(__m128i x)
+{
+    __m128i lsb = _mm_sub_epi32(_mm_and_si128(x, _mm_set1_epi32(0xffff)), _mm_srli_epi32(x, 16));
+    return _mm_mul_ps(_mm_cvtepi32_ps(lsb), _mm_set1_ps(1.0f / 65536.0f));
+}
+
+// 4 samples to int32, as cplug_interleave_round
+static inline __m128i
+cplug_interleave_round4(const float* src, __m128 scale, __m128 minValue, __m128 maxValue, __m128 noise)
+{
+    __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src), scale), noise);
+    return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, minValue), maxValue));
+}
+
+// Stores the low 3 bytes of each lane, 12 bytes in total
+static inline void cplug_interleave_pack24(uint8_t* dst, __m128i v)
+{
+    // Move each lane down by one byte more than the last, dropping the top bytes
+    __m128i a = _mm_and_si128(v, _mm_setr_epi32(0xffffff, 0, 0, 0));
+    __m128i b = _mm_srli_si128(_mm_and_si128(v, _mm_setr_epi32(0, 0xffffff, 0, 0)), 1);
+    __m128i c = _mm_srli_si128(_mm_and_si128(v, _mm_setr_epi32(0, 0, 0xffffff, 0)), 2);
+    __m128i d = _mm_srli_si128(_mm_and_si128(v, _mm_setr_epi32(0, 0, 0, 0xffffff)), 3);
+    __m128i p = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+    int32_t last = _mm_cvtsi128_si32(_mm_srli_si128(p, 8));
+    _mm_storel_epi64((__m128i*)dst, p);
+    memcpy(dst + 8, &last, sizeof(last));
+}
+#elif defined(CPLUG_INTERLEAVE_NEON)
+static inline uint32x4_t cplug_dither_step4(uint32x4_t x)
+{
+    x = veorq_u32(x, vshlq_n_u32(x, 13));
+    x = veorq_u32(x, vshrq_n_u32(x, 17));
+    return veorq_u32(x, vshlq_n_u32(x, 5));
+}
+
+static inline float32x4_t cplug_dither_noise4(uint32x4_t x)
+{
+    int32x4_t lo = vreinterpretq_s32_u32(vandq_u32(x, vdupq_n_u32(0xffff)));
+    int32x4_t hi = vreinterpretq_s32_u32(vshrq_n_u32(x, 16));
+    return vmulq_n_f32(vcvtq_f32_s32(vsubq_s32(lo, hi)), 1.0f / 65536.0f);
+}
+
+static inline int32x4_t cplug_interleave_round4(
+    const float* src,
+    float32x4_t  scale,
+    float32x4_t  minValue,
+    float32x4_t  maxValue,
+    float32x4_t  noise)
+{
+    float32x4_t v = vaddq_f32(vmulq_f32(vld1q_f32(src), scale), noise);
+    return vcvtnq_s32_f32(vminq_f32(vmaxq_f32(v, minValue), maxValue));
+}
+
+static inline void cplug_interleave_pack24(uint8_t* dst, int32x4_t v)
+{
+    static const uint8_t idx[16] = {0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 0, 0, 0, 0};
+    uint8x16_t           p       = vqtbl1q_u8(vreinterpretq_u8_s32(v), vld1q_u8(idx));
+    vst1_u8(dst, vget_low_u8(p));
+    vst1q_lane_u32((uint32_t*)(dst + 8), vreinterpretq_u32_u8(p), 2);
+}
+#endif
+
+// 'bits' is 16, 24 or 32. 'dither' may be NULL
+static inline void cplug_interleave_toInt(
+    uint8_t*     dst,
+    const float* src,
+    uint32_t     numSamples,
+    uint32_t     bits,
+    CplugDither* dither)
+{
+    // For 32bit the largest float below 2^31, as 2^31 - 1 rounds up out of range
+    float    scale    = bits == 16 ? 32768.0f : bits == 24 ? 8388608.0f : 2147483648.0f;
+    float    maxValue = bits == 16 ? 32767.0f : bits == 24 ? 8388607.0f : 2147483520.0f;
+    uint32_t i        = 0;
+
+#if defined(CPLUG_INTERLEAVE_SSE2)
+    // The dither state lives in registers for the whole run
+    __m128  vScale  = _mm_set1_ps(scale);
+    __m128  vMin    = _mm_set1_ps(-scale);
+    __m128  vMax    = _mm_set1_ps(maxValue);
+    __m128i stateLo = _mm_setzero_si128();
+    __m128i stateHi = _mm_setzero_si128();
+    if (dither != NULL)
+    {
+        stateLo = _mm_loadu_si128((const __m128i*)dither->state);
+        stateHi = _mm_loadu_si128((const __m128i*)(dither->state + 4));
+    }
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m128 noiseLo = _mm_setzero_ps();
+        __m128 noiseHi = _mm_setzero_ps();
+        if (dither != NULL)
+        {
+            stateLo = cplug_dither_step4(stateLo);
+            stateHi = cplug_dither_step4(stateHi);
+            noiseLo = cplug_dither_noise4(stateLo);
+            noiseHi = cplug_dither_noise4(stateHi);
+        }
+        __m128i lo = cplug_interleave_round4(src + i, vScale, vMin, vMax, noiseLo);
+        __m128i hi = cplug_interleave_round4(src + i + 4, vScale, vMin, vMax, noiseHi);
+        if (bits == 16)
+        {
+            _mm_storeu_si128((__m128i*)(dst + 2 * i), _mm_packs_epi32(lo, hi));
+        }
+        else if (bits == 24)
+        {
+            cplug_interleave_pack24(dst + 3 * i, lo);
+            cplug_interleave_pack24(dst + 3 * i + 12, hi);
+        }
+        else
+        {
+            _mm_storeu_si128((__m128i*)(dst + 4 * i), lo);
+            _mm_storeu_si128((__m128i*)(dst + 4 * i + 16), hi);
+        }
+    }
+    if (dither != NULL)
+    {
+        _mm_storeu_si128((__m128i*)dither->state, stateLo);
+        _mm_storeu_si128((__m128i*)(dither->state + 4), stateHi);
+    }
+#elif defined(CPLUG_INTERLEAVE_NEON)
+    float32x4_t vScale  = vdupq_n_f32(scale);
+    float32x4_t vMin    = vdupq_n_f32(-scale);
+    float32x4_t vMax    = vdupq_n_f32(maxValue);
+    uint32x4_t  stateLo = vdupq_n_u32(0);
+    uint32x4_t  stateHi = vdupq_n_u32(0);
+    if (dither != NULL)
+    {
+        stateLo = vld1q_u32(dither->state);
+        stateHi = vld1q_u32(dither->state + 4);
+    }
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        float32x4_t noiseLo = vdupq_n_f32(0);
+        float32x4_t noiseHi = vdupq_n_f32(0);
+        if (dither != NULL)
+        {
+            stateLo = cplug_dither_step4(stateLo);
+            stateHi = cplug_dither_step4(stateHi);
+            noiseLo = cplug_dither_noise4(stateLo);
+            noiseHi = cplug_dither_noise4(stateHi);
+        }
+        int32x4_t lo = cplug_interleave_round4(src + i, vScale, vMin, vMax, noiseLo);
+        int32x4_t hi = cplug_interleave_round4(src + i + 4, vScale, vMin, vMax, noiseHi);
+        if (bits == 16)
+        {
+            vst1q_s16((int16_t*)(dst + 2 * i), vcombine_s16(vmovn_s32(lo), vmovn_s32(hi)));
+        }
+        else if (bits == 24)
+        {
+            cplug_interleave_pack24(dst + 3 * i, lo);
+            cplug_interleave_pack24(dst + 3 * i + 12, hi);
+        }
+        else
+        {
+            vst1q_s32((int32_t*)(dst + 4 * i), lo);
+            vst1q_s32((int32_t*)(dst + 4 * i + 16), hi);
+        }
+    }
+    if (dither != NULL)
+    {
+        vst1q_u32(dither->state, stateLo);
+        vst1q_u32(dither->state + 4, stateHi);
+    }
+#endif
+
+    for (; i < numSamples; i += 8)
+    {
+        float noise[8] = {0};
+        if (dither != NULL)
+            cplug_dither_step(dither, noise);
+        for (uint32_t k = 0; k < 8 && i + k < numSamples; k++)
+        {
+            uint32_t j = i + k;
+            int32_t  v = cplug_interleave_round(src[j], scale, maxValue, noise[k]);
+            if (bits == 16)
+            {
+                int16_t v16 = (int16_t)v;
+                memcpy(dst + 2 * j, &v16, sizeof(v16));
+            }
+            else if (bits == 24)
+            {
+                dst[3 * j]     = (uint8_t)v;
+                dst[3 * j + 1] = (uint8_t)(v >> 8);
+                dst[3 * j + 2] = (uint8_t)(v >> 16);
+            }
+            else
+            {
+                memcpy(dst + 4 * j, &v, sizeof(v));
+            }
+        }
+    }
+}
+
+static inline void cplug_interleave_fromInt(float* dst, const uint8_t* src, uint32_t numSamples, uint32_t bits)
+{
+    uint32_t i = 0;
+#if defined(CPLUG_INTERLEAVE_SSE2)
+    if (bits == 16)
+    {
+        __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            __m128i v  = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+            // Sign extend by placing each sample in the top half of a 32bit lane
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+            _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+    }
+    else if (bits == 32)
+    {
+        __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+        }
+    }
+#elif defined(CPLUG_INTERLEAVE_NEON)
+    if (bits == 16)
+    {
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            int16x8_t v = vld1q_s16((const int16_t*)(src + 2 * i));
+            vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / 32768.0f));
+            vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / 32768.0f));
+        }
+    }
+    else if (bits == 32)
+    {
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            int32x4_t v = vld1q_s32((const int32_t*)(src + 4 * i));
+            vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(v), 1.0f / 2147483648.0f));
+        }
+    }
+#endif
+    for (; i < numSamples; i++)
+    {
+        if (bits == 16)
+        {
+            int16_t v;
+            memcpy(&v, src + 2 * i, sizeof(v));
+            dst[i] = v / 32768.0f;
+        }
+        else if (bits == 24)
+        {
+            uint32_t v = src[3 * i] | (src[3 * i + 1] << 8) | ((uint32_t)src[3 * i + 2] << 16);
+            dst[i]     = (int32_t)(v << 8) / 2147483648.0f;
+        }
+        else
+        {
+            int32_t v;
+            memcpy(&v, src + 4 * i, sizeof(v));
+            dst[i] = v / 2147483648.0f;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------------------------------------------------
+API */
+
+// Writes 'numFrames' frames of 'numChannels' interleaved samples to 'dst'. 'dither' may be NULL, and is only used when
+// converting to 16 or 24bit. 'numChannels' can be at most CPLUG_INTERLEAVE_MAX_CHANNELS
+static inline void cplug_interleave(
+    void*             dst,
+    CplugSampleFormat format,
+    float* const*     src,
+    uint32_t          numChannels,
+    uint32_t          numFrames,
+    CplugDither*      dither)
+{
+    if (numChannels == 0 || numChannels > CPLUG_INTERLEAVE_MAX_CHANNELS)
+        return;
+    if (format == CPLUG_SAMPLE_FLOAT32)
+    {
+        cplug_interleave_float((float*)dst, src, 0, numChannels, numFrames);
+        return;
+    }
+
+    uint32_t bits           = cplug_sampleFormatSize(format) * 8;
+    uint32_t framesPerChunk = CPLUG_INTERLEAVE_SCRATCH_SIZE / numChannels;
+    uint8_t* out            = (uint8_t*)dst;
+    float    scratch[CPLUG_INTERLEAVE_SCRATCH_SIZE];
+    if (bits == 32)
+        dither = NULL;
+
+    for (uint32_t frame = 0; frame < numFrames; frame += framesPerChunk)
+    {
+        uint32_t chunkFrames  = numFrames - frame < framesPerChunk ? numFrames - frame : framesPerChunk;
+        uint32_t chunkSamples = chunkFrames * numChannels;
+        cplug_interleave_float(scratch, src, frame, numChannels, chunkFrames);
+        cplug_interleave_toInt(out, scratch, chunkSamples, bits, dither);
+        out += chunkSamples * (bits / 8);
+    }
+}
+
+// Reads 'numFrames' frames of 'numChannels' interleaved samples into separate channels.
+// 'numChannels' can be at most CPLUG_INTERLEAVE_MAX_CHANNELS
+static inline void cplug_deinterleave(
+    float* const*     dst,
+    const void*       src,
+    CplugSampleFormat format,
+    uint32_t          numChannels,
+    uint32_t          numFrames)
+{
+    if (numChannels == 0 || numChannels > CPLUG_INTERLEAVE_MAX_CHANNELS)
+        return;
+    if (format == CPLUG_SAMPLE_FLOAT32)
+    {
+        cplug_deinterleave_float(dst, 0, (const float*)src, numChannels, numFrames);
+        return;
+    }
+
+    uint32_t       bits           = cplug_sampleFormatSize(format) * 8;
+    uint32_t       framesPerChunk = CPLUG_INTERLEAVE_SCRATCH_SIZE / numChannels;
+    const uint8_t* in             = (const uint8_t*)src;
+    float          scratch[CPLUG_INTERLEAVE_SCRATCH_SIZE];
+
+    for (uint32_t frame = 0; frame < numFrames; frame += framesPerChunk)
+    {
+        uint32_t chunkFrames  = numFrames - frame < framesPerChunk ? numFrames - frame : framesPerChunk;
+        uint32_t chunkSamples = chunkFrames * numChannels;
+        cplug_interleave_fromInt(scratch, in, chunkSamples, bits);
+        cplug_deinterleave_float(dst, frame, scratch, numChannels, chunkFrames);
+        in += chunkSamples * (bits / 8);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CPLUG_INTERLEAVE_H
@@ -0,0 +1,1007 @@
+/* Released into the public domain by Tré Dudman - 2024
+ * For licensing and more info see https://github.com/Tremus/CPLUG */
+
+/* Headless standalone runner for Linux. There is no window, menu or audio device. Instead audio is either discarded
+ * by a timer paced null sink, or written to a WAV file, optionally processing a WAV file as input.
+ * MIDI can be read from a raw MIDI device, eg. /dev/snd/midiC1D0, or a test note can be held.
+ * When built with HOTRELOAD_WATCH_DIR, saving a file in that folder rebuilds & reloads the plugin without stopping the
+ * runner, same as the Windows & macOS standalones.
+ *
+ * Usage: cplug_example_standalone [-r sampleRate] [-b blockSize] [-d seconds] [-i input.wav] [-o output.wav]
+ *                                 [-m midiDevice] [-n testNote] [-f] */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cplug.h>
+#include <cplug_interleave.h>
+#ifdef HOTRELOAD_BUILD_COMMAND
+#include <cplug_state_buffer.h>
+#endif
+#if CPLUG_WANT_THREAD_POOL
+#include <cplug_thread_pool.h>
+#endif
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CPLUG_MIDI_RINGBUFFER_SIZE 128
+#define MAX_BLOCK_SIZE             2048
+
+#define USER_SAMPLE_RATE  48000
+#define USER_BLOCK_SIZE   512
+#define USER_NUM_CHANNELS 2
+
+#ifndef ARRSIZE
+#define ARRSIZE(arr) (sizeof(arr) / sizeof(arr[0]))
+#endif
+
+#define cplug_assert(cond) (cond) ? (void)0 : __builtin_trap()
+
+////////////
+// Plugin //
+////////////
+
+struct STAND_Plugin
+{
+#ifdef HOTRELOAD_LIB_PATH
+    void* library;
+#endif
+    void* userPlugin;
+
+    void (*libraryLoad)();
+    void (*libraryUnload)();
+    void* (*createPlugin)();
+    void (*destroyPlugin)(void* userPlugin);
+    uint32_t (*getOutputBusChannelCount)(void*, uint32_t bus_idx);
+    void (*setSampleRateAndBlockSize)(void*, double sampleRate, uint32_t maxBlockSize);
+    void (*setRenderMode)(void*, uint32_t renderMode);
+    void (*process)(void* userPlugin, CplugProcessContext* ctx);
+    void (*saveState)(void* userPlugin, const void* stateCtx, cplug_writeProc writeProc);
+    void (*loadState)(void* userPlugin, const void* stateCtx, cplug_readProc readProc);
+} g_plugin;
+
+#ifdef HOTRELOAD_BUILD_COMMAND
+CplugStateBuffer g_pluginState;
+#endif // HOTRELOAD_BUILD_COMMAND
+
+//////////
+// MIDI //
+//////////
+
+typedef struct MIDIMessage
+{
+    union
+    {
+        struct
+        {
+            unsigned char status;
+            unsigned char data1;
+            unsigned char data2;
+        };
+        unsigned char bytes[4];
+        unsigned int  bytesAsInt;
+    };
+} MIDIMessage;
+
+typedef struct MidiRingBuffer
+{
+    volatile int writePos;
+    volatile int readPos;
+
+    MIDIMessage buffer[CPLUG_MIDI_RINGBUFFER_SIZE];
+} MidiRingBuffer;
+
+MidiRingBuffer g_midiRingBuffer;
+const char*    g_midiDevicePath = NULL;
+int            g_midiFD         = -1;
+int            g_midiTestNote   = -1;
+pthread_t      g_midiThread;
+
+///////////
+// Audio //
+///////////
+
+// Interleaved 32bit float WAV file
+typedef struct STAND_WavFile
+{
+    FILE*    file;
+    uint32_t sampleRate;
+    uint32_t numChannels;
+    uint64_t numFrames;
+} STAND_WavFile;
+
+// Whole file is decoded to deinterleaved floats up front. Loops when the end is reached
+typedef struct STAND_WavSource
+{
+    float*   channels[USER_NUM_CHANNELS];
+    uint32_t sampleRate;
+    uint64_t numFrames;
+    uint64_t readPos;
+} STAND_WavSource;
+
+double          g_audioSampleRate     = USER_SAMPLE_RATE;
+uint32_t        g_audioBlockSize      = USER_BLOCK_SIZE;
+uint32_t        g_audioNumChannels    = USER_NUM_CHANNELS;
+bool            g_audioOffline        = false; // Render as fast as possible instead of pacing blocks in real time
+double          g_audioDuration       = 0;     // Seconds. 0 runs until interrupted
+uint64_t        g_audioFramesRendered = 0;
+bool            g_audioRunning        = false;
+volatile int    g_audioStopFlag       = 0;
+pthread_t       g_audioThread;
+float           g_audioInput[USER_NUM_CHANNELS][MAX_BLOCK_SIZE] __attribute__((aligned(32)));
+float           g_audioOutput[USER_NUM_CHANNELS][MAX_BLOCK_SIZE] __attribute__((aligned(32)));
+float           g_audioInterleaved[USER_NUM_CHANNELS * MAX_BLOCK_SIZE];
+STAND_WavFile   g_wavSink;
+STAND_WavSource g_wavSource;
+volatile sig_atomic_t g_quitFlag = 0;
+
+///////////
+// Utils //
+///////////
+
+static inline uint64_t STAND_nowNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void STAND_writeU16(uint8_t* dst, uint16_t v)
+{
+    dst[0] = v & 0xff;
+    dst[1] = (v >> 8) & 0xff;
+}
+
+static inline void STAND_writeU32(uint8_t* dst, uint32_t v)
+{
+    STAND_writeU16(dst, v & 0xffff);
+    STAND_writeU16(dst + 2, v >> 16);
+}
+
+static inline uint16_t STAND_readU16(const uint8_t* src) { return src[0] | (src[1] << 8); }
+static inline uint32_t STAND_readU32(const uint8_t* src)
+{
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+//////////////////////////
+// Forward declarations //
+//////////////////////////
+
+// Main thread
+void STAND_openLibraryWithSymbols();
+void STAND_closeLibrary();
+void STAND_audioStart();
+void STAND_audioStop();
+bool STAND_midiConnect(const char* path);
+void STAND_midiDisconnect();
+bool STAND_wavSinkOpen(STAND_WavFile* wav, const char* path, uint32_t sampleRate, uint32_t numChannels);
+void STAND_wavSinkClose(STAND_WavFile* wav);
+bool STAND_wavSourceLoad(STAND_WavSource* wav, const char* path);
+void STAND_wavSourceFree(STAND_WavSource* wav);
+#ifdef HOTRELOAD_BUILD_COMMAND
+void STAND_hotreload();
+#endif
+
+// Audio thread
+void* STAND_audioRunProc(void* arg);
+// MIDI thread
+void* STAND_midiReadInputProc(void* arg);
+
+static void STAND_handleSignal(int sig) { g_quitFlag = 1; }
+
+static void STAND_printUsage(const char* name)
+{
+    fprintf(
+        stderr,
+        "Usage: %s [-r sampleRate] [-b blockSize] [-d seconds] [-i input.wav] [-o output.wav] [-m midiDevice] "
+        "[-n testNote] [-f]\n"
+        "  -r  Sample rate. Defaults to the input file rate, or %d\n"
+        "  -b  Block size, max %d. Default %d\n"
+        "  -d  Stop after rendering this many seconds. Default runs until interrupted\n"
+        "  -i  WAV file processed as input. Loops\n"
+        "  -o  Write output to a 32bit float WAV file. Otherwise output is discarded\n"
+        "  -m  Raw MIDI device to read from, eg. /dev/snd/midiC1D0\n"
+        "  -n  Hold a MIDI note (0-127) when not using a MIDI device\n"
+        "  -f  Render as fast as possible instead of in real time\n",
+        name,
+        USER_SAMPLE_RATE,
+        MAX_BLOCK_SIZE,
+        USER_BLOCK_SIZE);
+}
+
+int main(int argc, char** argv)
+{
+    const char* inputPath  = NULL;
+    const char* outputPath = NULL;
+    double      sampleRate = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (! strcmp(argv[i], "-r") && hasValue)
+            sampleRate = atof(argv[++i]);
+        else if (! strcmp(argv[i], "-b") && hasValue)
+            g_audioBlockSize = (uint32_t)atoi(argv[++i]);
+        else if (! strcmp(argv[i], "-d") && hasValue)
+            g_audioDuration = atof(argv[++i]);
+        else if (! strcmp(argv[i], "-i") && hasValue)
+            inputPath = argv[++i];
+        else if (! strcmp(argv[i], "-o") && hasValue)
+            outputPath = argv[++i];
+        else if (! strcmp(argv[i], "-m") && hasValue)
+            g_midiDevicePath = argv[++i];
+        else if (! strcmp(argv[i], "-n") && hasValue)
+            g_midiTestNote = atoi(argv[++i]) & 127;
+        else if (! strcmp(argv[i], "-f"))
+            g_audioOffline = true;
+        else
+        {
+            STAND_printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (g_audioBlockSize == 0 || g_audioBlockSize > MAX_BLOCK_SIZE || sampleRate < 0 || g_audioDuration < 0)
+    {
+        STAND_printUsage(argv[0]);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = STAND_handleSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    memset(&g_plugin, 0, sizeof(g_plugin));
+    memset(&g_midiRingBuffer, 0, sizeof(g_midiRingBuffer));
+    memset(&g_wavSink, 0, sizeof(g_wavSink));
+    memset(&g_wavSource, 0, sizeof(g_wavSource));
+#ifdef HOTRELOAD_BUILD_COMMAND
+    memset(&g_pluginState, 0, sizeof(g_pluginState));
+#endif
+
+    // Init audio
+    if (inputPath != NULL)
+    {
+        if (! STAND_wavSourceLoad(&g_wavSource, inputPath))
+            return 1;
+        uint32_t wavSampleRate = g_wavSource.sampleRate;
+        g_audioSampleRate      = wavSampleRate;
+        if (sampleRate != 0 && sampleRate != g_wavSource.sampleRate)
+            fprintf(stderr, "Warning: %s is %uHz, processing at %.0fHz\n", inputPath, wavSampleRate, sampleRate);
+    }
+    if (sampleRate != 0)
+        g_audioSampleRate = sampleRate;
+
+    if (outputPath != NULL)
+    {
+        if (! STAND_wavSinkOpen(&g_wavSink, outputPath, (uint32_t)g_audioSampleRate, g_audioNumChannels))
+            return 1;
+        printf("Writing audio to %s\n", outputPath);
+    }
+    else
+    {
+        printf("Writing audio to null output\n");
+    }
+
+    // Create user plugin
+    STAND_openLibraryWithSymbols();
+    g_plugin.libraryLoad();
+    g_plugin.userPlugin = g_plugin.createPlugin();
+    cplug_assert(g_plugin.userPlugin != NULL);
+    cplug_assert(g_plugin.getOutputBusChannelCount(g_plugin.userPlugin, 0) == g_audioNumChannels);
+
+    // Init MIDI
+    if (g_midiDevicePath != NULL)
+        STAND_midiConnect(g_midiDevicePath);
+
+#if CPLUG_WANT_THREAD_POOL
+    cplug_threadPool_acquire();
+#endif
+    STAND_audioStart();
+
+#ifdef HOTRELOAD_WATCH_DIR
+    // inotify isn't recursive, only files directly inside the folder are watched
+    int inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    cplug_assert(inotifyFD >= 0);
+    if (inotify_add_watch(inotifyFD, HOTRELOAD_WATCH_DIR, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        fprintf(stderr, "Failed to watch folder %s: %s\n", HOTRELOAD_WATCH_DIR, strerror(errno));
+    else
+        fprintf(stderr, "Watching folder %s\n", HOTRELOAD_WATCH_DIR);
+
+    // Editors often write several files, or the same file several times when saving. Like the Windows standalone, we
+    // wait until no events have been received for 50ms before reloading
+    int throttleReload = 0;
+#endif // HOTRELOAD_WATCH_DIR
+
+    while (! g_quitFlag)
+    {
+#ifdef HOTRELOAD_WATCH_DIR
+        struct pollfd pfd = {.fd = inotifyFD, .events = POLLIN};
+        int           ret = poll(&pfd, 1, 50);
+        if (ret > 0 && (pfd.revents & POLLIN))
+        {
+            // https://man7.org/linux/man-pages/man7/inotify.7.html
+            char    buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            ssize_t len;
+            while ((len = read(inotifyFD, buffer, sizeof(buffer))) > 0)
+            {
+                const struct inotify_event* event = NULL;
+                for (char* ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + event->len)
+                {
+                    event = (const struct inotify_event*)ptr;
+                    if (event->len > 0 && ! (event->mask & IN_ISDIR))
+                    {
+                        fprintf(stderr, "File changed: %s/%s\n", HOTRELOAD_WATCH_DIR, event->name);
+                        throttleReload++;
+                    }
+                }
+            }
+        }
+        else if (ret == 0)
+        {
+#ifdef HOTRELOAD_BUILD_COMMAND
+            if (throttleReload != 0)
+                STAND_hotreload();
+#endif
+            throttleReload = 0;
+        }
+#else
+        usleep(50 * 1000);
+#endif // HOTRELOAD_WATCH_DIR
+
+        // Audio thread exits by itself once the requested duration has been rendered
+        if (g_audioRunning && __atomic_load_n(&g_audioStopFlag, __ATOMIC_ACQUIRE))
+            break;
+    }
+
+#ifdef HOTRELOAD_WATCH_DIR
+    close(inotifyFD);
+#endif
+    if (g_audioRunning)
+        STAND_audioStop();
+#if CPLUG_WANT_THREAD_POOL
+    cplug_threadPool_release();
+#endif
+    g_quitFlag = 1;
+    STAND_midiDisconnect();
+
+    printf("Rendered %.2f seconds of audio\n", (double)g_audioFramesRendered / g_audioSampleRate);
+    STAND_wavSinkClose(&g_wavSink);
+    STAND_wavSourceFree(&g_wavSource);
+
+#ifdef HOTRELOAD_LIB_PATH
+    if (g_plugin.library)
+#endif
+        STAND_closeLibrary();
+#ifdef HOTRELOAD_BUILD_COMMAND
+    cplug_stateBuffer_free(&g_pluginState);
+#endif
+    return 0;
+}
+
+//////////
+// MIDI //
+//////////
+
+static inline unsigned STAND_midiCalcNumBytesFromStatus(unsigned char status_byte)
+{
+    /* https://www.midi.org/specifications-old/item/table-2-expanded-messages-list-status-bytes  */
+    switch (status_byte)
+    {
+    case 0x80 ... 0xbf:
+    case 0xe0 ... 0xef:
+    case 0xf2:
+        return 3;
+    case 0xc0 ... 0xdf:
+    case 0xf1:
+    case 0xf3:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+// Single producer. Either the MIDI thread or the main thread
+static void STAND_midiPush(MIDIMessage message)
+{
+    int writePos                      = __atomic_load_n(&g_midiRingBuffer.writePos, __ATOMIC_SEQ_CST);
+    g_midiRingBuffer.buffer[writePos] = message;
+    writePos                          = (writePos + 1) % ARRSIZE(g_midiRingBuffer.buffer);
+    __atomic_store_n(&g_midiRingBuffer.writePos, writePos, __ATOMIC_SEQ_CST);
+}
+
+// MIDI thread
+void* STAND_midiReadInputProc(void* arg)
+{
+    // Raw MIDI devices send a stream of bytes, which may use running status & contain realtime messages at any point
+    MIDIMessage   message  = {0};
+    unsigned      numBytes = 0;
+    unsigned      msgSize  = 0;
+    bool          inSysex  = false;
+    unsigned char buffer[256];
+
+    while (! g_quitFlag)
+    {
+        struct pollfd pfd = {.fd = g_midiFD, .events = POLLIN};
+        int           ret = poll(&pfd, 1, 50);
+        if (ret < 0 && errno != EINTR)
+            break;
+        if (ret <= 0)
+            continue;
+        ssize_t len = read(g_midiFD, buffer, sizeof(buffer));
+        if (len <= 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+        {
+            fprintf(stderr, "Disconnected MIDI input %s\n", g_midiDevicePath);
+            break;
+        }
+        for (ssize_t i = 0; i < len; i++)
+        {
+            unsigned char byte = buffer[i];
+            if (byte >= 0xf8) // Realtime messages, eg. clock. Ignored
+                continue;
+            if (byte == 0xf0)
+            {
+                inSysex = true;
+                continue;
+            }
+            if (byte & 0x80)
+            {
+                inSysex = false;
+                if (byte == 0xf7)
+                    continue;
+                message.bytesAsInt = 0;
+                message.status     = byte;
+                numBytes           = 1;
+                msgSize            = STAND_midiCalcNumBytesFromStatus(byte);
+            }
+            else
+            {
+                if (inSysex || msgSize == 0)
+                    continue;
+                if (numBytes == msgSize) // Running status
+                {
+                    unsigned char status = message.status;
+                    message.bytesAsInt   = 0;
+                    message.status       = status;
+                    numBytes             = 1;
+                }
+                message.bytes[numBytes++] = byte;
+            }
+
+            if (numBytes == msgSize)
+            {
+                STAND_midiPush(message);
+                // System common messages cancel running status
+                if (message.status >= 0xf0)
+                    msgSize = 0;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Main thread
+bool STAND_midiConnect(const char* path)
+{
+    cplug_assert(g_midiFD < 0);
+    g_midiFD = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (g_midiFD < 0)
+    {
+        fprintf(stderr, "Failed connecting to MIDI input %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    if (pthread_create(&g_midiThread, NULL, STAND_midiReadInputProc, NULL) != 0)
+    {
+        close(g_midiFD);
+        g_midiFD = -1;
+        return false;
+    }
+    printf("Connected to MIDI input %s\n", path);
+    return true;
+}
+
+// Main thread. The read thread exits by itself when g_quitFlag is set
+void STAND_midiDisconnect()
+{
+    if (g_midiFD >= 0)
+    {
+        pthread_join(g_midiThread, NULL);
+        close(g_midiFD);
+        g_midiFD = -1;
+    }
+}
+
+///////////
+// Audio //
+///////////
+
+typedef struct LinuxProcessContext
+{
+    CplugProcessContext cplugContext;
+
+    float* input[USER_NUM_CHANNELS];
+    float* output[USER_NUM_CHANNELS];
+} LinuxProcessContext;
+
+bool LinuxProcessContext_enqueueEvent(struct CplugProcessContext* ctx, const CplugEvent* e, uint32_t frameIdx)
+{
+    return true;
+}
+
+bool LinuxProcessContext_dequeueEvent(struct CplugProcessContext* ctx, CplugEvent* event, uint32_t frameIdx)
+{
+    if (frameIdx >= ctx->numFrames)
+        return false;
+
+    int head = __atomic_load_n(&g_midiRingBuffer.writePos, __ATOMIC_SEQ_CST);
+    int tail = g_midiRingBuffer.readPos;
+    if (tail != head)
+    {
+        MIDIMessage* msg       = &g_midiRingBuffer.buffer[tail];
+        event->type            = CPLUG_EVENT_MIDI;
+        event->midi.frame      = frameIdx;
+        event->midi.bytesAsInt = msg->bytesAsInt;
+
+        tail++;
+        tail %= CPLUG_MIDI_RINGBUFFER_SIZE;
+
+        __atomic_store_n(&g_midiRingBuffer.readPos, tail, __ATOMIC_SEQ_CST);
+        return true;
+    }
+
+    event->processAudio.type     = CPLUG_EVENT_PROCESS_AUDIO;
+    event->processAudio.endFrame = ctx->numFrames;
+    return true;
+}
+
+#if CPLUG_WANT_THREAD_POOL
+void LinuxProcessContext_parallelFor(
+    struct CplugProcessContext* ctx,
+    uint32_t                    taskCount,
+    cplug_taskProc              taskProc,
+    void*                       userdata)
+{
+    cplug_threadPool_parallelFor(g_cplugThreadPool, taskCount, taskProc, userdata);
+}
+#endif
+
+float** LinuxProcessContext_getAudioInput(const struct CplugProcessContext* ctx, uint32_t busIdx)
+{
+    const LinuxProcessContext* translator = (const LinuxProcessContext*)ctx;
+    if (busIdx == 0 && g_wavSource.numFrames > 0)
+        return (float**)&translator->input;
+    return NULL;
+}
+
+float** LinuxProcessContext_getAudioOutput(const struct CplugProcessContext* ctx, uint32_t busIdx)
+{
+    const LinuxProcessContext* translator = (const LinuxProcessContext*)ctx;
+    if (busIdx == 0)
+        return (float**)&translator->output;
+    return NULL;
+}
+
+// Audio thread
+void* STAND_audioRunProc(void* arg)
+{
+    // Ask for realtime scheduling. Fails without CAP_SYS_NICE or an rtprio limit, which is fine for a null device
+    struct sched_param param = {.sched_priority = sched_get_priority_min(SCHED_FIFO)};
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    LinuxProcessContext translator         = {0};
+    translator.cplugContext.numFrames      = g_audioBlockSize;
+    translator.cplugContext.renderMode     = g_audioOffline ? CPLUG_RENDER_MODE_OFFLINE : CPLUG_RENDER_MODE_REALTIME;
+    translator.cplugContext.enqueueEvent   = LinuxProcessContext_enqueueEvent;
+    translator.cplugContext.dequeueEvent   = LinuxProcessContext_dequeueEvent;
+    translator.cplugContext.dequeueEvents  = cplug_dequeueEventsSerially;
+    translator.cplugContext.getAudioInput  = LinuxProcessContext_getAudioInput;
+    translator.cplugContext.getAudioOutput = LinuxProcessContext_getAudioOutput;
+#if CPLUG_WANT_THREAD_POOL
+    translator.cplugContext.parallelFor = LinuxProcessContext_parallelFor;
+#endif
+    for (uint32_t ch = 0; ch < g_audioNumChannels; ch++)
+    {
+        translator.input[ch]  = g_audioInput[ch];
+        translator.output[ch] = g_audioOutput[ch];
+    }
+
+    uint64_t blockNS   = (uint64_t)(g_audioBlockSize / g_audioSampleRate * 1e9);
+    uint64_t maxFrames = (uint64_t)(g_audioDuration * g_audioSampleRate);
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (! __atomic_load_n(&g_audioStopFlag, __ATOMIC_ACQUIRE))
+    {
+        if (maxFrames && g_audioFramesRendered >= maxFrames)
+        {
+            __atomic_store_n(&g_audioStopFlag, 1, __ATOMIC_RELEASE);
+            break;
+        }
+
+        if (g_wavSource.numFrames > 0)
+        {
+            for (uint32_t i = 0; i < g_audioBlockSize; i++)
+            {
+                for (uint32_t ch = 0; ch < g_audioNumChannels; ch++)
+                    g_audioInput[ch][i] = g_wavSource.channels[ch][g_wavSource.readPos];
+                if (++g_wavSource.readPos == g_wavSource.numFrames)
+                    g_wavSource.readPos = 0;
+            }
+        }
+
+#if ! CPLUG_WANT_DENORMALS
+        uint64_t floatMode = cplug_disableDenormals();
+#endif
+        g_plugin.process(g_plugin.userPlugin, &translator.cplugContext);
+#if ! CPLUG_WANT_DENORMALS
+        cplug_restoreDenormals(floatMode);
+#endif
+        g_audioFramesRendered += g_audioBlockSize;
+
+        // File IO on the audio thread is fine here, there's no device waiting on us
+        if (g_wavSink.file != NULL)
+        {
+            cplug_interleave(
+                g_audioInterleaved,
+                CPLUG_SAMPLE_FLOAT32,
+                translator.output,
+                g_audioNumChannels,
+                g_audioBlockSize,
+                NULL);
+            fwrite(g_audioInterleaved, sizeof(float) * g_audioNumChannels, g_audioBlockSize, g_wavSink.file);
+            g_wavSink.numFrames += g_audioBlockSize;
+        }
+
+        if (! g_audioOffline)
+        {
+            // Pace blocks against an absolute clock so time spent processing doesn't cause drift
+            uint64_t nextNS = (uint64_t)next.tv_sec * 1000000000ull + next.tv_nsec + blockNS;
+            uint64_t nowNS  = STAND_nowNS();
+            if (nowNS > nextNS + blockNS) // Fell behind by over a block. Don't try to catch up
+                nextNS = nowNS;
+            next.tv_sec  = nextNS / 1000000000ull;
+            next.tv_nsec = nextNS % 1000000000ull;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+                ;
+        }
+    }
+    return NULL;
+}
+
+// Main thread
+void STAND_audioStart()
+{
+#ifdef HOTRELOAD_LIB_PATH
+    if (g_plugin.library == NULL)
+    {
+        cplug_log("[FAILED] Called STAND_audioStart when no plugin is loaded");
+        return;
+    }
+#endif // HOTRELOAD_LIB_PATH
+    if (g_audioRunning)
+        STAND_audioStop();
+
+    cplug_assert(g_audioSampleRate > 0);
+    cplug_assert(g_audioBlockSize > 0 && g_audioBlockSize <= MAX_BLOCK_SIZE);
+
+    g_plugin.setSampleRateAndBlockSize(g_plugin.userPlugin, g_audioSampleRate, g_audioBlockSize);
+    uint32_t renderMode = g_audioOffline ? CPLUG_RENDER_MODE_OFFLINE : CPLUG_RENDER_MODE_REALTIME;
+    g_plugin.setRenderMode(g_plugin.userPlugin, renderMode);
+
+    // New plugin instances won't know the note is held. The MIDI thread is the only writer when a device is connected
+    if (g_midiTestNote >= 0 && g_midiFD < 0)
+    {
+        MIDIMessage message = {0};
+        message.status      = 0x90;
+        message.data1       = g_midiTestNote;
+        message.data2       = 100;
+        STAND_midiPush(message);
+    }
+
+    g_audioStopFlag = 0;
+    int ret         = pthread_create(&g_audioThread, NULL, STAND_audioRunProc, NULL);
+    cplug_assert(ret == 0);
+    g_audioRunning = true;
+
+    printf("Started audio at %.0fHz, block size %u\n", g_audioSampleRate, g_audioBlockSize);
+}
+
+// Main thread
+void STAND_audioStop()
+{
+    if (! g_audioRunning)
+    {
+        cplug_log("[WARNING] Called STAND_audioStop() when audio is not running");
+        return;
+    }
+    __atomic_store_n(&g_audioStopFlag, 1, __ATOMIC_RELEASE);
+    pthread_join(g_audioThread, NULL);
+    g_audioRunning = false;
+}
+
+/////////
+// WAV //
+/////////
+
+static void STAND_wavWriteHeader(STAND_WavFile* wav)
+{
+    // http://soundfile.sapp.org/doc/WaveFormat/
+    uint8_t  header[44];
+    uint32_t blockAlign = wav->numChannels * sizeof(float);
+    uint64_t dataSize   = wav->numFrames * blockAlign;
+    if (dataSize > 0xffffffff - 36) // Past 4GB. Players will read as much as fits
+        dataSize = 0xffffffff - 36;
+
+    memcpy(header, "RIFF", 4);
+    STAND_writeU32(header + 4, (uint32_t)(36 + dataSize));
+    memcpy(header + 8, "WAVEfmt ", 8);
+    STAND_writeU32(header + 16, 16);
+    STAND_writeU16(header + 20, 3); // WAVE_FORMAT_IEEE_FLOAT
+    STAND_writeU16(header + 22, wav->numChannels);
+    STAND_writeU32(header + 24, wav->sampleRate);
+    STAND_writeU32(header + 28, wav->sampleRate * blockAlign);
+    STAND_writeU16(header + 32, blockAlign);
+    STAND_writeU16(header + 34, 32);
+    memcpy(header + 36, "data", 4);
+    STAND_writeU32(header + 40, (uint32_t)dataSize);
+
+    fseek(wav->file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), wav->file);
+}
+
+bool STAND_wavSinkOpen(STAND_WavFile* wav, const char* path, uint32_t sampleRate, uint32_t numChannels)
+{
+    wav->file = fopen(path, "wb");
+    if (wav->file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    wav->sampleRate  = sampleRate;
+    wav->numChannels = numChannels;
+    wav->numFrames   = 0;
+    // Sizes are filled in when closing
+    STAND_wavWriteHeader(wav);
+    return true;
+}
+
+void STAND_wavSinkClose(STAND_WavFile* wav)
+{
+    if (wav->file == NULL)
+        return;
+    STAND_wavWriteHeader(wav);
+    fclose(wav->file);
+    wav->file = NULL;
+}
+
+// Supports 16, 24 & 32bit integer PCM, and 32 & 64bit float. Mono files are copied to both channels
+bool STAND_wavSourceLoad(STAND_WavSource* wav, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = (uint8_t*)malloc(fileSize > 0 ? fileSize : 1);
+    size_t   size = fread(data, 1, fileSize > 0 ? fileSize : 0, file);
+    fclose(file);
+
+    const uint8_t* fmt      = NULL;
+    const uint8_t* samples  = NULL;
+    uint32_t       dataSize = 0;
+    if (size >= 12 && ! memcmp(data, "RIFF", 4) && ! memcmp(data + 8, "WAVE", 4))
+    {
+        // Chunks are padded to an even number of bytes
+        for (size_t pos = 12; pos + 8 <= size;)
+        {
+            uint32_t chunkSize = STAND_readU32(data + pos + 4);
+            if (chunkSize > size - pos - 8)
+                chunkSize = size - pos - 8;
+            if (! memcmp(data + pos, "fmt ", 4) && chunkSize >= 16)
+                fmt = data + pos + 8;
+            else if (! memcmp(data + pos, "data", 4))
+            {
+                samples  = data + pos + 8;
+                dataSize = chunkSize;
+            }
+            pos += 8 + chunkSize + (chunkSize & 1);
+        }
+    }
+    if (fmt == NULL || samples == NULL)
+    {
+        fprintf(stderr, "Failed to read %s: not a WAV file\n", path);
+        free(data);
+        return false;
+    }
+
+    uint16_t format         = STAND_readU16(fmt);
+    uint16_t numChannels    = STAND_readU16(fmt + 2);
+    uint32_t sampleRate     = STAND_readU32(fmt + 4);
+    uint16_t bitsPerSample  = STAND_readU16(fmt + 14);
+    uint32_t bytesPerSample = bitsPerSample / 8;
+    if (format == 0xfffe && STAND_readU16(fmt + 16) >= 22) // WAVE_FORMAT_EXTENSIBLE. Format is in the sub format GUID
+        format = STAND_readU16(fmt + 24);
+
+    bool isPCM   = format == 1 && (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32);
+    bool isFloat = format == 3 && (bitsPerSample == 32 || bitsPerSample == 64);
+    if ((! isPCM && ! isFloat) || numChannels == 0 || sampleRate == 0)
+    {
+        fprintf(stderr, "Failed to read %s: unsupported format %hu, %hu bits\n", path, format, bitsPerSample);
+        free(data);
+        return false;
+    }
+
+    wav->sampleRate = sampleRate;
+    wav->numFrames  = dataSize / (bytesPerSample * numChannels);
+    wav->readPos    = 0;
+    for (uint32_t ch = 0; ch < USER_NUM_CHANNELS; ch++)
+        wav->channels[ch] = (float*)malloc(sizeof(float) * (wav->numFrames > 0 ? wav->numFrames : 1));
+
+    if (numChannels == USER_NUM_CHANNELS && ! (isFloat && bitsPerSample == 64))
+    {
+        CplugSampleFormat sampleFormat = isFloat               ? CPLUG_SAMPLE_FLOAT32
+                                         : bitsPerSample == 16 ? CPLUG_SAMPLE_INT16
+                                         : bitsPerSample == 24 ? CPLUG_SAMPLE_INT24
+                                                               : CPLUG_SAMPLE_INT32;
+        cplug_deinterleave(wav->channels, samples, sampleFormat, numChannels, (uint32_t)wav->numFrames);
+    }
+    else
+    {
+        // Other channel counts & 64bit floats
+        for (uint64_t i = 0; i < wav->numFrames; i++)
+        {
+            for (uint32_t ch = 0; ch < USER_NUM_CHANNELS; ch++)
+            {
+                uint32_t       srcCh = ch < numChannels ? ch : (uint32_t)numChannels - 1;
+                const uint8_t* src   = samples + (i * numChannels + srcCh) * bytesPerSample;
+                float          v     = 0;
+                if (isFloat && bitsPerSample == 32)
+                    memcpy(&v, src, sizeof(v));
+                else if (isFloat)
+                {
+                    double d;
+                    memcpy(&d, src, sizeof(d));
+                    v = (float)d;
+                }
+                else if (bitsPerSample == 16)
+                    v = (int16_t)STAND_readU16(src) / 32768.0f;
+                else if (bitsPerSample == 24)
+                    v = (int32_t)((uint32_t)(src[0] | (src[1] << 8) | (src[2] << 16)) << 8) / 2147483648.0f;
+                else
+                    v = (int32_t)STAND_readU32(src) / 2147483648.0f;
+                wav->channels[ch][i] = v;
+            }
+        }
+    }
+    free(data);
+
+    printf(
+        "Reading audio from %s: %uHz, %hu channels, %.2f seconds\n",
+        path,
+        sampleRate,
+        numChannels,
+        (double)wav->numFrames / sampleRate);
+    return true;
+}
+
+void STAND_wavSourceFree(STAND_WavSource* wav)
+{
+    for (uint32_t ch = 0; ch < USER_NUM_CHANNELS; ch++)
+        free(wav->channels[ch]);
+    memset(wav, 0, sizeof(*wav));
+}
+
+//////////////////
+// Hotreloading //
+//////////////////
+
+void STAND_openLibraryWithSymbols()
+{
+#ifdef HOTRELOAD_LIB_PATH
+    cplug_assert(g_plugin.library == NULL);
+    g_plugin.library = dlopen(HOTRELOAD_LIB_PATH, RTLD_NOW);
+    if (g_plugin.library == NULL)
+        fprintf(stderr, "Failed to open %s: %s\n", HOTRELOAD_LIB_PATH, dlerror());
+    cplug_assert(g_plugin.library != NULL);
+#define CPLUG_DLSYM(name) dlsym(g_plugin.library, #name)
+#else
+#define CPLUG_DLSYM(func) func
+#endif // HOTRELOAD_LIB_PATH
+
+    // The ugly pointer silliness seen here is to deal with C++ not liking us setting void pointers
+    *(size_t*)&g_plugin.libraryLoad               = (size_t)CPLUG_DLSYM(cplug_libraryLoad);
+    *(size_t*)&g_plugin.libraryUnload             = (size_t)CPLUG_DLSYM(cplug_libraryUnload);
+    *(size_t*)&g_plugin.createPlugin              = (size_t)CPLUG_DLSYM(cplug_createPlugin);
+    *(size_t*)&g_plugin.destroyPlugin             = (size_t)CPLUG_DLSYM(cplug_destroyPlugin);
+    *(size_t*)&g_plugin.getOutputBusChannelCount  = (size_t)CPLUG_DLSYM(cplug_getOutputBusChannelCount);
+    *(size_t*)&g_plugin.setSampleRateAndBlockSize = (size_t)CPLUG_DLSYM(cplug_setSampleRateAndBlockSize);
+    *(size_t*)&g_plugin.setRenderMode             = (size_t)CPLUG_DLSYM(cplug_setRenderMode);
+    *(size_t*)&g_plugin.process                   = (size_t)CPLUG_DLSYM(cplug_process);
+    *(size_t*)&g_plugin.saveState                 = (size_t)CPLUG_DLSYM(cplug_saveState);
+    *(size_t*)&g_plugin.loadState                 = (size_t)CPLUG_DLSYM(cplug_loadState);
+
+    cplug_assert(NULL != g_plugin.libraryLoad);
+    cplug_assert(NULL != g_plugin.libraryUnload);
+    cplug_assert(NULL != g_plugin.createPlugin);
+    cplug_assert(NULL != g_plugin.destroyPlugin);
+    cplug_assert(NULL != g_plugin.getOutputBusChannelCount);
+    cplug_assert(NULL != g_plugin.setSampleRateAndBlockSize);
+    cplug_assert(NULL != g_plugin.setRenderMode);
+    cplug_assert(NULL != g_plugin.process);
+    cplug_assert(NULL != g_plugin.saveState);
+    cplug_assert(NULL != g_plugin.loadState);
+}
+
+void STAND_closeLibrary()
+{
+    g_plugin.destroyPlugin(g_plugin.userPlugin);
+    g_plugin.libraryUnload();
+#ifdef HOTRELOAD_LIB_PATH
+    dlclose(g_plugin.library);
+#endif
+    memset(&g_plugin, 0, sizeof(g_plugin));
+}
+
+#ifdef HOTRELOAD_BUILD_COMMAND
+// Main thread
+void STAND_hotreload()
+{
+    uint64_t reloadStart = STAND_nowNS();
+
+    if (g_plugin.library)
+    {
+        STAND_audioStop();
+
+        cplug_stateBuffer_reset(&g_pluginState);
+        g_plugin.saveState(g_plugin.userPlugin, &g_pluginState, cplug_stateBuffer_writeProc);
+
+        STAND_closeLibrary();
+    }
+
+    uint64_t buildStart = STAND_nowNS();
+    int      code       = system(HOTRELOAD_BUILD_COMMAND);
+    uint64_t buildEnd   = STAND_nowNS();
+
+    if (code != 0)
+    {
+        cplug_log("[WARNING] Rebuild failed. Exited with code: %d", code);
+    }
+    else
+    {
+        STAND_openLibraryWithSymbols();
+        g_plugin.libraryLoad();
+        g_plugin.userPlugin = g_plugin.createPlugin();
+        cplug_assert(g_plugin.userPlugin != NULL);
+        g_plugin.loadState(g_plugin.userPlugin, &g_pluginState, cplug_stateBuffer_readProc);
+
+        STAND_audioStart();
+    }
+
+    uint64_t reloadEnd = STAND_nowNS();
+
+    double rebuild_ms = (double)(buildEnd - buildStart) / 1.e6;
+    double reload_ms  = (double)(reloadEnd - reloadStart) / 1.e6;
+    fprintf(stderr, "Rebuild time %.2fms\n", rebuild_ms);
+    fprintf(stderr, "Reload time %.2fms\n", reload_ms);
+}
+#endif // HOTRELOAD_BUILD_COMMAND
@@ -6,6 +6,13 @@
 #include <CoreMIDI/CoreMIDI.h>
 #include <CoreServices/CoreServices.h>
 #include <cplug.h>
+#include <cplug_interleave.h>
+#ifdef HOTRELOAD_BUILD_COMMAND
+#include <cplug_state_buffer.h>
+#endif
+#if CPLUG_WANT_THREAD_POOL
+#include <cplug_thread_pool.h>
+#endif
 #include <dlfcn.h>
 #include <mach/mach_time.h>
 #include <pthread.h>
@@ -107,17 +114,7 @@ struct STAND_Plugin
 } g_plugin;
 
 #ifdef HOTRELOAD_BUILD_COMMAND
-struct STAND_PluginStateContext
-{
-    uint8_t* data;
-    size_t   bytesReserved;
-    size_t   bytesCommited;
-
-    size_t bytesWritten;
-    size_t bytesRead;
-} g_pluginState;
-int64_t STAND_writeStateProc(const void* stateCtx, void* writePos, size_t numBytesToWrite);
-int64_t STAND_readStateProc(const void* stateCtx, void* readPos, size_t maxBytesToRead);
+CplugStateBuffer g_pluginState;
 #endif // HOTRELOAD_BUILD_COMMAND
 
 mach_timebase_info_data_t g_timebase;
@@ -140,7 +137,6 @@ UInt32              g_audioNumChannels = USER_NUM_CHANNELS;
 volatile bool       g_audioStopFlag    = false;
 pthread_cond_t      g_audioStopCondition;
 pthread_mutex_t     g_audioMutex;
-
 FSEventStreamRef g_filesystemEventStream = NULL;
 
 NSWindow* g_window = NULL;
@@ -231,6 +227,9 @@ OSStatus STAND_audioDeviceChangeListener(
 
     // Init audio
     pthread_mutex_init(&g_audioMutex, NULL);
+#if CPLUG_WANT_THREAD_POOL
+    cplug_threadPool_acquire();
+#endif
 
     // Fixes macOS device detection problems
     // https://lists.apple.com/archives/Coreaudio-api/2010/Aug//msg00304.html
@@ -404,6 +403,9 @@ OSStatus STAND_audioDeviceChangeListener(
     FSEventStreamRelease(g_filesystemEventStream);
 
     STAND_audioStop();
+#if CPLUG_WANT_THREAD_POOL
+    cplug_threadPool_release();
+#endif
 
     AudioObjectPropertyAddress addr = {
         kAudioDevicePropertyDeviceIsAlive,
@@ -432,7 +434,7 @@ OSStatus STAND_audioDeviceChangeListener(
         g_plugin.libraryUnload();
 #ifdef HOTRELOAD_LIB_PATH
         dlclose(g_plugin.library);
-        munmap(g_pluginState.data, g_pluginState.bytesReserved);
+        cplug_stateBuffer_free(&g_pluginState);
     }
 #endif
 
@@ -847,6 +849,17 @@ bool OSXProcessContext_dequeueEvent(struct CplugProcessContext* ctx, CplugEvent*
     return true;
 }
 
+#if CPLUG_WANT_THREAD_POOL
+void OSXProcessContext_parallelFor(
+    struct CplugProcessContext* ctx,
+    uint32_t                    taskCount,
+    cplug_taskProc              taskProc,
+    void*                       userdata)
+{
+    cplug_threadPool_parallelFor(g_cplugThreadPool, taskCount, taskProc, userdata);
+}
+#endif
+
 float** OSXProcessContext_getAudioInput(const struct CplugProcessContext* ctx, uint32_t busIdx) { return NULL; }
 float** OSXProcessContext_getAudioOutput(const struct CplugProcessContext* ctx, uint32_t busIdx)
 {
@@ -875,19 +888,32 @@ OSStatus STAND_audioIOProc(
     translator.cplugContext.numFrames      = g_audioBlockSize;
     translator.cplugContext.enqueueEvent   = OSXProcessContext_enqueueEvent;
     translator.cplugContext.dequeueEvent   = OSXProcessContext_dequeueEvent;
+    translator.cplugContext.dequeueEvents  = cplug_dequeueEventsSerially;
     translator.cplugContext.getAudioInput  = OSXProcessContext_getAudioInput;
     translator.cplugContext.getAudioOutput = OSXProcessContext_getAudioOutput;
+#if CPLUG_WANT_THREAD_POOL
+    translator.cplugContext.parallelFor = OSXProcessContext_parallelFor;
+#endif
 
     translator.output[0] = (float*)STAND_roundUp((UInt64)&g_audioBuffer, 32);
     translator.output[1] = translator.output[0] + g_audioBlockSize;
 
+#if ! CPLUG_WANT_DENORMALS
+    uint64_t floatMode = cplug_disableDenormals();
+#endif
     g_plugin.process(g_plugin.userPlugin, &translator.cplugContext);
+#if ! CPLUG_WANT_DENORMALS
+    cplug_restoreDenormals(floatMode);
+#endif
 
     // copy from non-interleaved to interleaved
-    float* output = (float*)outOutputData->mBuffers->mData;
-    for (int i = 0; i < g_audioBlockSize; i++)
-        for (int ch = 0; ch < g_audioNumChannels; ch++)
-            *output++ = translator.output[ch][i];
+    cplug_interleave(
+        outOutputData->mBuffers->mData,
+        CPLUG_SAMPLE_FLOAT32,
+        translator.output,
+        g_audioNumChannels,
+        g_audioBlockSize,
+        NULL);
 
     if (__atomic_load_n(&g_audioStopFlag, __ATOMIC_SEQ_CST))
     {
@@ -1222,9 +1248,8 @@ void STAND_filesystemEventCallback(
                 g_plugin.setParent(g_plugin.userGUI, NULL);
                 g_plugin.destroyGUI(g_plugin.userGUI);
 
-                g_pluginState.bytesWritten = 0;
-                g_pluginState.bytesRead    = 0;
-                g_plugin.saveState(g_plugin.userPlugin, &g_pluginState, STAND_writeStateProc);
+                cplug_stateBuffer_reset(&g_pluginState);
+                g_plugin.saveState(g_plugin.userPlugin, &g_pluginState, cplug_stateBuffer_writeProc);
 
                 g_plugin.destroyPlugin(g_plugin.userPlugin);
                 g_plugin.libraryUnload();
@@ -1249,7 +1274,7 @@ void STAND_filesystemEventCallback(
                 g_plugin.libraryLoad();
                 g_plugin.userPlugin = g_plugin.createPlugin();
                 cplug_assert(g_plugin.userPlugin != NULL);
-                g_plugin.loadState(g_plugin.userPlugin, &g_pluginState, STAND_readStateProc);
+                g_plugin.loadState(g_plugin.userPlugin, &g_pluginState, cplug_stateBuffer_readProc);
 
                 STAND_audioStart();
 
@@ -1274,62 +1299,4 @@ void STAND_filesystemEventCallback(
         }
     }
 }
-
-int64_t STAND_writeStateProc(const void* stateCtx, void* writePos, size_t numBytesToWrite)
-{
-    cplug_assert(stateCtx != NULL);
-    cplug_assert(writePos != NULL);
-    cplug_assert(numBytesToWrite > 0);
-
-    // The idea is we reserve heaps of address space up front, and hope we never spill over it.
-    // In the rare case your plugin does, simply reserve more address space
-    // Some plugins may save big audio files in their state, hence the BIG reserve
-    struct STAND_PluginStateContext* ctx = (struct STAND_PluginStateContext*)stateCtx;
-
-    if (ctx->data == NULL)
-    {
-        size_t largePageSize = 2 * 1024 * 1024;
-        size_t bigreserve    = 8 * STAND_roundUp(numBytesToWrite, largePageSize);
-        ctx->data            = (UInt8*)mmap(MAP_FILE, bigreserve, PROT_NONE, MAP_ANON | MAP_PRIVATE, -1, 0);
-        cplug_assert((uint64_t)ctx->data != 0xffffffffffffffff);
-        ctx->bytesReserved = bigreserve;
-
-        size_t bigcommit = numBytesToWrite * 4;
-        int    retval    = mprotect(ctx->data, bigcommit, PROT_READ | PROT_WRITE);
-        cplug_assert(retval == 0);
-        ctx->bytesCommited = bigcommit;
-    }
-    // If you hit this assertion, you need to reserve more address space above!
-    cplug_assert(numBytesToWrite < (ctx->bytesReserved - ctx->bytesCommited));
-    if (numBytesToWrite > (ctx->bytesCommited - ctx->bytesWritten))
-    {
-        size_t nextcommit = 2 * ctx->bytesCommited;
-        int    retval     = mprotect(ctx->data, nextcommit, PROT_READ | PROT_WRITE);
-        cplug_assert(retval == 0);
-        ctx->bytesCommited = nextcommit;
-    }
-    memcpy(ctx->data + ctx->bytesWritten, writePos, numBytesToWrite);
-    ctx->bytesWritten += numBytesToWrite;
-    return numBytesToWrite;
-}
-
-int64_t STAND_readStateProc(const void* stateCtx, void* readPos, size_t maxBytesToRead)
-{
-    struct STAND_PluginStateContext* ctx = (struct STAND_PluginStateContext*)stateCtx;
-
-    cplug_assert(stateCtx != NULL);
-    cplug_assert(readPos != NULL);
-    cplug_assert(maxBytesToRead > 0);
-
-    size_t remainingBytes     = ctx->bytesWritten - ctx->bytesRead;
-    size_t bytesToActualyRead = maxBytesToRead > remainingBytes ? remainingBytes : maxBytesToRead;
-
-    if (bytesToActualyRead)
-    {
-        memcpy(readPos, ctx->data + ctx->bytesRead, bytesToActualyRead);
-        ctx->bytesRead += bytesToActualyRead;
-    }
-
-    return bytesToActualyRead;
-}
 #endif // HOTRELOAD_BUILD_COMMAND
\ No newline at end of file
@@ -18,6 +18,13 @@
 #include <synchapi.h>
 
 #include <cplug.h>
+#include <cplug_interleave.h>
+#ifdef HOTRELOAD_WATCH_DIR
+#include <cplug_state_buffer.h>
+#endif
+#if CPLUG_WANT_THREAD_POOL
+#include <cplug_thread_pool.h>
+#endif
 #include <stdio.h>
 
 #pragma comment(lib, "winmm.lib")
@@ -82,17 +89,7 @@ struct CPWIN_Plugin
 void CPWIN_LoadPlugin();
 
 #ifdef HOTRELOAD_WATCH_DIR
-struct CPWIN_PluginStateContext
-{
-    BYTE*  Data;
-    SIZE_T BytesReserved;
-    SIZE_T BytesCommited;
-
-    SIZE_T BytesWritten;
-    SIZE_T BytesRead;
-} _gPluginState;
-int64_t CPWIN_WriteStateProc(const void* stateCtx, void* writePos, size_t numBytesToWrite);
-int64_t CPWIN_ReadStateProc(const void* stateCtx, void* readPos, size_t maxBytesToRead);
+CplugStateBuffer _gPluginState;
 
 // File watch thread
 DWORD WINAPI CPWIN_WatchFileChangesProc(LPVOID hwnd);
@@ -334,6 +331,9 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR cmdline, int cmds
         (void**)&_gAudio.pIMMDeviceEnumerator);
     cplug_assert(! FAILED(hr));
 
+#if CPLUG_WANT_THREAD_POOL
+    cplug_threadPool_acquire();
+#endif
     CPWIN_Audio_SetDevice(-1); // -1 == default device
     CPWIN_Audio_Start();
     cplug_assert(_gAudio.ProcessBuffer);
@@ -486,6 +486,9 @@ LRESULT CALLBACK CPWIN_WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lP
         _gAudio.pIMMDevice->lpVtbl->Release(_gAudio.pIMMDevice);
         cplug_assert(_gAudio.pIMMDeviceEnumerator != NULL);
         _gAudio.pIMMDeviceEnumerator->lpVtbl->Release(_gAudio.pIMMDeviceEnumerator);
+#if CPLUG_WANT_THREAD_POOL
+        cplug_threadPool_release();
+#endif
 
         // Shutdown MIDI
         CPWIN_MIDI_DisconnectInput();
@@ -507,8 +510,7 @@ LRESULT CALLBACK CPWIN_WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lP
 #ifdef HOTRELOAD_WATCH_DIR
             FreeLibrary(_gCPLUG.Library);
         }
-        if (_gPluginState.Data)
-            VirtualFree(_gPluginState.Data, _gPluginState.BytesReserved, 0);
+        cplug_stateBuffer_free(&_gPluginState);
 #endif
         DestroyWindow(hWnd);
         return 0;
@@ -579,9 +581,8 @@ LRESULT CALLBACK CPWIN_WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lP
 
                 CPWIN_Audio_Stop();
 
-                _gPluginState.BytesWritten = 0;
-                _gPluginState.BytesRead    = 0;
-                _gCPLUG.saveState(_gCPLUG.UserPlugin, &_gPluginState, CPWIN_WriteStateProc);
+                cplug_stateBuffer_reset(&_gPluginState);
+                _gCPLUG.saveState(_gCPLUG.UserPlugin, &_gPluginState, cplug_stateBuffer_writeProc);
 
                 _gCPLUG.destroyPlugin(_gCPLUG.UserPlugin);
                 _gCPLUG.libraryUnload();
@@ -633,7 +634,7 @@ LRESULT CALLBACK CPWIN_WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lP
                 _gCPLUG.libraryLoad();
                 _gCPLUG.UserPlugin = _gCPLUG.createPlugin();
                 cplug_assert(_gCPLUG.UserPlugin != NULL);
-                _gCPLUG.loadState(_gCPLUG.UserPlugin, &_gPluginState, CPWIN_ReadStateProc);
+                _gCPLUG.loadState(_gCPLUG.UserPlugin, &_gPluginState, cplug_stateBuffer_readProc);
 
                 CPWIN_Audio_Start();
 
@@ -823,67 +824,6 @@ void CPWIN_LoadPlugin()
 }
 
 #ifdef HOTRELOAD_WATCH_DIR
-#pragma region PLUGIN_STATE
-int64_t        CPWIN_WriteStateProc(const void* stateCtx, void* writePos, size_t numBytesToWrite)
-{
-    cplug_assert(stateCtx != NULL);
-    cplug_assert(writePos != NULL);
-    cplug_assert(numBytesToWrite > 0);
-
-    // The idea is we reserve heaps of address space up front, and hope we never spill over it.
-    // In the rare case your plugin does, simply reserve more address space
-    // Some plugins may save big audio files in their state, hence the BIG reserve
-    struct CPWIN_PluginStateContext* ctx = (struct CPWIN_PluginStateContext*)stateCtx;
-
-    if (ctx->Data == NULL)
-    {
-        const SIZE_T largePageSize  = GetLargePageMinimum();
-        SIZE_T       bigreserve     = CPWIN_RoundUp(numBytesToWrite, largePageSize);
-        bigreserve                 *= 8;
-        ctx->Data                   = (BYTE*)VirtualAlloc(NULL, bigreserve, MEM_RESERVE, PAGE_READWRITE);
-        cplug_assert(ctx->Data != NULL);
-        ctx->BytesReserved = bigreserve;
-
-        SIZE_T bigcommit = numBytesToWrite * 4;
-        LPVOID retval    = VirtualAlloc(ctx->Data, bigcommit, MEM_COMMIT, PAGE_READWRITE);
-        cplug_assert(retval != NULL);
-        ctx->BytesCommited = bigcommit;
-    }
-    // If you hit this assertion, you need to reserve more address space above!
-    cplug_assert(numBytesToWrite < (ctx->BytesReserved - ctx->BytesCommited));
-    if (numBytesToWrite > (ctx->BytesCommited - ctx->BytesWritten))
-    {
-        SIZE_T nextcommit = 2 * ctx->BytesCommited;
-        LPVOID retval     = VirtualAlloc(ctx->Data, nextcommit, MEM_COMMIT, PAGE_READWRITE);
-        cplug_assert(retval != NULL);
-        ctx->BytesCommited = nextcommit;
-    }
-    memcpy(ctx->Data + ctx->BytesWritten, writePos, numBytesToWrite);
-    ctx->BytesWritten += numBytesToWrite;
-    return numBytesToWrite;
-}
-
-int64_t CPWIN_ReadStateProc(const void* stateCtx, void* readPos, size_t maxBytesToRead)
-{
-    struct CPWIN_PluginStateContext* ctx = (struct CPWIN_PluginStateContext*)stateCtx;
-
-    cplug_assert(stateCtx != NULL);
-    cplug_assert(readPos != NULL);
-    cplug_assert(maxBytesToRead > 0);
-
-    SIZE_T remainingBytes     = ctx->BytesWritten - ctx->BytesRead;
-    SIZE_T bytesToActualyRead = maxBytesToRead > remainingBytes ? remainingBytes : maxBytesToRead;
-
-    if (bytesToActualyRead)
-    {
-        memcpy(readPos, ctx->Data + ctx->BytesRead, bytesToActualyRead);
-        ctx->BytesRead += bytesToActualyRead;
-    }
-
-    return bytesToActualyRead;
-}
-#pragma endregion PLUGIN_STATE
-
 DWORD WINAPI CPWIN_WatchFileChangesProc(LPVOID hwnd)
 {
     // Most this code was taken from here: https://gist.github.com/nickav/a57009d4fcc3b527ed0f5c9cf30618f8
@@ -1272,6 +1212,17 @@ bool CPWIN_Audio_dequeueEvent(struct CplugProcessContext* ctx, CplugEvent* event
     return true;
 }
 
+#if CPLUG_WANT_THREAD_POOL
+void CPWIN_Audio_parallelFor(
+    struct CplugProcessContext* ctx,
+    uint32_t                    taskCount,
+    cplug_taskProc              taskProc,
+    void*                       userdata)
+{
+    cplug_threadPool_parallelFor(g_cplugThreadPool, taskCount, taskProc, userdata);
+}
+#endif
+
 float** CPWIN_Audio_getAudioInput(const struct CplugProcessContext* ctx, uint32_t busIdx) { return NULL; }
 
 float** CPWIN_Audio_getAudioOutput(const struct CplugProcessContext* ctx, uint32_t busIdx)
@@ -1310,8 +1261,12 @@ void CPWIN_Audio_Process(const UINT32 blockSize)
     ctx.cplugContext.numFrames      = _gAudio.BlockSize;
     ctx.cplugContext.enqueueEvent   = CPWIN_Audio_enqueueEvent;
     ctx.cplugContext.dequeueEvent   = CPWIN_Audio_dequeueEvent;
+    ctx.cplugContext.dequeueEvents  = cplug_dequeueEventsSerially;
     ctx.cplugContext.getAudioInput  = CPWIN_Audio_getAudioInput;
     ctx.cplugContext.getAudioOutput = CPWIN_Audio_getAudioOutput;
+#if CPLUG_WANT_THREAD_POOL
+    ctx.cplugContext.parallelFor = CPWIN_Audio_parallelFor;
+#endif
 
     SIZE_T processBufferOffset = sizeof(float) * _gAudio.NumChannels * _gAudio.ProcessBufferMaxFrames;
     processBufferOffset        = CPWIN_RoundUp(processBufferOffset, 32);
@@ -1322,22 +1277,30 @@ void CPWIN_Audio_Process(const UINT32 blockSize)
     {
         cplug_assert(_gAudio.ProcessBufferNumOverprocessedFrames == 0);
 
+#if ! CPLUG_WANT_DENORMALS
+        uint64_t floatMode = cplug_disableDenormals();
+#endif
         _gCPLUG.process(_gCPLUG.UserPlugin, &ctx.cplugContext);
+#if ! CPLUG_WANT_DENORMALS
+        cplug_restoreDenormals(floatMode);
+#endif
 
         UINT32 framesToCopy = remainingBlockFrames < _gAudio.BlockSize ? remainingBlockFrames : _gAudio.BlockSize;
         SIZE_T bytesToCopy  = sizeof(float) * _gAudio.NumChannels * framesToCopy;
 
-        int    i                 = 0;
-        float* outputInterleaved = (float*)outBuffer;
-        for (; i < framesToCopy; i++)
-            for (int ch = 0; ch < _gAudio.NumChannels; ch++)
-                *outputInterleaved++ = ctx.output[ch][i];
-
-        float* remainingInterleaved = (float*)_gAudio.ProcessBuffer;
-        for (; i < _gAudio.BlockSize; i++)
-            for (int ch = 0; ch < _gAudio.NumChannels; ch++)
-                *remainingInterleaved++ = ctx.output[ch][i];
-        _gAudio.ProcessBufferNumOverprocessedFrames = _gAudio.BlockSize - framesToCopy;
+        cplug_interleave(outBuffer, CPLUG_SAMPLE_FLOAT32, ctx.output, _gAudio.NumChannels, framesToCopy, NULL);
+
+        // Frames that didn't fit are kept for the next callback
+        UINT32 framesRemaining = _gAudio.BlockSize - framesToCopy;
+        float* remaining[2]    = {ctx.output[0] + framesToCopy, ctx.output[1] + framesToCopy};
+        cplug_interleave(
+            _gAudio.ProcessBuffer,
+            CPLUG_SAMPLE_FLOAT32,
+            remaining,
+            _gAudio.NumChannels,
+            framesRemaining,
+            NULL);
+        _gAudio.ProcessBufferNumOverprocessedFrames = framesRemaining;
 
         remainingBlockFrames -= framesToCopy;
         outBuffer            += bytesToCopy;
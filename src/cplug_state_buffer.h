@@ -0,0 +1,202 @@
+/* Growable byte buffer for saving & loading plugin state, used by the standalones & AUv2.
+ * A large range of address space is reserved up front and pages are committed on demand as the state grows, so big
+ * states (eg. embedded samples) are written without realloc & copy cycles. The buffer only moves if a state outgrows
+ * the reservation, in which case a reservation twice the size is made and the written bytes copied over. */
+#ifndef CPLUG_STATE_BUFFER_H
+#define CPLUG_STATE_BUFFER_H
+
+#include <cplug.h>
+#include <string.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Address space only. Physical memory is used for committed pages only
+#ifndef CPLUG_STATE_BUFFER_RESERVE
+#if UINTPTR_MAX > 0xffffffff
+#define CPLUG_STATE_BUFFER_RESERVE (4ull << 30)
+#else
+#define CPLUG_STATE_BUFFER_RESERVE (256u << 20)
+#endif
+#endif
+// Smallest amount of memory committed at once
+#ifndef CPLUG_STATE_BUFFER_MIN_COMMIT
+#define CPLUG_STATE_BUFFER_MIN_COMMIT (64u << 10)
+#endif
+
+// Zero initialise before use
+typedef struct CplugStateBuffer
+{
+    uint8_t* data;
+    size_t   bytesReserved;
+    size_t   bytesCommitted;
+    // Optional. Address space reserved on the first write, grows by doubling. 0 uses CPLUG_STATE_BUFFER_RESERVE
+    size_t initialReserve;
+
+    size_t bytesWritten;
+    size_t bytesRead;
+} CplugStateBuffer;
+
+static size_t cplug_stateBuffer_roundUp(size_t numBytes, size_t alignment)
+{
+    return (numBytes + alignment - 1) / alignment * alignment;
+}
+
+static size_t cplug_stateBuffer_getPageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    long pageSize = sysconf(_SC_PAGESIZE);
+    return pageSize > 0 ? (size_t)pageSize : 4096;
+#endif
+}
+
+static uint8_t* cplug_stateBuffer_reserveMemory(size_t numBytes)
+{
+#ifdef _WIN32
+    return (uint8_t*)VirtualAlloc(NULL, numBytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void* ptr = mmap(NULL, numBytes, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    return ptr == MAP_FAILED ? NULL : (uint8_t*)ptr;
+#endif
+}
+
+static bool cplug_stateBuffer_commitMemory(uint8_t* ptr, size_t numBytes)
+{
+#ifdef _WIN32
+    return VirtualAlloc(ptr, numBytes, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(ptr, numBytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void cplug_stateBuffer_releaseMemory(uint8_t* ptr, size_t numBytes)
+{
+#ifdef _WIN32
+    (void)numBytes;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, numBytes);
+#endif
+}
+
+// Makes sure at least 'numBytes' from the start of the buffer are writable. Returns false if we're out of memory
+static bool cplug_stateBuffer_commit(CplugStateBuffer* buf, size_t numBytes)
+{
+    if (numBytes <= buf->bytesCommitted)
+        return true;
+
+    size_t pageSize   = cplug_stateBuffer_getPageSize();
+    size_t nextCommit = buf->bytesCommitted * 2;
+    if (nextCommit < numBytes)
+        nextCommit = numBytes;
+    if (nextCommit < CPLUG_STATE_BUFFER_MIN_COMMIT)
+        nextCommit = CPLUG_STATE_BUFFER_MIN_COMMIT;
+    nextCommit = cplug_stateBuffer_roundUp(nextCommit, pageSize);
+
+    if (nextCommit > buf->bytesReserved)
+    {
+        size_t nextReserve = buf->bytesReserved * 2;
+        if (nextReserve == 0)
+            nextReserve = buf->initialReserve ? buf->initialReserve : CPLUG_STATE_BUFFER_RESERVE;
+        if (nextReserve < nextCommit)
+            nextReserve = nextCommit;
+        nextReserve = cplug_stateBuffer_roundUp(nextReserve, pageSize);
+
+        uint8_t* data = cplug_stateBuffer_reserveMemory(nextReserve);
+        CPLUG_LOG_ASSERT_RETURN(data != NULL, false);
+        if (! cplug_stateBuffer_commitMemory(data, nextCommit))
+        {
+            cplug_log("cplug_stateBuffer_commit => Failed to commit %zu bytes", nextCommit);
+            cplug_stateBuffer_releaseMemory(data, nextReserve);
+            return false;
+        }
+
+        if (buf->data != NULL)
+        {
+            memcpy(data, buf->data, buf->bytesWritten);
+            cplug_stateBuffer_releaseMemory(buf->data, buf->bytesReserved);
+        }
+        buf->data          = data;
+        buf->bytesReserved = nextReserve;
+    }
+    else if (! cplug_stateBuffer_commitMemory(buf->data, nextCommit))
+    {
+        cplug_log("cplug_stateBuffer_commit => Failed to commit %zu bytes", nextCommit);
+        return false;
+    }
+
+    buf->bytesCommitted = nextCommit;
+    return true;
+}
+
+static void cplug_stateBuffer_free(CplugStateBuffer* buf)
+{
+    size_t initialReserve = buf->initialReserve;
+    if (buf->data != NULL)
+        cplug_stateBuffer_releaseMemory(buf->data, buf->bytesReserved);
+    memset(buf, 0, sizeof(*buf));
+    buf->initialReserve = initialReserve;
+}
+
+// Call before saving a new state. Committed memory is kept for the next state
+static void cplug_stateBuffer_reset(CplugStateBuffer* buf)
+{
+    buf->bytesWritten = 0;
+    buf->bytesRead    = 0;
+}
+
+// Pass to cplug_saveState with a CplugStateBuffer* as the stateCtx
+static int64_t cplug_stateBuffer_writeProc(const void* stateCtx, void* writePos, size_t numBytesToWrite)
+{
+    CplugStateBuffer* buf = (CplugStateBuffer*)stateCtx;
+    CPLUG_LOG_ASSERT_RETURN(buf != NULL, -1);
+    CPLUG_LOG_ASSERT_RETURN(writePos != NULL || numBytesToWrite == 0, -1);
+
+    if (! cplug_stateBuffer_commit(buf, buf->bytesWritten + numBytesToWrite))
+        return -1;
+
+    if (numBytesToWrite)
+        memcpy(buf->data + buf->bytesWritten, writePos, numBytesToWrite);
+    buf->bytesWritten += numBytesToWrite;
+    return numBytesToWrite;
+}
+
+// Pass to cplug_loadState with a CplugStateBuffer* as the stateCtx. Reads from 'bytesRead' up to 'bytesWritten'
+static int64_t cplug_stateBuffer_readProc(const void* stateCtx, void* readPos, size_t maxBytesToRead)
+{
+    CplugStateBuffer* buf = (CplugStateBuffer*)stateCtx;
+    CPLUG_LOG_ASSERT_RETURN(buf != NULL, -1);
+    CPLUG_LOG_ASSERT_RETURN(readPos != NULL || maxBytesToRead == 0, -1);
+
+    size_t remainingBytes     = buf->bytesWritten - buf->bytesRead;
+    size_t bytesToActualyRead = maxBytesToRead > remainingBytes ? remainingBytes : maxBytesToRead;
+
+    if (bytesToActualyRead)
+    {
+        memcpy(readPos, buf->data + buf->bytesRead, bytesToActualyRead);
+        buf->bytesRead += bytesToActualyRead;
+    }
+
+    return bytesToActualyRead;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CPLUG_STATE_BUFFER_H
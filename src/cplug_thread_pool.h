@@ -0,0 +1,343 @@
+/* Worker pool used to implement parallelFor in CplugProcessContext when the host doesn't provide a thread pool.
+ * Included by the VST3, CLAP & standalone implementations when CPLUG_WANT_THREAD_POOL is set.
+ * Workers are pinned to a core each. After finishing a job they spin for a short while waiting for the next one, which
+ * is likely to arrive in the next process callback, then go to sleep until they are woken.
+ * One pool is shared by every plugin instance in the process, see cplug_threadPool_acquire. */
+#ifndef CPLUG_THREAD_POOL_H
+#define CPLUG_THREAD_POOL_H
+
+#include <cplug.h>
+#include <string.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#ifndef __cplusplus
+// unistd.h only declares this with _DEFAULT_SOURCE or _GNU_SOURCE
+long syscall(long number, ...);
+#endif
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CPLUG_THREAD_POOL_MAX_THREADS
+#define CPLUG_THREAD_POOL_MAX_THREADS 16
+#endif
+// Number of times a worker checks for a new job before sleeping. Roughly 50-100us on most machines
+#ifndef CPLUG_THREAD_POOL_SPIN_COUNT
+#define CPLUG_THREAD_POOL_SPIN_COUNT 4096
+#endif
+
+#if defined(_WIN32)
+#define cplug_threadPool_pause() YieldProcessor()
+#elif defined(__x86_64__) || defined(__i386__)
+#define cplug_threadPool_pause() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define cplug_threadPool_pause() __asm__ __volatile__("yield")
+#else
+#define cplug_threadPool_pause()
+#endif
+
+// Double buffered so a worker still reading the previous job never sees the current job being written
+typedef struct CplugThreadPoolJob
+{
+    cplug_taskProc taskProc;
+    void*          userdata;
+    uint32_t       taskCount;
+} CplugThreadPoolJob;
+
+typedef struct CplugThreadPool
+{
+    // Low 16 bits: next task index to claim. High 16 bits: generation of the job the index belongs to.
+    // Claiming with a compare exchange prevents workers late to the previous job from claiming tasks of the current one
+    cplug_atomic_i32 taskCounter;
+    char             _pad0[CPLUG_CACHE_LINE_SIZE - sizeof(cplug_atomic_i32)];
+    cplug_atomic_i32 numTasksRemaining;
+    char             _pad1[CPLUG_CACHE_LINE_SIZE - sizeof(cplug_atomic_i32)];
+    cplug_atomic_i32 generation;
+    cplug_atomic_i32 numSleeping;
+    cplug_atomic_i32 quit;
+    // Set while a thread is running a job. Other callers run their tasks themselves
+    cplug_atomic_i32 busy;
+
+    CplugThreadPoolJob jobs[2];
+    uint32_t           numThreads;
+
+#ifdef _WIN32
+    HANDLE semaphore;
+    HANDLE threads[CPLUG_THREAD_POOL_MAX_THREADS];
+#else
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    uint32_t        numWakeups;
+    pthread_t       threads[CPLUG_THREAD_POOL_MAX_THREADS];
+#endif
+} CplugThreadPool;
+
+typedef struct CplugThreadPoolWorker
+{
+    CplugThreadPool* pool;
+    uint32_t         coreIdx;
+} CplugThreadPoolWorker;
+
+static uint32_t cplug_threadPool_getNumCores()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+    return numCores > 0 ? (uint32_t)numCores : 1;
+#endif
+}
+
+static void cplug_threadPool_sleep(CplugThreadPool* pool)
+{
+#ifdef _WIN32
+    WaitForSingleObject(pool->semaphore, INFINITE);
+#else
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->numWakeups == 0)
+        pthread_cond_wait(&pool->cond, &pool->mutex);
+    pool->numWakeups--;
+    pthread_mutex_unlock(&pool->mutex);
+#endif
+}
+
+static void cplug_threadPool_wake(CplugThreadPool* pool, uint32_t numThreads)
+{
+#ifdef _WIN32
+    ReleaseSemaphore(pool->semaphore, numThreads, NULL);
+#else
+    pthread_mutex_lock(&pool->mutex);
+    pool->numWakeups += numThreads;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+#endif
+}
+
+// Claims & runs tasks until every task of the job has been claimed, or the job is no longer current
+static void cplug_threadPool_work(CplugThreadPool* pool, uint32_t generation)
+{
+    const CplugThreadPoolJob* job = &pool->jobs[generation & 1];
+    for (;;)
+    {
+        uint32_t counter = (uint32_t)cplug_atomic_load_acquire_i32(&pool->taskCounter);
+        uint32_t taskIdx = counter & 0xffff;
+        if ((counter >> 16) != (generation & 0xffff) || taskIdx >= job->taskCount)
+            break;
+        if (cplug_atomic_compare_exchange_i32(&pool->taskCounter, (int)counter, (int)(counter + 1)))
+        {
+            job->taskProc(job->userdata, taskIdx);
+            cplug_atomic_fetch_add_i32(&pool->numTasksRemaining, -1);
+        }
+    }
+}
+
+static void cplug_threadPool_pinToCore(uint32_t coreIdx)
+{
+#if defined(_WIN32)
+    if (coreIdx < sizeof(DWORD_PTR) * 8)
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << coreIdx);
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#elif defined(__linux__)
+    // The raw syscall works without _GNU_SOURCE, which would have to be defined before the first system include.
+    // A thread ID of 0 is the calling thread
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {0};
+    if (coreIdx >= 1024)
+        return;
+    mask[coreIdx / (8 * sizeof(unsigned long))] = 1ul << (coreIdx % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) != 0)
+        cplug_log("cplug_threadPool_pinToCore => Failed to pin thread to core %u", coreIdx);
+#else
+    // Apple platforms don't support pinning threads to cores
+    (void)coreIdx;
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI cplug_threadPool_run(LPVOID arg)
+#else
+static void* cplug_threadPool_run(void* arg)
+#endif
+{
+    CplugThreadPoolWorker worker = *(CplugThreadPoolWorker*)arg;
+    free(arg);
+    CplugThreadPool* pool = worker.pool;
+    cplug_threadPool_pinToCore(worker.coreIdx);
+#if ! CPLUG_WANT_DENORMALS
+    // Tasks are part of cplug_process, so they run with the same floating point mode
+    cplug_disableDenormals();
+#endif
+
+    uint32_t generation = (uint32_t)cplug_atomic_load_acquire_i32(&pool->generation);
+    while (! cplug_atomic_load_acquire_i32(&pool->quit))
+    {
+        uint32_t numSpins = 0;
+        uint32_t next     = (uint32_t)cplug_atomic_load_acquire_i32(&pool->generation);
+        while (next == generation && ! cplug_atomic_load_acquire_i32(&pool->quit))
+        {
+            if (numSpins++ < CPLUG_THREAD_POOL_SPIN_COUNT)
+            {
+                cplug_threadPool_pause();
+            }
+            else
+            {
+                // Announce we're sleeping before checking for work one last time. A missed wakeup is impossible,
+                // though a stale one may wake this thread early, which is harmless
+                cplug_atomic_fetch_add_i32(&pool->numSleeping, 1);
+                if ((uint32_t)cplug_atomic_load_acquire_i32(&pool->generation) == generation &&
+                    ! cplug_atomic_load_acquire_i32(&pool->quit))
+                    cplug_threadPool_sleep(pool);
+                numSpins = 0;
+            }
+            next = (uint32_t)cplug_atomic_load_acquire_i32(&pool->generation);
+        }
+        generation = next;
+        cplug_threadPool_work(pool, generation);
+    }
+    return 0;
+}
+
+// [main thread] Returns NULL when the machine only has a single core
+static CplugThreadPool* cplug_threadPool_create()
+{
+    uint32_t numThreads = cplug_threadPool_getNumCores() - 1;
+    if (numThreads > CPLUG_THREAD_POOL_MAX_THREADS)
+        numThreads = CPLUG_THREAD_POOL_MAX_THREADS;
+    if (numThreads == 0)
+        return NULL;
+
+    CplugThreadPool* pool = (CplugThreadPool*)calloc(1, sizeof(CplugThreadPool));
+    CPLUG_LOG_ASSERT_RETURN(pool != NULL, NULL);
+#ifdef _WIN32
+    pool->semaphore = CreateSemaphoreA(NULL, 0, MAXLONG, NULL);
+#else
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+#endif
+
+    // Core 0 is left for the host
+    for (uint32_t i = 0; i < numThreads; i++)
+    {
+        CplugThreadPoolWorker* worker = (CplugThreadPoolWorker*)malloc(sizeof(CplugThreadPoolWorker));
+        worker->pool                  = pool;
+        worker->coreIdx               = i + 1;
+#ifdef _WIN32
+        pool->threads[i] = CreateThread(NULL, 0, cplug_threadPool_run, worker, 0, NULL);
+        bool started     = pool->threads[i] != NULL;
+#else
+        bool started = pthread_create(&pool->threads[i], NULL, cplug_threadPool_run, worker) == 0;
+#endif
+        if (! started)
+        {
+            cplug_log("cplug_threadPool_create => Failed to start thread %u", i);
+            free(worker);
+            break;
+        }
+        pool->numThreads++;
+    }
+    return pool;
+}
+
+// [main thread] Make sure no other thread is inside cplug_threadPool_parallelFor
+static void cplug_threadPool_destroy(CplugThreadPool* pool)
+{
+    if (pool == NULL)
+        return;
+    cplug_atomic_store_release_i32(&pool->quit, 1);
+    cplug_threadPool_wake(pool, pool->numThreads);
+    for (uint32_t i = 0; i < pool->numThreads; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+#ifdef _WIN32
+    CloseHandle(pool->semaphore);
+#else
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+#endif
+    free(pool);
+}
+
+// [audio thread] Safe to call from many threads at once. Jobs are serialised: while the pool is busy with another
+// caller's job, the tasks run on the calling thread instead, as the workers are already occupied
+static void cplug_threadPool_parallelFor(
+    CplugThreadPool* pool,
+    uint32_t         taskCount,
+    cplug_taskProc   taskProc,
+    void*            userdata)
+{
+    CPLUG_LOG_ASSERT(taskCount <= 0xffff);
+    if (pool == NULL || pool->numThreads == 0 || taskCount <= 1 || taskCount > 0xffff ||
+        ! cplug_atomic_compare_exchange_i32(&pool->busy, 0, 1))
+    {
+        for (uint32_t i = 0; i < taskCount; i++)
+            taskProc(userdata, i);
+        return;
+    }
+
+    uint32_t            generation = (uint32_t)cplug_atomic_load_acquire_i32(&pool->generation) + 1;
+    CplugThreadPoolJob* job        = &pool->jobs[generation & 1];
+    job->taskProc                  = taskProc;
+    job->userdata                  = userdata;
+    job->taskCount                 = taskCount;
+
+    cplug_atomic_store_release_i32(&pool->numTasksRemaining, (int)taskCount);
+    cplug_atomic_store_release_i32(&pool->taskCounter, (int)((generation & 0xffff) << 16));
+    cplug_atomic_store_release_i32(&pool->generation, (int)generation);
+
+    uint32_t numSleeping = (uint32_t)cplug_atomic_exchange_i32(&pool->numSleeping, 0);
+    if (numSleeping)
+        cplug_threadPool_wake(pool, numSleeping);
+
+    cplug_threadPool_work(pool, generation);
+    while (cplug_atomic_load_acquire_i32(&pool->numTasksRemaining) != 0)
+        cplug_threadPool_pause();
+    cplug_atomic_store_release_i32(&pool->busy, 0);
+}
+
+// One pool for every plugin instance in the process, so 50 instances don't start 50 sets of workers on the same cores
+static CplugThreadPool* g_cplugThreadPool         = NULL;
+static uint32_t         g_cplugThreadPoolRefCount = 0;
+
+// [main thread] The wrappers call this next to cplug_libraryLoad. The first call creates the shared pool
+static void cplug_threadPool_acquire()
+{
+    if (g_cplugThreadPoolRefCount++ == 0)
+        g_cplugThreadPool = cplug_threadPool_create();
+}
+
+// [main thread] The wrappers call this next to cplug_libraryUnload. The last call destroys the shared pool
+static void cplug_threadPool_release()
+{
+    CPLUG_LOG_ASSERT_RETURN(g_cplugThreadPoolRefCount > 0, );
+    if (--g_cplugThreadPoolRefCount == 0)
+    {
+        cplug_threadPool_destroy(g_cplugThreadPool);
+        g_cplugThreadPool = NULL;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CPLUG_THREAD_POOL_H
@@ -0,0 +1,373 @@
+/* UTF-8 <-> UTF-16 conversion, used for the VST3 strings (names, parameter text, class infos).
+ * Runs of ASCII are widened/narrowed a vector at a time (SSE2, AVX2 or NEON), everything else goes through a validating
+ * scalar path. Malformed input is replaced with U+FFFD, one per maximal subpart as recommended by the Unicode standard.
+ * Output is truncated on a character boundary and always null terminated, like Steinberg's String128 helpers. */
+#ifndef CPLUG_UTF_H
+#define CPLUG_UTF_H
+
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPLUG_UTF_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define CPLUG_UTF_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define CPLUG_UTF_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CPLUG_UTF_REPLACEMENT_CHARACTER 0xfffd
+
+#if defined(CPLUG_UTF_SSE2) || defined(CPLUG_UTF_AVX2)
+// Index of the lowest set bit. 'mask' must not be 0
+static uint32_t cplug_utf_ctz(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return idx;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Decodes one character from 'src', which has at least 1 byte. Returns the number of bytes consumed
+static uint32_t cplug_utf_decode8(const uint8_t* src, uint32_t srcLength, uint32_t* cp)
+{
+    uint32_t b0 = src[0];
+    if (b0 < 0x80)
+    {
+        *cp = b0;
+        return 1;
+    }
+
+    // Complete 2 & 3 byte characters, the common case for non latin text
+    if (b0 >= 0xc2 && b0 <= 0xdf && srcLength >= 2 && (src[1] & 0xc0) == 0x80)
+    {
+        *cp = ((b0 & 0x1f) << 6) | (src[1] & 0x3f);
+        return 2;
+    }
+    if ((b0 & 0xf0) == 0xe0 && srcLength >= 3 && (src[1] & 0xc0) == 0x80 && (src[2] & 0xc0) == 0x80)
+    {
+        uint32_t c = ((b0 & 0x0f) << 12) | ((src[1] & 0x3f) << 6) | (src[2] & 0x3f);
+        if (c >= 0x800 && (c < 0xd800 || c > 0xdfff))
+        {
+            *cp = c;
+            return 3;
+        }
+    }
+
+    // Valid range of the byte after the lead byte. Narrowed to reject overlongs, surrogates & values > U+10FFFF
+    uint32_t lo = 0x80, hi = 0xbf;
+    uint32_t numBytes;
+    if (b0 >= 0xc2 && b0 <= 0xdf)
+    {
+        numBytes = 2;
+        *cp      = b0 & 0x1f;
+    }
+    else if (b0 >= 0xe0 && b0 <= 0xef)
+    {
+        numBytes = 3;
+        *cp      = b0 & 0x0f;
+        lo       = b0 == 0xe0 ? 0xa0 : lo;
+        hi       = b0 == 0xed ? 0x9f : hi;
+    }
+    else if (b0 >= 0xf0 && b0 <= 0xf4)
+    {
+        numBytes = 4;
+        *cp      = b0 & 0x07;
+        lo       = b0 == 0xf0 ? 0x90 : lo;
+        hi       = b0 == 0xf4 ? 0x8f : hi;
+    }
+    else
+    {
+        *cp = CPLUG_UTF_REPLACEMENT_CHARACTER;
+        return 1;
+    }
+
+    for (uint32_t i = 1; i < numBytes; i++)
+    {
+        if (i >= srcLength || src[i] < lo || src[i] > hi)
+        {
+            *cp = CPLUG_UTF_REPLACEMENT_CHARACTER;
+            return i;
+        }
+        *cp = (*cp << 6) | (src[i] & 0x3f);
+        lo  = 0x80;
+        hi  = 0xbf;
+    }
+    return numBytes;
+}
+
+// Decodes one character from 'src', which has at least 1 unit. Returns the number of units consumed
+static uint32_t cplug_utf_decode16(const uint16_t* src, uint32_t srcLength, uint32_t* cp)
+{
+    uint32_t u0 = src[0];
+    if (u0 < 0xd800 || u0 > 0xdfff)
+    {
+        *cp = u0;
+        return 1;
+    }
+    if (u0 <= 0xdbff && srcLength > 1 && src[1] >= 0xdc00 && src[1] <= 0xdfff)
+    {
+        *cp = 0x10000 + ((u0 - 0xd800) << 10) + (src[1] - 0xdc00);
+        return 2;
+    }
+    *cp = CPLUG_UTF_REPLACEMENT_CHARACTER;
+    return 1;
+}
+
+/* Converts up to 'srcLength' bytes of 'src', stopping early at a null terminator.
+ * Writes at most 'dstCapacity' units including the null terminator. Returns the number of units written, excluding the
+ * terminator */
+static uint32_t cplug_utf8To16(uint16_t* dst, uint32_t dstCapacity, const char* src, uint32_t srcLength)
+{
+    if (dstCapacity == 0)
+        return 0;
+
+    const uint8_t* in     = (const uint8_t*)src;
+    const uint8_t* inEnd  = in + srcLength;
+    uint16_t*      out    = dst;
+    uint16_t*      outEnd = dst + dstCapacity - 1; // Keep room for the terminator
+
+    while (in < inEnd && *in != 0)
+    {
+        // The whole vector is stored, but we only advance past the ASCII characters before the first non ASCII or null.
+        // Only tried when the next character is ASCII, so text in other scripts doesn't pay for it on every character
+        if (*in < 0x80)
+        {
+#if defined(CPLUG_UTF_AVX2)
+            while (inEnd - in >= 32 && outEnd - out >= 32)
+            {
+                __m256i  v    = _mm256_loadu_si256((const __m256i*)in);
+                __m256i  nul  = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+                uint32_t stop = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(v, nul));
+                _mm256_storeu_si256((__m256i*)out, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+                _mm256_storeu_si256((__m256i*)(out + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+                if (stop)
+                {
+                    uint32_t n  = cplug_utf_ctz(stop);
+                    in         += n;
+                    out        += n;
+                    break;
+                }
+                in  += 32;
+                out += 32;
+            }
+#endif
+#if defined(CPLUG_UTF_SSE2)
+            while (inEnd - in >= 16 && outEnd - out >= 16)
+            {
+                __m128i  zero = _mm_setzero_si128();
+                __m128i  v    = _mm_loadu_si128((const __m128i*)in);
+                uint32_t stop = (uint32_t)_mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, zero)));
+                _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(v, zero));
+                _mm_storeu_si128((__m128i*)(out + 8), _mm_unpackhi_epi8(v, zero));
+                if (stop)
+                {
+                    uint32_t n  = cplug_utf_ctz(stop);
+                    in         += n;
+                    out        += n;
+                    break;
+                }
+                in  += 16;
+                out += 16;
+            }
+#elif defined(CPLUG_UTF_NEON)
+            while (inEnd - in >= 16 && outEnd - out >= 16)
+            {
+                uint8x16_t v = vld1q_u8(in);
+                if (vmaxvq_u8(v) >= 0x80 || vminvq_u8(v) == 0)
+                    break;
+                vst1q_u16(out, vmovl_u8(vget_low_u8(v)));
+                vst1q_u16(out + 8, vmovl_high_u8(v));
+                in  += 16;
+                out += 16;
+            }
+#endif
+            if (in == inEnd || *in == 0)
+                break;
+            // Leftovers shorter than a vector
+            if (*in < 0x80)
+            {
+                if (out == outEnd)
+                    break;
+                *out++ = *in++;
+                continue;
+            }
+        }
+
+        uint32_t cp;
+        uint32_t numBytes = cplug_utf_decode8(in, (uint32_t)(inEnd - in), &cp);
+        if (cp < 0x10000)
+        {
+            if (out == outEnd)
+                break;
+            *out++ = (uint16_t)cp;
+        }
+        else
+        {
+            if (outEnd - out < 2)
+                break;
+            cp     -= 0x10000;
+            *out++  = (uint16_t)(0xd800 | (cp >> 10));
+            *out++  = (uint16_t)(0xdc00 | (cp & 0x3ff));
+        }
+        in += numBytes;
+    }
+    *out = 0;
+    return (uint32_t)(out - dst);
+}
+
+/* Converts up to 'srcLength' units of 'src', stopping early at a null terminator.
+ * Writes at most 'dstCapacity' bytes including the null terminator. Returns the number of bytes written, excluding the
+ * terminator */
+static uint32_t cplug_utf16To8(char* dst, uint32_t dstCapacity, const uint16_t* src, uint32_t srcLength)
+{
+    if (dstCapacity == 0)
+        return 0;
+
+    const uint16_t* in     = src;
+    const uint16_t* inEnd  = src + srcLength;
+    uint8_t*        out    = (uint8_t*)dst;
+    uint8_t*        outEnd = out + dstCapacity - 1; // Keep room for the terminator
+
+    while (in < inEnd && *in != 0)
+    {
+        if (*in < 0x80)
+        {
+#if defined(CPLUG_UTF_AVX2)
+            while (inEnd - in >= 32 && outEnd - out >= 32)
+            {
+                __m256i zero   = _mm256_setzero_si256();
+                __m256i notAsc = _mm256_set1_epi16((short)0xff80);
+                __m256i v0     = _mm256_loadu_si256((const __m256i*)in);
+                __m256i v1     = _mm256_loadu_si256((const __m256i*)(in + 16));
+                // 0xffff for every unit that's ASCII and not null
+                __m256i ok0 = _mm256_andnot_si256(
+                    _mm256_cmpeq_epi16(v0, zero),
+                    _mm256_cmpeq_epi16(_mm256_and_si256(v0, notAsc), zero));
+                __m256i ok1 = _mm256_andnot_si256(
+                    _mm256_cmpeq_epi16(v1, zero),
+                    _mm256_cmpeq_epi16(_mm256_and_si256(v1, notAsc), zero));
+                // Packing works within 128 bit lanes, so the 64 bit quarters need reordering
+                __m256i  bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(v0, v1), 0xd8);
+                __m256i  oks   = _mm256_permute4x64_epi64(_mm256_packs_epi16(ok0, ok1), 0xd8);
+                uint32_t stop  = ~(uint32_t)_mm256_movemask_epi8(oks);
+                _mm256_storeu_si256((__m256i*)out, bytes);
+                if (stop)
+                {
+                    uint32_t n  = cplug_utf_ctz(stop);
+                    in         += n;
+                    out        += n;
+                    break;
+                }
+                in  += 32;
+                out += 32;
+            }
+#endif
+#if defined(CPLUG_UTF_SSE2)
+            while (inEnd - in >= 16 && outEnd - out >= 16)
+            {
+                __m128i  zero   = _mm_setzero_si128();
+                __m128i  notAsc = _mm_set1_epi16((short)0xff80);
+                __m128i  v0     = _mm_loadu_si128((const __m128i*)in);
+                __m128i  v1     = _mm_loadu_si128((const __m128i*)(in + 8));
+                __m128i  ok0    = _mm_andnot_si128(
+                    _mm_cmpeq_epi16(v0, zero),
+                    _mm_cmpeq_epi16(_mm_and_si128(v0, notAsc), zero));
+                __m128i  ok1    = _mm_andnot_si128(
+                    _mm_cmpeq_epi16(v1, zero),
+                    _mm_cmpeq_epi16(_mm_and_si128(v1, notAsc), zero));
+                uint32_t stop   = ~(uint32_t)_mm_movemask_epi8(_mm_packs_epi16(ok0, ok1)) & 0xffff;
+                _mm_storeu_si128((__m128i*)out, _mm_packus_epi16(v0, v1));
+                if (stop)
+                {
+                    uint32_t n  = cplug_utf_ctz(stop);
+                    in         += n;
+                    out        += n;
+                    break;
+                }
+                in  += 16;
+                out += 16;
+            }
+#elif defined(CPLUG_UTF_NEON)
+            while (inEnd - in >= 16 && outEnd - out >= 16)
+            {
+                uint16x8_t v0 = vld1q_u16(in);
+                uint16x8_t v1 = vld1q_u16(in + 8);
+                if (vmaxvq_u16(vmaxq_u16(v0, v1)) >= 0x80 || vminvq_u16(vminq_u16(v0, v1)) == 0)
+                    break;
+                vst1q_u8(out, vcombine_u8(vmovn_u16(v0), vmovn_u16(v1)));
+                in  += 16;
+                out += 16;
+            }
+#endif
+            if (in == inEnd || *in == 0)
+                break;
+            // Leftovers shorter than a vector
+            if (*in < 0x80)
+            {
+                if (out == outEnd)
+                    break;
+                *out++ = (uint8_t)*in++;
+                continue;
+            }
+        }
+
+        uint32_t cp;
+        uint32_t numUnits = cplug_utf_decode16(in, (uint32_t)(inEnd - in), &cp);
+        if (cp < 0x80)
+        {
+            if (out == outEnd)
+                break;
+            *out++ = (uint8_t)cp;
+        }
+        else if (cp < 0x800)
+        {
+            if (outEnd - out < 2)
+                break;
+            *out++ = (uint8_t)(0xc0 | (cp >> 6));
+            *out++ = (uint8_t)(0x80 | (cp & 0x3f));
+        }
+        else if (cp < 0x10000)
+        {
+            if (outEnd - out < 3)
+                break;
+            *out++ = (uint8_t)(0xe0 | (cp >> 12));
+            *out++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+            *out++ = (uint8_t)(0x80 | (cp & 0x3f));
+        }
+        else
+        {
+            if (outEnd - out < 4)
+                break;
+            *out++ = (uint8_t)(0xf0 | (cp >> 18));
+            *out++ = (uint8_t)(0x80 | ((cp >> 12) & 0x3f));
+            *out++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+            *out++ = (uint8_t)(0x80 | (cp & 0x3f));
+        }
+        in += numUnits;
+    }
+    *out = 0;
+    return (uint32_t)(out - (uint8_t*)dst);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CPLUG_UTF_H
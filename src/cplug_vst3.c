@@ -3,6 +3,10 @@
  * A special thanks goes to him for allowing the use of his code here.
  * Edited and ported to CPLUG by Tré Dudman */
 #include <cplug.h>
+#if CPLUG_WANT_THREAD_POOL
+#include <cplug_thread_pool.h>
+#endif
+#include <cplug_utf.h>
 #include <math.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -177,82 +181,20 @@ static inline const char* _cplug_getBusDirectionStr(int32_t type)
 }
 #endif
 
-// clang-format off
-// Taken from Richard Mitton & Randy Gaul (public domain)
-// https://github.com/RandyGaul/cute_headers_deprecated/blob/master/cute_utf.h
-const char* _cplug_decode8(const char* text, int* cp)
-{
-	unsigned char c = *text++;
-	int extra = 0, min = 0;
-	*cp = 0;
-    if      (c >= 0xF0) { *cp = c & 0x07; extra = 3; min = 0x10000; }
-	else if (c >= 0xE0) { *cp = c & 0x0F; extra = 2; min = 0x800; }
-	else if (c >= 0xC0) { *cp = c & 0x1F; extra = 1; min = 0x80; }
-	else if (c >= 0x80) { *cp = 0xFFFD; }
-	else                { *cp = c; }
-	while (extra--)
-	{
-		c = *text++;
-		if ((c & 0xC0) != 0x80) { *cp = 0xFFFD; break; }
-		(*cp) = ((*cp) << 6) | (c & 0x3F);
-	}
-	if (*cp < min) *cp = 0xFFFD;
-	return text;
-}
-char* _cplug_encode8(char *text, int cp)
-{
-	if (cp < 0 || cp > 0x10FFFF) cp = 0xFFFD;
-
-#define CU_EMIT(X, Y, Z) *text++ = X | ((cp >> Y) & Z)
-    if      (cp <    0x80) { CU_EMIT(0x00,0,0x7F); }
-	else if (cp <   0x800) { CU_EMIT(0xC0,6,0x1F); CU_EMIT(0x80, 0,  0x3F); }
-	else if (cp < 0x10000) { CU_EMIT(0xE0,12,0xF); CU_EMIT(0x80, 6,  0x3F); CU_EMIT(0x80, 0, 0x3F); }
-	else                   { CU_EMIT(0xF0,18,0x7); CU_EMIT(0x80, 12, 0x3F); CU_EMIT(0x80, 6, 0x3F); CU_EMIT(0x80, 0, 0x3F); }
-#undef CU_EMIT
-	return text;
-}
-char16_t* _cplug_encode16(char16_t* text, int cp)
-{
-	if (cp < 0x10000) *text++ = cp;
-	else
-	{
-		cp -= 0x10000;
-		*text++ = 0xD800 | ((cp >> 10) & 0x03FF);
-		*text++ = 0xDC00 | (cp & 0x03FF);
-	}
-	return text;
-}
-const char16_t* _cplug_decode16(const char16_t* text, int* cp)
-{
-	int in = *text++;
-	if (in < 0xD800 || in > 0xDFFF) *cp = in;
-	else if (in > 0xD800 && in < 0xDBFF) *cp = ((in & 0x03FF) << 10) | (*text++ & 0x03FF);
-	else *cp = 0xFFFD;
-	return text;
-}
-void _cplug_utf8To16(char16_t* dst, const char* src, int len)
-{
-    char16_t* it = dst;
-    int cp;
-    while (*src && (it < dst + len - 1))
-    {
-        src = _cplug_decode8(src, &cp);
-        it  = _cplug_encode16(it, cp);
-    }
-    *it = 0;
+// 'len' is the capacity of 'dst' in units, including the null terminator
+static void _cplug_utf8To16(char16_t* dst, const char* src, int len)
+{
+    cplug_utf8To16((uint16_t*)dst, (uint32_t)len, src, (uint32_t)strlen(src));
 }
-void _cplug_utf16To8(char* dst, const char16_t* src, int len)
+// Host strings are null terminated, but their buffer size is unknown. Every unit makes at least 1 byte, so we never
+// need to look past 'len' units
+static void _cplug_utf16To8(char* dst, const char16_t* src, int len)
 {
-	char* it = dst;
-	int cp;
-	while (*src && (it < dst + len - 1))
-	{
-		src = _cplug_decode16(src, &cp);
-		it  = _cplug_encode8(it, cp);
-	}
-    *it = 0;
+    uint32_t srcLength = 0;
+    while (srcLength < (uint32_t)len && src[srcLength])
+        srcLength++;
+    cplug_utf16To8(dst, (uint32_t)len, (const uint16_t*)src, srcLength);
 }
-// clang-format on
 
 /*----------------------------------------------------------------------------------------------------------------------
 Structs */
@@ -303,6 +245,29 @@ typedef struct VST3Factory
     Steinberg_FUnknown* hostContext;
 } VST3Factory;
 
+// All MIDI & parameter events for a block, decoded & sorted by frame before calling cplug_process
+typedef struct VST3EventTimeline
+{
+    CplugEvent* events;
+    uint32_t*   frames;
+    uint32_t    numEvents;
+    uint32_t    capacity;
+
+    // Scratch space for counting sort. There is one bucket per quantized region ('cell') of the largest block
+    CplugEvent* unsortedEvents;
+    uint32_t*   unsortedFrames;
+    uint32_t*   cellOffsets;
+    uint32_t    numCells;
+
+#if CPLUG_WANT_DENSE_AUTOMATION && CPLUG_NUM_PARAMS
+    CplugAutomationPoint* automationPoints;
+    uint32_t              numAutomationPoints;
+    uint32_t              automationCapacity;
+    uint32_t              automationOffsets[CPLUG_NUM_PARAMS];
+    uint32_t              automationCounts[CPLUG_NUM_PARAMS];
+#endif
+} VST3EventTimeline;
+
 typedef struct VST3Plugin
 {
     void* userPlugin; // Pointer to your plugin lives here
@@ -318,8 +283,32 @@ typedef struct VST3Plugin
     // NOTE: We only assume that hosts aren't doubly stupid and only send these messages on the audio thread.
     size_t   midiContollerQueueSize;
     uint32_t midiContollerQueue[CPLUG_EVENT_QUEUE_SIZE];
+
+    uint32_t          eventQuantize;
+    uint32_t          renderMode;
+    VST3EventTimeline eventTimeline;
+#if CPLUG_WANT_PARAMETER_COOKIES && CPLUG_NUM_PARAMS
+    void* paramCookies[CPLUG_NUM_PARAMS];
+#endif
+#if CPLUG_WANT_PARAMETER_TEXT_CACHE
+    CplugParamTextCache paramTextCache; // Keyed by normalised value
+#endif
 } VST3Plugin;
 
+// Parameter IDs are indexes, unless CPLUG_WANT_SPARSE_PARAMETER_IDS is set. MIDI controller IDs map to invalid indexes
+#if CPLUG_WANT_SPARSE_PARAMETER_IDS && CPLUG_NUM_PARAMS
+static CplugParamIdMap g_vst3ParamIds;
+
+static inline Steinberg_Vst_ParamID VST3Params_getID(uint32_t index) { return g_vst3ParamIds.ids[index]; }
+static inline uint32_t VST3Params_getIndex(Steinberg_Vst_ParamID id)
+{
+    return cplug_paramIdMap_find(&g_vst3ParamIds, id);
+}
+#else
+static inline Steinberg_Vst_ParamID VST3Params_getID(uint32_t index) { return index; }
+static inline uint32_t              VST3Params_getIndex(Steinberg_Vst_ParamID id) { return id; }
+#endif
+
 // Naughty pointer shifting for VST3 classes
 static VST3Plugin* _cplug_pointerShiftController(VST3Controller* ptr)
 {
@@ -363,6 +352,10 @@ static int _cplug_tryDeleteVST3(VST3Plugin* vst3)
 
     cplug_log("_cplug_tryDeleteVST3 %p | all refcounts are zero, deleting everything!", vst3);
 
+    free(vst3->eventTimeline.events);
+#if CPLUG_WANT_DENSE_AUTOMATION && CPLUG_NUM_PARAMS
+    free(vst3->eventTimeline.automationPoints);
+#endif
     free(vst3);
 
     // If we previously stored a ptr that looked like a leak, we remove it
@@ -680,7 +673,8 @@ Steinberg_tresult SMTG_STDMETHODCALLTYPE VST3MidiMapping_getMidiControllerAssign
     CPLUG_LOG_ASSERT_RETURN(
         midiControllerNumber < Steinberg_Vst_ControllerNumbers_kCountCtrlNumber,
         Steinberg_kResultFalse);
-    *id = cplug_midiControllerOffset + channel * 16 + midiControllerNumber;
+    *id = cplug_midiControllerOffset + channel * Steinberg_Vst_ControllerNumbers_kCountCtrlNumber;
+    *id += midiControllerNumber;
     return Steinberg_kResultTrue;
 }
 
@@ -778,20 +772,22 @@ static int32_t SMTG_STDMETHODCALLTYPE VST3Controller_getParameterCount(void* sel
     return CPLUG_NUM_PARAMS;
 }
 
-static Steinberg_tresult SMTG_STDMETHODCALLTYPE
-VST3Controller_getParameterInfo(void* self, int32_t index, struct Steinberg_Vst_ParameterInfo* info)
-{
-    // cplug_log("VST3Controller_getParameterInfo => %p %i", self, index);
-    VST3Plugin* const vst3 = _cplug_pointerShiftController((VST3Controller*)self);
+#if defined(CPLUG_PARAMETER_DESCRIPTORS) && CPLUG_NUM_PARAMS
+// Built once in ModuleEntry from your descriptors, then copied out to the host
+static struct Steinberg_Vst_ParameterInfo g_vst3ParamInfos[CPLUG_NUM_PARAMS];
+#endif
 
+static void VST3Controller_fillParameterInfo(
+    struct Steinberg_Vst_ParameterInfo* info,
+    uint32_t                            index,
+    const char*                         name,
+    double                              min,
+    double                              max,
+    double                              defaultNormalised,
+    uint32_t                            hints)
+{
     memset(info, 0, sizeof(*info));
-    CPLUG_LOG_ASSERT_RETURN(index >= 0 && index < CPLUG_NUM_PARAMS, Steinberg_kInvalidArgument);
-    info->id = index;
-
-    // set up flags
-    double min, max;
-    cplug_getParameterRange(vst3->userPlugin, index, &min, &max);
-    const uint32_t hints = cplug_getParameterFlags(vst3->userPlugin, index);
+    info->id = VST3Params_getID(index);
 
     if (hints & CPLUG_FLAG_PARAMETER_IS_AUTOMATABLE)
         info->flags |= Steinberg_Vst_ParameterInfo_ParameterFlags_kCanAutomate;
@@ -807,37 +803,91 @@ VST3Controller_getParameterInfo(void* self, int32_t index, struct Steinberg_Vst_
     else if (hints & CPLUG_FLAG_PARAMETER_IS_INTEGER)
         info->stepCount = (int)(max - min);
 
-    double defaultValue          = cplug_getDefaultParameterValue(vst3->userPlugin, index);
-    info->defaultNormalizedValue = cplug_normaliseParameterValue(vst3->userPlugin, index, defaultValue);
-    _cplug_utf8To16(info->title, cplug_getParameterName(vst3->userPlugin, index), 128);
+    info->defaultNormalizedValue = defaultNormalised;
+    _cplug_utf8To16(info->title, name, 128);
     // Who cares?
-    _cplug_utf8To16(info->shortTitle, cplug_getParameterName(vst3->userPlugin, index), 128);
+    _cplug_utf8To16(info->shortTitle, name, 128);
+}
+
+#if defined(CPLUG_PARAMETER_DESCRIPTORS) && CPLUG_NUM_PARAMS
+static void VST3Controller_buildParameterInfos()
+{
+    for (uint32_t i = 0; i < CPLUG_NUM_PARAMS; i++)
+    {
+        const CplugParamDescriptor* desc              = cplug_getParamDescriptor(i);
+        double                      defaultNormalised = cplug_paramDescriptor_normalise(desc, desc->defaultValue);
+        VST3Controller_fillParameterInfo(
+            &g_vst3ParamInfos[i],
+            i,
+            desc->name,
+            desc->min,
+            desc->max,
+            defaultNormalised,
+            desc->flags);
+    }
+}
+#endif
+
+static Steinberg_tresult SMTG_STDMETHODCALLTYPE
+VST3Controller_getParameterInfo(void* self, int32_t index, struct Steinberg_Vst_ParameterInfo* info)
+{
+    // cplug_log("VST3Controller_getParameterInfo => %p %i", self, index);
+    CPLUG_LOG_ASSERT_RETURN(index >= 0 && index < CPLUG_NUM_PARAMS, Steinberg_kInvalidArgument);
+
+#if defined(CPLUG_PARAMETER_DESCRIPTORS) && CPLUG_NUM_PARAMS
+    memcpy(info, &g_vst3ParamInfos[index], sizeof(*info));
+#else
+    VST3Plugin* const vst3 = _cplug_pointerShiftController((VST3Controller*)self);
+
+    double min, max;
+    cplug_getParameterRange(vst3->userPlugin, index, &min, &max);
+    double defaultValue = cplug_getDefaultParameterValue(vst3->userPlugin, index);
+    VST3Controller_fillParameterInfo(
+        info,
+        index,
+        cplug_getParameterName(vst3->userPlugin, index),
+        min,
+        max,
+        cplug_normaliseParameterValue(vst3->userPlugin, index, defaultValue),
+        cplug_getParameterFlags(vst3->userPlugin, index));
+#endif
     return Steinberg_kResultOk;
 }
 
 static Steinberg_tresult SMTG_STDMETHODCALLTYPE
-VST3Controller_getParamStringByValue(void* self, uint32_t index, double normalised, Steinberg_Vst_String128 output)
+VST3Controller_getParamStringByValue(void* self, uint32_t id, double normalised, Steinberg_Vst_String128 output)
 {
     // NOTE very noisy, called many times
-    // cplug_log("VST3Controller_getParamStringByValue => %p %u %f %p", self, index, normalised, output);
-    VST3Plugin* const vst3 = _cplug_pointerShiftController((VST3Controller*)self);
+    // cplug_log("VST3Controller_getParamStringByValue => %p %u %f %p", self, id, normalised, output);
+    VST3Plugin* const vst3  = _cplug_pointerShiftController((VST3Controller*)self);
+    const uint32_t    index = VST3Params_getIndex(id);
     // Bitwig 5 has been spotted failing this assertion
     CPLUG_LOG_ASSERT_RETURN(normalised >= 0.0 && normalised <= 1.0, Steinberg_kInvalidArgument);
     CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, Steinberg_kInvalidArgument);
 
+#if CPLUG_WANT_PARAMETER_TEXT_CACHE
+    uint32_t version = cplug_getParameterTextVersion(vst3->userPlugin);
+    if (cplug_paramTextCache_get(&vst3->paramTextCache, index, normalised, version, NULL, 0, (uint16_t*)output, 128))
+        return Steinberg_kResultOk;
+#endif
+
     char   buf[128];
     double denormalised = cplug_denormaliseParameterValue(vst3->userPlugin, index, normalised);
     cplug_parameterValueToString(vst3->userPlugin, index, buf, 128, denormalised);
     _cplug_utf8To16(output, buf, sizeof(buf));
+#if CPLUG_WANT_PARAMETER_TEXT_CACHE
+    cplug_paramTextCache_put(&vst3->paramTextCache, index, normalised, version, buf, (const uint16_t*)output);
+#endif
 
     return Steinberg_kResultOk;
 }
 
 static Steinberg_tresult SMTG_STDMETHODCALLTYPE
-VST3Controller_getParamValueByString(void* self, uint32_t index, char16_t* input, double* output)
+VST3Controller_getParamValueByString(void* self, uint32_t id, char16_t* input, double* output)
 {
-    // cplug_log("VST3Controller_getParamValueByString => %p %u %p %p", self, rindex, input, output);
-    VST3Plugin* const vst3 = _cplug_pointerShiftController((VST3Controller*)self);
+    // cplug_log("VST3Controller_getParamValueByString => %p %u %p %p", self, id, input, output);
+    VST3Plugin* const vst3  = _cplug_pointerShiftController((VST3Controller*)self);
+    const uint32_t    index = VST3Params_getIndex(id);
 
     CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, Steinberg_kInvalidArgument);
 
@@ -851,54 +901,57 @@ VST3Controller_getParamValueByString(void* self, uint32_t index, char16_t* input
 }
 
 static double SMTG_STDMETHODCALLTYPE
-VST3Controller_normalizedParamToPlain(void* self, uint32_t index, double normalised)
+VST3Controller_normalizedParamToPlain(void* self, uint32_t id, double normalised)
 {
     // Gets called a lot in ableton, even when you aren't touching parameters
-    // cplug_log("VST3Controller_normalizedParamToPlain => %p %u %f", self, rindex, normalised);
-    VST3Plugin* const vst3 = _cplug_pointerShiftController((VST3Controller*)self);
+    // cplug_log("VST3Controller_normalizedParamToPlain => %p %u %f", self, id, normalised);
+    VST3Plugin* const vst3  = _cplug_pointerShiftController((VST3Controller*)self);
+    const uint32_t    index = VST3Params_getIndex(id);
     CPLUG_LOG_ASSERT_RETURN(normalised >= 0.0 && normalised <= 1.0, 0.0);
     CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, 0.0);
 
     return cplug_denormaliseParameterValue(vst3->userPlugin, index, normalised);
 }
 
-static double SMTG_STDMETHODCALLTYPE VST3Controller_plainParamToNormalised(void* self, uint32_t index, double plain)
+static double SMTG_STDMETHODCALLTYPE VST3Controller_plainParamToNormalised(void* self, uint32_t id, double plain)
 {
     // Gets called a lot in ableton, even when you aren't touching parameters
-    // cplug_log("VST3Controller_plainParamToNormalised => %p %u %f", self, index, plain);
-    VST3Plugin* const vst3 = _cplug_pointerShiftController((VST3Controller*)self);
+    // cplug_log("VST3Controller_plainParamToNormalised => %p %u %f", self, id, plain);
+    VST3Plugin* const vst3  = _cplug_pointerShiftController((VST3Controller*)self);
+    const uint32_t    index = VST3Params_getIndex(id);
 
     CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, 0.0);
 
     return cplug_normaliseParameterValue(vst3->userPlugin, index, plain);
 }
 
-static double SMTG_STDMETHODCALLTYPE VST3Controller_getParamNormalized(void* self, uint32_t index)
+static double SMTG_STDMETHODCALLTYPE VST3Controller_getParamNormalized(void* self, uint32_t id)
 {
-    // cplug_log("VST3Controller_getParamNormalized => %p %u", self, index);
+    // cplug_log("VST3Controller_getParamNormalized => %p %u", self, id);
     VST3Plugin* const vst3 = _cplug_pointerShiftController((VST3Controller*)self);
 
     // Ableton will ask you for MIDI control values. So far, returning 0 here hasn't caused any problems...
-    if (index >= cplug_midiControllerOffset)
+    if (id >= cplug_midiControllerOffset)
         return 0.0;
 
+    const uint32_t index = VST3Params_getIndex(id);
     CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, 0.0);
     double val = cplug_getParameterValue(vst3->userPlugin, index);
     return cplug_normaliseParameterValue(vst3->userPlugin, index, val);
 }
 
 static Steinberg_tresult SMTG_STDMETHODCALLTYPE
-VST3Controller_setParamNormalized(void* const self, const uint32_t index, const double normalised)
+VST3Controller_setParamNormalized(void* const self, const uint32_t id, const double normalised)
 {
     // Gets called a lot in ableton, even when you aren't touching parameters
-    // cplug_log("VST3Controller_setParamNormalized => %p %u %f", self, index, normalised);
+    // cplug_log("VST3Controller_setParamNormalized => %p %u %f", self, id, normalised);
     VST3Plugin* const vst3 = _cplug_pointerShiftController((VST3Controller*)self);
     CPLUG_LOG_ASSERT_RETURN(normalised >= 0.0 && normalised <= 1.0, Steinberg_kInvalidArgument);
 
-    if (index >= cplug_midiControllerOffset)
+    if (id >= cplug_midiControllerOffset)
     {
-        uint8_t channel = (index - cplug_midiControllerOffset) / 16;
-        uint8_t control = (index - cplug_midiControllerOffset) % Steinberg_Vst_ControllerNumbers_kCountCtrlNumber;
+        uint8_t channel = (id - cplug_midiControllerOffset) / Steinberg_Vst_ControllerNumbers_kCountCtrlNumber;
+        uint8_t control = (id - cplug_midiControllerOffset) % Steinberg_Vst_ControllerNumbers_kCountCtrlNumber;
 
         if (vst3->midiContollerQueueSize < ARRSIZE(vst3->midiContollerQueue))
         {
@@ -931,6 +984,7 @@ VST3Controller_setParamNormalized(void* const self, const uint32_t index, const
         return Steinberg_kResultOk;
     }
 
+    const uint32_t index = VST3Params_getIndex(id);
     CPLUG_LOG_ASSERT_RETURN(index < CPLUG_NUM_PARAMS, 0.0);
     double denormalisedVal = cplug_denormaliseParameterValue(vst3->userPlugin, index, normalised);
     cplug_setParameterValue(vst3->userPlugin, index, denormalisedVal);
@@ -1180,8 +1234,13 @@ VST3Processor_canProcessSampleSize(void* self, const int32_t symbolic_sample_siz
 {
     // NOTE runs during RT
     // cplug_log("VST3Processor_canProcessSampleSize => %i", symbolic_sample_size);
-    return symbolic_sample_size == Steinberg_Vst_SymbolicSampleSizes_kSample32 ? Steinberg_kResultOk
-                                                                               : Steinberg_kNotImplemented;
+    VST3Plugin* const vst3 = _cplug_pointerShiftProcessor((VST3Processor*)self);
+
+    if (symbolic_sample_size == Steinberg_Vst_SymbolicSampleSizes_kSample32)
+        return Steinberg_kResultOk;
+    if (symbolic_sample_size == Steinberg_Vst_SymbolicSampleSizes_kSample64 && cplug_canProcessDouble(vst3->userPlugin))
+        return Steinberg_kResultOk;
+    return Steinberg_kNotImplemented;
 }
 
 static uint32_t SMTG_STDMETHODCALLTYPE VST3Processor_getLatencySamples(void* const self)
@@ -1192,6 +1251,33 @@ static uint32_t SMTG_STDMETHODCALLTYPE VST3Processor_getLatencySamples(void* con
     return cplug_getLatencyInSamples(vst3->userPlugin);
 }
 
+static bool VST3EventTimeline_reserve(VST3EventTimeline* timeline, uint32_t capacity, uint32_t numCells)
+{
+    if (capacity <= timeline->capacity && numCells <= timeline->numCells)
+        return true;
+
+    free(timeline->events);
+    timeline->events    = NULL;
+    timeline->numEvents = 0;
+    timeline->capacity  = 0;
+    timeline->numCells  = 0;
+
+    size_t eventsBytes = sizeof(CplugEvent) * capacity;
+    size_t framesBytes = sizeof(uint32_t) * capacity;
+    size_t cellsBytes  = sizeof(uint32_t) * (numCells + 1);
+    char*  mem         = (char*)malloc(eventsBytes * 2 + framesBytes * 2 + cellsBytes);
+    CPLUG_LOG_ASSERT_RETURN(mem != NULL, false);
+
+    timeline->events         = (CplugEvent*)mem;
+    timeline->unsortedEvents = (CplugEvent*)(mem + eventsBytes);
+    timeline->frames         = (uint32_t*)(mem + eventsBytes * 2);
+    timeline->unsortedFrames = (uint32_t*)(mem + eventsBytes * 2 + framesBytes);
+    timeline->cellOffsets    = (uint32_t*)(mem + eventsBytes * 2 + framesBytes * 2);
+    timeline->capacity       = capacity;
+    timeline->numCells       = numCells;
+    return true;
+}
+
 static Steinberg_tresult SMTG_STDMETHODCALLTYPE
 VST3Processor_setupProcessing(void* const self, struct Steinberg_Vst_ProcessSetup* const setup)
 {
@@ -1206,19 +1292,53 @@ VST3Processor_setupProcessing(void* const self, struct Steinberg_Vst_ProcessSetu
         setup->sampleRate);
 
     CPLUG_LOG_ASSERT_RETURN(
-        setup->symbolicSampleSize == Steinberg_Vst_SymbolicSampleSizes_kSample32,
+        VST3Processor_canProcessSampleSize(self, setup->symbolicSampleSize) == Steinberg_kResultOk,
         Steinberg_kInvalidArgument);
 
-    // TODO processMode can be:
-    // Steinberg_Vst_ProcessModes_kRealtime
-    // Steinberg_Vst_ProcessModes_kPrefetch,
-    // Steinberg_Vst_ProcessModes_kOffline
+    uint32_t renderMode = CPLUG_RENDER_MODE_REALTIME;
+    if (setup->processMode == Steinberg_Vst_ProcessModes_kPrefetch)
+        renderMode = CPLUG_RENDER_MODE_PREFETCH;
+    else if (setup->processMode == Steinberg_Vst_ProcessModes_kOffline)
+        renderMode = CPLUG_RENDER_MODE_OFFLINE;
+    if (renderMode != vst3->renderMode)
+    {
+        vst3->renderMode = renderMode;
+        cplug_setRenderMode(vst3->userPlugin, renderMode);
+    }
 
     CPLUG_LOG_ASSERT(setup->sampleRate > 0.0);
     CPLUG_LOG_ASSERT(setup->maxSamplesPerBlock >= 2);
 
     cplug_setSampleRateAndBlockSize(vst3->userPlugin, setup->sampleRate, setup->maxSamplesPerBlock);
 
+    uint32_t quantize = cplug_getEventQuantize(vst3->userPlugin);
+    CPLUG_LOG_ASSERT(quantize > 0 && (quantize & (quantize - 1)) == 0);
+    if (quantize == 0 || (quantize & (quantize - 1)) != 0)
+        quantize = 1;
+    vst3->eventQuantize = quantize;
+
+    // Reserve space for all queued MIDI events & MIDI controllers, plus a change for every parameter in every quantized
+    // region of the largest block
+    uint32_t numCells = (setup->maxSamplesPerBlock + quantize - 1) / quantize;
+    uint32_t capacity = CPLUG_EVENT_QUEUE_SIZE * 2 + CPLUG_NUM_PARAMS * numCells;
+    if (! VST3EventTimeline_reserve(&vst3->eventTimeline, capacity, numCells))
+        return Steinberg_kOutOfMemory;
+
+#if CPLUG_WANT_DENSE_AUTOMATION && CPLUG_NUM_PARAMS
+    // Hosts usually send a handful of points per parameter each block, though may send one for every frame
+    VST3EventTimeline* timeline  = &vst3->eventTimeline;
+    uint32_t           numPoints = setup->maxSamplesPerBlock + CPLUG_NUM_PARAMS * 16;
+    if (numPoints > timeline->automationCapacity)
+    {
+        free(timeline->automationPoints);
+        timeline->automationPoints    = (CplugAutomationPoint*)malloc(sizeof(CplugAutomationPoint) * numPoints);
+        timeline->automationCapacity  = timeline->automationPoints != NULL ? numPoints : 0;
+        timeline->numAutomationPoints = 0;
+        if (timeline->automationPoints == NULL)
+            return Steinberg_kOutOfMemory;
+    }
+#endif
+
     return Steinberg_kResultOk;
 }
 
@@ -1238,93 +1358,138 @@ typedef struct VST3ProcessContextTranslator
     VST3Plugin*                       vst3;
     struct Steinberg_Vst_ProcessData* data;
 
-    uint32_t midiControlQueueIdx;
-    uint32_t midiEventIdx;
-    uint32_t paramIdx;
-    uint32_t nextEventFrame;
+    uint32_t eventIdx;
 } VST3ProcessContextTranslator;
 
-bool VST3ProcessContextTranslator_enqueueEvent(CplugProcessContext* ctx, const CplugEvent* event, uint32_t frameIdx)
+static void VST3EventTimeline_push(VST3EventTimeline* timeline, const CplugEvent* event, uint32_t frame)
 {
-    // cplug_log("VST3ProcessContextTranslator_enqueueEvent => %p %p %u", ctx, event, frameIdx);
-    VST3ProcessContextTranslator* vst3ctx = (VST3ProcessContextTranslator*)ctx;
-
-    switch (event->type)
+    if (timeline->numEvents == timeline->capacity)
     {
-    case CPLUG_EVENT_PARAM_CHANGE_UPDATE:
+        cplug_log("[WARNING] VST3EventTimeline_push: Dropped event %u, timeline is full", event->type);
+        return;
+    }
+    timeline->unsortedEvents[timeline->numEvents] = *event;
+    timeline->unsortedFrames[timeline->numEvents] = frame;
+    timeline->numEvents++;
+}
+
+static void VST3EventTimeline_pushParamPoint(
+    VST3EventTimeline*       timeline,
+    VST3Plugin*              vst3,
+    Steinberg_Vst_ParamID    paramId,
+    uint32_t                 paramIdx,
+    Steinberg_Vst_ParamValue value,
+    uint32_t                 frame)
+{
+    CplugEvent event;
+    memset(&event, 0, sizeof(event));
+
+    if (paramId >= cplug_midiControllerOffset) // See VST3MidiMapping_getMidiControllerAssignment
     {
-        CPLUG_LOG_ASSERT_RETURN(vst3ctx->data->outputParameterChanges != NULL, false);
+        event.midi.type  = CPLUG_EVENT_MIDI;
+        event.midi.frame = frame;
 
-        Steinberg_int32                        idx   = 0;
-        struct Steinberg_Vst_IParamValueQueue* queue = vst3ctx->data->outputParameterChanges->lpVtbl->addParameterData(
-            vst3ctx->data->outputParameterChanges,
-            &event->parameter.idx,
-            &idx);
-        CPLUG_LOG_ASSERT_RETURN(queue != NULL, false);
+        uint32_t                        ccIdx   = paramId - cplug_midiControllerOffset;
+        uint8_t                         channel = ccIdx / Steinberg_Vst_ControllerNumbers_kCountCtrlNumber;
+        Steinberg_Vst_ControllerNumbers midiControllerNumber =
+            (Steinberg_Vst_ControllerNumbers)(ccIdx % Steinberg_Vst_ControllerNumbers_kCountCtrlNumber);
 
-        double normalised =
-            cplug_normaliseParameterValue(vst3ctx->vst3->userPlugin, event->parameter.idx, event->parameter.value);
-        Steinberg_tresult result = queue->lpVtbl->addPoint(queue, frameIdx, normalised, &idx);
-        return result == Steinberg_kResultOk;
+        switch (midiControllerNumber)
+        {
+        case Steinberg_Vst_ControllerNumbers_kAfterTouch:
+            event.midi.status = 0xd0 | channel;
+            event.midi.data1  = (uint8_t)(value * 127.0);
+            break;
+        case Steinberg_Vst_ControllerNumbers_kPitchBend:
+        {
+            uint16_t pb       = (uint16_t)(value * 16383);
+            event.midi.status = 0xe0 | channel;
+            event.midi.data1  = pb & 127;
+            event.midi.data2  = (pb >> 7) & 127;
+            break;
+        }
+        default:
+            event.midi.status = 0xb0 | channel;
+            event.midi.data1  = midiControllerNumber;
+            event.midi.data2  = (uint8_t)(value * 127.0);
+            break;
+        }
     }
-    default:
-        break;
+    else
+    {
+        event.parameter.type  = CPLUG_EVENT_PARAM_CHANGE_UPDATE;
+        event.parameter.idx   = paramIdx;
+        event.parameter.value = cplug_denormaliseParameterValue(vst3->userPlugin, paramIdx, value);
+#if CPLUG_WANT_PARAMETER_COOKIES && CPLUG_NUM_PARAMS
+        event.parameter.cookie = vst3->paramCookies[paramIdx];
+#endif
     }
 
-    return false;
+    VST3EventTimeline_push(timeline, &event, frame);
 }
 
-bool VST3ProcessContextTranslator_dequeueEvent(CplugProcessContext* ctx, CplugEvent* event, uint32_t frameIdx)
+// Decodes all MIDI controllers, MIDI events & parameter changes for this block into a single list sorted by frame.
+// Frames are quantized to cplug_getEventQuantize, and only the last change to a parameter within a quantized
+// region is kept. Events sharing a frame keep the order: MIDI controllers, MIDI events, parameters.
+static void
+VST3EventTimeline_build(VST3EventTimeline* timeline, VST3Plugin* vst3, struct Steinberg_Vst_ProcessData* data)
 {
-    // cplug_log("VST3ProcessContextTranslator_dequeueEvent => %p %p %u", ctx, event, frameIdx);
-    VST3ProcessContextTranslator* translator = (VST3ProcessContextTranslator*)ctx;
+    timeline->numEvents = 0;
+#if CPLUG_WANT_DENSE_AUTOMATION && CPLUG_NUM_PARAMS
+    timeline->numAutomationPoints = 0;
+    memset(timeline->automationCounts, 0, sizeof(timeline->automationCounts));
+#endif
+    if (timeline->capacity == 0)
+        return;
 
-    if (frameIdx >= translator->cplugContext.numFrames)
-        return false;
+    uint32_t quantize   = vst3->eventQuantize;
+    uint32_t maxFrame   = data->numSamples > 0 ? data->numSamples - 1 : 0;
+    uint32_t lastFrame  = maxFrame - (maxFrame & (quantize - 1));
 
-    if (translator->midiControlQueueIdx < translator->vst3->midiContollerQueueSize)
+    for (size_t i = 0; i < vst3->midiContollerQueueSize; i++)
     {
-        event->type            = CPLUG_EVENT_MIDI;
-        event->midi.frame      = frameIdx;
-        event->midi.bytesAsInt = translator->vst3->midiContollerQueue[translator->midiControlQueueIdx];
-
-        translator->midiControlQueueIdx++;
-        return true;
+        CplugEvent event;
+        event.midi.type       = CPLUG_EVENT_MIDI;
+        event.midi.frame      = 0;
+        event.midi.bytesAsInt = vst3->midiContollerQueue[i];
+        VST3EventTimeline_push(timeline, &event, 0);
     }
 
-    Steinberg_Vst_IEventList* inEvents = translator->data->inputEvents;
-    CPLUG_LOG_ASSERT(inEvents != NULL);
-
-    int numMidiEvents = inEvents->lpVtbl->getEventCount(inEvents);
-    if (translator->midiEventIdx < numMidiEvents)
+    Steinberg_Vst_IEventList* inEvents = data->inputEvents;
+    if (inEvents != NULL)
     {
-        struct Steinberg_Vst_Event vst3Midi;
-        inEvents->lpVtbl->getEvent(inEvents, translator->midiEventIdx, &vst3Midi);
-
-        vst3Midi.sampleOffset -= vst3Midi.sampleOffset & (CPLUG_EVENT_FRAME_QUANTIZE - 1);
-
-        if (vst3Midi.sampleOffset == frameIdx)
+        int numMidiEvents = inEvents->lpVtbl->getEventCount(inEvents);
+        for (int i = 0; i < numMidiEvents; i++)
         {
-            translator->midiEventIdx++;
-
-            event->type       = CPLUG_EVENT_MIDI;
-            event->midi.frame = vst3Midi.sampleOffset;
+            struct Steinberg_Vst_Event vst3Midi;
+            if (inEvents->lpVtbl->getEvent(inEvents, i, &vst3Midi) != Steinberg_kResultOk)
+                continue;
+
+            uint32_t frame  = vst3Midi.sampleOffset > 0 ? (uint32_t)vst3Midi.sampleOffset : 0;
+            frame          -= frame & (quantize - 1);
+            if (frame > lastFrame)
+                frame = lastFrame;
+
+            CplugEvent event;
+            memset(&event, 0, sizeof(event));
+            event.midi.type  = CPLUG_EVENT_MIDI;
+            event.midi.frame = frame;
             switch (vst3Midi.type)
             {
             case Steinberg_Vst_Event_EventTypes_kNoteOnEvent:
-                event->midi.status = 0x90 | vst3Midi.Steinberg_Vst_Event_noteOn.channel;
-                event->midi.data1  = (uint8_t)vst3Midi.Steinberg_Vst_Event_noteOn.pitch;
-                event->midi.data2  = (uint8_t)(vst3Midi.Steinberg_Vst_Event_noteOn.velocity * 127.0f);
+                event.midi.status = 0x90 | vst3Midi.Steinberg_Vst_Event_noteOn.channel;
+                event.midi.data1  = (uint8_t)vst3Midi.Steinberg_Vst_Event_noteOn.pitch;
+                event.midi.data2  = (uint8_t)(vst3Midi.Steinberg_Vst_Event_noteOn.velocity * 127.0f);
                 break;
             case Steinberg_Vst_Event_EventTypes_kNoteOffEvent:
-                event->midi.status = 0x80 | vst3Midi.Steinberg_Vst_Event_noteOff.channel;
-                event->midi.data1  = (uint8_t)vst3Midi.Steinberg_Vst_Event_noteOff.pitch;
-                event->midi.data2  = (uint8_t)(vst3Midi.Steinberg_Vst_Event_noteOff.velocity * 127.0f);
+                event.midi.status = 0x80 | vst3Midi.Steinberg_Vst_Event_noteOff.channel;
+                event.midi.data1  = (uint8_t)vst3Midi.Steinberg_Vst_Event_noteOff.pitch;
+                event.midi.data2  = (uint8_t)(vst3Midi.Steinberg_Vst_Event_noteOff.velocity * 127.0f);
                 break;
             case Steinberg_Vst_Event_EventTypes_kPolyPressureEvent:
-                event->midi.status = 0xA0 | vst3Midi.Steinberg_Vst_Event_polyPressure.channel;
-                event->midi.data1  = (uint8_t)vst3Midi.Steinberg_Vst_Event_polyPressure.pitch;
-                event->midi.data2  = (uint8_t)(vst3Midi.Steinberg_Vst_Event_polyPressure.pressure * 127.0f);
+                event.midi.status = 0xA0 | vst3Midi.Steinberg_Vst_Event_polyPressure.channel;
+                event.midi.data1  = (uint8_t)vst3Midi.Steinberg_Vst_Event_polyPressure.pitch;
+                event.midi.data2  = (uint8_t)(vst3Midi.Steinberg_Vst_Event_polyPressure.pressure * 127.0f);
                 break;
             case Steinberg_Vst_Event_EventTypes_kDataEvent: // TODO: support SYSEX
             case Steinberg_Vst_Event_EventTypes_kNoteExpressionValueEvent:
@@ -1332,104 +1497,243 @@ bool VST3ProcessContextTranslator_dequeueEvent(CplugProcessContext* ctx, CplugEv
             case Steinberg_Vst_Event_EventTypes_kChordEvent:
             case Steinberg_Vst_Event_EventTypes_kScaleEvent:
             case Steinberg_Vst_Event_EventTypes_kLegacyMIDICCOutEvent:
+            default:
                 cplug_log("Unhandled MIDI event: %hu", vst3Midi.type);
-                break;
+                continue;
             }
-            return true;
+            VST3EventTimeline_push(timeline, &event, frame);
         }
+    }
+
+    Steinberg_Vst_IParameterChanges* inParams = data->inputParameterChanges;
+    if (inParams != NULL)
+    {
+        int numParams = inParams->lpVtbl->getParameterCount(inParams);
+        for (int i = 0; i < numParams; i++)
+        {
+            Steinberg_Vst_IParamValueQueue* queue = inParams->lpVtbl->getParameterData(inParams, i);
+            if (queue == NULL)
+                continue;
+
+            Steinberg_Vst_ParamID paramId   = queue->lpVtbl->getParameterId(queue);
+            uint32_t              paramIdx  = VST3Params_getIndex(paramId);
+            int                   numPoints = queue->lpVtbl->getPointCount(queue);
+            // Skip IDs that are neither ours nor a MIDI controller
+            if (paramIdx >= CPLUG_NUM_PARAMS && paramId < cplug_midiControllerOffset)
+                continue;
+#if CPLUG_WANT_DENSE_AUTOMATION && CPLUG_NUM_PARAMS
+            if (paramIdx < CPLUG_NUM_PARAMS)
+            {
+                // Points are contiguous per queue. Should a host send two queues for one ID, the last one wins
+                timeline->automationOffsets[paramIdx] = timeline->numAutomationPoints;
+                timeline->automationCounts[paramIdx]  = 0;
+            }
+#endif
+
+            // Points are sorted by sampleOffset. Push the last point of each quantized region
+            uint32_t                 prevFrame = 0;
+            Steinberg_Vst_ParamValue prevValue = 0;
+            for (int pointIdx = 0; pointIdx < numPoints; pointIdx++)
+            {
+                int                      sampleOffset = 0;
+                Steinberg_Vst_ParamValue value        = 0;
+                queue->lpVtbl->getPoint(queue, pointIdx, &sampleOffset, &value);
+
+                uint32_t frame = sampleOffset > 0 ? (uint32_t)sampleOffset : 0;
+#if CPLUG_WANT_DENSE_AUTOMATION && CPLUG_NUM_PARAMS
+                if (paramIdx < CPLUG_NUM_PARAMS)
+                {
+                    // Room is kept for the first point of every other parameter. Once the rest is full, each point
+                    // replaces this parameter's previous one, so the value it ends the block on is never lost
+                    uint32_t count = timeline->automationCounts[paramIdx];
+                    uint32_t limit = timeline->automationCapacity - (count ? CPLUG_NUM_PARAMS : 0);
+
+                    CplugAutomationPoint* point = NULL;
+                    if (timeline->numAutomationPoints < limit)
+                    {
+                        point = &timeline->automationPoints[timeline->numAutomationPoints];
+                        timeline->numAutomationPoints++;
+                        timeline->automationCounts[paramIdx]++;
+                    }
+                    else
+                    {
+                        CPLUG_LOG_ASSERT(timeline->numAutomationPoints < limit); // Out of automation points
+                        if (count)
+                            point = &timeline->automationPoints[timeline->numAutomationPoints - 1];
+                    }
+                    if (point != NULL)
+                    {
+                        point->frame = frame < maxFrame ? frame : maxFrame;
+                        point->value = cplug_denormaliseParameterValue(vst3->userPlugin, paramIdx, value);
+                    }
+                }
+#endif
+                frame -= frame & (quantize - 1);
+                if (frame > lastFrame)
+                    frame = lastFrame;
+
+                if (pointIdx > 0 && frame != prevFrame)
+                    VST3EventTimeline_pushParamPoint(timeline, vst3, paramId, paramIdx, prevValue, prevFrame);
 
-        if (vst3Midi.sampleOffset < translator->nextEventFrame)
-            translator->nextEventFrame = vst3Midi.sampleOffset;
+                prevFrame = frame;
+                prevValue = value;
+            }
+            if (numPoints > 0)
+                VST3EventTimeline_pushParamPoint(timeline, vst3, paramId, paramIdx, prevValue, prevFrame);
+        }
     }
 
-    Steinberg_Vst_IParameterChanges* inParams = translator->data->inputParameterChanges;
-    CPLUG_LOG_ASSERT(inParams != NULL);
+    // Stable counting sort. Every frame is quantized, so we sort by region instead of by frame
+    uint32_t* cellOffsets = timeline->cellOffsets;
+    uint32_t  numCells    = timeline->numCells;
+    memset(cellOffsets, 0, sizeof(*cellOffsets) * (numCells + 1));
 
-    int numParams = inParams->lpVtbl->getParameterCount(inParams);
-    while (translator->paramIdx < numParams)
+    for (uint32_t i = 0; i < timeline->numEvents; i++)
     {
-        Steinberg_Vst_IParamValueQueue* queue = inParams->lpVtbl->getParameterData(inParams, translator->paramIdx);
-        translator->paramIdx++;
+        uint32_t cell = timeline->unsortedFrames[i] / quantize;
+        if (cell >= numCells) // Host sent a block larger than maxSamplesPerBlock
+            cell = numCells - 1;
+        cellOffsets[cell + 1]++;
+    }
+    for (uint32_t i = 0; i < numCells; i++)
+        cellOffsets[i + 1] += cellOffsets[i];
 
-        int pointIdx  = 0;
-        int numPoints = queue->lpVtbl->getPointCount(queue);
+    for (uint32_t i = 0; i < timeline->numEvents; i++)
+    {
+        uint32_t cell = timeline->unsortedFrames[i] / quantize;
+        if (cell >= numCells)
+            cell = numCells - 1;
+        uint32_t sortedIdx = cellOffsets[cell]++;
 
-        int                      sampleOffset = 0;
-        Steinberg_Vst_ParamValue value        = 0;
-        queue->lpVtbl->getPoint(queue, pointIdx, &sampleOffset, &value);
+        timeline->events[sortedIdx] = timeline->unsortedEvents[i];
+        timeline->frames[sortedIdx] = timeline->unsortedFrames[i];
+    }
+}
 
-        // Skip to next frame within our quantize region
-        pointIdx++;
-        while (pointIdx < numPoints && sampleOffset < (frameIdx + CPLUG_EVENT_FRAME_QUANTIZE))
-        {
-            queue->lpVtbl->getPoint(queue, pointIdx, &sampleOffset, &value);
-            pointIdx++;
-        }
-        pointIdx--;
+bool VST3ProcessContextTranslator_enqueueEvent(CplugProcessContext* ctx, const CplugEvent* event, uint32_t frameIdx)
+{
+    // cplug_log("VST3ProcessContextTranslator_enqueueEvent => %p %p %u", ctx, event, frameIdx);
+    VST3ProcessContextTranslator* vst3ctx = (VST3ProcessContextTranslator*)ctx;
 
-        queue->lpVtbl->getPoint(queue, pointIdx, &sampleOffset, &value);
-        sampleOffset -= sampleOffset & (CPLUG_EVENT_FRAME_QUANTIZE - 1);
+    switch (event->type)
+    {
+    case CPLUG_EVENT_PARAM_CHANGE_UPDATE:
+    {
+        CPLUG_LOG_ASSERT_RETURN(vst3ctx->data->outputParameterChanges != NULL, false);
 
-        Steinberg_Vst_ParamID paramId = queue->lpVtbl->getParameterId(queue);
-        if (sampleOffset == frameIdx)
-        {
-            if (paramId > 0xffffff00) // probably MIDI Controller
-            {
-                event->midi.type  = CPLUG_EVENT_MIDI;
-                event->midi.frame = sampleOffset;
+        Steinberg_Vst_IParameterChanges*       outParams = vst3ctx->data->outputParameterChanges;
+        Steinberg_Vst_ParamID                  paramId   = VST3Params_getID(event->parameter.idx);
+        Steinberg_int32                        idx       = 0;
+        struct Steinberg_Vst_IParamValueQueue* queue =
+            outParams->lpVtbl->addParameterData(outParams, &paramId, &idx);
+        CPLUG_LOG_ASSERT_RETURN(queue != NULL, false);
 
-                Steinberg_Vst_ControllerNumbers midiControllerNumber =
-                    (Steinberg_Vst_ControllerNumbers)(0xffffffff - paramId);
+        double normalised =
+            cplug_normaliseParameterValue(vst3ctx->vst3->userPlugin, event->parameter.idx, event->parameter.value);
+        Steinberg_tresult result = queue->lpVtbl->addPoint(queue, frameIdx, normalised, &idx);
+        return result == Steinberg_kResultOk;
+    }
+    default:
+        break;
+    }
 
-                switch (midiControllerNumber)
-                {
-                case Steinberg_Vst_ControllerNumbers_kAfterTouch:
-                    event->midi.status = 0xd0;
-                    event->midi.data1  = (uint8_t)(value * 127.0);
-                    break;
-                case Steinberg_Vst_ControllerNumbers_kPitchBend:
-                {
-                    uint16_t pb        = (uint16_t)(value * 16383);
-                    event->midi.status = 0xe0;
-                    event->midi.data1  = pb & 127;
-                    event->midi.data2  = (pb >> 7) & 127;
-                    break;
-                }
-                default:
-                    event->midi.status = 0xb0;
-                    event->midi.data1  = midiControllerNumber;
-                    event->midi.data2  = (uint8_t)(value * 127.0);
-                    break;
-                }
-            }
-            else
-            {
-                event->parameter.type  = CPLUG_EVENT_PARAM_CHANGE_UPDATE;
-                event->parameter.idx   = paramId;
-                event->parameter.value = cplug_denormaliseParameterValue(translator->vst3->userPlugin, paramId, value);
-            }
+    return false;
+}
 
+bool VST3ProcessContextTranslator_dequeueEvent(CplugProcessContext* ctx, CplugEvent* event, uint32_t frameIdx)
+{
+    // cplug_log("VST3ProcessContextTranslator_dequeueEvent => %p %p %u", ctx, event, frameIdx);
+    VST3ProcessContextTranslator* translator = (VST3ProcessContextTranslator*)ctx;
+    const VST3EventTimeline*      timeline   = &translator->vst3->eventTimeline;
+
+    if (frameIdx >= translator->cplugContext.numFrames)
+        return false;
+
+    if (translator->eventIdx < timeline->numEvents)
+    {
+        if (timeline->frames[translator->eventIdx] <= frameIdx)
+        {
+            *event = timeline->events[translator->eventIdx];
+            translator->eventIdx++;
+            cplug_smoothers_handleEvent(ctx, event);
             return true;
         }
 
-        if (sampleOffset < translator->nextEventFrame)
-            translator->nextEventFrame = sampleOffset;
+        event->processAudio.type     = CPLUG_EVENT_PROCESS_AUDIO;
+        event->processAudio.endFrame = timeline->frames[translator->eventIdx];
+        return true;
     }
 
-    translator->paramIdx = 0;
-
     event->processAudio.type     = CPLUG_EVENT_PROCESS_AUDIO;
-    event->processAudio.endFrame = translator->nextEventFrame;
-
-    translator->nextEventFrame = translator->cplugContext.numFrames;
+    event->processAudio.endFrame = translator->cplugContext.numFrames;
     return true;
 }
 
+#if CPLUG_WANT_DENSE_AUTOMATION && CPLUG_NUM_PARAMS
+uint32_t VST3ProcessContextTranslator_getAutomation(
+    const CplugProcessContext*   ctx,
+    uint32_t                     paramIdx,
+    const CplugAutomationPoint** points)
+{
+    const VST3ProcessContextTranslator* translator = (const VST3ProcessContextTranslator*)ctx;
+    const VST3EventTimeline*            timeline   = &translator->vst3->eventTimeline;
+    CPLUG_LOG_ASSERT_RETURN(paramIdx < CPLUG_NUM_PARAMS, 0);
+
+    *points = &timeline->automationPoints[timeline->automationOffsets[paramIdx]];
+    return timeline->automationCounts[paramIdx];
+}
+#endif
+
+uint32_t VST3ProcessContextTranslator_dequeueEvents(
+    CplugProcessContext* ctx,
+    CplugEvent*          events,
+    uint32_t             maxEvents,
+    uint32_t             frameIdx)
+{
+    VST3ProcessContextTranslator* translator = (VST3ProcessContextTranslator*)ctx;
+    const VST3EventTimeline*      timeline   = &translator->vst3->eventTimeline;
+
+    if (frameIdx >= translator->cplugContext.numFrames || maxEvents == 0)
+        return 0;
+
+    // The timeline is already sorted, so copy every event due by 'frameIdx' in one go
+    uint32_t startIdx = translator->eventIdx;
+    uint32_t endIdx   = startIdx;
+    while (endIdx < timeline->numEvents && endIdx - startIdx < maxEvents && timeline->frames[endIdx] <= frameIdx)
+        endIdx++;
+
+    uint32_t numEvents = endIdx - startIdx;
+    memcpy(events, &timeline->events[startIdx], sizeof(*events) * numEvents);
+    translator->eventIdx = endIdx;
+    for (uint32_t i = 0; i < numEvents; i++)
+        cplug_smoothers_handleEvent(ctx, &events[i]);
+
+    if (numEvents == maxEvents)
+        return numEvents;
+    events[numEvents].processAudio.type = CPLUG_EVENT_PROCESS_AUDIO;
+    events[numEvents].processAudio.endFrame =
+        endIdx < timeline->numEvents ? timeline->frames[endIdx] : translator->cplugContext.numFrames;
+    return numEvents + 1;
+}
+
+#if CPLUG_WANT_THREAD_POOL
+void VST3ProcessContextTranslator_parallelFor(
+    CplugProcessContext* ctx,
+    uint32_t             taskCount,
+    cplug_taskProc       taskProc,
+    void*                userdata)
+{
+    cplug_threadPool_parallelFor(g_cplugThreadPool, taskCount, taskProc, userdata);
+}
+#endif
+
 float** VST3ProcessContextTranslator_getAudioInput(const CplugProcessContext* ctx, uint32_t busIdx)
 {
     // cplug_log("VST3ProcessContextTranslator_getAudioInput => %p %u", ctx, busIdx);
     VST3ProcessContextTranslator* vst3ctx = (VST3ProcessContextTranslator*)ctx;
     CPLUG_LOG_ASSERT(busIdx < vst3ctx->data->numInputs);
+    if (ctx->isDoublePrecision)
+        return NULL;
     return vst3ctx->data->inputs[busIdx].Steinberg_Vst_AudioBusBuffers_channelBuffers32;
 }
 
@@ -1438,9 +1742,92 @@ float** VST3ProcessContextTranslator_getAudioOutput(const CplugProcessContext* c
     // cplug_log("VST3ProcessContextTranslator_getAudioOutput => %p %u", ctx, busIdx);
     VST3ProcessContextTranslator* vst3ctx = (VST3ProcessContextTranslator*)ctx;
     CPLUG_LOG_ASSERT(busIdx < vst3ctx->data->numOutputs);
+    if (ctx->isDoublePrecision)
+        return NULL;
     return vst3ctx->data->outputs[busIdx].Steinberg_Vst_AudioBusBuffers_channelBuffers32;
 }
 
+double** VST3ProcessContextTranslator_getAudioInput64(const CplugProcessContext* ctx, uint32_t busIdx)
+{
+    VST3ProcessContextTranslator* vst3ctx = (VST3ProcessContextTranslator*)ctx;
+    CPLUG_LOG_ASSERT(busIdx < vst3ctx->data->numInputs);
+    if (! ctx->isDoublePrecision)
+        return NULL;
+    return vst3ctx->data->inputs[busIdx].Steinberg_Vst_AudioBusBuffers_channelBuffers64;
+}
+
+double** VST3ProcessContextTranslator_getAudioOutput64(const CplugProcessContext* ctx, uint32_t busIdx)
+{
+    VST3ProcessContextTranslator* vst3ctx = (VST3ProcessContextTranslator*)ctx;
+    CPLUG_LOG_ASSERT(busIdx < vst3ctx->data->numOutputs);
+    if (! ctx->isDoublePrecision)
+        return NULL;
+    return vst3ctx->data->outputs[busIdx].Steinberg_Vst_AudioBusBuffers_channelBuffers64;
+}
+
+bool VST3ProcessContextTranslator_isInPlace(const CplugProcessContext* ctx, uint32_t busIdx, uint32_t channelIdx)
+{
+    const VST3ProcessContextTranslator*     vst3ctx = (const VST3ProcessContextTranslator*)ctx;
+    const struct Steinberg_Vst_ProcessData* data    = vst3ctx->data;
+    if ((int32_t)busIdx >= data->numInputs || (int32_t)busIdx >= data->numOutputs)
+        return false;
+
+    const struct Steinberg_Vst_AudioBusBuffers* input  = &data->inputs[busIdx];
+    const struct Steinberg_Vst_AudioBusBuffers* output = &data->outputs[busIdx];
+    if ((int32_t)channelIdx >= input->numChannels || (int32_t)channelIdx >= output->numChannels)
+        return false;
+    if (ctx->isDoublePrecision)
+    {
+        Steinberg_Vst_Sample64** in  = input->Steinberg_Vst_AudioBusBuffers_channelBuffers64;
+        Steinberg_Vst_Sample64** out = output->Steinberg_Vst_AudioBusBuffers_channelBuffers64;
+        return in != NULL && out != NULL && in[channelIdx] == out[channelIdx];
+    }
+    Steinberg_Vst_Sample32** in  = input->Steinberg_Vst_AudioBusBuffers_channelBuffers32;
+    Steinberg_Vst_Sample32** out = output->Steinberg_Vst_AudioBusBuffers_channelBuffers32;
+    return in != NULL && out != NULL && in[channelIdx] == out[channelIdx];
+}
+
+static uint32_t VST3ProcessContextTranslator_getInPlaceBusses(const CplugProcessContext* ctx)
+{
+    const VST3ProcessContextTranslator*     vst3ctx = (const VST3ProcessContextTranslator*)ctx;
+    const struct Steinberg_Vst_ProcessData* data    = vst3ctx->data;
+
+    uint32_t mask = 0;
+    for (int32_t bus = 0; bus < data->numInputs && bus < data->numOutputs && bus < 32; bus++)
+    {
+        int32_t numChannels = data->outputs[bus].numChannels;
+        bool    inPlace     = numChannels > 0 && numChannels == data->inputs[bus].numChannels;
+        for (int32_t ch = 0; ch < numChannels && inPlace; ch++)
+            inPlace = VST3ProcessContextTranslator_isInPlace(ctx, bus, ch);
+        if (inPlace)
+            mask |= 1u << bus;
+    }
+    return mask;
+}
+
+uint64_t VST3ProcessContextTranslator_getInputSilence(const CplugProcessContext* ctx, uint32_t busIdx)
+{
+    const VST3ProcessContextTranslator* vst3ctx = (const VST3ProcessContextTranslator*)ctx;
+    CPLUG_LOG_ASSERT_RETURN((int32_t)busIdx < vst3ctx->data->numInputs, 0);
+    const struct Steinberg_Vst_AudioBusBuffers* input = &vst3ctx->data->inputs[busIdx];
+    // Some hosts leave bits set past the last channel
+    uint64_t channelMask = input->numChannels >= 64 ? ~0ull : (1ull << input->numChannels) - 1;
+    return input->silenceFlags & channelMask;
+}
+
+// VST3 only flags silence, which is also constant
+uint64_t VST3ProcessContextTranslator_getInputConstant(const CplugProcessContext* ctx, uint32_t busIdx)
+{
+    return VST3ProcessContextTranslator_getInputSilence(ctx, busIdx);
+}
+
+void VST3ProcessContextTranslator_setOutputSilence(CplugProcessContext* ctx, uint32_t busIdx, uint64_t channelMask)
+{
+    VST3ProcessContextTranslator* vst3ctx = (VST3ProcessContextTranslator*)ctx;
+    CPLUG_LOG_ASSERT_RETURN((int32_t)busIdx < vst3ctx->data->numOutputs, );
+    vst3ctx->data->outputs[busIdx].silenceFlags = channelMask;
+}
+
 static Steinberg_tresult SMTG_STDMETHODCALLTYPE
 VST3Processor_process(void* const self, struct Steinberg_Vst_ProcessData* const data)
 {
@@ -1448,11 +1835,17 @@ VST3Processor_process(void* const self, struct Steinberg_Vst_ProcessData* const
     VST3Plugin* const vst3 = _cplug_pointerShiftProcessor((VST3Processor*)self);
 
     CPLUG_LOG_ASSERT_RETURN(
-        data->symbolicSampleSize == Steinberg_Vst_SymbolicSampleSizes_kSample32,
+        data->symbolicSampleSize == Steinberg_Vst_SymbolicSampleSizes_kSample32 ||
+            data->symbolicSampleSize == Steinberg_Vst_SymbolicSampleSizes_kSample64,
         Steinberg_kInvalidArgument);
+    // canProcessSampleSize refused 64bit, but some hosts don't ask
+    if (data->symbolicSampleSize == Steinberg_Vst_SymbolicSampleSizes_kSample64 &&
+        ! cplug_canProcessDouble(vst3->userPlugin))
+        return Steinberg_kInvalidArgument;
 
     VST3ProcessContextTranslator translator = {0};
     translator.cplugContext.numFrames       = data->numSamples;
+    translator.cplugContext.renderMode      = vst3->renderMode;
 
     if (data->processContext != NULL)
     {
@@ -1485,18 +1878,45 @@ VST3Processor_process(void* const self, struct Steinberg_Vst_ProcessData* const
         }
     }
 
-    translator.cplugContext.enqueueEvent   = VST3ProcessContextTranslator_enqueueEvent;
-    translator.cplugContext.dequeueEvent   = VST3ProcessContextTranslator_dequeueEvent;
-    translator.cplugContext.getAudioInput  = VST3ProcessContextTranslator_getAudioInput;
-    translator.cplugContext.getAudioOutput = VST3ProcessContextTranslator_getAudioOutput;
-    translator.vst3                        = vst3;
-    translator.data                        = data;
-    translator.midiControlQueueIdx         = 0;
-    translator.midiEventIdx                = 0;
-    translator.paramIdx                    = 0;
-    translator.nextEventFrame              = data->numSamples;
+    translator.cplugContext.enqueueEvent  = VST3ProcessContextTranslator_enqueueEvent;
+    translator.cplugContext.dequeueEvent  = VST3ProcessContextTranslator_dequeueEvent;
+    translator.cplugContext.dequeueEvents = VST3ProcessContextTranslator_dequeueEvents;
+#if CPLUG_WANT_DENSE_AUTOMATION && CPLUG_NUM_PARAMS
+    translator.cplugContext.getAutomation = VST3ProcessContextTranslator_getAutomation;
+#endif
+#if CPLUG_WANT_THREAD_POOL
+    translator.cplugContext.parallelFor = VST3ProcessContextTranslator_parallelFor;
+#endif
 
+    translator.cplugContext.isDoublePrecision =
+        data->symbolicSampleSize == Steinberg_Vst_SymbolicSampleSizes_kSample64;
+    translator.cplugContext.getAudioInput64  = VST3ProcessContextTranslator_getAudioInput64;
+    translator.cplugContext.getAudioOutput64 = VST3ProcessContextTranslator_getAudioOutput64;
+    translator.cplugContext.getAudioInput    = VST3ProcessContextTranslator_getAudioInput;
+    translator.cplugContext.getAudioOutput   = VST3ProcessContextTranslator_getAudioOutput;
+    translator.cplugContext.isInPlace        = VST3ProcessContextTranslator_isInPlace;
+    translator.cplugContext.getInputSilence  = VST3ProcessContextTranslator_getInputSilence;
+    translator.cplugContext.getInputConstant = VST3ProcessContextTranslator_getInputConstant;
+    translator.cplugContext.setOutputSilence = VST3ProcessContextTranslator_setOutputSilence;
+    translator.vst3                          = vst3;
+    translator.data                          = data;
+    translator.eventIdx                      = 0;
+
+    translator.cplugContext.inPlaceBusses = VST3ProcessContextTranslator_getInPlaceBusses(&translator.cplugContext);
+
+    // Outputs aren't silent unless the plugin says so. Some hosts pass on flags from the last block
+    for (int32_t i = 0; i < data->numOutputs; i++)
+        data->outputs[i].silenceFlags = 0;
+
+    VST3EventTimeline_build(&vst3->eventTimeline, vst3, data);
+
+#if ! CPLUG_WANT_DENORMALS
+    uint64_t floatMode = cplug_disableDenormals();
+#endif
     cplug_process(vst3->userPlugin, &translator.cplugContext);
+#if ! CPLUG_WANT_DENORMALS
+    cplug_restoreDenormals(floatMode);
+#endif
 
     vst3->midiContollerQueueSize = 0;
 
@@ -1609,6 +2029,10 @@ VST3Component_initialize(void* const self, Steinberg_FUnknown* const context)
     cplug_log("VST3Component_initialize => %p %p | hostApplication %p", self, context, vst3->host);
 
     vst3->userPlugin = cplug_createPlugin();
+#if CPLUG_WANT_PARAMETER_COOKIES && CPLUG_NUM_PARAMS
+    for (uint32_t i = 0; i < CPLUG_NUM_PARAMS; i++)
+        vst3->paramCookies[i] = cplug_getParameterCookie(vst3->userPlugin, i);
+#endif
 
     return Steinberg_kResultOk;
 }
@@ -1798,44 +2222,82 @@ static Steinberg_tresult SMTG_STDMETHODCALLTYPE VST3Component_setActive(void* co
     return Steinberg_kResultOk;
 }
 
+// IBStream takes 32 bit sizes and may read or write fewer bytes than asked, so requests are split into chunks and we
+// keep calling the stream until the plugins request is complete
+typedef struct VST3StateContext
+{
+    Steinberg_IBStream* stream;
+    bool                failed;
+} VST3StateContext;
+
 int64_t cplug_VST3ReadProcTranslator(const void* stateCtx, void* readPos, size_t maxBytesToRead)
 {
-    Steinberg_IBStream* const stream    = (Steinberg_IBStream* const)stateCtx;
-    Steinberg_int32           bytesRead = 0;
-    Steinberg_tresult         result    = stream->lpVtbl->read(stream, readPos, maxBytesToRead, &bytesRead);
-    if (result != Steinberg_kResultOk)
-        return -1;
-    return bytesRead;
+    VST3StateContext* ctx    = (VST3StateContext*)stateCtx;
+    uint8_t*          dst    = (uint8_t*)readPos;
+    size_t            remain = maxBytesToRead;
+
+    while (remain > 0 && ! ctx->failed)
+    {
+        size_t            chunk     = remain > CPLUG_STATE_CHUNK_SIZE ? CPLUG_STATE_CHUNK_SIZE : remain;
+        Steinberg_int32   bytesRead = 0;
+        Steinberg_tresult result    = ctx->stream->lpVtbl->read(ctx->stream, dst, (Steinberg_int32)chunk, &bytesRead);
+        if (result != Steinberg_kResultOk || bytesRead < 0)
+        {
+            cplug_log("cplug_VST3ReadProcTranslator => Stream failed with result %d", result);
+            ctx->failed = true;
+            break;
+        }
+        if (bytesRead == 0) // End of stream
+            break;
+        dst    += bytesRead;
+        remain -= bytesRead;
+    }
+    return ctx->failed ? -1 : (int64_t)(maxBytesToRead - remain);
 }
 
 static Steinberg_tresult SMTG_STDMETHODCALLTYPE
 VST3Component_setState(void* const self, Steinberg_IBStream* const stream)
 {
     cplug_log("VST3Component_setState => %p", self);
-    VST3Plugin* vst3 = _cplug_pointerShiftComponent((VST3Component*)self);
+    VST3Plugin*      vst3 = _cplug_pointerShiftComponent((VST3Component*)self);
+    VST3StateContext ctx  = {stream, false};
 
-    cplug_loadState(vst3->userPlugin, stream, cplug_VST3ReadProcTranslator);
-    return Steinberg_kResultOk;
+    cplug_loadState(vst3->userPlugin, &ctx, cplug_VST3ReadProcTranslator);
+    return ctx.failed ? Steinberg_kResultFalse : Steinberg_kResultOk;
 }
 
 int64_t cplug_VST3WriteProcTranslator(const void* stateCtx, void* writePos, size_t numBytesToWrite)
 {
-    Steinberg_IBStream* const stream       = (Steinberg_IBStream* const)stateCtx;
-    Steinberg_int32           bytesWritten = 0;
-    Steinberg_tresult         result       = stream->lpVtbl->write(stream, writePos, numBytesToWrite, &bytesWritten);
-    if (result != Steinberg_kResultOk)
-        return -1;
-    return bytesWritten;
+    VST3StateContext* ctx    = (VST3StateContext*)stateCtx;
+    uint8_t*          src    = (uint8_t*)writePos;
+    size_t            remain = numBytesToWrite;
+
+    while (remain > 0 && ! ctx->failed)
+    {
+        size_t            chunk   = remain > CPLUG_STATE_CHUNK_SIZE ? CPLUG_STATE_CHUNK_SIZE : remain;
+        Steinberg_int32   written = 0;
+        Steinberg_tresult result  = ctx->stream->lpVtbl->write(ctx->stream, src, (Steinberg_int32)chunk, &written);
+        if (result != Steinberg_kResultOk || written <= 0)
+        {
+            cplug_log("cplug_VST3WriteProcTranslator => Stream failed with result %d", result);
+            ctx->failed = true;
+            break;
+        }
+        src    += written;
+        remain -= written;
+    }
+    return ctx->failed ? -1 : (int64_t)numBytesToWrite;
 }
 
 static Steinberg_tresult SMTG_STDMETHODCALLTYPE
 VST3Component_getState(void* const self, Steinberg_IBStream* const stream)
 {
     cplug_log("VST3Component_getState => %p %p", self, stream);
-    VST3Plugin* vst3 = _cplug_pointerShiftComponent((VST3Component*)self);
+    VST3Plugin*      vst3 = _cplug_pointerShiftComponent((VST3Component*)self);
+    VST3StateContext ctx  = {stream, false};
 
-    cplug_saveState(vst3->userPlugin, stream, cplug_VST3WriteProcTranslator);
-    return Steinberg_kResultOk;
+    cplug_saveState(vst3->userPlugin, &ctx, cplug_VST3WriteProcTranslator);
+    return ctx.failed ? Steinberg_kResultFalse : Steinberg_kResultOk;
 }
 
 /*----------------------------------------------------------------------------------------------------------------------
@@ -2127,6 +2589,20 @@ bool VST3_ENTRY(VST3_ENTRY_ARGS)
 {
     cplug_log("Bundle entry");
     cplug_libraryLoad();
+#if CPLUG_WANT_SPARSE_PARAMETER_IDS && CPLUG_NUM_PARAMS
+    if (! cplug_paramIdMap_build(&g_vst3ParamIds))
+    {
+        cplug_log("Bundle entry => Parameter IDs must be unique and below 0x80000000");
+        cplug_libraryUnload();
+        return false;
+    }
+#endif
+#if CPLUG_WANT_THREAD_POOL
+    cplug_threadPool_acquire();
+#endif
+#if defined(CPLUG_PARAMETER_DESCRIPTORS) && CPLUG_NUM_PARAMS
+    VST3Controller_buildParameterInfos();
+#endif
 
     g_vst3MidiMapping.lpVtbl                           = &g_vst3MidiMapping.base;
     g_vst3MidiMapping.base.queryInterface              = VST3MidiMapping_queryInterface;
@@ -2148,6 +2624,9 @@ CPLUG_VST3_EXPORT
 bool VST3_EXIT(void)
 {
     cplug_log("Bundle exit");
+#if CPLUG_WANT_THREAD_POOL
+    cplug_threadPool_release();
+#endif
     cplug_libraryUnload();
     return true;
 }
@@ -5,6 +5,7 @@
 #include "example/config.h"
 #include "src/cplug_clap.c"
 #include "src/cplug_vst3.c"
+#include "src/cplug_dsp.c"
 #ifndef __APPLE__
 #include "src/cplug_standalone_win.c"
 
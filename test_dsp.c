@@ -0,0 +1,213 @@
+// Checks every cplug_dsp.h variant this CPU can run against the scalar reference kernels, at every length up to a few
+// vectors and at unaligned offsets, and checks nothing is written past the end of a buffer.
+// Also checks the scalar sine against the C library.
+// Usage: ./test_dsp
+#include <cplug_dsp.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define test_check(cond, ...)                                                                                          \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "test_dsp: " __VA_ARGS__);                                                                     \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+#define TEST_MAX_SAMPLES 1100
+// Room for interleaved buffers, unaligned offsets & a guard
+#define TEST_BUFFER_SIZE (2 * TEST_MAX_SAMPLES + 64)
+#define TEST_GUARD 12345.0f
+
+typedef struct TestBuffers
+{
+    float src[TEST_BUFFER_SIZE];
+    float src2[TEST_BUFFER_SIZE];
+    float dst[TEST_BUFFER_SIZE];
+    float dst2[TEST_BUFFER_SIZE];
+} TestBuffers;
+
+static uint32_t test_random(uint32_t* seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static void test_fill(TestBuffers* b, uint32_t seed)
+{
+    for (int i = 0; i < TEST_BUFFER_SIZE; i++)
+    {
+        b->src[i]  = (float)(int32_t)test_random(&seed) / 2147483648.0f;
+        b->src2[i] = (float)(int32_t)test_random(&seed) / 2147483648.0f;
+        b->dst[i]  = TEST_GUARD;
+        b->dst2[i] = TEST_GUARD;
+    }
+}
+
+// Runs one kernel with the given variant on copies of the same input
+typedef void (*TestRunProc)(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result);
+
+static void test_compare(
+    const char*            name,
+    TestRunProc            run,
+    const CplugDSPKernels* reference,
+    const CplugDSPKernels* kernels,
+    CplugDSPLevel          level,
+    float                  tolerance)
+{
+    static TestBuffers expected, actual;
+    for (uint32_t n = 0; n <= TEST_MAX_SAMPLES; n += n < 80 ? 1 : 97)
+    {
+        for (uint32_t offset = 0; offset < 4; offset++)
+        {
+            float expectedResult = 0, actualResult = 0;
+            test_fill(&expected, n * 4 + offset);
+            test_fill(&actual, n * 4 + offset);
+            run(reference, &expected, offset, n, &expectedResult);
+            run(kernels, &actual, offset, n, &actualResult);
+
+            for (int i = 0; i < TEST_BUFFER_SIZE; i++)
+            {
+                float e = expected.dst[i], a = actual.dst[i];
+                test_check(
+                    fabsf(e - a) <= tolerance,
+                    "%s %s: dst[%d] is %g, expected %g (n=%u offset=%u)",
+                    cplug_dsp_getLevelName(level),
+                    name,
+                    i,
+                    a,
+                    e,
+                    n,
+                    offset);
+                e = expected.dst2[i], a = actual.dst2[i];
+                test_check(
+                    fabsf(e - a) <= tolerance,
+                    "%s %s: dst2[%d] is %g, expected %g (n=%u offset=%u)",
+                    cplug_dsp_getLevelName(level),
+                    name,
+                    i,
+                    a,
+                    e,
+                    n,
+                    offset);
+            }
+            test_check(
+                fabsf(expectedResult - actualResult) <= tolerance,
+                "%s %s: returned %g, expected %g (n=%u)",
+                cplug_dsp_getLevelName(level),
+                name,
+                actualResult,
+                expectedResult,
+                n);
+        }
+    }
+}
+
+static void test_runClear(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result)
+{
+    k->clear(b->dst + offset, n);
+}
+
+static void test_runCopy(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result)
+{
+    k->copy(b->dst + offset, b->src + 1, n);
+}
+
+static void test_runGain(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result)
+{
+    k->gain(b->dst + offset, b->src + 3, 0.7f, n);
+    // In place
+    memcpy(b->dst2, b->src2, sizeof(b->dst2));
+    k->gain(b->dst2 + offset, b->dst2 + offset, -1.5f, n);
+}
+
+static void test_runGainRamp(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result)
+{
+    k->gainRamp(b->dst + offset, b->src + 2, 0.25f, 1.0f, n);
+    memcpy(b->dst2, b->src2, sizeof(b->dst2));
+    k->gainRamp(b->dst2 + offset, b->dst2 + offset, 1.0f, 0.0f, n);
+}
+
+static void test_runMix(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result)
+{
+    memcpy(b->dst, b->src2, sizeof(b->dst));
+    k->mix(b->dst + offset, b->src, 0.5f, n);
+}
+
+static void test_runPan(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result)
+{
+    k->pan(b->dst + offset, b->dst2 + 1, b->src + offset, 0.8f, 0.6f, n);
+}
+
+static void test_runInterleave2(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result)
+{
+    k->interleave2(b->dst + offset, b->src + 1, b->src2 + offset, n);
+}
+
+static void test_runDeinterleave2(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result)
+{
+    k->deinterleave2(b->dst + offset, b->dst2 + 3, b->src + offset, n);
+}
+
+static void test_runSine(const CplugDSPKernels* k, TestBuffers* b, uint32_t offset, uint32_t n, float* result)
+{
+    // A low & a high note, starting from different phases
+    *result = k->sine(b->dst + offset, 0.1f * offset, 0.0011f, 0.9f, n);
+    k->sine(b->dst2 + offset, 0.99f, 0.37f, 1.0f, n);
+}
+
+static void test_sineAccuracy(const CplugDSPKernels* scalar)
+{
+    // No phase accumulation here, each sample starts from the exact phase
+    float maxError = 0;
+    for (int i = 0; i <= 1000000; i++)
+    {
+        float phase = (float)i / 1000000.0f;
+        if (phase >= 1.0f)
+            phase = 0.0f;
+        float out;
+        scalar->sine(&out, phase, 0.0f, 1.0f, 1);
+        float error = fabsf(out - (float)sin(2 * 3.14159265358979323846 * phase));
+        maxError    = error > maxError ? error : maxError;
+    }
+    test_check(maxError < 5e-7f, "Scalar sine error is %g", maxError);
+    printf("scalar sine max error %g\n", maxError);
+}
+
+int main()
+{
+    CplugDSPKernels reference;
+    test_check(cplug_dsp_getKernels(CPLUG_DSP_SCALAR, &reference), "No scalar kernels");
+    test_sineAccuracy(&reference);
+
+    for (int level = CPLUG_DSP_SCALAR + 1; level < CPLUG_DSP_NUM_LEVELS; level++)
+    {
+        CplugDSPKernels kernels;
+        if (! cplug_dsp_getKernels((CplugDSPLevel)level, &kernels))
+        {
+            printf("%s not supported, skipped\n", cplug_dsp_getLevelName((CplugDSPLevel)level));
+            continue;
+        }
+        // Arithmetic may be fused or reordered by the compiler, data movement must be exact
+        test_compare("clear", test_runClear, &reference, &kernels, level, 0);
+        test_compare("copy", test_runCopy, &reference, &kernels, level, 0);
+        test_compare("gain", test_runGain, &reference, &kernels, level, 1e-6f);
+        test_compare("gainRamp", test_runGainRamp, &reference, &kernels, level, 1e-6f);
+        test_compare("mix", test_runMix, &reference, &kernels, level, 1e-6f);
+        test_compare("pan", test_runPan, &reference, &kernels, level, 1e-6f);
+        test_compare("interleave2", test_runInterleave2, &reference, &kernels, level, 0);
+        test_compare("deinterleave2", test_runDeinterleave2, &reference, &kernels, level, 0);
+        // Vectors step the phase by several samples at once, so rounding accumulates differently
+        test_compare("sine", test_runSine, &reference, &kernels, level, 2e-4f);
+        printf("%s matches the scalar reference\n", cplug_dsp_getLevelName((CplugDSPLevel)level));
+    }
+
+    cplug_dsp_init();
+    printf("cplug_dsp_init picked %s\n", cplug_dsp_getLevelName(cplug_dsp_getLevel()));
+    return 0;
+}
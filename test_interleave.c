@@ -0,0 +1,226 @@
+// Checks cplug_interleave.h against plain nested loops, for every sample format, 1 to 10 channels and block sizes
+// around the vector widths, and round trips each format back through cplug_deinterleave.
+// Usage: ./test_interleave
+#include <cplug_interleave.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define test_check(cond, ...)                                                                                          \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "test_interleave: " __VA_ARGS__);                                                              \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+#define TEST_MAX_CHANNELS 10
+#define TEST_MAX_FRAMES   300
+#define TEST_GUARD        0xa5
+
+static const char* g_formatNames[] = {"float32", "int16", "int24", "int32"};
+
+static float   g_planar[TEST_MAX_CHANNELS][TEST_MAX_FRAMES];
+static float   g_roundTrip[TEST_MAX_CHANNELS][TEST_MAX_FRAMES + 1];
+static uint8_t g_expected[TEST_MAX_CHANNELS * TEST_MAX_FRAMES * 4 + 16];
+static uint8_t g_actual[TEST_MAX_CHANNELS * TEST_MAX_FRAMES * 4 + 16];
+
+static uint32_t test_random(uint32_t* seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+// Reference: one sample at a time, frame by frame, with its own copy of the dither sequence
+static int32_t test_toInt(float v, uint32_t bits, float noise)
+{
+    double scale = bits == 16 ? 32768.0 : bits == 24 ? 8388608.0 : 2147483648.0;
+    double x     = (double)v * scale + noise;
+    double lo    = -scale;
+    double hi    = bits == 32 ? 2147483520.0 : scale - 1;
+    x            = x < lo ? lo : x > hi ? hi : x;
+    return (int32_t)nearbyint(x);
+}
+
+static void test_reference(
+    uint8_t*          dst,
+    CplugSampleFormat format,
+    uint32_t          numChannels,
+    uint32_t          numFrames,
+    CplugDither*      dither)
+{
+    uint32_t size       = cplug_sampleFormatSize(format);
+    uint32_t numSamples = numChannels * numFrames;
+    float    noise[8]   = {0};
+    for (uint32_t n = 0; n < numSamples; n++)
+    {
+        float    v   = g_planar[n % numChannels][n / numChannels];
+        uint8_t* out = dst + n * size;
+        if (format == CPLUG_SAMPLE_FLOAT32)
+        {
+            memcpy(out, &v, sizeof(v));
+            continue;
+        }
+        // The header's scratch buffer restarts the groups of 8 at each chunk
+        uint32_t framesPerChunk = CPLUG_INTERLEAVE_SCRATCH_SIZE / numChannels;
+        uint32_t idxInChunk     = n % (framesPerChunk * numChannels);
+        if (dither != NULL && format != CPLUG_SAMPLE_INT32 && idxInChunk % 8 == 0)
+            cplug_dither_step(dither, noise);
+        int32_t x = test_toInt(v, size * 8, dither != NULL ? noise[idxInChunk % 8] : 0.0f);
+        for (uint32_t b = 0; b < size; b++)
+            out[b] = (uint8_t)(x >> (8 * b));
+    }
+}
+
+// Integers as their value, floats as their bits
+static int64_t test_decode(const uint8_t* src, CplugSampleFormat format)
+{
+    uint32_t size = cplug_sampleFormatSize(format);
+    uint32_t bits = 0;
+    for (uint32_t b = 0; b < size; b++)
+        bits |= (uint32_t)src[b] << (8 * b);
+    if (format == CPLUG_SAMPLE_INT16)
+        return (int16_t)bits;
+    if (format == CPLUG_SAMPLE_INT24)
+        return (int32_t)(bits << 8) >> 8;
+    return (int32_t)bits;
+}
+
+static void test_format(CplugSampleFormat format)
+{
+    uint32_t size = cplug_sampleFormatSize(format);
+    for (uint32_t numChannels = 1; numChannels <= TEST_MAX_CHANNELS; numChannels++)
+    {
+        for (uint32_t numFrames = 0; numFrames <= TEST_MAX_FRAMES; numFrames += numFrames < 40 ? 1 : 37)
+        {
+            for (int useDither = 0; useDither < 2; useDither++)
+            {
+                CplugDither ditherExpected, ditherActual;
+                cplug_dither_init(&ditherExpected, numFrames);
+                cplug_dither_init(&ditherActual, numFrames);
+
+                uint32_t numBytes = numChannels * numFrames * size;
+                memset(g_expected, TEST_GUARD, sizeof(g_expected));
+                memset(g_actual, TEST_GUARD, sizeof(g_actual));
+                test_reference(g_expected, format, numChannels, numFrames, useDither ? &ditherExpected : NULL);
+
+                float* src[TEST_MAX_CHANNELS];
+                for (uint32_t ch = 0; ch < numChannels; ch++)
+                    src[ch] = g_planar[ch];
+                cplug_interleave(g_actual, format, src, numChannels, numFrames, useDither ? &ditherActual : NULL);
+
+                for (uint32_t i = 0; i < numBytes; i += size)
+                {
+                    int64_t expected = test_decode(g_expected + i, format);
+                    int64_t actual   = test_decode(g_actual + i, format);
+                    // With dither, a step either way where the compiler fuses the multiply & add differently
+                    int64_t tolerance = useDither && format != CPLUG_SAMPLE_FLOAT32 ? 1 : 0;
+                    test_check(
+                        actual - expected >= -tolerance && actual - expected <= tolerance,
+                        "%s interleave: sample %u is %lld, expected %lld (channels=%u frames=%u dither=%d)",
+                        g_formatNames[format],
+                        i / size,
+                        (long long)actual,
+                        (long long)expected,
+                        numChannels,
+                        numFrames,
+                        useDither);
+                }
+                for (uint32_t i = numBytes; i < sizeof(g_actual); i++)
+                    test_check(g_actual[i] == TEST_GUARD, "%s interleave wrote past the end", g_formatNames[format]);
+            }
+
+            // Round trip the dithered output. Floats come back exactly, integers within rounding plus dither
+            float* dst[TEST_MAX_CHANNELS];
+            for (uint32_t ch = 0; ch < numChannels; ch++)
+            {
+                dst[ch] = g_roundTrip[ch];
+                for (uint32_t i = 0; i <= TEST_MAX_FRAMES; i++)
+                    g_roundTrip[ch][i] = 12345.0f;
+            }
+            cplug_deinterleave(dst, g_expected, format, numChannels, numFrames);
+
+            float step = 0;
+            if (format == CPLUG_SAMPLE_INT16)
+                step = 1.5f / 32768.0f;
+            else if (format == CPLUG_SAMPLE_INT24)
+                step = 1.5f / 8388608.0f;
+            else if (format == CPLUG_SAMPLE_INT32)
+                step = 1e-7f;
+            for (uint32_t ch = 0; ch < numChannels; ch++)
+            {
+                for (uint32_t i = 0; i < numFrames; i++)
+                {
+                    float diff = g_roundTrip[ch][i] - g_planar[ch][i];
+                    test_check(
+                        diff >= -step && diff <= step,
+                        "%s round trip: channel %u frame %u is %g, expected %g (channels=%u frames=%u)",
+                        g_formatNames[format],
+                        ch,
+                        i,
+                        g_roundTrip[ch][i],
+                        g_planar[ch][i],
+                        numChannels,
+                        numFrames);
+                }
+                test_check(
+                    g_roundTrip[ch][numFrames] == 12345.0f,
+                    "%s deinterleave wrote past the end",
+                    g_formatNames[format]);
+            }
+        }
+    }
+    printf("%s matches the reference\n", g_formatNames[format]);
+}
+
+int main()
+{
+    // Random values, plus exact full scale & silence
+    uint32_t seed = 1;
+    for (int ch = 0; ch < TEST_MAX_CHANNELS; ch++)
+        for (int i = 0; i < TEST_MAX_FRAMES; i++)
+            g_planar[ch][i] = (float)(int32_t)test_random(&seed) / 1900000000.0f;
+    // Clipped samples don't round trip, clipping is checked separately below
+    for (int ch = 0; ch < TEST_MAX_CHANNELS; ch++)
+        for (int i = 0; i < TEST_MAX_FRAMES; i++)
+            g_planar[ch][i] = g_planar[ch][i] > 0.99f ? 0.99f : g_planar[ch][i] < -1.0f ? -1.0f : g_planar[ch][i];
+    g_planar[0][1] = 1.0f;
+    g_planar[0][2] = -1.0f;
+    g_planar[1][3] = 0.0f;
+
+    for (int format = CPLUG_SAMPLE_FLOAT32; format <= CPLUG_SAMPLE_INT32; format++)
+        test_format((CplugSampleFormat)format);
+
+    // Clipping
+    float   loud[8] = {2.0f, -2.0f, 1.0f, -1.0f, 1.5f, -1.5f, 0.999999f, -0.999999f};
+    float*  src[1]  = {loud};
+    int16_t out16[8];
+    cplug_interleave(out16, CPLUG_SAMPLE_INT16, src, 1, 8, NULL);
+    test_check(out16[0] == 32767 && out16[1] == -32768 && out16[2] == 32767 && out16[3] == -32768, "int16 clipping");
+    int32_t out32[8];
+    cplug_interleave(out32, CPLUG_SAMPLE_INT32, src, 1, 8, NULL);
+    test_check(out32[0] > 2147483000 && out32[1] == INT32_MIN && out32[4] > 2147483000, "int32 clipping");
+
+    // Dither should average out, and never move a sample by a whole step or more
+    CplugDither dither;
+    cplug_dither_init(&dither, 42);
+    float   quiet[1000];
+    int16_t dithered[1000];
+    for (int i = 0; i < 1000; i++)
+        quiet[i] = 0.25f / 32768.0f;
+    src[0] = quiet;
+    cplug_interleave(dithered, CPLUG_SAMPLE_INT16, src, 1, 1000, &dither);
+    int sum = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        test_check(dithered[i] >= -1 && dithered[i] <= 1, "dither moved a sample by %d", dithered[i]);
+        sum += dithered[i];
+    }
+    test_check(sum > 150 && sum < 350, "dithered sum is %d, expected ~250", sum);
+
+    printf("clipping & dither ok\n");
+    return 0;
+}
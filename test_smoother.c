@@ -0,0 +1,161 @@
+// Ramps every smoother type through cplug_smoother_process, in one block and split into odd sized blocks, checking
+// ramp lengths, final values & the shape of each ramp against the per frame formula.
+// Usage: ./test_smoother
+#include <cplug.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define test_check(cond, ...)                                                                                          \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "test_smoother: " __VA_ARGS__);                                                                \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_TIME_MS     10.0f // 480 frames
+#define TEST_MAX_FRAMES  16384
+
+static const char* g_typeNames[] = {"NONE", "LINEAR", "ONE_POLE", "MULTIPLICATIVE"};
+
+static float g_out[TEST_MAX_FRAMES];
+
+// Runs 'numFrames' through the smoother in blocks of 'blockSize'. Returns the index of the first block that reported a
+// constant value, counted in frames, or numFrames if it never settled
+static uint32_t test_render(CplugSmoother* smoother, uint32_t numFrames, uint32_t blockSize)
+{
+    uint32_t settledFrame = numFrames;
+    for (uint32_t frame = 0; frame < numFrames; frame += blockSize)
+    {
+        uint32_t n = numFrames - frame < blockSize ? numFrames - frame : blockSize;
+        if (cplug_smoother_process(smoother, &g_out[frame], n))
+        {
+            for (uint32_t i = 0; i < n; i++)
+                g_out[frame + i] = smoother->current;
+            if (settledFrame == numFrames)
+                settledFrame = frame;
+        }
+    }
+    return settledFrame;
+}
+
+static void test_ramp(uint32_t type, float start, float target, uint32_t blockSize)
+{
+    const char* name = g_typeNames[type];
+
+    CplugSmoother smoother;
+    cplug_smoother_init(&smoother, type, TEST_TIME_MS, TEST_SAMPLE_RATE, start);
+    test_check(cplug_smoother_process(&smoother, g_out, 64), "%s: not constant before setting a target", name);
+
+    uint32_t rampFrames = smoother.rampFrames;
+    test_check(rampFrames == 480, "%s: ramp of %u frames, expected 480", name, rampFrames);
+
+    cplug_smoother_setTarget(&smoother, target);
+    uint32_t settledFrame = test_render(&smoother, TEST_MAX_FRAMES, blockSize);
+    test_check(smoother.current == target, "%s: ended at %g, expected %g", name, smoother.current, target);
+
+    if (type == CPLUG_SMOOTHER_NONE)
+    {
+        test_check(settledFrame == 0 && g_out[0] == target, "%s: didn't jump to the target", name);
+        return;
+    }
+
+    // Linear & multiplicative ramps last exactly rampFrames, then hold the target
+    uint32_t lastRampFrame = rampFrames - 1;
+    if (type == CPLUG_SMOOTHER_LINEAR || type == CPLUG_SMOOTHER_MULTIPLICATIVE)
+    {
+        for (uint32_t i = 0; i < rampFrames - 1; i++)
+            test_check(g_out[i] != target, "%s: reached the target at frame %u (block size %u)", name, i, blockSize);
+        for (uint32_t i = rampFrames; i < TEST_MAX_FRAMES; i++)
+            test_check(g_out[i] == target, "%s: frame %u is %g, expected the target", name, i, g_out[i]);
+        test_check(settledFrame <= rampFrames + blockSize, "%s: took %u frames to settle", name, settledFrame);
+    }
+    else
+    {
+        // 'timeMs' is the time constant, so a one pole covers 1 - 1/e of the distance in rampFrames
+        float covered = (g_out[lastRampFrame] - start) / (target - start);
+        test_check(fabsf(covered - (1.0f - expf(-1.0f))) < 1e-3f, "%s: covered %g in one time constant", name, covered);
+        test_check(smoother.remainingFrames == 0, "%s: never settled", name);
+        // It stops once it's within the threshold, even though the last frame it wrote isn't exactly on the target
+        float lastError = fabsf(g_out[TEST_MAX_FRAMES - 1] - target);
+        test_check(lastError <= 1e-5f * (fabsf(target) + 1e-3f), "%s: stopped %g from the target", name, lastError);
+    }
+
+    // Every ramp frame against the formula, evaluated in double
+    double step  = smoother.step;
+    double coeff = smoother.coefficient;
+    for (uint32_t i = 0; i <= lastRampFrame; i++)
+    {
+        double expected;
+        if (type == CPLUG_SMOOTHER_LINEAR)
+            expected = start + (target - start) * (double)(i + 1) / rampFrames;
+        else if (type == CPLUG_SMOOTHER_MULTIPLICATIVE)
+            expected = start * pow(step, i + 1);
+        else
+            expected = target + (start - target) * pow(coeff, i + 1);
+
+        double tolerance = 1e-4 * fabs(target - start);
+        test_check(
+            fabs(g_out[i] - expected) <= tolerance,
+            "%s: frame %u is %g, expected %g (block size %u)",
+            name,
+            i,
+            g_out[i],
+            expected,
+            blockSize);
+    }
+}
+
+int main()
+{
+    static const uint32_t blockSizes[] = {TEST_MAX_FRAMES, 1, 7, 64, 479, 480, 481};
+
+    for (uint32_t b = 0; b < sizeof(blockSizes) / sizeof(blockSizes[0]); b++)
+    {
+        for (uint32_t type = CPLUG_SMOOTHER_NONE; type <= CPLUG_SMOOTHER_MULTIPLICATIVE; type++)
+        {
+            test_ramp(type, 0.25f, 1.0f, blockSizes[b]);
+            test_ramp(type, 2.0f, 0.001f, blockSizes[b]);
+        }
+        test_ramp(CPLUG_SMOOTHER_LINEAR, 1.0f, -1.0f, blockSizes[b]);
+        test_ramp(CPLUG_SMOOTHER_ONE_POLE, -3.0f, 5.0f, blockSizes[b]);
+    }
+
+    // Ratios can't cross 0, so multiplicative smoothers fall back to a linear ramp
+    CplugSmoother smoother;
+    cplug_smoother_init(&smoother, CPLUG_SMOOTHER_MULTIPLICATIVE, TEST_TIME_MS, TEST_SAMPLE_RATE, 1.0f);
+    cplug_smoother_setTarget(&smoother, -1.0f);
+    test_check(smoother.rampType == CPLUG_SMOOTHER_LINEAR, "MULTIPLICATIVE: expected a linear ramp through 0");
+    test_render(&smoother, TEST_MAX_FRAMES, 64);
+    test_check(fabsf(g_out[239]) < 1e-5f && g_out[480] == -1.0f, "MULTIPLICATIVE: linear fallback ramped wrong");
+
+    // Setting the current value again doesn't start a ramp
+    cplug_smoother_setTarget(&smoother, -1.0f);
+    test_check(cplug_smoother_process(&smoother, g_out, 64), "Ramped to the value it already had");
+
+    // Parameter events set the target of their smoother
+    CplugSmoother       smoothers[2];
+    CplugProcessContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.smoothers    = smoothers;
+    ctx.numSmoothers = 2;
+    cplug_smoother_init(&smoothers[0], CPLUG_SMOOTHER_LINEAR, TEST_TIME_MS, TEST_SAMPLE_RATE, 0.0f);
+    cplug_smoother_init(&smoothers[1], CPLUG_SMOOTHER_LINEAR, TEST_TIME_MS, TEST_SAMPLE_RATE, 0.0f);
+
+    CplugEvent event;
+    memset(&event, 0, sizeof(event));
+    event.parameter.type  = CPLUG_EVENT_PARAM_CHANGE_UPDATE;
+    event.parameter.idx   = 1;
+    event.parameter.value = 0.5;
+    cplug_smoothers_handleEvent(&ctx, &event);
+    event.parameter.idx = 2; // Out of range, ignored
+    cplug_smoothers_handleEvent(&ctx, &event);
+    test_check(smoothers[0].target == 0.0f && smoothers[1].target == 0.5f, "Event set the wrong smoother");
+
+    printf("Smoothers match the reference\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Saves & loads a large synthetic state through cplug_state_buffer.h, checking every byte survives the round trip.
+// The reservation is kept small so the state outgrows it and the buffer has to move a few times.
+// Usage: ./test_state_buffer [stateSizeMB]
+#define CPLUG_STATE_BUFFER_RESERVE (64u << 20)
+#include <cplug_state_buffer.h>
+
+#include <stdio.h>
+#include <time.h>
+
+#define test_check(cond, ...)                                                                                          \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "test_state_buffer: " __VA_ARGS__);                                                            \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+static uint64_t test_nowNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t test_random(uint32_t* seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+// Byte expected at offset 'pos' of the state
+static uint8_t test_pattern(size_t pos) { return (uint8_t)((pos * 2654435761u) >> 13); }
+
+// Mix of tiny writes (headers, params) and big ones (samples), like a real plugin
+static size_t test_nextChunkSize(uint32_t* seed)
+{
+    uint32_t r = test_random(seed);
+    return (r & 7) == 0 ? (r >> 8) % (16u << 20) : 1 + (r >> 8) % 512;
+}
+
+static void test_writeState(CplugStateBuffer* buf, size_t stateSize, uint8_t* scratch, uint32_t seed)
+{
+    size_t written = 0;
+    while (written < stateSize)
+    {
+        size_t chunk = test_nextChunkSize(&seed);
+        if (chunk > stateSize - written)
+            chunk = stateSize - written;
+        for (size_t i = 0; i < chunk; i++)
+            scratch[i] = test_pattern(written + i);
+
+        int64_t ret = cplug_stateBuffer_writeProc(buf, scratch, chunk);
+        test_check(ret == (int64_t)chunk, "Failed writing %zu bytes at offset %zu", chunk, written);
+        written += chunk;
+    }
+    test_check(buf->bytesWritten == stateSize, "Wrote %zu bytes, expected %zu", buf->bytesWritten, stateSize);
+}
+
+static void test_readState(CplugStateBuffer* buf, size_t stateSize, uint8_t* scratch, uint32_t seed)
+{
+    size_t numRead = 0;
+    for (;;)
+    {
+        size_t  chunk = test_nextChunkSize(&seed);
+        int64_t ret   = cplug_stateBuffer_readProc(buf, scratch, chunk);
+        test_check(ret >= 0 && (size_t)ret <= chunk, "Read returned %lld", (long long)ret);
+        if (ret == 0)
+            break;
+        for (int64_t i = 0; i < ret; i++)
+            test_check(scratch[i] == test_pattern(numRead + i), "Corrupt byte at offset %zu", (size_t)(numRead + i));
+        numRead += ret;
+    }
+    test_check(numRead == stateSize, "Read %zu bytes, expected %zu", numRead, stateSize);
+}
+
+int main(int argc, char** argv)
+{
+    size_t stateSize = (size_t)(argc > 1 ? atoi(argv[1]) : 300) << 20;
+    test_check(stateSize > 0, "Usage: %s [stateSizeMB]", argv[0]);
+
+    uint8_t* scratch = (uint8_t*)malloc(16u << 20);
+    test_check(scratch != NULL, "Out of memory");
+
+    CplugStateBuffer buf;
+    memset(&buf, 0, sizeof(buf));
+
+    uint64_t writeStart = test_nowNS();
+    test_writeState(&buf, stateSize, scratch, 0x12345678);
+    uint64_t writeEnd = test_nowNS();
+    test_readState(&buf, stateSize, scratch, 0x87654321);
+    test_check(buf.bytesReserved > CPLUG_STATE_BUFFER_RESERVE, "Expected the buffer to outgrow its reservation");
+
+    // Saving the same state again must reuse the committed pages, and loading must be repeatable
+    size_t   bytesCommitted = buf.bytesCommitted;
+    uint8_t* data           = buf.data;
+    cplug_stateBuffer_reset(&buf);
+    uint64_t rewriteStart = test_nowNS();
+    test_writeState(&buf, stateSize, scratch, 0xdeadbeef);
+    uint64_t rewriteEnd = test_nowNS();
+    test_check(buf.data == data && buf.bytesCommitted == bytesCommitted, "Buffer grew when saving the same state");
+    test_readState(&buf, stateSize, scratch, 0xcafef00d);
+    buf.bytesRead = 0;
+    test_readState(&buf, stateSize, scratch, 0x0badf00d);
+
+    // Zero sized writes & reads are allowed
+    test_check(cplug_stateBuffer_writeProc(&buf, scratch, 0) == 0, "Zero sized write failed");
+    test_check(cplug_stateBuffer_readProc(&buf, scratch, 0) == 0, "Zero sized read failed");
+
+    printf(
+        "%zuMB state | first save %.2fms | second save %.2fms | reserved %zuMB | committed %zuMB\n",
+        stateSize >> 20,
+        (double)(writeEnd - writeStart) / 1e6,
+        (double)(rewriteEnd - rewriteStart) / 1e6,
+        buf.bytesReserved >> 20,
+        buf.bytesCommitted >> 20);
+
+    cplug_stateBuffer_free(&buf);
+    test_check(buf.data == NULL && buf.bytesReserved == 0, "Buffer not cleared after free");
+
+    // A small initial reservation grows by doubling & keeps its setting after free
+    buf.initialReserve = CPLUG_STATE_BUFFER_MIN_COMMIT;
+    test_writeState(&buf, 3u << 20, scratch, 0x13579bdf);
+    test_check(buf.bytesReserved < CPLUG_STATE_BUFFER_RESERVE, "Ignored the initial reservation");
+    test_readState(&buf, 3u << 20, scratch, 0x2468ace0);
+    cplug_stateBuffer_free(&buf);
+    test_check(buf.initialReserve == CPLUG_STATE_BUFFER_MIN_COMMIT, "Initial reservation cleared by free");
+    free(scratch);
+    return 0;
+}
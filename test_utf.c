@@ -0,0 +1,364 @@
+// Checks cplug_utf.h against a table driven reference: every scalar value round trips, every 1-3 byte sequence (and
+// a spread of 4 byte ones) decodes with the same replacements, every surrogate combination, and truncation at every
+// capacity. Characters are padded with ASCII so the vector fast paths are entered & left at every offset.
+// Usage: ./test_utf
+#include <cplug_utf.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define test_check(cond, ...)                                                                                          \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        fprintf(stderr, "test_utf: " __VA_ARGS__);                                                                     \
+        fprintf(stderr, "\n");                                                                                         \
+        exit(1);                                                                                                       \
+    }
+
+#define TEST_MAX_UNITS 256
+// Written past the capacity we hand out, to catch overflows
+#define TEST_GUARD 0x5a5a
+
+static uint64_t test_nowNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t test_random(uint32_t* seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static uint32_t test_encode8(uint8_t* dst, uint32_t cp)
+{
+    if (cp < 0x80)
+    {
+        dst[0] = (uint8_t)cp;
+        return 1;
+    }
+    if (cp < 0x800)
+    {
+        dst[0] = (uint8_t)(0xc0 | (cp >> 6));
+        dst[1] = (uint8_t)(0x80 | (cp & 0x3f));
+        return 2;
+    }
+    if (cp < 0x10000)
+    {
+        dst[0] = (uint8_t)(0xe0 | (cp >> 12));
+        dst[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+        dst[2] = (uint8_t)(0x80 | (cp & 0x3f));
+        return 3;
+    }
+    dst[0] = (uint8_t)(0xf0 | (cp >> 18));
+    dst[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3f));
+    dst[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+    dst[3] = (uint8_t)(0x80 | (cp & 0x3f));
+    return 4;
+}
+
+static uint32_t test_encode16(uint16_t* dst, uint32_t cp)
+{
+    if (cp < 0x10000)
+    {
+        dst[0] = (uint16_t)cp;
+        return 1;
+    }
+    dst[0] = (uint16_t)(0xd800 + ((cp - 0x10000) >> 10));
+    dst[1] = (uint16_t)(0xdc00 + ((cp - 0x10000) & 0x3ff));
+    return 2;
+}
+
+// Well formed byte sequences, straight from table 3-7 of the Unicode standard
+static const uint8_t g_wellFormed[9][4][2] = {
+    {{0x00, 0x7f}},
+    {{0xc2, 0xdf}, {0x80, 0xbf}},
+    {{0xe0, 0xe0}, {0xa0, 0xbf}, {0x80, 0xbf}},
+    {{0xe1, 0xec}, {0x80, 0xbf}, {0x80, 0xbf}},
+    {{0xed, 0xed}, {0x80, 0x9f}, {0x80, 0xbf}},
+    {{0xee, 0xef}, {0x80, 0xbf}, {0x80, 0xbf}},
+    {{0xf0, 0xf0}, {0x90, 0xbf}, {0x80, 0xbf}, {0x80, 0xbf}},
+    {{0xf1, 0xf3}, {0x80, 0xbf}, {0x80, 0xbf}, {0x80, 0xbf}},
+    {{0xf4, 0xf4}, {0x80, 0x8f}, {0x80, 0xbf}, {0x80, 0xbf}},
+};
+
+// Reference decoder. Finds the row matching the lead byte, then takes the longest run of bytes within the table's
+// ranges. A full row is a character, anything shorter is a maximal subpart and becomes 1 U+FFFD
+static uint32_t test_referenceUtf8To16(uint16_t* dst, const uint8_t* src, uint32_t srcLength)
+{
+    uint32_t numUnits = 0;
+    uint32_t pos      = 0;
+    while (pos < srcLength && src[pos] != 0)
+    {
+        uint32_t numMatched = 0, rowLength = 0;
+        for (int row = 0; row < 9 && numMatched == 0; row++)
+        {
+            rowLength = row == 0 ? 1 : row == 1 ? 2 : row < 6 ? 3 : 4;
+            while (numMatched < rowLength && pos + numMatched < srcLength &&
+                   src[pos + numMatched] >= g_wellFormed[row][numMatched][0] &&
+                   src[pos + numMatched] <= g_wellFormed[row][numMatched][1])
+                numMatched++;
+        }
+        if (numMatched == rowLength)
+        {
+            uint32_t cp = numMatched == 1 ? src[pos] : src[pos] & (0x7f >> numMatched);
+            for (uint32_t i = 1; i < numMatched; i++)
+                cp = (cp << 6) | (src[pos + i] & 0x3f);
+            numUnits += test_encode16(dst + numUnits, cp);
+        }
+        else
+        {
+            dst[numUnits++] = CPLUG_UTF_REPLACEMENT_CHARACTER;
+        }
+        pos += numMatched ? numMatched : 1;
+    }
+    return numUnits;
+}
+
+// Converts with plenty of room and checks nothing past the capacity was touched
+static uint32_t test_utf8To16(uint16_t* dst, const uint8_t* src, uint32_t srcLength)
+{
+    dst[TEST_MAX_UNITS] = TEST_GUARD;
+    uint32_t n          = cplug_utf8To16(dst, TEST_MAX_UNITS, (const char*)src, srcLength);
+    test_check(n < TEST_MAX_UNITS && dst[n] == 0, "Missing terminator");
+    test_check(dst[TEST_MAX_UNITS] == TEST_GUARD, "Wrote past the capacity");
+    return n;
+}
+
+static uint32_t test_utf16To8(uint8_t* dst, const uint16_t* src, uint32_t srcLength)
+{
+    dst[TEST_MAX_UNITS] = TEST_GUARD & 0xff;
+    uint32_t n          = cplug_utf16To8((char*)dst, TEST_MAX_UNITS, src, srcLength);
+    test_check(n < TEST_MAX_UNITS && dst[n] == 0, "Missing terminator");
+    test_check(dst[TEST_MAX_UNITS] == (TEST_GUARD & 0xff), "Wrote past the capacity");
+    return n;
+}
+
+// Puts 'bytes' after 'pad' ASCII characters & before 40 more, then compares against the reference
+static void test_checkBytes(const uint8_t* bytes, uint32_t numBytes, uint32_t pad)
+{
+    uint8_t  src[128];
+    uint16_t expected[TEST_MAX_UNITS], actual[TEST_MAX_UNITS + 1];
+    memset(src, 'a', sizeof(src));
+    memcpy(src + pad, bytes, numBytes);
+    uint32_t srcLength = pad + numBytes + 40;
+
+    uint32_t numExpected = test_referenceUtf8To16(expected, src, srcLength);
+    uint32_t numActual   = test_utf8To16(actual, src, srcLength);
+    test_check(
+        numActual == numExpected && ! memcmp(actual, expected, numExpected * 2),
+        "Mismatch decoding %02x %02x %02x %02x (%u bytes) at offset %u",
+        bytes[0],
+        numBytes > 1 ? bytes[1] : 0,
+        numBytes > 2 ? bytes[2] : 0,
+        numBytes > 3 ? bytes[3] : 0,
+        numBytes,
+        pad);
+}
+
+static void test_roundTripScalarValues()
+{
+    uint8_t  utf8[128], utf8Back[TEST_MAX_UNITS + 1];
+    uint16_t utf16[128], utf16Back[TEST_MAX_UNITS + 1];
+    for (uint32_t cp = 1; cp <= 0x10ffff; cp++)
+    {
+        if (cp >= 0xd800 && cp <= 0xdfff)
+            continue;
+
+        uint32_t pad = cp % 37;
+        memset(utf8, 'x', sizeof(utf8));
+        for (int i = 0; i < 128; i++)
+            utf16[i] = 'x';
+        uint32_t len8  = pad + test_encode8(utf8 + pad, cp) + 33;
+        uint32_t len16 = pad + test_encode16(utf16 + pad, cp) + 33;
+
+        uint32_t n16 = test_utf8To16(utf16Back, utf8, len8);
+        test_check(n16 == len16 && ! memcmp(utf16Back, utf16, len16 * 2), "U+%04X failed converting to UTF-16", cp);
+        uint32_t n8 = test_utf16To8(utf8Back, utf16, len16);
+        test_check(n8 == len8 && ! memcmp(utf8Back, utf8, len8), "U+%04X failed converting to UTF-8", cp);
+    }
+}
+
+static void test_allShortSequences()
+{
+    uint8_t bytes[4];
+    for (uint32_t i = 1; i < (1u << 24); i++)
+    {
+        bytes[0] = (uint8_t)(i >> 16);
+        bytes[1] = (uint8_t)(i >> 8);
+        bytes[2] = (uint8_t)i;
+        if (bytes[0] == 0)
+            continue; // Covered by the shorter lengths below
+        test_checkBytes(bytes, 3, i % 37);
+    }
+    for (uint32_t i = 1; i < (1u << 16); i++)
+    {
+        bytes[0] = (uint8_t)(i >> 8);
+        bytes[1] = (uint8_t)i;
+        if (bytes[0] != 0)
+            test_checkBytes(bytes, 2, i % 37);
+        // A truncated sequence right at the end of the input
+        uint8_t src[2] = {bytes[0], bytes[1]};
+        if (src[0] != 0)
+        {
+            uint16_t expected[8], actual[TEST_MAX_UNITS + 1];
+            uint32_t numExpected = test_referenceUtf8To16(expected, src, 2);
+            uint32_t numActual   = test_utf8To16(actual, src, 2);
+            test_check(numActual == numExpected && ! memcmp(actual, expected, numExpected * 2), "Mismatch at end");
+        }
+    }
+}
+
+static void test_fourByteSequences()
+{
+    static const uint8_t interesting[] = {0x00, 0x41, 0x7f, 0x80, 0x8f, 0x90, 0x9f, 0xa0, 0xbf, 0xc0, 0xf4, 0xff};
+    const uint32_t       numInteresting = sizeof(interesting);
+
+    uint8_t bytes[4];
+    for (uint32_t b0 = 0xf0; b0 <= 0xff; b0++)
+        for (uint32_t b1 = 0; b1 < 256; b1++)
+            for (uint32_t i = 0; i < numInteresting * numInteresting; i++)
+            {
+                bytes[0] = (uint8_t)b0;
+                bytes[1] = (uint8_t)b1;
+                bytes[2] = interesting[i / numInteresting];
+                bytes[3] = interesting[i % numInteresting];
+                test_checkBytes(bytes, 4, (b1 + i) % 37);
+            }
+}
+
+static void test_surrogates()
+{
+    // Every pair of units in & around the surrogate range. Pairs must combine, lone halves become U+FFFD
+    uint16_t src[128];
+    uint8_t  actual[TEST_MAX_UNITS + 1], expected[128];
+    for (uint32_t u0 = 0xd7fe; u0 <= 0xe001; u0++)
+        for (uint32_t u1 = 0xd7fe; u1 <= 0xe001; u1++)
+        {
+            uint32_t pad = (u0 + u1) % 37;
+            for (int i = 0; i < 128; i++)
+                src[i] = 'y';
+            src[pad]     = (uint16_t)u0;
+            src[pad + 1] = (uint16_t)u1;
+
+            memset(expected, 'y', sizeof(expected));
+            uint32_t numExpected = pad;
+            bool     isHigh0 = u0 >= 0xd800 && u0 <= 0xdbff, isLow0 = u0 >= 0xdc00 && u0 <= 0xdfff;
+            bool     isHigh1 = u1 >= 0xd800 && u1 <= 0xdbff, isLow1 = u1 >= 0xdc00 && u1 <= 0xdfff;
+            if (isHigh0 && isLow1)
+            {
+                numExpected += test_encode8(expected + numExpected, 0x10000 + ((u0 - 0xd800) << 10) + (u1 - 0xdc00));
+            }
+            else
+            {
+                numExpected += test_encode8(expected + numExpected, isHigh0 || isLow0 ? 0xfffd : u0);
+                numExpected += test_encode8(expected + numExpected, isHigh1 || isLow1 ? 0xfffd : u1);
+            }
+            numExpected += 33;
+
+            uint32_t numActual = test_utf16To8(actual, src, pad + 2 + 33);
+            test_check(
+                numActual == numExpected && ! memcmp(actual, expected, numExpected),
+                "Mismatch converting %04x %04x",
+                u0,
+                u1);
+        }
+
+    // A high surrogate as the very last unit
+    src[0] = 0xd800;
+    test_check(test_utf16To8(actual, src, 1) == 3 && ! memcmp(actual, "\xef\xbf\xbd", 3), "Lone surrogate at end");
+}
+
+static void test_truncation()
+{
+    // Random mixes of 1 to 4 byte characters, converted at every capacity. The output must always be the longest
+    // prefix of whole characters that fits, null terminated, without touching anything past the capacity
+    uint32_t seed = 0x1234567;
+    for (int iteration = 0; iteration < 2000; iteration++)
+    {
+        uint8_t  utf8[512];
+        uint16_t utf16[256];
+        uint32_t ends8[128], ends16[128];
+        uint32_t len8 = 0, len16 = 0, numChars = 1 + test_random(&seed) % 100;
+        for (uint32_t i = 0; i < numChars; i++)
+        {
+            uint32_t r  = test_random(&seed);
+            uint32_t cp = (r & 3) == 0 ? 1 + (r >> 8) % 0x7f : (r & 3) == 1 ? 0x80 + (r >> 8) % 0x780
+                        : (r & 3) == 2 ? 0xe000 + (r >> 8) % 0x2000
+                                       : 0x10000 + (r >> 8) % 0x100000;
+            if (r & 0x80)
+                cp = 'a' + (r >> 24) % 26; // Plenty of ASCII runs
+            len8      += test_encode8(utf8 + len8, cp);
+            len16     += test_encode16(utf16 + len16, cp);
+            ends8[i]   = len8;
+            ends16[i]  = len16;
+        }
+
+        for (uint32_t capacity = 0; capacity <= len16 + 2; capacity++)
+        {
+            uint16_t out[260];
+            for (int i = 0; i < 260; i++)
+                out[i] = TEST_GUARD;
+            uint32_t n        = cplug_utf8To16(out, capacity, (const char*)utf8, len8);
+            uint32_t expected = 0;
+            for (uint32_t i = 0; i < numChars && ends16[i] < capacity; i++)
+                expected = ends16[i];
+            test_check(n == expected, "UTF-16 capacity %u: wrote %u units, expected %u", capacity, n, expected);
+            test_check(capacity == 0 || out[n] == 0, "UTF-16 capacity %u: missing terminator", capacity);
+            test_check(! memcmp(out, utf16, n * 2), "UTF-16 capacity %u: wrong prefix", capacity);
+            test_check(out[capacity] == TEST_GUARD, "UTF-16 capacity %u: overflow", capacity);
+        }
+        for (uint32_t capacity = 0; capacity <= len8 + 2; capacity++)
+        {
+            uint8_t out[520];
+            memset(out, TEST_GUARD & 0xff, sizeof(out));
+            uint32_t n        = cplug_utf16To8((char*)out, capacity, utf16, len16);
+            uint32_t expected = 0;
+            for (uint32_t i = 0; i < numChars && ends8[i] < capacity; i++)
+                expected = ends8[i];
+            test_check(n == expected, "UTF-8 capacity %u: wrote %u bytes, expected %u", capacity, n, expected);
+            test_check(capacity == 0 || out[n] == 0, "UTF-8 capacity %u: missing terminator", capacity);
+            test_check(! memcmp(out, utf8, n), "UTF-8 capacity %u: wrong prefix", capacity);
+            test_check(out[capacity] == (TEST_GUARD & 0xff), "UTF-8 capacity %u: overflow", capacity);
+        }
+    }
+}
+
+static void test_nullTerminators()
+{
+    // Conversion stops at a null before the given length, including inside a vector sized run
+    uint16_t out16[TEST_MAX_UNITS + 1];
+    uint8_t  out8[TEST_MAX_UNITS + 1];
+    for (uint32_t pos = 0; pos < 100; pos++)
+    {
+        uint8_t  src8[100];
+        uint16_t src16[100];
+        memset(src8, 'z', sizeof(src8));
+        for (int i = 0; i < 100; i++)
+            src16[i] = 'z';
+        src8[pos]  = 0;
+        src16[pos] = 0;
+        test_check(test_utf8To16(out16, src8, 100) == pos, "UTF-8 null at %u ignored", pos);
+        test_check(test_utf16To8(out8, src16, 100) == pos, "UTF-16 null at %u ignored", pos);
+    }
+}
+
+int main()
+{
+    uint64_t start = test_nowNS();
+    test_roundTripScalarValues();
+    test_allShortSequences();
+    test_fourByteSequences();
+    test_surrogates();
+    test_truncation();
+    test_nullTerminators();
+    printf("All UTF tests passed in %.2fs\n", (double)(test_nowNS() - start) / 1e9);
+    return 0;
+}